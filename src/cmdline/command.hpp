@@ -33,6 +33,8 @@ enum class command
     ls,
     put,
     get,
+    reput,
+    reget,
     pwd,
     mkdir,
     rmdir,
@@ -40,6 +42,7 @@ enum class command
     stat,
     syst,
     binary,
+    ascii,
     size,
     noop,
     close,
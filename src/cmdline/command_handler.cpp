@@ -70,6 +70,14 @@ void command_handler::handle(command command, const vector<string> & args)
     {
         get(args);
     }
+    else if (command == command::reput)
+    {
+        reput(args);
+    }
+    else if (command == command::reget)
+    {
+        reget(args);
+    }
     else if (command == command::pwd)
     {
         pwd();
@@ -98,6 +106,10 @@ void command_handler::handle(command command, const vector<string> & args)
     {
         binary();
     }
+    else if (command == command::ascii)
+    {
+        ascii();
+    }
     else if (command == command::size)
     {
         size(args);
@@ -294,6 +306,60 @@ void command_handler::get(const vector<string> & args)
     ftp_client_.download(remote_file, local_file);
 }
 
+void command_handler::reput(const vector<string> & args)
+{
+    string local_file, remote_file;
+
+    if (args.empty())
+    {
+        local_file = utils::read_line("local-file: ");
+        remote_file = utils::get_filename(local_file);
+    }
+    else if (args.size() == 1)
+    {
+        local_file = args[0];
+        remote_file = utils::get_filename(local_file);
+    }
+    else if (args.size() == 2)
+    {
+        local_file = args[0];
+        remote_file = args[1];
+    }
+    else
+    {
+        throw cmdline_exception("usage: reput local-file [ remote-file ]");
+    }
+
+    ftp_client_.resume_upload(local_file, remote_file);
+}
+
+void command_handler::reget(const vector<string> & args)
+{
+    string remote_file, local_file;
+
+    if (args.empty())
+    {
+        remote_file = utils::read_line("remote-file: ");
+        local_file = utils::get_filename(remote_file);
+    }
+    else if (args.size() == 1)
+    {
+        remote_file = args[0];
+        local_file = utils::get_filename(remote_file);
+    }
+    else if (args.size() == 2)
+    {
+        remote_file = args[0];
+        local_file = args[1];
+    }
+    else
+    {
+        throw cmdline_exception("usage: reget remote-file [ local-file ]");
+    }
+
+    ftp_client_.resume_download(remote_file, local_file);
+}
+
 void command_handler::pwd()
 {
     ftp_client_.pwd();
@@ -364,6 +430,11 @@ void command_handler::binary()
     ftp_client_.binary();
 }
 
+void command_handler::ascii()
+{
+    ftp_client_.ascii();
+}
+
 void command_handler::size(const vector<string> & args)
 {
     string remote_file;
@@ -425,11 +496,14 @@ void command_handler::help()
         "  ls [ remote-directory ] - print list of files in the remote directory\n"
         "  put local-file [ remote-file ] - store a file at the server\n"
         "  get remote-file [ local-file ] - retrieve a copy of the file\n"
+        "  reput local-file [ remote-file ] - continue storing a file at the server\n"
+        "  reget remote-file [ local-file ] - continue retrieving a copy of the file\n"
         "  pwd - print the current working directory name\n"
         "  mkdir directory-name - make a directory on the remote machine\n"
         "  rmdir directory-name - remove a directory\n"
         "  del remote-file - delete a file\n"
         "  binary - set binary transfer type\n"
+        "  ascii - set ascii transfer type\n"
         "  size remote-file - show size of remote file\n"
         "  stat [ remote-file ] - print server information\n"
         "  syst - show remote system type\n"
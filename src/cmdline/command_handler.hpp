@@ -51,6 +51,10 @@ private:
 
     void get(const std::vector<std::string> & args);
 
+    void reput(const std::vector<std::string> & args);
+
+    void reget(const std::vector<std::string> & args);
+
     void pwd();
 
     void mkdir(const std::vector<std::string> & args);
@@ -61,6 +65,8 @@ private:
 
     void binary();
 
+    void ascii();
+
     void size(const std::vector<std::string> & args);
 
     void stat(const std::vector<std::string> & args);
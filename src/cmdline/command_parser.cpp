@@ -64,6 +64,14 @@ static command get_command_from_string(const string & str)
     {
         return command::get;
     }
+    else if (boost::iequals(str, "reput"))
+    {
+        return command::reput;
+    }
+    else if (boost::iequals(str, "reget"))
+    {
+        return command::reget;
+    }
     else if (boost::iequals(str, "pwd"))
     {
         return command::pwd;
@@ -92,6 +100,10 @@ static command get_command_from_string(const string & str)
     {
         return command::binary;
     }
+    else if (boost::iequals(str, "ascii"))
+    {
+        return command::ascii;
+    }
     else if (boost::iequals(str, "size"))
     {
         return command::size;
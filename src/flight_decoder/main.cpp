@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ftp/flight_recorder.hpp"
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::exception;
+using std::ifstream;
+using std::vector;
+
+/* Prints flight records dumped by ftp::client as timelines, each event
+ * with the time since the first one.
+ *
+ * Usage: ftp_flight_decoder dump...
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 2)
+    {
+        cerr << "Usage: " << argv[0] << " dump..." << endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        for (int i = 1; i < argc; i++)
+        {
+            ifstream file(argv[i], std::ios_base::binary);
+
+            if (!file)
+            {
+                cerr << "Cannot open file '" << argv[i] << "'." << endl;
+                return EXIT_FAILURE;
+            }
+
+            vector<ftp::flight_event> events = ftp::flight_recorder::load(file);
+
+            cout << argv[i] << ": " << events.size() << " events" << endl;
+
+            for (const ftp::flight_event & event : events)
+            {
+                std::chrono::duration<double> offset = event.time - events.front().time;
+                char prefix[32];
+
+                std::snprintf(prefix, sizeof(prefix), "%+12.6f ", offset.count());
+
+                cout << prefix << ftp::flight_recorder::to_string(event) << endl;
+            }
+        }
+    }
+    catch (const exception & ex)
+    {
+        cerr << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
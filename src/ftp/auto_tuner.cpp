@@ -0,0 +1,285 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "auto_tuner.hpp"
+#include "ftp_exception.hpp"
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+namespace ftp
+{
+
+using std::string;
+using std::size_t;
+using std::uint64_t;
+using std::lock_guard;
+using std::mutex;
+using std::chrono::microseconds;
+
+/* A transfer held back by a full buffer for this part of the time it was
+ * busy needs a larger one.
+ */
+static const double buffer_limited_share = 0.1;
+
+/* The largest buffers autotuning grows to, the smaller of the receive and
+ * the send ones.
+ */
+static size_t system_autotuning_limit()
+{
+#ifdef __linux__
+    size_t limit = 0;
+
+    for (const char *path : {"/proc/sys/net/ipv4/tcp_rmem", "/proc/sys/net/ipv4/tcp_wmem"})
+    {
+        std::ifstream file(path);
+        size_t min, initial, max;
+
+        if (file >> min >> initial >> max && max > 0)
+        {
+            limit = limit == 0 ? max : std::min(limit, max);
+        }
+    }
+
+    if (limit > 0)
+    {
+        return limit;
+    }
+#endif
+
+    return auto_tuner::default_autotuning_limit;
+}
+
+auto_tuner::auto_tuner(size_t max_sessions)
+    : max_sessions_(std::max<size_t>(max_sessions, 1)),
+      autotuning_limit_(system_autotuning_limit())
+{
+}
+
+void auto_tuner::set_autotuning_limit(size_t size)
+{
+    lock_guard<mutex> lock(mutex_);
+    autotuning_limit_ = size;
+}
+
+auto_tuner::settings auto_tuner::get(const string & hostname) const
+{
+    lock_guard<mutex> lock(mutex_);
+
+    auto it = hosts_.find(hostname);
+
+    if (it == hosts_.end())
+    {
+        return settings();
+    }
+
+    return it->second.current;
+}
+
+void auto_tuner::record_transfer(const string & hostname,
+                                 uint64_t bytes,
+                                 const tcp_statistics & tcp,
+                                 size_t sessions)
+{
+    if (bytes == 0 || !tcp.available || tcp.end.elapsed <= microseconds::zero())
+    {
+        return;
+    }
+
+    double throughput = bytes / std::chrono::duration<double>(tcp.end.elapsed).count();
+
+    lock_guard<mutex> lock(mutex_);
+
+    host & host = hosts_[hostname];
+
+    tune_buffer(host, bytes, tcp);
+
+    /* Only transfers at the level being measured tell its throughput. */
+    if (sessions == host.current.sessions)
+    {
+        tune_sessions(host, throughput * sessions);
+    }
+}
+
+void auto_tuner::tune_buffer(host & host, uint64_t bytes, const tcp_statistics & tcp)
+{
+    /* The kernel caps explicit sizes, e.g. at rmem_max and wmem_max on
+     * Linux, without an error.
+     */
+    if (host.current.socket_buffer_size > 0 && tcp.socket_buffer_size > 0 &&
+        tcp.socket_buffer_size < host.current.socket_buffer_size)
+    {
+        host.buffer_cap = tcp.socket_buffer_size;
+    }
+
+    /* The first periodic sample is taken once slow start is over. */
+    const tcp_sample & early = tcp.samples.empty() ? tcp.end : tcp.samples.front();
+
+    /* The receiver of a download only knows the RTT of its own estimate. */
+    microseconds rtt = std::max(early.rtt, early.receive_rtt);
+
+    if (rtt <= microseconds::zero())
+    {
+        return;
+    }
+
+    double throughput = bytes / std::chrono::duration<double>(tcp.end.elapsed).count();
+    uint64_t bdp = static_cast<uint64_t>(throughput * std::chrono::duration<double>(rtt).count());
+
+    /* A transfer is at most as fast as the path, so the largest estimate
+     * is the closest one.
+     */
+    host.current.bandwidth_delay_product = std::max(host.current.bandwidth_delay_product, bdp);
+
+    size_t size = static_cast<size_t>(std::min<uint64_t>(2 * host.current.bandwidth_delay_product,
+                                                         max_socket_buffer_size));
+
+    const tcp_sample & end = tcp.end;
+
+    if (end.busy_time > microseconds::zero() &&
+        (end.rwnd_limited + end.sndbuf_limited).count() > buffer_limited_share * end.busy_time.count())
+    {
+        size_t current = tcp.socket_buffer_size > 0 ? tcp.socket_buffer_size : autotuning_limit_;
+        size = std::max(size, std::min(2 * current, max_socket_buffer_size));
+    }
+
+    if (host.buffer_cap > 0)
+    {
+        size = std::min(size, host.buffer_cap);
+    }
+
+    /* Autotuning gets there by itself, and adapts the size as it goes. */
+    host.current.socket_buffer_size = size > autotuning_limit_ ? size : 0;
+}
+
+void auto_tuner::tune_sessions(host & host, double throughput)
+{
+    host.throughput_sum += throughput;
+
+    if (++host.transfers < transfers_per_level)
+    {
+        return;
+    }
+
+    double average = host.throughput_sum / host.transfers;
+
+    host.throughput_sum = 0;
+    host.transfers = 0;
+
+    if (host.settled)
+    {
+        if (std::abs(average - host.best_throughput) <= host.best_throughput * min_gain)
+        {
+            return;
+        }
+
+        /* The path has changed, look for the best level again from here. */
+        host.settled = false;
+        host.best_throughput = 0;
+    }
+
+    if (average < host.best_throughput * (1 + min_gain))
+    {
+        host.current.sessions = host.best_sessions;
+        host.settled = true;
+        return;
+    }
+
+    host.best_throughput = average;
+    host.best_sessions = host.current.sessions;
+
+    if (host.current.sessions < max_sessions_)
+    {
+        host.current.sessions++;
+    }
+    else
+    {
+        host.settled = true;
+    }
+}
+
+/* A line per host: hostname, sessions, socket buffer size and BDP. */
+bool auto_tuner::load(const string & path)
+{
+    std::ifstream file(path);
+
+    if (!file)
+    {
+        return false;
+    }
+
+    lock_guard<mutex> lock(mutex_);
+
+    string line;
+
+    while (std::getline(file, line))
+    {
+        if (line.empty())
+        {
+            continue;
+        }
+
+        std::istringstream fields(line);
+        string hostname;
+        host host;
+
+        if (!(fields >> hostname >> host.current.sessions >> host.current.socket_buffer_size
+                     >> host.current.bandwidth_delay_product) ||
+            host.current.sessions == 0)
+        {
+            throw ftp_exception("Cannot parse tuning settings '%1%'.", line);
+        }
+
+        /* A start, measured and ramped up from like any other level. */
+        host.current.sessions = std::min(host.current.sessions, max_sessions_);
+        host.best_sessions = host.current.sessions;
+
+        hosts_[hostname] = host;
+    }
+
+    return true;
+}
+
+void auto_tuner::save(const string & path) const
+{
+    std::ofstream file(path, std::ios_base::trunc);
+
+    lock_guard<mutex> lock(mutex_);
+
+    for (const auto & [hostname, host] : hosts_)
+    {
+        file << hostname << " " << host.current.sessions << " " << host.current.socket_buffer_size
+             << " " << host.current.bandwidth_delay_product << "\n";
+    }
+
+    file.flush();
+
+    if (!file)
+    {
+        throw ftp_exception("Cannot write tuning settings to '%1%'.", path);
+    }
+}
+
+} // namespace ftp
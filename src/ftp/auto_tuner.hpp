@@ -0,0 +1,154 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_AUTO_TUNER_HPP
+#define FTP_AUTO_TUNER_HPP
+
+#include "tcp_statistics.hpp"
+#include <chrono>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp
+{
+
+/* Learns the number of parallel sessions and the socket buffer size for
+ * each host from finished transfers.
+ *
+ * The bandwidth-delay product is the throughput of a session times the RTT
+ * seen early in the transfer. The socket buffers are left to the kernel's
+ * autotuning unless they need to be larger than it would make them, twice
+ * the BDP, or twice their size for transfers held back by a full buffer.
+ * A size the kernel caps below that is not asked for again, as an explicit
+ * size turns autotuning off.
+ *
+ * The sessions ramp up one at a time, each level measured over a few
+ * transfers. Once another session adds less than min_gain to the total
+ * throughput, the host settles at the best level. It keeps measuring there,
+ * and ramps up again when the throughput changes by more than min_gain.
+ *
+ * The learned settings can be saved and loaded, so that the next run starts
+ * where this one ended and goes on adapting from there.
+ */
+class auto_tuner
+{
+public:
+    struct settings
+    {
+        settings()
+            : sessions(1),
+              socket_buffer_size(0),
+              bandwidth_delay_product(0)
+        {
+        }
+
+        std::size_t sessions;
+
+        /* Zero leaves the system default. */
+        std::size_t socket_buffer_size;
+
+        /* Bytes, zero if not known yet. */
+        std::uint64_t bandwidth_delay_product;
+    };
+
+    explicit auto_tuner(std::size_t max_sessions = default_max_sessions);
+
+    /* The largest buffers the kernel's autotuning grows to, read from the
+     * system where it tells, e.g. tcp_rmem and tcp_wmem on Linux.
+     */
+    void set_autotuning_limit(std::size_t size);
+
+    auto_tuner(const auto_tuner &) = delete;
+
+    auto_tuner & operator=(const auto_tuner &) = delete;
+
+    settings get(const std::string & hostname) const;
+
+    /* Takes a transfer of 'bytes' that finished while 'sessions' sessions
+     * with the host were open. Transfers without TCP_INFO are ignored.
+     */
+    void record_transfer(const std::string & hostname,
+                         std::uint64_t bytes,
+                         const tcp_statistics & tcp,
+                         std::size_t sessions);
+
+    /* Returns false if the file doesn't exist. Throws ftp_exception if it's
+     * malformed.
+     */
+    bool load(const std::string & path);
+
+    void save(const std::string & path) const;
+
+    static constexpr std::size_t default_max_sessions = 8;
+
+    /* Transfers measured at each level of sessions. */
+    static constexpr unsigned int transfers_per_level = 3;
+
+    static constexpr double min_gain = 0.1;
+
+    static constexpr std::size_t default_autotuning_limit = 4 * 1024 * 1024;
+
+    static constexpr std::size_t max_socket_buffer_size = 32 * 1024 * 1024;
+
+private:
+    struct host
+    {
+        host()
+            : best_throughput(0),
+              best_sessions(1),
+              throughput_sum(0),
+              transfers(0),
+              settled(false),
+              buffer_cap(0)
+        {
+        }
+
+        settings current;
+        double best_throughput;
+        std::size_t best_sessions;
+
+        /* Total throughput of the transfers at the current level. */
+        double throughput_sum;
+        unsigned int transfers;
+        bool settled;
+
+        /* The size the kernel capped the buffers at, zero if it didn't. */
+        std::size_t buffer_cap;
+    };
+
+    void tune_buffer(host & host, std::uint64_t bytes, const tcp_statistics & tcp);
+
+    void tune_sessions(host & host, double throughput);
+
+    mutable std::mutex mutex_;
+    std::unordered_map<std::string, host> hosts_;
+    std::size_t max_sessions_;
+    std::size_t autotuning_limit_;
+};
+
+} // namespace ftp
+#endif //FTP_AUTO_TUNER_HPP
@@ -0,0 +1,263 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "buffer_pool.hpp"
+#include <cstdlib>
+#include <new>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#endif
+
+namespace ftp
+{
+
+using std::size_t;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+
+static size_t round_up(size_t size, size_t alignment)
+{
+    return (size + alignment - 1) / alignment * alignment;
+}
+
+buffer_pool::buffer::buffer(buffer_pool *pool, const block & block)
+    : pool_(pool),
+      block_(block)
+{
+}
+
+buffer_pool::buffer::buffer(buffer && other) noexcept
+    : pool_(other.pool_),
+      block_(other.block_)
+{
+    other.pool_ = nullptr;
+}
+
+buffer_pool::buffer::~buffer()
+{
+    if (pool_)
+    {
+        pool_->release(block_);
+    }
+}
+
+char * buffer_pool::buffer::data() const
+{
+    return block_.data;
+}
+
+size_t buffer_pool::buffer::size() const
+{
+    return block_.size;
+}
+
+buffer_pool & buffer_pool::instance()
+{
+    static buffer_pool pool;
+    return pool;
+}
+
+buffer_pool::buffer_pool()
+    : buffer_size_(default_buffer_size),
+      memory_budget_(default_memory_budget),
+      allocated_(0),
+      huge_pages_(false)
+{
+}
+
+buffer_pool::~buffer_pool()
+{
+    for (const block & block : idle_)
+    {
+        deallocate(block);
+    }
+}
+
+void buffer_pool::configure(size_t buffer_size, size_t memory_budget, bool huge_pages)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    huge_pages_ = huge_pages;
+    buffer_size_ = round_up(std::max<size_t>(buffer_size, 1), huge_pages ? huge_page_size : page_size);
+    memory_budget_ = memory_budget;
+
+    for (const block & block : idle_)
+    {
+        allocated_ -= block.size;
+        deallocate(block);
+    }
+
+    idle_.clear();
+
+    /* Waiting transfers may fit into the new budget. */
+    released_.notify_all();
+}
+
+buffer_pool::buffer buffer_pool::acquire()
+{
+    return std::move(acquire(1).front());
+}
+
+std::vector<buffer_pool::buffer> buffer_pool::acquire(size_t count)
+{
+    unique_lock<mutex> lock(mutex_);
+
+    /* Idle buffers are always of the current size. */
+    released_.wait(lock, [&]()
+    {
+        size_t in_use = allocated_ - idle_.size() * buffer_size_;
+        size_t allocatable = allocated_ < memory_budget_ ? (memory_budget_ - allocated_) / buffer_size_ : 0;
+
+        return in_use == 0 || idle_.size() + allocatable >= count;
+    });
+
+    std::vector<block> blocks;
+    blocks.reserve(count);
+
+    while (blocks.size() < count && !idle_.empty())
+    {
+        blocks.push_back(idle_.back());
+        idle_.pop_back();
+    }
+
+    try
+    {
+        while (blocks.size() < count)
+        {
+            blocks.push_back(allocate());
+            allocated_ += blocks.back().size;
+        }
+    }
+    catch (...)
+    {
+        idle_.insert(idle_.end(), blocks.begin(), blocks.end());
+        throw;
+    }
+
+    lock.unlock();
+
+    std::vector<buffer> buffers;
+    buffers.reserve(count);
+
+    for (const block & block : blocks)
+    {
+        buffers.push_back(buffer(this, block));
+    }
+
+    return buffers;
+}
+
+size_t buffer_pool::buffer_size() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return buffer_size_;
+}
+
+size_t buffer_pool::memory_budget() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return memory_budget_;
+}
+
+size_t buffer_pool::allocated() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return allocated_;
+}
+
+void buffer_pool::release(const block & block)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    if (block.size == buffer_size_ && allocated_ <= memory_budget_)
+    {
+        idle_.push_back(block);
+    }
+    else
+    {
+        /* The pool has been reconfigured since the buffer was borrowed. */
+        allocated_ -= block.size;
+        deallocate(block);
+    }
+
+    /* Wake everybody: a transfer waiting for several buffers may not fit
+     * yet while one waiting for a single buffer does.
+     */
+    released_.notify_all();
+}
+
+buffer_pool::block buffer_pool::allocate() const
+{
+#ifdef __linux__
+    if (huge_pages_)
+    {
+        /* Explicit huge pages need to be reserved by the administrator.
+         * If there are none, ask for transparent huge pages instead.
+         */
+        void *data = mmap(nullptr, buffer_size_, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (data == MAP_FAILED)
+        {
+            data = mmap(nullptr, buffer_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+            if (data == MAP_FAILED)
+            {
+                throw std::bad_alloc();
+            }
+
+            madvise(data, buffer_size_, MADV_HUGEPAGE);
+        }
+
+        return block{static_cast<char *>(data), buffer_size_, true};
+    }
+#endif
+
+    void *data = std::aligned_alloc(page_size, buffer_size_);
+
+    if (!data)
+    {
+        throw std::bad_alloc();
+    }
+
+    return block{static_cast<char *>(data), buffer_size_, false};
+}
+
+void buffer_pool::deallocate(const block & block)
+{
+#ifdef __linux__
+    if (block.mapped)
+    {
+        munmap(block.data, block.size);
+        return;
+    }
+#endif
+
+    std::free(block.data);
+}
+
+} // namespace ftp
@@ -0,0 +1,135 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_BUFFER_POOL_HPP
+#define FTP_BUFFER_POOL_HPP
+
+#include <mutex>
+#include <condition_variable>
+#include <vector>
+#include <cstddef>
+
+namespace ftp
+{
+
+/* Process-wide pool of page-aligned transfer buffers. Data connections borrow
+ * a buffer for the duration of a transfer. The total size of allocated
+ * buffers never exceeds the memory budget: when it is reached, transfers
+ * wait until another transfer returns its buffer.
+ */
+class buffer_pool
+{
+    struct block
+    {
+        char *data;
+        std::size_t size;
+        bool mapped;
+    };
+
+public:
+    class buffer
+    {
+    public:
+        buffer(buffer && other) noexcept;
+
+        buffer & operator=(buffer &&) = delete;
+
+        buffer(const buffer &) = delete;
+
+        buffer & operator=(const buffer &) = delete;
+
+        ~buffer();
+
+        char * data() const;
+
+        std::size_t size() const;
+
+    private:
+        friend class buffer_pool;
+
+        buffer(buffer_pool *pool, const block & block);
+
+        buffer_pool *pool_;
+        block block_;
+    };
+
+    static buffer_pool & instance();
+
+    buffer_pool(const buffer_pool &) = delete;
+
+    buffer_pool & operator=(const buffer_pool &) = delete;
+
+    /* The buffer size is rounded up to the page size, or to the huge page
+     * size if 'huge_pages' is set. Huge pages are used only if the system
+     * allows it. Idle buffers are released immediately, buffers in use are
+     * released when returned.
+     */
+    void configure(std::size_t buffer_size, std::size_t memory_budget, bool huge_pages = false);
+
+    buffer acquire();
+
+    /* Waits until 'count' buffers can be taken at once. Transfers that need
+     * several buffers don't hold some of them while they wait for the rest,
+     * so they can't deadlock each other. More buffers than the budget holds
+     * are taken once no buffer is in use.
+     */
+    std::vector<buffer> acquire(std::size_t count);
+
+    std::size_t buffer_size() const;
+
+    std::size_t memory_budget() const;
+
+    std::size_t allocated() const;
+
+    static constexpr std::size_t page_size = 4096;
+
+    static constexpr std::size_t huge_page_size = 2 * 1024 * 1024;
+
+    static constexpr std::size_t default_buffer_size = 64 * 1024;
+
+    static constexpr std::size_t default_memory_budget = 256 * 1024 * 1024;
+
+private:
+    buffer_pool();
+
+    ~buffer_pool();
+
+    void release(const block & block);
+
+    block allocate() const;
+
+    static void deallocate(const block & block);
+
+    mutable std::mutex mutex_;
+    std::condition_variable released_;
+    std::vector<block> idle_;
+    std::size_t buffer_size_;
+    std::size_t memory_budget_;
+    std::size_t allocated_;
+    bool huge_pages_;
+};
+
+} // namespace ftp
+#endif //FTP_BUFFER_POOL_HPP
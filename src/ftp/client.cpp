@@ -24,9 +24,15 @@
 
 #include "client.hpp"
 #include "ftp_exception.hpp"
+#include "buffer_pool.hpp"
+#include "metrics.hpp"
+#include "detail/chunk_window.hpp"
 #include "detail/connection_exception.hpp"
+#include "detail/ring_buffer.hpp"
+#include <algorithm>
 #include <filesystem>
 #include <fstream>
+#include <thread>
 #include <boost/lexical_cast.hpp>
 
 namespace ftp
@@ -37,34 +43,138 @@ using std::optional;
 using std::ifstream;
 using std::ofstream;
 using std::unique_ptr;
+using std::make_shared;
 using std::ios_base;
 using std::pair;
 using std::make_pair;
 using std::nullopt;
 using std::make_optional;
+using std::uint64_t;
+using std::to_string;
+using std::function;
+using std::vector;
+using std::chrono::steady_clock;
 
 using namespace ftp::detail;
 
+/* Traces the operation it lives in, unless tracing is off or another
+ * operation of the client is being traced already.
+ */
+class client::span_scope
+{
+public:
+    span_scope(client & client, const char *operation, const string & target)
+        : client_(client),
+          active_(false),
+          exceptions_(std::uncaught_exceptions())
+    {
+        if (client_.trace_exporter_ && !client_.span_)
+        {
+            active_ = true;
+            client_.span_ = make_unique<span_recorder>(operation, target);
+            client_.control_connection_.set_span(client_.span_.get());
+        }
+    }
+
+    span_scope(const span_scope &) = delete;
+
+    span_scope & operator=(const span_scope &) = delete;
+
+    bool finish(bool succeeded)
+    {
+        end(succeeded, string());
+        return succeeded;
+    }
+
+    void fail(const std::exception & ex)
+    {
+        end(false, ex.what());
+    }
+
+    ~span_scope()
+    {
+        if (std::uncaught_exceptions() > exceptions_)
+        {
+            end(false, "Operation failed with an exception.");
+        }
+        else
+        {
+            end(false, string());
+        }
+    }
+
+private:
+    void end(bool succeeded, const string & error)
+    {
+        if (!active_)
+        {
+            return;
+        }
+
+        active_ = false;
+
+        try
+        {
+            client_.trace_exporter_->export_span(client_.span_->finish(succeeded, error));
+        }
+        catch (const std::exception &)
+        {
+            /* Tracing doesn't fail operations. */
+        }
+
+        client_.control_connection_.set_span(nullptr);
+        client_.span_.reset();
+    }
+
+    client & client_;
+    bool active_;
+    int exceptions_;
+};
+
 client::client(client::event_observer *observer)
+    : sparse_download_(false),
+      abort_requested_(false),
+      rate_limiter_(make_shared<rate_limiter>(rate_limiter::unlimited, rate_limiter::global())),
+      socket_buffer_size_(0),
+      port_(0),
+      tls_(false)
 {
     if (observer)
     {
         observers_.push_back(observer);
     }
+
+    set_progress_interval(default_progress_interval);
 }
 
 bool client::open(const string & hostname, uint16_t port)
 {
+    span_scope span(*this, "open", hostname);
+
     try
     {
+        flight_recorder_.record_connect(hostname, port);
+
         control_connection_.open(hostname, port);
 
+        rate_limiter_ = make_shared<rate_limiter>(rate_limiter_->rate(), rate_limiter::for_host(hostname));
+
+        hostname_ = hostname;
+        port_ = port;
+        tls_ = false;
+        username_.reset();
+        transfer_type_.reset();
+        directories_.clear();
+
         reply_t reply = recv();
 
-        return reply.is_positive();
+        mark("greeting");
+
+        return span.finish(reply.is_positive());
     }
     catch (const connection_exception & ex)
     {
+        span.fail(ex);
         reset_connection();
         throw ftp_exception(ex);
     }
@@ -83,8 +193,98 @@ bool client::is_open()
     }
 }
 
+void client::set_timeouts(const timeouts & timeouts)
+{
+    timeouts_ = timeouts;
+    control_connection_.set_timeouts(timeouts);
+}
+
+void client::set_rate_limit(uint64_t bytes_per_second)
+{
+    rate_limiter_->set_rate(bytes_per_second);
+}
+
+void client::set_socket_buffer_size(size_t size)
+{
+    socket_buffer_size_ = size;
+}
+
+void client::set_transport(const std::shared_ptr<transport> & transport)
+{
+    transport_ = transport;
+    control_connection_.set_transport(transport);
+}
+
+void client::set_progress_interval(std::chrono::milliseconds interval)
+{
+    progress_.configure(interval, [this](const transfer_progress & progress) { report_progress(progress); });
+}
+
+transfer_progress client::progress() const
+{
+    return progress_.get();
+}
+
+const tcp_statistics & client::last_tcp_statistics() const
+{
+    return tcp_statistics_;
+}
+
+void client::set_trace_exporter(const std::shared_ptr<trace_exporter> & exporter)
+{
+    trace_exporter_ = exporter;
+}
+
+const flight_recorder & client::flight_record() const
+{
+    return flight_recorder_;
+}
+
+void client::set_flight_record_directory(const optional<string> & directory)
+{
+    flight_record_directory_ = directory;
+}
+
+void client::abort()
+{
+    abort_requested_ = true;
+}
+
+void client::set_tls_options(const tls_options & options)
+{
+    tls_options_ = options;
+    tls_context_.reset();
+}
+
+bool client::auth_tls()
+{
+    try
+    {
+        if (!is_open())
+        {
+            throw ftp_exception("Connection is not open.");
+        }
+
+        if (control_connection_.is_secure())
+        {
+            throw ftp_exception("TLS is already started.");
+        }
+
+        tls_ = start_tls();
+
+        return tls_;
+    }
+    catch (const connection_exception & ex)
+    {
+        reset_connection();
+        throw ftp_exception(ex);
+    }
+}
+
 bool client::login(const string & username, const string & password)
 {
+    span_scope span(*this, "login", username);
+
     try
     {
         if (!is_open())
@@ -106,10 +306,18 @@ bool client::login(const string & username, const string & password)
              */
         }
 
-        return reply.is_positive();
+        if (reply.is_positive())
+        {
+            username_ = username;
+            password_ = password;
+            directories_.clear();
+        }
+
+        return span.finish(reply.is_positive());
     }
     catch (const connection_exception & ex)
     {
+        span.fail(ex);
         reset_connection();
         throw ftp_exception(ex);
     }
@@ -126,6 +334,16 @@ bool client::cd(const string & remote_directory)
 
         reply_t reply = send_command("CWD " + remote_directory);
 
+        if (reply.is_positive())
+        {
+            if (!remote_directory.empty() && remote_directory[0] == '/')
+            {
+                directories_.clear();
+            }
+
+            directories_.push_back(remote_directory);
+        }
+
         return reply.is_positive();
     }
     catch (const connection_exception & ex)
@@ -137,6 +355,8 @@ bool client::cd(const string & remote_directory)
 
 bool client::ls(const optional<string> & remote_directory)
 {
+    span_scope span(*this, "ls", remote_directory.value_or(string()));
+
     try
     {
         if (!is_open())
@@ -162,7 +382,13 @@ bool client::ls(const optional<string> & remote_directory)
             return false;
         }
 
-        string file_list = data_connection->recv();
+        string file_list;
+
+        if (!run_transfer(*data_connection, [&]() { file_list = data_connection->recv(); }))
+        {
+            return false;
+        }
+
         report_reply(file_list);
 
         /* Don't keep the data connection. */
@@ -170,10 +396,13 @@ bool client::ls(const optional<string> & remote_directory)
 
         reply_t reply = recv();
 
-        return reply.is_positive();
+        mark("final_reply");
+
+        return span.finish(reply.is_positive());
     }
     catch (const connection_exception & ex)
     {
+        span.fail(ex);
         reset_connection();
         throw ftp_exception(ex);
     }
@@ -181,6 +410,8 @@ bool client::ls(const optional<string> & remote_directory)
 
 bool client::upload(const string & local_file, const string & remote_file)
 {
+    span_scope span(*this, "upload", remote_file);
+
     try
     {
         if (!is_open())
@@ -188,102 +419,219 @@ bool client::upload(const string & local_file, const string & remote_file)
             throw ftp_exception("Connection is not open.");
         }
 
-        ifstream file(local_file, ios_base::binary);
+        return span.finish(send_file(local_file, remote_file, 0));
+    }
+    catch (const connection_exception & ex)
+    {
+        span.fail(ex);
+        reset_connection();
+        throw ftp_exception(ex);
+    }
+}
 
-        if (!file)
-        {
-            throw ftp_exception("Cannot open file '%1%'.", local_file);
-        }
+/* Chunks of the file kept for the targets of a fan-out upload. */
+static const size_t fan_out_chunks = 4;
 
-        unique_ptr<data_connection> data_connection = establish_data_connection("STOR " + remote_file);
+/* Sends the file from the offset on, for a target of a fan-out upload that
+ * fell behind the others. The file is likely still in the page cache.
+ */
+static void send_rest_of_file(data_connection & connection, const string & path, uint64_t offset,
+                              char *buffer, size_t buffer_size)
+{
+    if (connection.sendfile(path, offset))
+    {
+        return;
+    }
 
-        if (!data_connection)
+    ifstream file(path, ios_base::binary);
+
+    if (!file)
+    {
+        throw connection_exception("Cannot read data from file");
+    }
+
+    file.seekg(offset);
+
+    for (;;)
+    {
+        file.read(buffer, buffer_size);
+
+        if (file.fail() && !file.eof())
         {
-            return false;
+            throw connection_exception("Cannot read data from file");
         }
 
-        data_connection->send(file);
+        connection.write(buffer, file.gcount());
 
-        /* Don't keep the data connection. */
-        data_connection->close();
+        if (file.eof())
+        {
+            break;
+        }
+    }
+}
 
-        reply_t reply = recv();
+vector<client::upload_result> client::upload(const string & local_file, const vector<upload_target> & targets)
+{
+    ifstream file(local_file, ios_base::binary);
 
-        return reply.is_positive();
-    }
-    catch (const connection_exception & ex)
+    if (!file)
     {
-        reset_connection();
-        throw ftp_exception(ex);
+        throw ftp_exception("Cannot open file '%1%'.", local_file);
     }
-}
 
-bool client::download(const string & remote_file, const string & local_file)
-{
-    try
+    vector<upload_result> results(targets.size(), upload_result{false, string()});
+    vector<unique_ptr<data_connection>> connections(targets.size());
+    vector<std::exception_ptr> errors(targets.size());
+
+    for (size_t i = 0; i < targets.size(); i++)
     {
-        if (!is_open())
+        client & target = *targets[i].session;
+
+        try
         {
-            throw ftp_exception("Connection is not open.");
+            if (!target.is_open())
+            {
+                throw ftp_exception("Connection is not open.");
+            }
+
+            connections[i] = target.guarded([&]()
+            {
+                return target.establish_data_connection("STOR " + targets[i].remote_file);
+            });
         }
-
-        if (std::filesystem::exists(local_file))
+        catch (const ftp_exception & ex)
         {
-            throw ftp_exception("The file '%1%' already exists.", local_file);
+            results[i].error = ex.what();
         }
+    }
 
-        ofstream file(local_file, ios_base::binary);
+    size_t readers = std::count_if(connections.begin(), connections.end(),
+                                   [](const unique_ptr<data_connection> & connection) { return connection != nullptr; });
+    chunk_window window(fan_out_chunks, readers);
+    vector<std::thread> senders;
 
-        if (!file)
+    for (size_t i = 0; i < targets.size(); i++)
+    {
+        if (!connections[i])
         {
-            throw ftp_exception("Cannot create file %1%.", local_file);
+            continue;
         }
 
-        unique_ptr<data_connection> data_connection = establish_data_connection("RETR " + remote_file);
+        /* Each target finishes its transfer as soon as it has sent the file,
+         * without waiting for the slower ones.
+         */
+        senders.emplace_back([&, i, reader = senders.size()]()
+        {
+            data_connection & connection = *connections[i];
+            client & target = *targets[i].session;
+
+            try
+            {
+                for (uint64_t index = 0; ; index++)
+                {
+                    const char *data;
+                    size_t size;
+                    chunk_window::status status = window.read(reader, index, data, size);
+
+                    if (status == chunk_window::status::end)
+                    {
+                        break;
+                    }
+                    else if (status == chunk_window::status::evicted)
+                    {
+                        window.finish(reader);
+                        send_rest_of_file(connection, local_file, index * window.chunk_size(),
+                                          window.reader_buffer(reader), window.chunk_size());
+                        break;
+                    }
+                    else if (status == chunk_window::status::cancelled)
+                    {
+                        boost::system::error_code ec = boost::asio::error::operation_aborted;
+                        throw connection_exception(ec, "Transfer is cancelled");
+                    }
+
+                    connection.write(data, size);
+                }
+            }
+            catch (...)
+            {
+                errors[i] = std::current_exception();
+            }
+
+            window.finish(reader);
+
+            try
+            {
+                results[i].succeeded = target.guarded([&]()
+                {
+                    return target.finish_transfer(connection, errors[i]);
+                });
+            }
+            catch (const ftp_exception & ex)
+            {
+                results[i].error = ex.what();
+            }
+        });
+    }
 
-        if (!data_connection)
+    std::exception_ptr file_error;
+
+    try
+    {
+        for (;;)
         {
-            return false;
-        }
+            char *data = window.prepare();
 
-        data_connection->recv(file);
+            file.read(data, window.chunk_size());
 
-        /* Don't keep the data connection. */
-        data_connection->close();
+            if (file.fail() && !file.eof())
+            {
+                throw ftp_exception("Cannot read file '%1%'.", local_file);
+            }
 
-        reply_t reply = recv();
+            /* All chunks but the last one are full. */
+            if (file.gcount() > 0)
+            {
+                window.commit(file.gcount());
+            }
 
-        return reply.is_positive();
+            if (file.eof())
+            {
+                break;
+            }
+        }
+
+        window.close();
     }
-    catch (const connection_exception & ex)
+    catch (const ftp_exception &)
     {
-        reset_connection();
-        throw ftp_exception(ex);
-    }
-}
+        file_error = std::current_exception();
 
-bool client::pwd()
-{
-    try
-    {
-        if (!is_open())
+        for (const upload_target & target : targets)
         {
-            throw ftp_exception("Connection is not open.");
+            target.session->abort_requested_ = true;
         }
 
-        reply_t reply = send_command("PWD");
+        window.cancel();
+    }
 
-        return reply.is_positive();
+    for (std::thread & sender : senders)
+    {
+        sender.join();
     }
-    catch (const connection_exception & ex)
+
+    if (file_error)
     {
-        reset_connection();
-        throw ftp_exception(ex);
+        std::rethrow_exception(file_error);
     }
+
+    return results;
 }
 
-bool client::mkdir(const string & directory_name)
+bool client::download(const string & remote_file, const string & local_file)
 {
+    span_scope span(*this, "download", remote_file);
+
     try
     {
         if (!is_open())
@@ -291,19 +639,30 @@ bool client::mkdir(const string & directory_name)
             throw ftp_exception("Connection is not open.");
         }
 
-        reply_t reply = send_command("MKD " + directory_name);
+        if (std::filesystem::exists(local_file))
+        {
+            throw ftp_exception("The file '%1%' already exists.", local_file);
+        }
 
-        return reply.is_positive();
+        return span.finish(recv_file(remote_file, local_file, 0));
     }
     catch (const connection_exception & ex)
     {
+        span.fail(ex);
         reset_connection();
         throw ftp_exception(ex);
     }
 }
 
-bool client::rmdir(const string & directory_name)
+void client::set_sparse_download(bool enable)
+{
+    sparse_download_ = enable;
+}
+
+bool client::fxp(const string & remote_file, client & destination, const string & destination_file)
 {
+    span_scope span(*this, "fxp", remote_file);
+
     try
     {
         if (!is_open())
@@ -311,19 +670,80 @@ bool client::rmdir(const string & directory_name)
             throw ftp_exception("Connection is not open.");
         }
 
-        reply_t reply = send_command("RMD " + directory_name);
+        if (&destination == this || !destination.is_open())
+        {
+            throw ftp_exception("Destination connection is not open.");
+        }
 
-        return reply.is_positive();
+        /* Protected data connections need the servers to agree on which
+         * of them acts as the TLS client, which is not standardized.
+         */
+        if (tls_ || destination.tls_)
+        {
+            throw ftp_exception("FXP is not supported over TLS.");
+        }
+
+        reply_t reply = destination.guarded([&]() { return destination.send_command("PASV"); });
+
+        if (!reply.is_positive())
+        {
+            return false;
+        }
+
+        string host_port;
+        if (!try_parse_host_port(reply.status_line, host_port))
+        {
+            throw ftp_exception("Cannot parse server address from '%1%'.", reply.status_line);
+        }
+
+        reply = send_command("PORT " + host_port);
+
+        if (!reply.is_positive())
+        {
+            return false;
+        }
+
+        /* The destination server waits for the data connection. */
+        reply = destination.guarded([&]() { return destination.send_command("STOR " + destination_file); });
+
+        if (!reply.is_positive())
+        {
+            return false;
+        }
+
+        reply = send_command("RETR " + remote_file);
+
+        if (!reply.is_positive())
+        {
+            destination.guarded([&]() { destination.abort_transfer(); });
+
+            return false;
+        }
+
+        /* The servers reply once the whole file is transferred. */
+        reply = recv(timeouts_.transfer);
+
+        reply_t destination_reply = destination.guarded([&]()
+        {
+            return destination.recv(destination.timeouts_.transfer);
+        });
+
+        mark("final_reply");
+
+        return span.finish(reply.is_positive() && destination_reply.is_positive());
     }
     catch (const connection_exception & ex)
     {
+        span.fail(ex);
         reset_connection();
         throw ftp_exception(ex);
     }
 }
 
-bool client::rm(const string & remote_file)
+bool client::copy(const string & remote_file, client & destination, const string & destination_file)
 {
+    span_scope span(*this, "copy", remote_file);
+
     try
     {
         if (!is_open())
@@ -331,8 +751,301 @@ bool client::rm(const string & remote_file)
             throw ftp_exception("Connection is not open.");
         }
 
-        reply_t reply = send_command("DELE " + remote_file);
-
+        if (&destination == this || !destination.is_open())
+        {
+            throw ftp_exception("Destination connection is not open.");
+        }
+
+        unique_ptr<data_connection> source_connection = establish_data_connection("RETR " + remote_file);
+
+        if (!source_connection)
+        {
+            return false;
+        }
+
+        unique_ptr<data_connection> destination_connection;
+
+        /* The source's transfer is already accepted, its reply is read
+         * before anything else is sent on the connection.
+         */
+        try
+        {
+            destination_connection = destination.guarded([&]()
+            {
+                return destination.establish_data_connection("STOR " + destination_file);
+            });
+        }
+        catch (const ftp_exception &)
+        {
+            source_connection->abort();
+            abort_transfer();
+
+            throw;
+        }
+
+        if (!destination_connection)
+        {
+            source_connection->abort();
+            abort_transfer();
+
+            return false;
+        }
+
+        ring_buffer ring(buffer_pool::instance().acquire());
+        std::exception_ptr source_error;
+        std::exception_ptr destination_error;
+
+        /* A failed side cancels the ring and the transfer of the other side,
+         * which may be waiting for its socket rather than for the ring.
+         */
+        auto cancelled = []()
+        {
+            boost::system::error_code ec = boost::asio::error::operation_aborted;
+            return std::make_exception_ptr(connection_exception(ec, "Transfer is cancelled"));
+        };
+
+        std::thread reader([&]()
+        {
+            try
+            {
+                for (;;)
+                {
+                    char *data;
+                    size_t size = ring.prepare(data);
+
+                    if (size == 0)
+                    {
+                        source_error = cancelled();
+                        break;
+                    }
+
+                    size_t len = source_connection->read_some(data, size);
+
+                    if (len == 0)
+                    {
+                        ring.close();
+                        break;
+                    }
+
+                    ring.commit(len);
+                }
+            }
+            catch (...)
+            {
+                source_error = std::current_exception();
+                ring.cancel();
+                destination.abort_requested_ = true;
+            }
+        });
+
+        try
+        {
+            for (;;)
+            {
+                const char *data;
+                size_t size = ring.peek(data);
+
+                if (size == 0)
+                {
+                    if (ring.is_cancelled())
+                    {
+                        destination_error = cancelled();
+                    }
+
+                    break;
+                }
+
+                destination_connection->write(data, size);
+                ring.consume(size);
+            }
+        }
+        catch (...)
+        {
+            destination_error = std::current_exception();
+            ring.cancel();
+            abort_requested_ = true;
+        }
+
+        reader.join();
+
+        /* Both servers expect an answer before either error is reported. */
+        bool destination_completed = false;
+        std::exception_ptr destination_failure;
+
+        try
+        {
+            destination_completed = destination.guarded([&]()
+            {
+                return destination.finish_transfer(*destination_connection, destination_error);
+            });
+        }
+        catch (const ftp_exception &)
+        {
+            destination_failure = std::current_exception();
+        }
+
+        bool source_completed = finish_transfer(*source_connection, source_error);
+
+        if (destination_failure)
+        {
+            std::rethrow_exception(destination_failure);
+        }
+
+        return span.finish(source_completed && destination_completed);
+    }
+    catch (const connection_exception & ex)
+    {
+        span.fail(ex);
+        reset_connection();
+        throw ftp_exception(ex);
+    }
+}
+
+bool client::resume_download(const string & remote_file, const string & local_file)
+{
+    span_scope span(*this, "resume_download", remote_file);
+
+    /* In ASCII mode the local size doesn't match the remote one. */
+    if (transfer_type_ == transfer_type::ascii)
+    {
+        throw ftp_exception("Cannot resume a transfer in ASCII mode.");
+    }
+
+    return span.finish(retry([&]()
+    {
+        uint64_t offset = 0;
+
+        if (std::filesystem::exists(local_file))
+        {
+            offset = std::filesystem::file_size(local_file);
+        }
+
+        return recv_file(remote_file, local_file, offset);
+    }));
+}
+
+bool client::resume_upload(const string & local_file, const string & remote_file)
+{
+    span_scope span(*this, "resume_upload", remote_file);
+
+    /* In ASCII mode the local size doesn't match the remote one. */
+    if (transfer_type_ == transfer_type::ascii)
+    {
+        throw ftp_exception("Cannot resume a transfer in ASCII mode.");
+    }
+
+    return span.finish(retry([&]()
+    {
+        std::error_code ec;
+        uint64_t local_size = std::filesystem::file_size(local_file, ec);
+
+        if (ec)
+        {
+            throw ftp_exception("Cannot open file '%1%'.", local_file);
+        }
+
+        reply_t reply = send_command("SIZE " + remote_file);
+
+        uint64_t offset = 0;
+
+        /* If the remote file doesn't exist, upload the whole file. */
+        if (reply.is_positive() && !try_parse_file_size(reply.status_line, offset))
+        {
+            throw ftp_exception("Cannot parse file size from '%1%'.", reply.status_line);
+        }
+
+        if (offset > local_size)
+        {
+            throw ftp_exception("The remote file '%1%' is larger than the local file '%2%'.",
+                                remote_file, local_file);
+        }
+
+        if (reply.is_positive() && offset == local_size)
+        {
+            /* Nothing to upload. */
+            return true;
+        }
+
+        return send_file(local_file, remote_file, offset);
+    }));
+}
+
+void client::set_retry_policy(const retry_policy & policy)
+{
+    retry_policy_ = policy;
+}
+
+bool client::pwd()
+{
+    try
+    {
+        if (!is_open())
+        {
+            throw ftp_exception("Connection is not open.");
+        }
+
+        reply_t reply = send_command("PWD");
+
+        return reply.is_positive();
+    }
+    catch (const connection_exception & ex)
+    {
+        reset_connection();
+        throw ftp_exception(ex);
+    }
+}
+
+bool client::mkdir(const string & directory_name)
+{
+    try
+    {
+        if (!is_open())
+        {
+            throw ftp_exception("Connection is not open.");
+        }
+
+        reply_t reply = send_command("MKD " + directory_name);
+
+        return reply.is_positive();
+    }
+    catch (const connection_exception & ex)
+    {
+        reset_connection();
+        throw ftp_exception(ex);
+    }
+}
+
+bool client::rmdir(const string & directory_name)
+{
+    try
+    {
+        if (!is_open())
+        {
+            throw ftp_exception("Connection is not open.");
+        }
+
+        reply_t reply = send_command("RMD " + directory_name);
+
+        return reply.is_positive();
+    }
+    catch (const connection_exception & ex)
+    {
+        reset_connection();
+        throw ftp_exception(ex);
+    }
+}
+
+bool client::rm(const string & remote_file)
+{
+    try
+    {
+        if (!is_open())
+        {
+            throw ftp_exception("Connection is not open.");
+        }
+
+        reply_t reply = send_command("DELE " + remote_file);
+
         return reply.is_positive();
     }
     catch (const connection_exception & ex)
@@ -353,6 +1066,36 @@ bool client::binary()
 
         reply_t reply = send_command("TYPE I");
 
+        if (reply.is_positive())
+        {
+            transfer_type_ = transfer_type::binary;
+        }
+
+        return reply.is_positive();
+    }
+    catch (const connection_exception & ex)
+    {
+        reset_connection();
+        throw ftp_exception(ex);
+    }
+}
+
+bool client::ascii()
+{
+    try
+    {
+        if (!is_open())
+        {
+            throw ftp_exception("Connection is not open.");
+        }
+
+        reply_t reply = send_command("TYPE A");
+
+        if (reply.is_positive())
+        {
+            transfer_type_ = transfer_type::ascii;
+        }
+
         return reply.is_positive();
     }
     catch (const connection_exception & ex)
@@ -382,6 +1125,32 @@ bool client::size(const string & remote_file)
     }
 }
 
+optional<uint64_t> client::file_size(const string & remote_file)
+{
+    try
+    {
+        if (!is_open())
+        {
+            throw ftp_exception("Connection is not open.");
+        }
+
+        reply_t reply = send_command("SIZE " + remote_file);
+        uint64_t size = 0;
+
+        if (!reply.is_positive() || !try_parse_file_size(reply.status_line, size))
+        {
+            return std::nullopt;
+        }
+
+        return size;
+    }
+    catch (const connection_exception & ex)
+    {
+        reset_connection();
+        throw ftp_exception(ex);
+    }
+}
+
 bool client::stat(const optional<string> & remote_file)
 {
     try
@@ -475,12 +1244,35 @@ bool client::close()
     }
 }
 
+void client::mark(const char *phase)
+{
+    if (span_)
+    {
+        span_->mark(phase);
+    }
+}
+
 reply_t client::send_command(const string & command)
 {
+    steady_clock::time_point sent = steady_clock::now();
+
+    flight_recorder_.record_command(command);
+
     control_connection_.send(command);
 
     reply_t reply = control_connection_.recv();
 
+    flight_recorder_.record_reply(reply.status_code);
+
+    metrics::instance().record_command(command, steady_clock::now() - sent);
+    metrics::instance().record_reply(reply.status_code);
+
+    if (span_)
+    {
+        span_->mark(command.substr(0, command.find(' ')));
+    }
+
+    last_reply_ = reply;
     report_reply(reply);
 
     return reply;
@@ -488,8 +1280,18 @@ reply_t client::send_command(const string & command)
 
 reply_t client::recv()
 {
-    reply_t reply = control_connection_.recv();
+    return recv(timeouts_.reply);
+}
+
+reply_t client::recv(std::chrono::milliseconds timeout)
+{
+    reply_t reply = control_connection_.recv(timeout);
+
+    flight_recorder_.record_reply(reply.status_code);
 
+    metrics::instance().record_reply(reply.status_code);
+
+    last_reply_ = reply;
     report_reply(reply);
 
     return reply;
@@ -504,41 +1306,532 @@ void client::reset_connection()
     catch (...)
     {
     }
+
+    flight_recorder_.record_reset();
+
+    if (flight_record_directory_)
+    {
+        dump_flight_record(flight_record_directory_.value());
+    }
 }
 
-unique_ptr<data_connection> client::establish_data_connection(const string & command)
+/* Failures don't hide the error that caused the dump. */
+void client::dump_flight_record(const string & directory)
 {
-    if (!is_open())
+    try
     {
-        throw ftp_exception("Connection is not open.");
-    }
+        int64_t now = std::chrono::duration_cast<std::chrono::microseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count();
 
-    reply_t reply = send_command("EPSV");
+        std::filesystem::path path = std::filesystem::path(directory) /
+            ("ftp-" + to_string(now) + ".flight");
 
-    if (!reply.is_positive())
+        ofstream file(path, ios_base::binary);
+
+        if (file)
+        {
+            flight_recorder_.dump(file);
+        }
+    }
+    catch (const std::exception &)
     {
-        return nullptr;
     }
+}
 
-    uint16_t port;
-    if (!try_parse_server_port(reply.status_line, port))
+bool client::send_file(const string & local_file, const string & remote_file, uint64_t offset)
+{
+    ifstream file(local_file, ios_base::binary);
+
+    if (!file)
     {
-        throw ftp_exception("Cannot parse server port from '%1%'.", reply.status_line);
+        throw ftp_exception("Cannot open file '%1%'.", local_file);
     }
 
-    unique_ptr<data_connection> connection = make_unique<data_connection>(control_connection_.ip(), port);
+    string command;
 
-    connection->open();
+    if (offset > 0)
+    {
+        file.seekg(offset);
 
-    reply = send_command(command);
+        /* APPE doesn't depend on REST support for STOR, which some servers
+         * only implement for RETR.
+         */
+        command = "APPE " + remote_file;
+    }
+    else
+    {
+        command = "STOR " + remote_file;
+    }
 
-    if (!reply.is_positive())
+    unique_ptr<data_connection> data_connection = establish_data_connection(command);
+
+    if (!data_connection)
     {
-        return nullptr;
+        return false;
     }
 
-    return connection;
-}
+    std::error_code ec;
+    uint64_t size = std::filesystem::file_size(local_file, ec);
+
+    if (!ec && size >= offset)
+    {
+        progress_.set_total(size - offset);
+    }
+
+    bool completed = run_transfer(*data_connection, [&]()
+    {
+        if (!data_connection->sendfile(local_file, offset))
+        {
+            data_connection->send(file);
+        }
+    });
+
+    if (!completed)
+    {
+        return false;
+    }
+
+    progress_.finish();
+
+    /* Don't keep the data connection. */
+    data_connection->close();
+
+    reply_t reply = recv();
+
+    mark("final_reply");
+
+    return reply.is_positive();
+}
+
+bool client::recv_file(const string & remote_file, const string & local_file, uint64_t offset)
+{
+    unique_ptr<data_connection> data_connection;
+
+    if (sparse_download_)
+    {
+        sparse_file_writer file(local_file, offset);
+
+        if (!file.is_open())
+        {
+            throw ftp_exception("Cannot create file %1%.", local_file);
+        }
+
+        data_connection = establish_data_connection("RETR " + remote_file, offset);
+
+        if (!data_connection)
+        {
+            return false;
+        }
+
+        set_download_total(offset);
+
+        if (!run_transfer(*data_connection, [&]() { data_connection->recv(file); }))
+        {
+            return false;
+        }
+
+        file.close();
+    }
+    else
+    {
+        ios_base::openmode mode = ios_base::binary;
+
+        if (offset > 0)
+        {
+            mode |= ios_base::app;
+        }
+
+        ofstream file(local_file, mode);
+
+        if (!file)
+        {
+            throw ftp_exception("Cannot create file %1%.", local_file);
+        }
+
+        data_connection = establish_data_connection("RETR " + remote_file, offset);
+
+        if (!data_connection)
+        {
+            return false;
+        }
+
+        set_download_total(offset);
+
+        if (!run_transfer(*data_connection, [&]() { data_connection->recv(file); }))
+        {
+            return false;
+        }
+    }
+
+    progress_.finish();
+
+    /* Don't keep the data connection. */
+    data_connection->close();
+
+    reply_t reply = recv();
+
+    mark("final_reply");
+
+    return reply.is_positive();
+}
+
+/* Many servers tell the size of the file in the reply to RETR, e.g.
+ *
+ *     150 Opening BINARY mode data connection for file.txt (1024 bytes).
+ *
+ * The size is not standardized, so it's only used for progress.
+ */
+void client::set_download_total(uint64_t offset)
+{
+    const string & reply = last_reply_.status_line;
+    size_t end = reply.rfind(" bytes)");
+
+    if (end == string::npos)
+    {
+        return;
+    }
+
+    size_t begin = reply.rfind('(', end);
+
+    if (begin == string::npos)
+    {
+        return;
+    }
+
+    uint64_t size;
+    if (!boost::conversion::try_lexical_convert(reply.substr(begin + 1, end - begin - 1), size))
+    {
+        return;
+    }
+
+    /* Servers report either the size of the file or what is left of it. */
+    progress_.set_total(size > offset ? size - offset : size);
+}
+
+/* Repeat the transfer while it fails because of a connection error, a
+ * timeout or a transient negative reply. Each attempt is expected to continue
+ * from where the previous one stopped.
+ */
+bool client::retry(const function<bool()> & transfer)
+{
+    std::chrono::milliseconds delay = retry_policy_.initial_delay;
+
+    if (!is_open())
+    {
+        throw ftp_exception("Connection is not open.");
+    }
+
+    for (unsigned int attempt = 1;; ++attempt)
+    {
+        bool last_attempt = attempt >= retry_policy_.max_attempts;
+
+        try
+        {
+            if (!control_connection_.is_open())
+            {
+                reconnect();
+            }
+
+            if (transfer())
+            {
+                return true;
+            }
+
+            if (!last_reply_.is_transient_negative() || last_attempt)
+            {
+                return false;
+            }
+        }
+        catch (const connection_exception & ex)
+        {
+            reset_connection();
+
+            if (last_attempt)
+            {
+                throw ftp_exception(ex);
+            }
+        }
+        catch (const ftp_exception & ex)
+        {
+            /* The transfer that timed out has been aborted, and the session
+             * is still usable.
+             */
+            if (ex.code() != boost::asio::error::timed_out || last_attempt)
+            {
+                throw;
+            }
+        }
+
+        std::this_thread::sleep_for(delay);
+
+        delay = std::chrono::duration_cast<std::chrono::milliseconds>(delay * retry_policy_.backoff_factor);
+        delay = std::min(delay, retry_policy_.max_delay);
+    }
+}
+
+void client::reconnect()
+{
+    metrics::instance().record_reconnect();
+    flight_recorder_.record_connect(hostname_, port_);
+
+    control_connection_.open(hostname_, port_);
+
+    reply_t reply = recv();
+
+    if (!reply.is_positive())
+    {
+        throw connection_exception("Cannot reconnect to '%1%'.", hostname_);
+    }
+
+    if (tls_ && !start_tls())
+    {
+        throw connection_exception("Cannot start TLS with '%1%'.", hostname_);
+    }
+
+    if (username_)
+    {
+        reply = send_command("USER " + username_.value());
+
+        if (reply.status_code == 331)
+        {
+            reply = send_command("PASS " + password_);
+        }
+
+        if (!reply.is_positive())
+        {
+            throw connection_exception("Cannot log in to '%1%'.", hostname_);
+        }
+    }
+
+    if (transfer_type_)
+    {
+        if (transfer_type_ == transfer_type::ascii)
+        {
+            reply = send_command("TYPE A");
+        }
+        else
+        {
+            reply = send_command("TYPE I");
+        }
+
+        if (!reply.is_positive())
+        {
+            throw connection_exception("Cannot restore transfer type.");
+        }
+    }
+
+    for (const string & directory : directories_)
+    {
+        reply = send_command("CWD " + directory);
+
+        if (!reply.is_positive())
+        {
+            throw connection_exception("Cannot restore working directory.");
+        }
+    }
+}
+
+/* Runs the data phase of a transfer. If it's cancelled or times out, drops
+ * the data connection and aborts the transfer on the server, so that the
+ * control connection stays usable. Returns false if it's cancelled.
+ */
+bool client::run_transfer(data_connection & connection, const function<void()> & transfer)
+{
+    try
+    {
+        transfer();
+
+        metrics::instance().record_transfer(progress_.elapsed(), true);
+        flight_recorder_.record_transfer(progress_.get().bytes, true);
+
+        mark("transfer");
+
+        return true;
+    }
+    catch (const connection_exception & ex)
+    {
+        metrics::instance().record_transfer(progress_.elapsed(), false);
+        flight_recorder_.record_transfer(progress_.get().bytes, false);
+
+        if (ex.code() != boost::asio::error::operation_aborted &&
+            ex.code() != boost::asio::error::timed_out)
+        {
+            throw;
+        }
+
+        connection.abort();
+        abort_transfer();
+
+        if (ex.code() == boost::asio::error::timed_out)
+        {
+            throw ftp_exception(ex);
+        }
+
+        return false;
+    }
+}
+
+bool client::finish_transfer(data_connection & connection, const std::exception_ptr & error)
+{
+    bool completed = run_transfer(connection, [&]()
+    {
+        if (error)
+        {
+            std::rethrow_exception(error);
+        }
+    });
+
+    if (!completed)
+    {
+        return false;
+    }
+
+    progress_.finish();
+
+    /* Don't keep the data connection. */
+    connection.close();
+
+    reply_t reply = recv();
+
+    mark("final_reply");
+
+    return reply.is_positive();
+}
+
+/* Depending on whether the server has noticed the closed data connection
+ * and whether the transfer has completed in the meantime, ABOR gets a 426
+ * reply for the transfer followed by a 226 one, or a single 225 or 226
+ * reply, possibly preceded by the final reply to the transfer command.
+ * A NOOP sent right after ABOR marks the end of these replies.
+ *
+ * RFC 959: https://tools.ietf.org/html/rfc959
+ */
+void client::abort_transfer()
+{
+    control_connection_.send("ABOR");
+    control_connection_.send("NOOP");
+
+    for (;;)
+    {
+        reply_t reply = recv();
+
+        /* 200 Command okay. */
+        if (reply.status_code == 200)
+        {
+            break;
+        }
+    }
+}
+
+bool client::start_tls()
+{
+    if (!tls_context_)
+    {
+        tls_context_ = make_unique<tls_context>(tls_options_);
+    }
+
+    reply_t reply = send_command("AUTH TLS");
+
+    /* 234 Security data exchange complete. */
+    if (reply.status_code != 234)
+    {
+        return false;
+    }
+
+    string session_key = tls_context_->session_key(hostname_, port_);
+
+    control_connection_.start_tls(*tls_context_, hostname_, session_key);
+
+    /* Protection buffer size must be 0 for TLS, and data connections are
+     * only protected after PROT P.
+     *
+     * RFC 4217: https://tools.ietf.org/html/rfc4217#section-9
+     */
+    reply = send_command("PBSZ 0");
+
+    if (!reply.is_positive())
+    {
+        return false;
+    }
+
+    reply = send_command("PROT P");
+
+    return reply.is_positive();
+}
+
+unique_ptr<data_connection> client::establish_data_connection(const string & command, uint64_t offset)
+{
+    if (!is_open())
+    {
+        throw ftp_exception("Connection is not open.");
+    }
+
+    steady_clock::time_point started = steady_clock::now();
+
+    reply_t reply = send_command("EPSV");
+
+    if (!reply.is_positive())
+    {
+        return nullptr;
+    }
+
+    uint16_t port;
+    if (!try_parse_server_port(reply.status_line, port))
+    {
+        throw ftp_exception("Cannot parse server port from '%1%'.", reply.status_line);
+    }
+
+    unique_ptr<data_connection> connection =
+            make_unique<data_connection>(control_connection_.ip(), port, transfer_type_.value_or(transfer_type::binary));
+
+    /* abort() only cancels the transfer that is in progress. */
+    abort_requested_ = false;
+
+    connection->set_timeouts(timeouts_);
+    connection->set_cancellation(&abort_requested_);
+    connection->set_rate_limiter(rate_limiter_);
+    connection->set_span(span_.get());
+    connection->set_tcp_statistics(&tcp_statistics_);
+    connection->set_socket_buffer_size(socket_buffer_size_);
+    connection->set_transport(transport_);
+    connection->open();
+
+    if (offset > 0)
+    {
+        reply = send_command("REST " + to_string(offset));
+
+        /* 350 Requested file action pending further information. */
+        if (reply.status_code != 350)
+        {
+            return nullptr;
+        }
+    }
+
+    reply = send_command(command);
+
+    if (!reply.is_positive())
+    {
+        return nullptr;
+    }
+
+    if (tls_)
+    {
+        /* Resume the session of the control connection, some servers
+         * require it to make sure that both connections come from the same
+         * client.
+         */
+        string session_key = tls_context_->session_key(hostname_, port_);
+
+        connection->start_tls(*tls_context_, hostname_, session_key);
+    }
+
+    metrics::instance().record_data_connection(steady_clock::now() - started);
+
+    progress_.start();
+    connection->set_progress(&progress_);
+
+    return connection;
+}
 
 /* The text returned in response to the EPSV command MUST be:
  *
@@ -589,6 +1882,87 @@ bool client::try_parse_server_port(const string & epsv_reply, uint16_t & port)
     return boost::conversion::try_lexical_convert(port_str, port);
 }
 
+/* The reply to PASV carries the host and port the server listens on, in
+ * the same form as the argument of PORT:
+ *
+ *     227 Entering Passive Mode (h1,h2,h3,h4,p1,p2)
+ *
+ * RFC 959: https://tools.ietf.org/html/rfc959#section-4.1.2
+ */
+bool client::try_parse_host_port(const string & pasv_reply, string & host_port)
+{
+    /* Skip the status code, some servers omit the parentheses. */
+    size_t begin = pasv_reply.find_first_of("0123456789", 3);
+    if (begin == string::npos)
+    {
+        return false;
+    }
+
+    size_t end = pasv_reply.find_first_not_of("0123456789,", begin);
+    if (end == string::npos)
+    {
+        end = pasv_reply.size();
+    }
+
+    host_port = pasv_reply.substr(begin, end - begin);
+
+    size_t fields = 0;
+    size_t field_begin = 0;
+
+    while (field_begin <= host_port.size())
+    {
+        size_t field_end = host_port.find(',', field_begin);
+        if (field_end == string::npos)
+        {
+            field_end = host_port.size();
+        }
+
+        unsigned int value;
+        if (!boost::conversion::try_lexical_convert(host_port.substr(field_begin, field_end - field_begin), value) ||
+            value > 255)
+        {
+            return false;
+        }
+
+        fields++;
+        field_begin = field_end + 1;
+    }
+
+    if (fields != 6)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+/* The returned <SIZE> is:
+ *
+ *     size-response = "213" SP 1*DIGIT CRLF /
+ *                     error-response
+ *
+ * RFC 3659: https://tools.ietf.org/html/rfc3659
+ */
+bool client::try_parse_file_size(const string & size_reply, uint64_t & size)
+{
+    const size_t begin = 4;
+
+    if (size_reply.size() <= begin)
+    {
+        return false;
+    }
+
+    size_t end = size_reply.find_first_of("\r\n", begin);
+    if (end == string::npos)
+    {
+        end = size_reply.size();
+    }
+
+    string size_str = size_reply.substr(begin, end - begin);
+
+    return boost::conversion::try_lexical_convert(size_str, size);
+}
+
 void client::subscribe(event_observer *observer)
 {
     observers_.push_back(observer);
@@ -617,4 +1991,13 @@ void client::report_reply(const reply_t & reply)
     }
 }
 
+void client::report_progress(const transfer_progress & progress)
+{
+    for (const auto & observer : observers_)
+    {
+        if (observer)
+            observer->on_progress(progress);
+    }
+}
+
 } // namespace ftp
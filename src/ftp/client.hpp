@@ -25,10 +25,29 @@
 #ifndef FTP_CLIENT_HPP
 #define FTP_CLIENT_HPP
 
+#include "flight_recorder.hpp"
+#include "rate_limiter.hpp"
+#include "retry_policy.hpp"
+#include "tcp_statistics.hpp"
+#include "timeouts.hpp"
+#include "tls_options.hpp"
+#include "tracing.hpp"
+#include "transfer_progress.hpp"
+#include "transport.hpp"
+#include "ftp_exception.hpp"
 #include "detail/control_connection.hpp"
 #include "detail/data_connection.hpp"
+#include "detail/progress_tracker.hpp"
+#include "detail/span_recorder.hpp"
+#include "detail/tls_context.hpp"
+#include <atomic>
+#include <exception>
 #include <string>
 #include <list>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <memory>
 
 namespace ftp
 {
@@ -41,9 +60,30 @@ public:
     public:
         virtual void on_reply(const std::string & reply) = 0;
 
+        /* Called by the transferring thread once per progress interval and
+         * when a file transfer completes.
+         */
+        virtual void on_progress(const transfer_progress & /* progress */)
+        {
+        }
+
         virtual ~event_observer() = default;
     };
 
+    struct upload_target
+    {
+        client *session;
+        std::string remote_file;
+    };
+
+    struct upload_result
+    {
+        bool succeeded;
+
+        /* The message of the exception that ended the transfer, if any. */
+        std::string error;
+    };
+
     explicit client(client::event_observer *observer = nullptr);
 
     client(const client &) = delete;
@@ -54,6 +94,75 @@ public:
 
     bool is_open();
 
+    void set_timeouts(const timeouts & timeouts);
+
+    /* Cancels the transfer in progress, can be called from another thread.
+     * The client drops the data connection, sends ABOR and waits for the
+     * server to confirm it, and the transfer returns false. The session stays
+     * usable, as it does when a data transfer times out.
+     */
+    void abort();
+
+    /* Limits the transfer rate of this client in bytes per second, 0 means
+     * unlimited. Takes effect immediately, also for a transfer in progress.
+     * The transfers are also limited by rate_limiter::for_host() of the
+     * server and by rate_limiter::global().
+     */
+    void set_rate_limit(std::uint64_t bytes_per_second);
+
+    /* The send and receive buffers of the data connections, zero leaves the
+     * system default. See auto_tuner.
+     */
+    void set_socket_buffer_size(std::size_t size);
+
+    /* Carries the connections opened from now on instead of TCP sockets,
+     * nullptr goes back to sockets. See transport.
+     */
+    void set_transport(const std::shared_ptr<transport> & transport);
+
+    /* How often event_observer::on_progress() is called, zero disables it.
+     * Takes effect on the next transfer.
+     */
+    void set_progress_interval(std::chrono::milliseconds interval);
+
+    /* The progress of the current or the last transfer, can be called from
+     * another thread.
+     */
+    transfer_progress progress() const;
+
+    static constexpr std::chrono::milliseconds default_progress_interval = std::chrono::seconds(1);
+
+    /* TCP_INFO of the data connection of the last transfer, to tell a slow
+     * server from a lossy network or a small buffer.
+     */
+    const tcp_statistics & last_tcp_statistics() const;
+
+    /* Exports a span with the phases of each operation: open, login, ls,
+     * upload, download, resume_upload, resume_download, fxp and copy.
+     * Tracing is off unless an exporter is set, nullptr turns it off again.
+     */
+    void set_trace_exporter(const std::shared_ptr<trace_exporter> & exporter);
+
+    /* The last events of the session, kept whether or not it fails.
+     * flight_record().dump() writes them for ftp_flight_decoder.
+     */
+    const flight_recorder & flight_record() const;
+
+    /* Dumps the flight record into a new file in the directory whenever the
+     * connection is dropped after an error. Off by default.
+     */
+    void set_flight_record_directory(const std::optional<std::string> & directory);
+
+    /* Used by auth_tls(). Takes effect on the next call. */
+    void set_tls_options(const tls_options & options);
+
+    /* Explicit FTPS: upgrade the control connection to TLS and protect data
+     * connections as well. Must be called before login().
+     *
+     * RFC 4217: https://tools.ietf.org/html/rfc4217
+     */
+    bool auth_tls();
+
     bool login(const std::string & username, const std::string & password);
 
     bool cd(const std::string & remote_directory);
@@ -62,8 +171,62 @@ public:
 
     bool upload(const std::string & local_file, const std::string & remote_file);
 
+    /* Uploads the file to several servers at once, each through its own
+     * client, and returns the results in the order of the targets. The file
+     * is read once and each chunk is sent to all of them. A target that falls
+     * behind the others by more than a few chunks reads the rest of the file
+     * by itself, so it doesn't hold them up, and a failed target doesn't stop
+     * the rest. The file is sent as is, like in binary mode.
+     */
+    static std::vector<upload_result> upload(const std::string & local_file,
+                                             const std::vector<upload_target> & targets);
+
     bool download(const std::string & remote_file, const std::string & local_file);
 
+    /* Site-to-site (FXP) transfer of the remote file to the server of the
+     * 'destination' client. The destination server listens after PASV, this
+     * server connects to it after PORT, and the data flows between the
+     * servers directly. Both clients must be logged in and use the same
+     * transfer type. The servers must accept data connections with a host
+     * other than the client, which many of them refuse by default. Not
+     * supported over TLS.
+     *
+     * RFC 959: https://tools.ietf.org/html/rfc959#section-2.3
+     */
+    bool fxp(const std::string & remote_file, client & destination, const std::string & destination_file);
+
+    /* Copies the remote file to the server of the 'destination' client, or
+     * to another path on the same server if both clients connect to it. The
+     * data passes through a buffer of the buffer pool, with the download and
+     * the upload running at the same time. The bytes are copied as they are
+     * on the wire, so both clients should use the same transfer type.
+     */
+    bool copy(const std::string & remote_file, client & destination, const std::string & destination_file);
+
+    /* Don't write all-zero blocks of downloaded files to disk, leave holes
+     * instead. The file system must support sparse files.
+     */
+    void set_sparse_download(bool enable);
+
+    /* Continue downloading the remote file from the end of the partially
+     * downloaded local file. If the local file doesn't exist, download the
+     * whole file. Throws ftp_exception in ASCII mode, where the offsets of
+     * the local and the remote file differ.
+     */
+    bool resume_download(const std::string & remote_file, const std::string & local_file);
+
+    /* Continue uploading the local file from the end of the partially
+     * uploaded remote file. If the remote file doesn't exist, upload the
+     * whole file. Throws ftp_exception in ASCII mode, like resume_download().
+     */
+    bool resume_upload(const std::string & local_file, const std::string & remote_file);
+
+    /* Used by resume_download() and resume_upload(). If an attempt fails,
+     * the client reconnects, logs in again, restores the transfer type and
+     * the working directory, and continues the transfer.
+     */
+    void set_retry_policy(const retry_policy & policy);
+
     bool pwd();
 
     bool mkdir(const std::string & directory_name);
@@ -74,8 +237,16 @@ public:
 
     bool binary();
 
+    /* Convert line endings between the local LF and the network CRLF ones. */
+    bool ascii();
+
     bool size(const std::string & remote_file);
 
+    /* The size of the remote file in bytes, or nothing if the server
+     * doesn't report it.
+     */
+    std::optional<std::uint64_t> file_size(const std::string & remote_file);
+
     bool stat(const std::optional<std::string> & remote_file = std::nullopt);
 
     bool system();
@@ -89,22 +260,100 @@ public:
     void unsubscribe(event_observer *observer);
 
 private:
+    class span_scope;
+
+    void mark(const char *phase);
+
     detail::reply_t send_command(const std::string & command);
 
     detail::reply_t recv();
 
+    detail::reply_t recv(std::chrono::milliseconds timeout);
+
     void reset_connection();
 
-    std::unique_ptr<detail::data_connection> establish_data_connection(const std::string & command);
+    void dump_flight_record(const std::string & directory);
+
+    std::unique_ptr<detail::data_connection> establish_data_connection(const std::string & command,
+                                                                       std::uint64_t offset = 0);
+
+    bool send_file(const std::string & local_file, const std::string & remote_file, std::uint64_t offset);
+
+    bool recv_file(const std::string & remote_file, const std::string & local_file, std::uint64_t offset);
+
+    void set_download_total(std::uint64_t offset);
+
+    bool retry(const std::function<bool()> & transfer);
+
+    void reconnect();
+
+    bool start_tls();
+
+    bool run_transfer(detail::data_connection & connection, const std::function<void()> & transfer);
+
+    /* Completes a transfer that has been run elsewhere and failed with
+     * 'error', if it's set.
+     */
+    bool finish_transfer(detail::data_connection & connection, const std::exception_ptr & error);
+
+    /* Runs an operation on this connection when another client is in charge
+     * of handling errors.
+     */
+    template<typename Operation>
+    auto guarded(const Operation & operation) -> decltype(operation())
+    {
+        try
+        {
+            return operation();
+        }
+        catch (const detail::connection_exception & ex)
+        {
+            reset_connection();
+            throw ftp_exception(ex);
+        }
+    }
+
+    void abort_transfer();
 
     static bool try_parse_server_port(const std::string & epsv_reply, uint16_t & port);
 
+    static bool try_parse_host_port(const std::string & pasv_reply, std::string & host_port);
+
+    static bool try_parse_file_size(const std::string & size_reply, std::uint64_t & size);
+
     void report_reply(const std::string & reply);
 
     void report_reply(const detail::reply_t & reply);
 
+    void report_progress(const transfer_progress & progress);
+
     detail::control_connection control_connection_;
     std::list<event_observer *> observers_;
+    bool sparse_download_;
+    retry_policy retry_policy_;
+    detail::reply_t last_reply_;
+    timeouts timeouts_;
+    std::atomic<bool> abort_requested_;
+    std::shared_ptr<rate_limiter> rate_limiter_;
+    detail::progress_tracker progress_;
+    std::shared_ptr<trace_exporter> trace_exporter_;
+    std::unique_ptr<detail::span_recorder> span_;
+    flight_recorder flight_recorder_;
+    tcp_statistics tcp_statistics_;
+    std::size_t socket_buffer_size_;
+    std::shared_ptr<transport> transport_;
+    std::optional<std::string> flight_record_directory_;
+    tls_options tls_options_;
+    std::unique_ptr<detail::tls_context> tls_context_;
+
+    /* Session state to restore after reconnect. */
+    std::string hostname_;
+    uint16_t port_;
+    bool tls_;
+    std::optional<std::string> username_;
+    std::string password_;
+    std::optional<detail::transfer_type> transfer_type_;
+    std::vector<std::string> directories_;
 };
 
 } // namespace ftp
@@ -0,0 +1,148 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "ascii_conversion.hpp"
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define FTP_ASCII_CONVERSION_SSE2
+#endif
+
+namespace ftp::detail
+{
+
+using std::size_t;
+
+/* Both conversions scan 16 bytes at a time and copy chunks without line
+ * endings as a whole. Since the output never gets ahead of the input, the
+ * conversion is done in a single pass over the same buffer.
+ */
+size_t lf_to_crlf(char *buffer, size_t offset, size_t size, bool & last_cr)
+{
+    const char *in = buffer + offset;
+    const char *end = in + size;
+    char *out = buffer;
+
+    while (in < end)
+    {
+#ifdef FTP_ASCII_CONVERSION_SSE2
+        if (end - in >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\n')));
+
+            if (mask == 0)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), chunk);
+                in += 16;
+                out += 16;
+                last_cr = out[-1] == '\r';
+                continue;
+            }
+
+            /* Copy everything before the first LF. */
+            int len = __builtin_ctz(mask);
+
+            if (len > 0)
+            {
+                std::memmove(out, in, len);
+                in += len;
+                out += len;
+                last_cr = out[-1] == '\r';
+            }
+        }
+#endif
+
+        char c = *in++;
+
+        if (c == '\n' && !last_cr)
+        {
+            *out++ = '\r';
+        }
+
+        *out++ = c;
+        last_cr = c == '\r';
+    }
+
+    return out - buffer;
+}
+
+size_t crlf_to_lf(char *data, size_t size, bool & cr_pending)
+{
+    const char *in = data;
+    const char *end = data + size;
+    char *out = data;
+
+    cr_pending = false;
+
+    while (in < end)
+    {
+#ifdef FTP_ASCII_CONVERSION_SSE2
+        if (end - in >= 16)
+        {
+            __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i *>(in));
+            int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, _mm_set1_epi8('\r')));
+
+            if (mask == 0)
+            {
+                _mm_storeu_si128(reinterpret_cast<__m128i *>(out), chunk);
+                in += 16;
+                out += 16;
+                continue;
+            }
+
+            /* Copy everything before the first CR. */
+            int len = __builtin_ctz(mask);
+
+            std::memmove(out, in, len);
+            in += len;
+            out += len;
+        }
+#endif
+
+        char c = *in++;
+
+        if (c == '\r')
+        {
+            if (in == end)
+            {
+                cr_pending = true;
+                break;
+            }
+
+            if (*in == '\n')
+            {
+                continue;
+            }
+        }
+
+        *out++ = c;
+    }
+
+    return out - data;
+}
+
+} // namespace ftp::detail
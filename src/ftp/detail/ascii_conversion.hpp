@@ -0,0 +1,53 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_ASCII_CONVERSION_HPP
+#define FTP_ASCII_CONVERSION_HPP
+
+#include <cstddef>
+
+namespace ftp::detail
+{
+
+/* Converts local LF line endings to the network CRLF ones in place. The data
+ * of length 'size' must be located at 'buffer + offset', where 'offset' is
+ * not less than 'size', so that the converted data fits into the buffer from
+ * its beginning. LF already preceded by CR is left as is, 'last_cr' keeps
+ * whether the previous chunk ended with CR.
+ *
+ * Returns the size of the converted data.
+ */
+std::size_t lf_to_crlf(char *buffer, std::size_t offset, std::size_t size, bool & last_cr);
+
+/* Converts the network CRLF line endings to local LF ones in place. If the
+ * data ends with CR, it is not copied and 'cr_pending' is set: whether it is
+ * a part of CRLF is known only with the next chunk.
+ *
+ * Returns the size of the converted data.
+ */
+std::size_t crlf_to_lf(char *data, std::size_t size, bool & cr_pending);
+
+} // namespace ftp::detail
+#endif //FTP_ASCII_CONVERSION_HPP
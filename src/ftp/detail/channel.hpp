@@ -0,0 +1,146 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_CHANNEL_HPP
+#define FTP_CHANNEL_HPP
+
+#include "tls_stream.hpp"
+#include "../transport.hpp"
+#include <boost/asio/buffer.hpp>
+#include <boost/asio/error.hpp>
+#include <atomic>
+#include <memory>
+
+namespace ftp::detail
+{
+
+/* The stream a connection reads and writes: the TLS stream over the socket,
+ * or the stream of a transport once one is set. Meets the requirements of
+ * Boost.Asio SyncReadStream and SyncWriteStream.
+ */
+class channel
+{
+public:
+    explicit channel(tls_stream & stream)
+        : stream_(stream),
+          cancelled_(nullptr)
+    {
+    }
+
+    channel(const channel &) = delete;
+
+    channel & operator=(const channel &) = delete;
+
+    void set_transport_stream(std::unique_ptr<transport_stream> stream)
+    {
+        transport_stream_ = std::move(stream);
+    }
+
+    /* nullptr unless a transport is used. */
+    transport_stream * get_transport_stream() const
+    {
+        return transport_stream_.get();
+    }
+
+    /* The TLS stream checks the flag itself. */
+    void set_cancellation(const std::atomic<bool> *cancelled)
+    {
+        cancelled_ = cancelled;
+    }
+
+    template<typename MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence & buffers, boost::system::error_code & ec)
+    {
+        if (!transport_stream_)
+        {
+            return stream_.read_some(buffers, ec);
+        }
+
+        if (is_cancelled(ec))
+        {
+            return 0;
+        }
+
+        for (auto it = boost::asio::buffer_sequence_begin(buffers);
+             it != boost::asio::buffer_sequence_end(buffers); ++it)
+        {
+            boost::asio::mutable_buffer buffer(*it);
+
+            if (buffer.size() > 0)
+            {
+                return transport_stream_->read_some(static_cast<char *>(buffer.data()), buffer.size(), ec);
+            }
+        }
+
+        ec.clear();
+        return 0;
+    }
+
+    template<typename ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence & buffers, boost::system::error_code & ec)
+    {
+        if (!transport_stream_)
+        {
+            return stream_.write_some(buffers, ec);
+        }
+
+        if (is_cancelled(ec))
+        {
+            return 0;
+        }
+
+        for (auto it = boost::asio::buffer_sequence_begin(buffers);
+             it != boost::asio::buffer_sequence_end(buffers); ++it)
+        {
+            boost::asio::const_buffer buffer(*it);
+
+            if (buffer.size() > 0)
+            {
+                return transport_stream_->write_some(static_cast<const char *>(buffer.data()), buffer.size(), ec);
+            }
+        }
+
+        ec.clear();
+        return 0;
+    }
+
+private:
+    bool is_cancelled(boost::system::error_code & ec) const
+    {
+        if (cancelled_ && *cancelled_)
+        {
+            ec = boost::asio::error::operation_aborted;
+            return true;
+        }
+
+        return false;
+    }
+
+    tls_stream & stream_;
+    std::unique_ptr<transport_stream> transport_stream_;
+    const std::atomic<bool> *cancelled_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_CHANNEL_HPP
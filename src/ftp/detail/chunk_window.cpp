@@ -0,0 +1,195 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "chunk_window.hpp"
+#include <algorithm>
+
+namespace ftp::detail
+{
+
+using std::size_t;
+using std::uint64_t;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+
+chunk_window::chunk_window(size_t chunks, size_t readers)
+    : oldest_(0),
+      produced_(0),
+      closed_(false),
+      cancelled_(false)
+{
+    std::vector<buffer_pool::buffer> buffers = buffer_pool::instance().acquire(chunks + readers);
+
+    slots_.reserve(chunks);
+    readers_.reserve(readers);
+
+    for (size_t i = 0; i < chunks; i++)
+    {
+        slots_.push_back(slot{std::move(buffers[i]), 0});
+    }
+
+    for (size_t i = 0; i < readers; i++)
+    {
+        readers_.push_back(reader_state{std::move(buffers[chunks + i]), 0, false});
+    }
+}
+
+size_t chunk_window::chunk_size() const
+{
+    return slots_.front().buffer.size();
+}
+
+char * chunk_window::prepare()
+{
+    unique_lock<mutex> lock(mutex_);
+
+    changed_.wait(lock, [&]() { return cancelled_ || can_overwrite(); });
+
+    if (cancelled_)
+    {
+        return nullptr;
+    }
+
+    /* The chunk kept in the slot is gone. */
+    if (produced_ >= slots_.size())
+    {
+        oldest_ = produced_ - slots_.size() + 1;
+    }
+
+    return slots_[produced_ % slots_.size()].buffer.data();
+}
+
+void chunk_window::commit(size_t size)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        slots_[produced_ % slots_.size()].size = size;
+        produced_++;
+    }
+
+    changed_.notify_all();
+}
+
+void chunk_window::close()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        closed_ = true;
+    }
+
+    changed_.notify_all();
+}
+
+void chunk_window::cancel()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+
+    changed_.notify_all();
+}
+
+chunk_window::status chunk_window::read(size_t reader, uint64_t index, const char * & data, size_t & size)
+{
+    unique_lock<mutex> lock(mutex_);
+
+    changed_.wait(lock, [&]() { return cancelled_ || closed_ || index < produced_; });
+
+    if (cancelled_)
+    {
+        return status::cancelled;
+    }
+
+    if (index < oldest_)
+    {
+        return status::evicted;
+    }
+
+    if (index >= produced_)
+    {
+        return status::end;
+    }
+
+    const slot & slot = slots_[index % slots_.size()];
+    reader_state & state = readers_[reader];
+
+    std::copy(slot.buffer.data(), slot.buffer.data() + slot.size, state.buffer.data());
+    state.position = index + 1;
+
+    data = state.buffer.data();
+    size = slot.size;
+
+    lock.unlock();
+    changed_.notify_all();
+
+    return status::available;
+}
+
+char * chunk_window::reader_buffer(size_t reader) const
+{
+    return readers_[reader].buffer.data();
+}
+
+void chunk_window::finish(size_t reader)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        readers_[reader].finished = true;
+    }
+
+    changed_.notify_all();
+}
+
+bool chunk_window::can_overwrite() const
+{
+    if (produced_ < slots_.size())
+    {
+        return true;
+    }
+
+    uint64_t overwritten = produced_ - slots_.size();
+    bool waiting = false;
+
+    for (const reader_state & reader : readers_)
+    {
+        if (reader.finished)
+        {
+            continue;
+        }
+
+        if (reader.position > overwritten)
+        {
+            return true;
+        }
+
+        waiting = true;
+    }
+
+    return !waiting;
+}
+
+} // namespace ftp::detail
@@ -0,0 +1,124 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_CHUNK_WINDOW_HPP
+#define FTP_CHUNK_WINDOW_HPP
+
+#include "../buffer_pool.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp::detail
+{
+
+/* The last few chunks of a stream, read once by a producer and sent by a
+ * fixed number of readers, each at its own pace. A reader copies a chunk
+ * into its own buffer before sending it, so no chunk is held while a reader
+ * blocks on a slow network. The producer keeps pace with the leading reader
+ * only: a reader that falls behind the window finds its next chunk gone and
+ * has to get the rest of the data elsewhere.
+ */
+class chunk_window
+{
+public:
+    enum class status
+    {
+        available,
+        end,
+        evicted,
+        cancelled
+    };
+
+    /* Takes the buffers of the chunks and of the readers from the pool at
+     * once, so that windows can't deadlock each other on a tight budget.
+     */
+    chunk_window(std::size_t chunks, std::size_t readers);
+
+    chunk_window(const chunk_window &) = delete;
+
+    chunk_window & operator=(const chunk_window &) = delete;
+
+    std::size_t chunk_size() const;
+
+    /* Waits until the leading reader has copied the chunk about to be
+     * overwritten and returns its buffer of chunk_size() bytes, nullptr if
+     * the window has been cancelled.
+     */
+    char * prepare();
+
+    void commit(std::size_t size);
+
+    /* Marks the end of data. */
+    void close();
+
+    /* Wakes up everybody. */
+    void cancel();
+
+    /* Waits for the chunk and copies it into the buffer of the reader. */
+    status read(std::size_t reader, std::uint64_t index, const char * & data, std::size_t & size);
+
+    /* The buffer of chunk_size() bytes the reader copies chunks into. */
+    char * reader_buffer(std::size_t reader) const;
+
+    /* The producer stops waiting for the reader. */
+    void finish(std::size_t reader);
+
+private:
+    struct slot
+    {
+        buffer_pool::buffer buffer;
+        std::size_t size;
+    };
+
+    struct reader_state
+    {
+        buffer_pool::buffer buffer;
+
+        /* The next chunk the reader copies. */
+        std::uint64_t position;
+        bool finished;
+    };
+
+    /* Whether the chunk in the slot about to be overwritten is no longer
+     * needed by the leading reader.
+     */
+    bool can_overwrite() const;
+
+    std::vector<slot> slots_;
+    std::vector<reader_state> readers_;
+    std::mutex mutex_;
+    std::condition_variable changed_;
+
+    /* Chunks [oldest_, produced_) are available. */
+    std::uint64_t oldest_;
+    std::uint64_t produced_;
+    bool closed_;
+    bool cancelled_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_CHUNK_WINDOW_HPP
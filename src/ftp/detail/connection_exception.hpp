@@ -35,12 +35,14 @@ class connection_exception : public std::exception
 {
 public:
     explicit connection_exception(boost::system::error_code & ec)
+        : error_(ec)
     {
         message_ = ec.message();
     }
 
     template<typename ...Args>
     explicit connection_exception(boost::system::error_code & ec, const std::string & fmt, Args && ...args)
+        : error_(ec)
     {
         message_ = detail::utils::format(fmt, std::forward<Args>(args)...);
         message_.append(": ");
@@ -58,8 +60,14 @@ public:
         return message_.c_str();
     }
 
+    const boost::system::error_code & code() const noexcept
+    {
+        return error_;
+    }
+
 private:
     std::string message_;
+    boost::system::error_code error_;
 };
 
 } // namespace ftp::detail
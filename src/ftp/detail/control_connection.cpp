@@ -24,17 +24,31 @@
 
 #include "control_connection.hpp"
 #include "connection_exception.hpp"
-#include <boost/asio/connect.hpp>
+#include "../resolver_cache.hpp"
+#include <boost/asio/steady_timer.hpp>
 #include <boost/asio/read_until.hpp>
 #include <boost/asio/write.hpp>
 #include <boost/lexical_cast/try_lexical_convert.hpp>
+#include <functional>
+#include <memory>
+#include <vector>
 
 namespace ftp::detail
 {
 
 using std::uint16_t;
 using std::string;
-using std::to_string;
+using std::vector;
+using std::unique_ptr;
+using std::make_unique;
+using boost::asio::ip::tcp;
+using boost::system::error_code;
+
+/* Connection Attempt Delay.
+ *
+ * RFC 8305: https://tools.ietf.org/html/rfc8305#section-5
+ */
+static const std::chrono::milliseconds connection_attempt_delay(250);
 
 static bool try_parse_status_code(const string & line, uint16_t & status_code)
 {
@@ -48,49 +62,253 @@ static bool try_parse_status_code(const string & line, uint16_t & status_code)
 
 control_connection::control_connection()
     : io_context_(),
-      socket_(io_context_)
+      socket_(io_context_),
+      stream_(socket_),
+      channel_(stream_),
+      span_(nullptr)
 {
 }
 
+/* Alternate address families, starting with the family of the most
+ * preferred address. The resolver has already sorted addresses by
+ * preference within each family.
+ *
+ * RFC 8305: https://tools.ietf.org/html/rfc8305#section-4
+ */
+vector<tcp::endpoint> interleave_address_families(const vector<tcp::endpoint> & addresses)
+{
+    vector<tcp::endpoint> preferred;
+    vector<tcp::endpoint> other;
+
+    for (const tcp::endpoint & endpoint : addresses)
+    {
+        if (endpoint.address().is_v6() == addresses.front().address().is_v6())
+        {
+            preferred.push_back(endpoint);
+        }
+        else
+        {
+            other.push_back(endpoint);
+        }
+    }
+
+    vector<tcp::endpoint> endpoints;
+
+    for (size_t i = 0; i < preferred.size() || i < other.size(); ++i)
+    {
+        if (i < preferred.size())
+        {
+            endpoints.push_back(preferred[i]);
+        }
+
+        if (i < other.size())
+        {
+            endpoints.push_back(other[i]);
+        }
+    }
+
+    return endpoints;
+}
+
+void control_connection::set_span(span_recorder *span)
+{
+    span_ = span;
+}
+
+void control_connection::set_transport(const std::shared_ptr<transport> & transport)
+{
+    transport_ = transport;
+}
+
 void control_connection::open(const string & hostname, uint16_t port)
 {
-    boost::asio::ip::tcp::resolver resolver(io_context_);
-    boost::system::error_code ec;
+    error_code ec;
+
+    if (transport_)
+    {
+        channel_.set_transport_stream(transport_->connect(hostname, port, 0, ec));
+
+        if (span_)
+        {
+            span_->mark("connect");
+        }
+
+        if (ec)
+        {
+            channel_.set_transport_stream(nullptr);
+            throw connection_exception(ec, "Cannot open connection");
+        }
+
+        return;
+    }
+
+    vector<tcp::endpoint> addresses = resolver_cache::instance().resolve(hostname, port, ec);
 
-    boost::asio::ip::tcp::resolver::results_type endpoints =
-            resolver.resolve(hostname, to_string(port), ec);
+    if (span_)
+    {
+        span_->mark("resolve");
+    }
 
     if (ec)
     {
         throw connection_exception(ec, "Cannot open connection");
     }
 
-    boost::asio::connect(socket_, endpoints, ec);
+    open(addresses);
+}
+
+void control_connection::open(const vector<tcp::endpoint> & addresses)
+{
+    error_code ec;
+
+    connect(interleave_address_families(addresses), ec);
+
+    if (span_)
+    {
+        span_->mark("connect");
+    }
 
     if (ec)
     {
-        boost::system::error_code ignored;
+        throw connection_exception(ec, "Cannot open connection");
+    }
+}
 
-        /* If the connect fails, and the socket was automatically opened,
-         * the socket is not returned to the closed state.
-         *
-         * https://www.boost.org/doc/libs/1_70_0/doc/html/boost_asio/reference/basic_stream_socket/connect/overload2.html
-         */
-        socket_.close(ignored);
+/* Happy Eyeballs: start a new connection attempt every 250 ms, or as soon as
+ * the previous one fails, without cancelling the attempts in progress. The
+ * first attempt to succeed wins, and the others are cancelled. A dead route
+ * for one address family doesn't delay the connection over the other one.
+ *
+ * RFC 8305: https://tools.ietf.org/html/rfc8305#section-5
+ */
+void control_connection::connect(const vector<tcp::endpoint> & endpoints, error_code & ec)
+{
+    vector<unique_ptr<tcp::socket>> attempts;
+    boost::asio::steady_timer attempt_timer(io_context_);
+    boost::asio::steady_timer deadline_timer(io_context_);
+    size_t next = 0;
+    size_t pending = 0;
+    bool finished = false;
 
-        throw connection_exception(ec, "Cannot open connection");
+    ec = boost::asio::error::host_not_found;
+
+    /* Otherwise, nothing would stop the deadline timer. */
+    if (endpoints.empty())
+    {
+        return;
+    }
+
+    auto finish = [&]()
+    {
+        error_code ignored;
+
+        finished = true;
+        attempt_timer.cancel();
+        deadline_timer.cancel();
+
+        for (const unique_ptr<tcp::socket> & attempt : attempts)
+        {
+            attempt->close(ignored);
+        }
+    };
+
+    std::function<void()> start_attempt = [&]()
+    {
+        if (finished || next == endpoints.size())
+        {
+            return;
+        }
+
+        attempts.push_back(make_unique<tcp::socket>(io_context_));
+        tcp::socket & attempt = *attempts.back();
+        ++pending;
+
+        attempt.async_connect(endpoints[next++], [&](const error_code & error)
+        {
+            --pending;
+
+            if (finished)
+            {
+                return;
+            }
+
+            if (!error)
+            {
+                ec.clear();
+                socket_ = std::move(attempt);
+                finish();
+                return;
+            }
+
+            error_code ignored;
+
+            ec = error;
+            attempt.close(ignored);
+
+            if (pending == 0 && next == endpoints.size())
+            {
+                finish();
+            }
+            else
+            {
+                start_attempt();
+            }
+        });
+
+        attempt_timer.expires_after(connection_attempt_delay);
+        attempt_timer.async_wait([&](const error_code & error)
+        {
+            if (!error)
+            {
+                start_attempt();
+            }
+        });
+    };
+
+    if (timeouts_.connect > std::chrono::milliseconds::zero())
+    {
+        deadline_timer.expires_after(timeouts_.connect);
+        deadline_timer.async_wait([&](const error_code & error)
+        {
+            if (!error && !finished)
+            {
+                ec = boost::asio::error::timed_out;
+                finish();
+            }
+        });
     }
+
+    start_attempt();
+
+    io_context_.restart();
+    io_context_.run();
+}
+
+void control_connection::set_timeouts(const timeouts & timeouts)
+{
+    timeouts_ = timeouts;
 }
 
 bool control_connection::is_open() const
 {
-    return socket_.is_open();
+    return socket_.is_open() || channel_.get_transport_stream() != nullptr;
 }
 
 void control_connection::close()
 {
     boost::system::error_code ec;
 
+    if (transport_stream *stream = channel_.get_transport_stream())
+    {
+        stream->shutdown_send(ec);
+        stream->close(false);
+        channel_.set_transport_stream(nullptr);
+        return;
+    }
+
+    /* Ignore errors, the connection is closed anyway. */
+    stream_.shutdown(ec);
+
     socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
 
     if (ec == boost::asio::error::not_connected)
@@ -113,8 +331,48 @@ void control_connection::close()
     }
 }
 
+void control_connection::start_tls(const tls_context & context,
+                                   const string & hostname,
+                                   const string & session_key)
+{
+    /* Anything received before the handshake is not protected, and must not
+     * be treated as a reply to commands sent afterwards.
+     */
+    buffer_.clear();
+
+    if (channel_.get_transport_stream())
+    {
+        throw connection_exception("Cannot start TLS: not supported by the transport");
+    }
+
+    boost::system::error_code ec;
+
+    stream_.set_timeouts(std::chrono::milliseconds::zero(), utils::deadline_after(timeouts_.connect));
+    stream_.handshake(context, hostname, session_key, ec);
+
+    if (ec)
+    {
+        throw connection_exception(ec, "Cannot start TLS");
+    }
+
+    if (span_)
+    {
+        span_->mark("tls_handshake");
+    }
+}
+
+bool control_connection::is_secure() const
+{
+    return stream_.is_secure();
+}
+
 string control_connection::ip() const
 {
+    if (transport_stream *stream = channel_.get_transport_stream())
+    {
+        return stream->remote_ip();
+    }
+
     boost::system::error_code ec;
 
     boost::asio::ip::tcp::endpoint remote_endpoint = socket_.remote_endpoint(ec);
@@ -136,6 +394,14 @@ string control_connection::ip() const
 
 reply_t control_connection::recv()
 {
+    return recv(timeouts_.reply);
+}
+
+reply_t control_connection::recv(std::chrono::milliseconds timeout)
+{
+    /* The whole reply, including all lines of a multi-line one. */
+    stream_.set_timeouts(std::chrono::milliseconds::zero(), utils::deadline_after(timeout));
+
     uint16_t status_code;
     string status_line;
 
@@ -176,6 +442,15 @@ reply_t control_connection::recv()
     {
         boost::system::error_code ec;
 
+        if (transport_stream *stream = channel_.get_transport_stream())
+        {
+            stream->close(false);
+            channel_.set_transport_stream(nullptr);
+
+            return reply_t(status_code, status_line);
+        }
+
+        stream_.shutdown(ec);
         socket_.close(ec);
 
         if (ec)
@@ -218,7 +493,9 @@ void control_connection::send(const string & command)
 {
     boost::system::error_code ec;
 
-    boost::asio::write(socket_, boost::asio::buffer(command + "\r\n"), ec);
+    stream_.set_timeouts(std::chrono::milliseconds::zero(), utils::deadline_after(timeouts_.reply));
+
+    boost::asio::write(channel_, boost::asio::buffer(command + "\r\n"), ec);
 
     if (ec)
     {
@@ -230,7 +507,7 @@ string control_connection::read_line()
 {
     boost::system::error_code ec;
 
-    size_t len = boost::asio::read_until(socket_, boost::asio::dynamic_buffer(buffer_), '\n', ec);
+    size_t len = boost::asio::read_until(channel_, boost::asio::dynamic_buffer(buffer_), '\n', ec);
 
     if (ec == boost::asio::error::eof)
     {
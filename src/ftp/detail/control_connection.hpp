@@ -25,12 +25,25 @@
 #ifndef FTP_CONTROL_CONNECTION_HPP
 #define FTP_CONTROL_CONNECTION_HPP
 
+#include "channel.hpp"
 #include "reply.hpp"
+#include "tls_stream.hpp"
+#include "../timeouts.hpp"
+#include "../transport.hpp"
+#include "span_recorder.hpp"
 #include <boost/asio/ip/tcp.hpp>
+#include <memory>
+#include <vector>
 
 namespace ftp::detail
 {
 
+/* Orders the resolved addresses for connection attempts, alternating the
+ * address families. Used by control_connection::open().
+ */
+std::vector<boost::asio::ip::tcp::endpoint>
+interleave_address_families(const std::vector<boost::asio::ip::tcp::endpoint> & addresses);
+
 class control_connection
 {
 public:
@@ -40,19 +53,49 @@ public:
 
     control_connection & operator=(const control_connection &) = delete;
 
+    /* Used by the following operations. The reply timeout limits sending
+     * a command and receiving a reply separately.
+     */
+    void set_timeouts(const timeouts & timeouts);
+
+    /* Marks the phases of open() in the span, if it's set. */
+    void set_span(span_recorder *span);
+
+    /* Connects through the transport instead of a socket from the next
+     * open() on, nullptr goes back to sockets.
+     */
+    void set_transport(const std::shared_ptr<transport> & transport);
+
     void open(const std::string & hostname, uint16_t port);
 
+    /* Connects to the first of the addresses that accepts the connection,
+     * without resolving anything.
+     */
+    void open(const std::vector<boost::asio::ip::tcp::endpoint> & addresses);
+
     bool is_open() const;
 
     void close();
 
+    /* Starts TLS on the open connection, after a positive reply to AUTH TLS. */
+    void start_tls(const tls_context & context,
+                   const std::string & hostname,
+                   const std::string & session_key);
+
+    bool is_secure() const;
+
     std::string ip() const;
 
     void send(const std::string & command);
 
     reply_t recv();
 
+    /* Waits for the reply for at most 'timeout', zero means no limit. */
+    reply_t recv(std::chrono::milliseconds timeout);
+
 private:
+    void connect(const std::vector<boost::asio::ip::tcp::endpoint> & endpoints, boost::system::error_code & ec);
+
     std::string read_line();
 
     static bool is_last_line(const std::string & line, uint16_t status_code);
@@ -60,6 +103,11 @@ private:
     std::string buffer_;
     boost::asio::io_context io_context_;
     boost::asio::ip::tcp::socket socket_;
+    tls_stream stream_;
+    channel channel_;
+    std::shared_ptr<transport> transport_;
+    timeouts timeouts_;
+    span_recorder *span_;
 };
 
 } // namespace ftp::detail
@@ -24,8 +24,21 @@
 
 #include "data_connection.hpp"
 #include "connection_exception.hpp"
+#include "ascii_conversion.hpp"
+#include "tcp_info.hpp"
+#include "../buffer_pool.hpp"
+#include "../metrics.hpp"
 #include <boost/asio/read.hpp>
 #include <boost/asio/write.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <algorithm>
+#include <limits>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 namespace ftp::detail
 {
@@ -33,19 +46,81 @@ namespace ftp::detail
 using std::string;
 using std::ifstream;
 using std::ofstream;
+using std::uint64_t;
+
+/* The most sendfile() sends at once when the progress is tracked. */
+static const size_t progress_chunk_size = 4 * 1024 * 1024;
 
-data_connection::data_connection(const string & ip, uint16_t port)
+data_connection::data_connection(const string & ip, uint16_t port, transfer_type type)
     : io_context_(),
       socket_(io_context_),
+      stream_(socket_),
+      channel_(stream_),
       ip_(ip),
-      port_(port)
+      port_(port),
+      transfer_type_(type),
+      cancelled_(nullptr),
+      progress_(nullptr),
+      span_(nullptr),
+      first_data_(true),
+      tcp_statistics_(nullptr),
+      socket_buffer_size_(0),
+      granted_buffer_size_(0)
+{
+}
+
+void data_connection::set_timeouts(const timeouts & timeouts)
+{
+    timeouts_ = timeouts;
+}
+
+void data_connection::set_cancellation(const std::atomic<bool> *cancelled)
+{
+    cancelled_ = cancelled;
+    stream_.set_cancellation(cancelled);
+    channel_.set_cancellation(cancelled);
+}
+
+void data_connection::set_rate_limiter(const std::shared_ptr<rate_limiter> & limiter)
+{
+    rate_limiter_ = limiter;
+}
+
+void data_connection::set_progress(progress_tracker *progress)
+{
+    progress_ = progress;
+}
+
+void data_connection::set_span(span_recorder *span)
 {
+    span_ = span;
+}
+
+void data_connection::set_socket_buffer_size(size_t size)
+{
+    socket_buffer_size_ = size;
+}
+
+void data_connection::set_tcp_statistics(tcp_statistics *statistics)
+{
+    tcp_statistics_ = statistics;
+}
+
+void data_connection::set_transport(const std::shared_ptr<transport> & transport)
+{
+    transport_ = transport;
 }
 
 void data_connection::open()
 {
     boost::system::error_code ec;
 
+    if (transport_)
+    {
+        open_transport();
+        return;
+    }
+
     boost::asio::ip::address address = boost::asio::ip::address::from_string(ip_, ec);
 
     if (ec)
@@ -53,8 +128,72 @@ void data_connection::open()
         throw connection_exception(ec, "Cannot get ip address");
     }
 
+    /* The transfer deadline includes connecting. */
+    std::chrono::steady_clock::time_point deadline = utils::deadline_after(timeouts_.transfer);
+
     boost::asio::ip::tcp::endpoint remote_endpoint(address, port_);
-    socket_.connect(remote_endpoint, ec);
+    boost::asio::steady_timer timer(io_context_);
+
+    if (socket_buffer_size_ > 0)
+    {
+        socket_.open(remote_endpoint.protocol(), ec);
+
+        if (ec)
+        {
+            throw connection_exception(ec, "Cannot open connection");
+        }
+
+        /* The kernel caps the sizes, which is not an error. */
+        boost::system::error_code ignored;
+        int size = static_cast<int>(std::min<size_t>(socket_buffer_size_, std::numeric_limits<int>::max()));
+
+        socket_.set_option(boost::asio::socket_base::send_buffer_size(size), ignored);
+        socket_.set_option(boost::asio::socket_base::receive_buffer_size(size), ignored);
+
+        boost::asio::socket_base::send_buffer_size send_size;
+        boost::asio::socket_base::receive_buffer_size receive_size;
+
+        socket_.get_option(send_size, ignored);
+        socket_.get_option(receive_size, ignored);
+
+        granted_buffer_size_ = static_cast<size_t>(std::max(std::min(send_size.value(), receive_size.value()), 0));
+
+#ifdef __linux__
+        /* Linux reports twice the size, the other half is its bookkeeping. */
+        granted_buffer_size_ /= 2;
+#endif
+    }
+    else
+    {
+        granted_buffer_size_ = 0;
+    }
+
+    ec = boost::asio::error::would_block;
+
+    socket_.async_connect(remote_endpoint, [&](const boost::system::error_code & error)
+    {
+        if (ec == boost::asio::error::would_block)
+        {
+            ec = error;
+            timer.cancel();
+        }
+    });
+
+    if (timeouts_.connect > std::chrono::milliseconds::zero())
+    {
+        timer.expires_after(timeouts_.connect);
+        timer.async_wait([&](const boost::system::error_code & error)
+        {
+            if (!error && ec == boost::asio::error::would_block)
+            {
+                ec = boost::asio::error::timed_out;
+                socket_.cancel();
+            }
+        });
+    }
+
+    io_context_.restart();
+    io_context_.run();
 
     if (ec)
     {
@@ -69,17 +208,93 @@ void data_connection::open()
 
         throw connection_exception(ec, "Cannot open connection");
     }
+
+    if (span_)
+    {
+        span_->mark("data_connect");
+    }
+
+    if (tcp_statistics_)
+    {
+        *tcp_statistics_ = tcp_statistics();
+        tcp_statistics_->socket_buffer_size = granted_buffer_size_;
+        opened_ = std::chrono::steady_clock::now();
+        last_tcp_sample_ = opened_;
+        sample_tcp(tcp_statistics_->start);
+    }
+
+    stream_.set_timeouts(timeouts_.data_idle, deadline);
+}
+
+/* Like open(), without the socket options and the timeouts. */
+void data_connection::open_transport()
+{
+    boost::system::error_code ec;
+
+    channel_.set_transport_stream(transport_->connect(ip_, port_, socket_buffer_size_, ec));
+    granted_buffer_size_ = socket_buffer_size_;
+
+    if (ec)
+    {
+        channel_.set_transport_stream(nullptr);
+        throw connection_exception(ec, "Cannot open connection");
+    }
+
+    if (span_)
+    {
+        span_->mark("data_connect");
+    }
+
+    if (tcp_statistics_)
+    {
+        *tcp_statistics_ = tcp_statistics();
+        tcp_statistics_->socket_buffer_size = granted_buffer_size_;
+        opened_ = std::chrono::steady_clock::now();
+        last_tcp_sample_ = opened_;
+        sample_tcp(tcp_statistics_->start);
+    }
 }
 
 bool data_connection::is_open() const
 {
-    return socket_.is_open();
+    return socket_.is_open() || channel_.get_transport_stream() != nullptr;
 }
 
 void data_connection::close()
 {
     boost::system::error_code ec;
 
+    finish_tcp_statistics();
+
+    if (transport_stream *stream = channel_.get_transport_stream())
+    {
+        stream->shutdown_send(ec);
+        stream->close(false);
+        channel_.set_transport_stream(nullptr);
+        return;
+    }
+
+    if (stream_.is_secure())
+    {
+        /* Send close_notify, so that the server can tell a complete upload
+         * from a truncated one. Errors are reported by the server reply.
+         */
+        stream_.shutdown(ec);
+
+        /* The server may have sent records that were never read, such as
+         * TLS 1.3 session tickets. Closing a socket with unread data resets
+         * the connection, and the server loses the end of an upload. Wait
+         * for the server to close its side instead.
+         */
+        socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+
+        while (!ec)
+        {
+            char discarded[1024];
+            stream_.read_some(boost::asio::buffer(discarded), ec);
+        }
+    }
+
     socket_.shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
 
     if (ec == boost::asio::error::not_connected)
@@ -102,26 +317,91 @@ void data_connection::close()
     }
 }
 
+void data_connection::abort()
+{
+    boost::system::error_code ignored;
+
+    finish_tcp_statistics();
+
+    if (transport_stream *stream = channel_.get_transport_stream())
+    {
+        stream->close(true);
+        channel_.set_transport_stream(nullptr);
+        return;
+    }
+
+    /* Reset the connection rather than close it gracefully, so that the
+     * server doesn't take an interrupted upload for a complete one.
+     */
+    socket_.set_option(boost::asio::socket_base::linger(true, 0), ignored);
+    socket_.close(ignored);
+}
+
+void data_connection::start_tls(const tls_context & context,
+                                const string & hostname,
+                                const string & session_key)
+{
+    if (channel_.get_transport_stream())
+    {
+        throw connection_exception("Cannot start TLS on data connection: not supported by the transport");
+    }
+
+    boost::system::error_code ec;
+
+    stream_.handshake(context, hostname, session_key, ec);
+
+    if (ec)
+    {
+        throw connection_exception(ec, "Cannot start TLS on data connection");
+    }
+
+    if (span_)
+    {
+        span_->mark("data_tls_handshake");
+    }
+}
+
 void data_connection::send(ifstream & file)
 {
     boost::system::error_code ec;
+    buffer_pool::buffer buffer = buffer_pool::instance().acquire();
+
+    /* In ASCII mode, read the file into the second half of the buffer, so
+     * that line endings can be expanded in place.
+     */
+    size_t offset = 0;
+    bool last_cr = false;
+
+    if (transfer_type_ == transfer_type::ascii)
+    {
+        offset = buffer.size() / 2;
+    }
 
     for (;;)
     {
-        file.read(buffer_.data(), buffer_.size());
+        file.read(buffer.data() + offset, buffer.size() - offset);
 
         if (file.fail() && !file.eof())
         {
             throw connection_exception("Cannot read data from file");
         }
 
-        boost::asio::write(socket_, boost::asio::buffer(buffer_, file.gcount()), ec);
+        size_t len = file.gcount();
+
+        if (transfer_type_ == transfer_type::ascii)
+        {
+            len = lf_to_crlf(buffer.data(), offset, len, last_cr);
+        }
+
+        boost::asio::write(channel_, boost::asio::buffer(buffer.data(), len), ec);
 
         if (ec)
         {
             throw connection_exception(ec, "Cannot send data over data connection");
         }
 
+        count_sent(len);
+
         if (file.eof())
         {
             break;
@@ -132,10 +412,23 @@ void data_connection::send(ifstream & file)
 void data_connection::recv(ofstream & file)
 {
     boost::system::error_code ec;
+    buffer_pool::buffer buffer = buffer_pool::instance().acquire();
+
+    /* In ASCII mode, reserve one byte before the received data for CR held
+     * back from the previous chunk.
+     */
+    size_t offset = 0;
+    bool cr_pending = false;
+
+    if (transfer_type_ == transfer_type::ascii)
+    {
+        offset = 1;
+    }
 
     for (;;)
     {
-        size_t len = socket_.read_some(boost::asio::buffer(buffer_), ec);
+        char *data = buffer.data() + offset;
+        size_t len = channel_.read_some(boost::asio::buffer(data, buffer.size() - offset), ec);
 
         if (ec == boost::asio::error::eof)
         {
@@ -146,7 +439,30 @@ void data_connection::recv(ofstream & file)
             throw connection_exception(ec, "Cannot receive data over data connection");
         }
 
-        file.write(buffer_.data(), len);
+        count_received(len);
+
+        if (transfer_type_ == transfer_type::ascii)
+        {
+            if (cr_pending)
+            {
+                *--data = '\r';
+                ++len;
+            }
+
+            len = crlf_to_lf(data, len, cr_pending);
+        }
+
+        file.write(data, len);
+
+        if (file.fail())
+        {
+            throw connection_exception("Cannot write data to file");
+        }
+    }
+
+    if (cr_pending)
+    {
+        file.put('\r');
 
         if (file.fail())
         {
@@ -155,12 +471,249 @@ void data_connection::recv(ofstream & file)
     }
 }
 
+/* Read whole buffers rather than whatever is available on the socket, so
+ * that every chunk passed to the writer starts at a block boundary and
+ * zero blocks can be detected.
+ */
+void data_connection::recv(sparse_file_writer & file)
+{
+    boost::system::error_code ec;
+    buffer_pool::buffer buffer = buffer_pool::instance().acquire();
+
+    /* See recv(ofstream &). Line ending conversion breaks the block
+     * alignment, but text files are rarely sparse anyway.
+     */
+    size_t offset = 0;
+    bool cr_pending = false;
+
+    if (transfer_type_ == transfer_type::ascii)
+    {
+        offset = 1;
+    }
+
+    for (;;)
+    {
+        char *data = buffer.data() + offset;
+        size_t len = boost::asio::read(channel_, boost::asio::buffer(data, buffer.size() - offset), ec);
+
+        if (ec && ec != boost::asio::error::eof)
+        {
+            throw connection_exception(ec, "Cannot receive data over data connection");
+        }
+
+        count_received(len);
+
+        if (transfer_type_ == transfer_type::ascii)
+        {
+            if (cr_pending)
+            {
+                *--data = '\r';
+                ++len;
+            }
+
+            len = crlf_to_lf(data, len, cr_pending);
+
+            if (ec == boost::asio::error::eof && cr_pending)
+            {
+                data[len++] = '\r';
+            }
+        }
+
+        file.write(data, len);
+
+        if (ec == boost::asio::error::eof)
+        {
+            break;
+        }
+    }
+}
+
+bool data_connection::sendfile(const string & path, uint64_t offset)
+{
+#ifdef __linux__
+    /* Line endings have to be converted in user space. */
+    if (transfer_type_ != transfer_type::binary || !stream_.can_send_file() || channel_.get_transport_stream())
+    {
+        return false;
+    }
+
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+
+    if (fd < 0)
+    {
+        throw connection_exception("Cannot read data from file");
+    }
+
+    struct stat file_stat;
+
+    if (::fstat(fd, &file_stat) != 0)
+    {
+        ::close(fd);
+        throw connection_exception("Cannot read data from file");
+    }
+
+    uint64_t size = file_stat.st_size;
+
+    while (offset < size)
+    {
+        boost::system::error_code ec;
+
+        /* sendfile() transfers at most 0x7ffff000 bytes at once. A rate
+         * limited transfer sends a buffer at a time, as send() does.
+         */
+        size_t chunk = static_cast<size_t>(std::min<uint64_t>(size - offset, 0x7ffff000));
+
+        if (rate_limiter_ && rate_limiter_->is_limited())
+        {
+            chunk = std::min(chunk, buffer_pool::instance().buffer_size());
+        }
+        else if (progress_)
+        {
+            chunk = std::min(chunk, progress_chunk_size);
+        }
+
+        size_t len = stream_.send_file(fd, offset, chunk, ec);
+
+        if (ec)
+        {
+            ::close(fd);
+            throw connection_exception(ec, "Cannot send data over data connection");
+        }
+
+        if (len == 0)
+        {
+            /* The file has been truncated. */
+            break;
+        }
+
+        offset += len;
+
+        count_sent(len);
+    }
+
+    ::close(fd);
+
+    return true;
+#else
+    return false;
+#endif
+}
+
+void data_connection::count_sent(size_t size)
+{
+    metrics::instance().add_bytes_sent(size);
+    count_transferred(size);
+}
+
+void data_connection::count_received(size_t size)
+{
+    metrics::instance().add_bytes_received(size);
+    count_transferred(size);
+}
+
+/* Limit the rate after the data has been sent or received. Slower reading
+ * makes the server slow down as well, once the TCP window fills up.
+ */
+void data_connection::count_transferred(size_t size)
+{
+    if (span_ && first_data_)
+    {
+        first_data_ = false;
+        span_->mark("first_byte");
+    }
+
+    if (progress_)
+    {
+        progress_->add(size);
+    }
+
+    if (tcp_statistics_ && tcp_statistics_->available)
+    {
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+
+        if (now - last_tcp_sample_ >= tcp_statistics::sample_interval)
+        {
+            last_tcp_sample_ = now;
+            tcp_statistics_->samples.emplace_back();
+            sample_tcp(tcp_statistics_->samples.back());
+        }
+    }
+
+    if (rate_limiter_)
+    {
+        rate_limiter_->acquire(size, cancelled_);
+    }
+}
+
+void data_connection::sample_tcp(tcp_sample & sample)
+{
+    if (transport_stream *stream = channel_.get_transport_stream())
+    {
+        tcp_statistics_->available = stream->sample(sample);
+        return;
+    }
+
+    tcp_statistics_->available = sample_tcp_info(socket_.native_handle(), sample);
+    sample.elapsed = std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - opened_);
+}
+
+/* Once per connection, before the socket is closed. */
+void data_connection::finish_tcp_statistics()
+{
+    if (!tcp_statistics_ || !tcp_statistics_->available || !is_open())
+    {
+        return;
+    }
+
+    sample_tcp(tcp_statistics_->end);
+
+    if (span_)
+    {
+        span_->set_tcp(tcp_statistics_->end);
+    }
+}
+
+size_t data_connection::read_some(char *data, size_t size)
+{
+    boost::system::error_code ec;
+
+    size_t len = channel_.read_some(boost::asio::buffer(data, size), ec);
+
+    if (ec == boost::asio::error::eof)
+    {
+        return 0;
+    }
+    else if (ec)
+    {
+        throw connection_exception(ec, "Cannot receive data over data connection");
+    }
+
+    count_received(len);
+
+    return len;
+}
+
+void data_connection::write(const char *data, size_t size)
+{
+    boost::system::error_code ec;
+
+    boost::asio::write(channel_, boost::asio::buffer(data, size), ec);
+
+    if (ec)
+    {
+        throw connection_exception(ec, "Cannot send data over data connection");
+    }
+
+    count_sent(size);
+}
+
 string data_connection::recv()
 {
     boost::system::error_code ec;
     string reply;
 
-    boost::asio::read(socket_, boost::asio::dynamic_buffer(reply), ec);
+    boost::asio::read(channel_, boost::asio::dynamic_buffer(reply), ec);
 
     if (ec == boost::asio::error::eof)
     {
@@ -171,6 +724,8 @@ string data_connection::recv()
         throw connection_exception(ec, "Cannot receive data through data connection");
     }
 
+    metrics::instance().add_bytes_received(reply.size());
+
     return reply;
 }
 
@@ -25,39 +25,134 @@
 #ifndef FTP_DATA_CONNECTION_HPP
 #define FTP_DATA_CONNECTION_HPP
 
+#include "channel.hpp"
+#include "sparse_file_writer.hpp"
+#include "tls_stream.hpp"
+#include "../timeouts.hpp"
+#include "../rate_limiter.hpp"
+#include "../tcp_statistics.hpp"
+#include "../transport.hpp"
+#include "progress_tracker.hpp"
+#include "span_recorder.hpp"
 #include <boost/asio/ip/tcp.hpp>
 #include <fstream>
+#include <memory>
 
 namespace ftp::detail
 {
 
+enum class transfer_type
+{
+    binary,
+    ascii
+};
+
 class data_connection
 {
 public:
-    data_connection(const std::string & ip, uint16_t port);
+    data_connection(const std::string & ip, uint16_t port, transfer_type type = transfer_type::binary);
 
     data_connection(const data_connection &) = delete;
 
     data_connection & operator=(const data_connection &) = delete;
 
+    /* Used from open() on. The transfer timeout counts from open(). */
+    void set_timeouts(const timeouts & timeouts);
+
+    /* Transfers fail with 'operation_aborted' once the flag is set. */
+    void set_cancellation(const std::atomic<bool> *cancelled);
+
+    /* Limits the rate of all transfers but recv() into a string. */
+    void set_rate_limiter(const std::shared_ptr<rate_limiter> & limiter);
+
+    /* Counts the data of the same transfers. */
+    void set_progress(progress_tracker *progress);
+
+    /* Marks connecting and the first data in the span. */
+    void set_span(span_recorder *span);
+
+    /* SO_SNDBUF and SO_RCVBUF, set before connecting so that the window
+     * scale fits them. Zero leaves the system default.
+     */
+    void set_socket_buffer_size(std::size_t size);
+
+    /* Samples TCP_INFO into the statistics, which open() resets. */
+    void set_tcp_statistics(tcp_statistics *statistics);
+
+    /* Connects through the transport instead of a socket. */
+    void set_transport(const std::shared_ptr<transport> & transport);
+
     void open();
 
     bool is_open() const;
 
     void close();
 
+    /* Drops the connection without waiting for the server. */
+    void abort();
+
+    /* Starts TLS on the open connection. The server accepts the handshake
+     * once it has replied to the transfer command.
+     */
+    void start_tls(const tls_context & context,
+                   const std::string & hostname,
+                   const std::string & session_key);
+
     void send(std::ifstream & file);
 
+    /* Sends the file from the given offset without copying it to user space.
+     * Returns false if it's not supported for this connection, in which case
+     * nothing is sent.
+     */
+    bool sendfile(const std::string & path, std::uint64_t offset);
+
     void recv(std::ofstream & file);
 
+    void recv(sparse_file_writer & file);
+
     std::string recv();
 
+    /* The data as it is on the wire, in any transfer type. Returns zero at
+     * the end of data.
+     */
+    std::size_t read_some(char *data, std::size_t size);
+
+    void write(const char *data, std::size_t size);
+
 private:
+    void open_transport();
+
+    void count_sent(std::size_t size);
+
+    void count_received(std::size_t size);
+
+    void count_transferred(std::size_t size);
+
+    void sample_tcp(tcp_sample & sample);
+
+    void finish_tcp_statistics();
+
     boost::asio::io_context io_context_;
     boost::asio::ip::tcp::socket socket_;
-    std::array<char, 8192> buffer_;
+    tls_stream stream_;
+    channel channel_;
+    std::shared_ptr<transport> transport_;
     std::string ip_;
     uint16_t port_;
+    transfer_type transfer_type_;
+    timeouts timeouts_;
+    const std::atomic<bool> *cancelled_;
+    std::shared_ptr<rate_limiter> rate_limiter_;
+    progress_tracker *progress_;
+    span_recorder *span_;
+    bool first_data_;
+    tcp_statistics *tcp_statistics_;
+    std::size_t socket_buffer_size_;
+
+    /* What the kernel made of socket_buffer_size_. */
+    std::size_t granted_buffer_size_;
+    std::chrono::steady_clock::time_point opened_;
+    std::chrono::steady_clock::time_point last_tcp_sample_;
 };
 
 } // namespace ftp::detail
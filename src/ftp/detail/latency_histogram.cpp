@@ -0,0 +1,119 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "latency_histogram.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace ftp::detail
+{
+
+using std::size_t;
+using std::uint64_t;
+
+latency_histogram::latency_histogram()
+{
+    reset();
+}
+
+uint64_t latency_histogram::count() const
+{
+    return count_.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::sum() const
+{
+    return sum_.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::max() const
+{
+    return max_.load(std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::value_at(double quantile) const
+{
+    /* The counts are read one by one while values may be recorded, so the
+     * total is taken from them rather than from count_.
+     */
+    std::array<uint64_t, buckets> counts;
+    uint64_t total = 0;
+
+    for (size_t i = 0; i < buckets; i++)
+    {
+        counts[i] = counts_[i].load(std::memory_order_relaxed);
+        total += counts[i];
+    }
+
+    if (total == 0)
+    {
+        return 0;
+    }
+
+    quantile = std::clamp(quantile, 0.0, 1.0);
+
+    uint64_t rank = std::max<uint64_t>(static_cast<uint64_t>(std::ceil(quantile * total)), 1);
+    uint64_t seen = 0;
+
+    for (size_t i = 0; i < buckets; i++)
+    {
+        seen += counts[i];
+
+        if (seen >= rank)
+        {
+            return std::min(bucket_upper_bound(i), max());
+        }
+    }
+
+    return max();
+}
+
+void latency_histogram::reset()
+{
+    for (std::atomic<uint64_t> & count : counts_)
+    {
+        count.store(0, std::memory_order_relaxed);
+    }
+
+    count_.store(0, std::memory_order_relaxed);
+    sum_.store(0, std::memory_order_relaxed);
+    max_.store(0, std::memory_order_relaxed);
+}
+
+uint64_t latency_histogram::bucket_upper_bound(size_t index)
+{
+    if (index < sub_buckets)
+    {
+        return index;
+    }
+
+    unsigned int exponent = static_cast<unsigned int>(index / sub_buckets) + sub_bucket_bits - 1;
+    uint64_t sub_bucket = index % sub_buckets;
+    unsigned int shift = exponent - sub_bucket_bits;
+
+    /* The lowest value of the next bucket, minus one. */
+    return (((sub_buckets + sub_bucket + 1) << shift) - 1);
+}
+
+} // namespace ftp::detail
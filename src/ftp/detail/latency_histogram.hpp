@@ -0,0 +1,105 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_LATENCY_HISTOGRAM_HPP
+#define FTP_LATENCY_HISTOGRAM_HPP
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp::detail
+{
+
+/* Lock-free histogram of durations in nanoseconds with log-linear buckets,
+ * as in HdrHistogram: every power of two is split into 16 buckets, so a
+ * value is known within 1/16 of itself. Recording is a few relaxed atomic
+ * additions.
+ */
+class latency_histogram
+{
+public:
+    latency_histogram();
+
+    latency_histogram(const latency_histogram &) = delete;
+
+    latency_histogram & operator=(const latency_histogram &) = delete;
+
+    void record(std::uint64_t nanoseconds)
+    {
+        counts_[bucket_index(nanoseconds)].fetch_add(1, std::memory_order_relaxed);
+        count_.fetch_add(1, std::memory_order_relaxed);
+        sum_.fetch_add(nanoseconds, std::memory_order_relaxed);
+
+        std::uint64_t max = max_.load(std::memory_order_relaxed);
+
+        while (nanoseconds > max && !max_.compare_exchange_weak(max, nanoseconds, std::memory_order_relaxed))
+        {
+        }
+    }
+
+    std::uint64_t count() const;
+
+    std::uint64_t sum() const;
+
+    std::uint64_t max() const;
+
+    /* The highest value that may fall into the same bucket as the value at
+     * the quantile, 'quantile' is between 0 and 1.
+     */
+    std::uint64_t value_at(double quantile) const;
+
+    void reset();
+
+    static constexpr unsigned int sub_bucket_bits = 4;
+
+    static constexpr std::size_t sub_buckets = std::size_t(1) << sub_bucket_bits;
+
+    static constexpr std::size_t buckets = (64 - sub_bucket_bits + 1) * sub_buckets;
+
+private:
+    static std::size_t bucket_index(std::uint64_t value)
+    {
+        if (value < sub_buckets)
+        {
+            return static_cast<std::size_t>(value);
+        }
+
+        unsigned int exponent = 63 - __builtin_clzll(value);
+        unsigned int shift = exponent - sub_bucket_bits;
+
+        return (exponent - sub_bucket_bits + 1) * sub_buckets + ((value >> shift) & (sub_buckets - 1));
+    }
+
+    static std::uint64_t bucket_upper_bound(std::size_t index);
+
+    std::array<std::atomic<std::uint64_t>, buckets> counts_;
+    std::atomic<std::uint64_t> count_;
+    std::atomic<std::uint64_t> sum_;
+    std::atomic<std::uint64_t> max_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_LATENCY_HISTOGRAM_HPP
@@ -0,0 +1,161 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "progress_tracker.hpp"
+
+namespace ftp::detail
+{
+
+using std::int64_t;
+using std::uint64_t;
+using std::optional;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+/* The total of a transfer of unknown size. */
+static const uint64_t unknown_total = UINT64_MAX;
+
+/* The end of a transfer that is still running. */
+static const int64_t running = 0;
+
+/* The rate before the first sample. */
+static const double no_rate = -1;
+
+static const double nanoseconds_per_second = 1e9;
+
+progress_tracker::progress_tracker()
+    : bytes_(0),
+      total_(unknown_total),
+      started_(0),
+      finished_(running),
+      rate_(no_rate),
+      interval_(0),
+      next_sample_(0),
+      last_sample_(0),
+      last_sample_bytes_(0)
+{
+}
+
+void progress_tracker::configure(std::chrono::milliseconds interval, const callback & callback)
+{
+    interval_.store(std::chrono::duration_cast<nanoseconds>(interval).count(), std::memory_order_relaxed);
+    callback_ = callback;
+}
+
+void progress_tracker::start()
+{
+    int64_t started = now();
+
+    bytes_.store(0, std::memory_order_relaxed);
+    total_.store(unknown_total, std::memory_order_relaxed);
+    rate_.store(no_rate, std::memory_order_relaxed);
+    started_.store(started, std::memory_order_relaxed);
+    finished_.store(running, std::memory_order_relaxed);
+
+    next_sample_ = started + interval_.load(std::memory_order_relaxed);
+    last_sample_ = started;
+    last_sample_bytes_ = 0;
+}
+
+void progress_tracker::set_total(optional<uint64_t> total)
+{
+    total_.store(total.value_or(unknown_total), std::memory_order_relaxed);
+}
+
+void progress_tracker::finish()
+{
+    finished_.store(now(), std::memory_order_relaxed);
+
+    if (interval_.load(std::memory_order_relaxed) > 0)
+    {
+        sample();
+    }
+}
+
+transfer_progress progress_tracker::get() const
+{
+    transfer_progress progress;
+    uint64_t total = total_.load(std::memory_order_relaxed);
+    int64_t elapsed = end() - started_.load(std::memory_order_relaxed);
+
+    progress.bytes = bytes_.load(std::memory_order_relaxed);
+
+    if (total != unknown_total)
+    {
+        progress.total = total;
+    }
+
+    progress.elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(nanoseconds(elapsed));
+
+    if (elapsed > 0)
+    {
+        progress.average_rate = progress.bytes * nanoseconds_per_second / elapsed;
+    }
+
+    double rate = rate_.load(std::memory_order_relaxed);
+
+    progress.rate = rate == no_rate ? progress.average_rate : rate;
+
+    return progress;
+}
+
+nanoseconds progress_tracker::elapsed() const
+{
+    return nanoseconds(end() - started_.load(std::memory_order_relaxed));
+}
+
+void progress_tracker::sample()
+{
+    int64_t sampled = now();
+    uint64_t bytes = bytes_.load(std::memory_order_relaxed);
+
+    if (sampled > last_sample_)
+    {
+        rate_.store((bytes - last_sample_bytes_) * nanoseconds_per_second / (sampled - last_sample_),
+                    std::memory_order_relaxed);
+    }
+
+    last_sample_ = sampled;
+    last_sample_bytes_ = bytes;
+    next_sample_ = sampled + interval_.load(std::memory_order_relaxed);
+
+    if (callback_)
+    {
+        callback_(get());
+    }
+}
+
+int64_t progress_tracker::end() const
+{
+    int64_t finished = finished_.load(std::memory_order_relaxed);
+
+    return finished == running ? now() : finished;
+}
+
+int64_t progress_tracker::now()
+{
+    return std::chrono::duration_cast<nanoseconds>(steady_clock::now().time_since_epoch()).count();
+}
+
+} // namespace ftp::detail
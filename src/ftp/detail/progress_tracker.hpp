@@ -0,0 +1,106 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_PROGRESS_TRACKER_HPP
+#define FTP_PROGRESS_TRACKER_HPP
+
+#include "../transfer_progress.hpp"
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <optional>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp::detail
+{
+
+/* Progress of the current transfer of a client. The transfer thread only
+ * adds to an atomic counter and reads the clock once per chunk, everything
+ * else happens once per sampling interval. Other threads read the progress
+ * without locking.
+ */
+class progress_tracker
+{
+public:
+    using callback = std::function<void(const transfer_progress & progress)>;
+
+    progress_tracker();
+
+    progress_tracker(const progress_tracker &) = delete;
+
+    progress_tracker & operator=(const progress_tracker &) = delete;
+
+    /* A zero interval disables sampling, the rate is the average one then.
+     * The callback is called by the transfer thread after each sample.
+     */
+    void configure(std::chrono::milliseconds interval, const callback & callback);
+
+    void start();
+
+    void set_total(std::optional<std::uint64_t> total);
+
+    void add(std::size_t size)
+    {
+        bytes_.fetch_add(size, std::memory_order_relaxed);
+
+        if (interval_.load(std::memory_order_relaxed) > 0 && now() >= next_sample_)
+        {
+            sample();
+        }
+    }
+
+    /* Takes the last sample, the transfer is complete. The elapsed time
+     * stops at this point.
+     */
+    void finish();
+
+    transfer_progress get() const;
+
+    std::chrono::nanoseconds elapsed() const;
+
+private:
+    void sample();
+
+    static std::int64_t now();
+
+    /* The end of the transfer, or now while it runs. */
+    std::int64_t end() const;
+
+    std::atomic<std::uint64_t> bytes_;
+    std::atomic<std::uint64_t> total_;
+    std::atomic<std::int64_t> started_;
+    std::atomic<std::int64_t> finished_;
+    std::atomic<double> rate_;
+    std::atomic<std::int64_t> interval_;
+
+    /* Used by the transfer thread only. */
+    std::int64_t next_sample_;
+    std::int64_t last_sample_;
+    std::uint64_t last_sample_bytes_;
+    callback callback_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_PROGRESS_TRACKER_HPP
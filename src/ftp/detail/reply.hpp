@@ -48,6 +48,14 @@ struct reply_t
         return status_code < 400;
     }
 
+    /* The command was not accepted, but the error condition is temporary
+     * and the action may be requested again.
+     */
+    bool is_transient_negative() const
+    {
+        return status_code >= 400 && status_code < 500;
+    }
+
     std::uint16_t status_code;
     std::string status_line;
 };
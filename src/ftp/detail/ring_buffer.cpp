@@ -0,0 +1,131 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "ring_buffer.hpp"
+#include <algorithm>
+
+namespace ftp::detail
+{
+
+using std::size_t;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+
+ring_buffer::ring_buffer(buffer_pool::buffer && storage)
+    : storage_(std::move(storage)),
+      read_(0),
+      written_(0),
+      closed_(false),
+      cancelled_(false)
+{
+}
+
+size_t ring_buffer::prepare(char * & data)
+{
+    unique_lock<mutex> lock(mutex_);
+    size_t capacity = storage_.size();
+
+    changed_.wait(lock, [&]() { return cancelled_ || written_ - read_ < capacity; });
+
+    if (cancelled_)
+    {
+        return 0;
+    }
+
+    size_t begin = written_ % capacity;
+    size_t size = std::min<size_t>(capacity - (written_ - read_), capacity - begin);
+
+    data = storage_.data() + begin;
+
+    return size;
+}
+
+void ring_buffer::commit(size_t size)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        written_ += size;
+    }
+
+    changed_.notify_all();
+}
+
+size_t ring_buffer::peek(const char * & data)
+{
+    unique_lock<mutex> lock(mutex_);
+    size_t capacity = storage_.size();
+
+    changed_.wait(lock, [&]() { return cancelled_ || closed_ || written_ > read_; });
+
+    if (cancelled_)
+    {
+        return 0;
+    }
+
+    size_t begin = read_ % capacity;
+    size_t size = std::min<size_t>(written_ - read_, capacity - begin);
+
+    data = storage_.data() + begin;
+
+    return size;
+}
+
+void ring_buffer::consume(size_t size)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        read_ += size;
+    }
+
+    changed_.notify_all();
+}
+
+void ring_buffer::close()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        closed_ = true;
+    }
+
+    changed_.notify_all();
+}
+
+void ring_buffer::cancel()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        cancelled_ = true;
+    }
+
+    changed_.notify_all();
+}
+
+bool ring_buffer::is_cancelled() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return cancelled_;
+}
+
+} // namespace ftp::detail
@@ -0,0 +1,83 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_RING_BUFFER_HPP
+#define FTP_RING_BUFFER_HPP
+
+#include "../buffer_pool.hpp"
+#include <condition_variable>
+#include <mutex>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp::detail
+{
+
+/* Bounded buffer between a thread producing data and a thread consuming it.
+ * Both sides work on contiguous regions of the buffer in place, e.g. read
+ * from one socket into it and write to another one from it.
+ */
+class ring_buffer
+{
+public:
+    explicit ring_buffer(buffer_pool::buffer && storage);
+
+    ring_buffer(const ring_buffer &) = delete;
+
+    ring_buffer & operator=(const ring_buffer &) = delete;
+
+    /* Waits for free space and returns its size, zero if the buffer has
+     * been cancelled.
+     */
+    std::size_t prepare(char * & data);
+
+    void commit(std::size_t size);
+
+    /* Waits for data and returns its size, zero at the end of data or if
+     * the buffer has been cancelled.
+     */
+    std::size_t peek(const char * & data);
+
+    void consume(std::size_t size);
+
+    /* Marks the end of data. */
+    void close();
+
+    /* Wakes up both sides. */
+    void cancel();
+
+    bool is_cancelled() const;
+
+private:
+    buffer_pool::buffer storage_;
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::uint64_t read_;
+    std::uint64_t written_;
+    bool closed_;
+    bool cancelled_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_RING_BUFFER_HPP
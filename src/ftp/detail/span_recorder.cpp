@@ -0,0 +1,66 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "span_recorder.hpp"
+
+namespace ftp::detail
+{
+
+using std::string;
+using std::chrono::steady_clock;
+
+span_recorder::span_recorder(const string & operation, const string & target)
+    : started_(steady_clock::now()),
+      last_mark_(started_)
+{
+    span_.operation = operation;
+    span_.target = target;
+    span_.start = std::chrono::system_clock::now();
+    span_.duration = std::chrono::nanoseconds::zero();
+    span_.succeeded = false;
+}
+
+void span_recorder::mark(const string & phase)
+{
+    steady_clock::time_point now = steady_clock::now();
+
+    span_.phases.push_back(trace_phase{phase, last_mark_ - started_, now - last_mark_});
+    last_mark_ = now;
+}
+
+void span_recorder::set_tcp(const tcp_sample & sample)
+{
+    span_.tcp = sample;
+}
+
+const trace_span & span_recorder::finish(bool succeeded, const string & error)
+{
+    span_.duration = steady_clock::now() - started_;
+    span_.succeeded = succeeded;
+    span_.error = error;
+
+    return span_;
+}
+
+} // namespace ftp::detail
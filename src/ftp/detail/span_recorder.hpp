@@ -0,0 +1,61 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_SPAN_RECORDER_HPP
+#define FTP_SPAN_RECORDER_HPP
+
+#include "../tracing.hpp"
+#include <chrono>
+#include <string>
+
+namespace ftp::detail
+{
+
+/* Builds the span of an operation in progress. Each mark ends the current
+ * phase and starts the next one.
+ */
+class span_recorder
+{
+public:
+    span_recorder(const std::string & operation, const std::string & target);
+
+    span_recorder(const span_recorder &) = delete;
+
+    span_recorder & operator=(const span_recorder &) = delete;
+
+    void mark(const std::string & phase);
+
+    /* The TCP_INFO of the last data connection of the operation. */
+    void set_tcp(const tcp_sample & sample);
+
+    const trace_span & finish(bool succeeded, const std::string & error = std::string());
+
+private:
+    trace_span span_;
+    std::chrono::steady_clock::time_point started_;
+    std::chrono::steady_clock::time_point last_mark_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_SPAN_RECORDER_HPP
@@ -0,0 +1,191 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "sparse_file_writer.hpp"
+#include "connection_exception.hpp"
+#include <filesystem>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#endif
+
+namespace ftp::detail
+{
+
+using std::string;
+using std::ios_base;
+using std::uint64_t;
+
+static ios_base::openmode get_open_mode(uint64_t offset)
+{
+    if (offset > 0)
+    {
+        /* Don't truncate the file. */
+        return ios_base::binary | ios_base::in | ios_base::out;
+    }
+    else
+    {
+        return ios_base::binary | ios_base::out;
+    }
+}
+
+sparse_file_writer::sparse_file_writer(const string & path, uint64_t offset)
+    : path_(path),
+      file_(path, get_open_mode(offset)),
+      size_(offset),
+      seek_pending_(offset > 0)
+{
+}
+
+bool sparse_file_writer::is_open() const
+{
+    return file_.is_open();
+}
+
+/* Every full block that starts at a block boundary and contains only zeros
+ * is skipped: the file position is moved past it, and the next write creates
+ * a hole. Partial blocks are always written as is.
+ */
+void sparse_file_writer::write(const char *data, size_t size)
+{
+    while (size > 0)
+    {
+        size_t offset_in_block = size_ % block_size;
+        size_t len = std::min(size, block_size - offset_in_block);
+
+        if (offset_in_block == 0 && len == block_size && is_zero_block(data, len))
+        {
+            seek_pending_ = true;
+        }
+        else
+        {
+            if (seek_pending_)
+            {
+                file_.seekp(size_);
+                seek_pending_ = false;
+            }
+
+            file_.write(data, len);
+
+            if (file_.fail())
+            {
+                throw connection_exception("Cannot write data to file");
+            }
+        }
+
+        size_ += len;
+        data += len;
+        size -= len;
+    }
+}
+
+/* If the file ends with a hole, nothing has been written there yet.
+ * Truncate the file to its final size to get the trailing zeros.
+ */
+void sparse_file_writer::close()
+{
+    file_.close();
+
+    if (file_.fail())
+    {
+        throw connection_exception("Cannot write data to file");
+    }
+
+    std::error_code ec;
+
+    std::filesystem::resize_file(path_, size_, ec);
+
+    if (ec)
+    {
+        throw connection_exception("Cannot truncate file '%1%': %2%", path_, ec.message());
+    }
+}
+
+uint64_t sparse_file_writer::size() const
+{
+    return size_;
+}
+
+bool sparse_file_writer::is_zero_block(const char *data, size_t size)
+{
+#if defined(__SSE2__) || defined(_M_X64)
+    const __m128i zero = _mm_setzero_si128();
+
+    /* OR 64 bytes together and test them at once, so that a block with data
+     * is rejected early without a branch per 16 bytes.
+     */
+    for (; size >= 64; data += 64, size -= 64)
+    {
+        const auto *p = reinterpret_cast<const __m128i *>(data);
+
+        __m128i acc = _mm_or_si128(_mm_or_si128(_mm_loadu_si128(p), _mm_loadu_si128(p + 1)),
+                                   _mm_or_si128(_mm_loadu_si128(p + 2), _mm_loadu_si128(p + 3)));
+
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xFFFF)
+        {
+            return false;
+        }
+    }
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+    for (; size >= 64; data += 64, size -= 64)
+    {
+        const auto *p = reinterpret_cast<const uint8_t *>(data);
+
+        uint8x16_t acc = vorrq_u8(vorrq_u8(vld1q_u8(p), vld1q_u8(p + 16)),
+                                  vorrq_u8(vld1q_u8(p + 32), vld1q_u8(p + 48)));
+
+        if (vmaxvq_u8(acc) != 0)
+        {
+            return false;
+        }
+    }
+#endif
+
+    for (; size >= sizeof(uint64_t); data += sizeof(uint64_t), size -= sizeof(uint64_t))
+    {
+        uint64_t word;
+        std::memcpy(&word, data, sizeof(word));
+
+        if (word != 0)
+        {
+            return false;
+        }
+    }
+
+    for (; size > 0; ++data, --size)
+    {
+        if (*data != 0)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+} // namespace ftp::detail
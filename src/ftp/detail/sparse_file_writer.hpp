@@ -0,0 +1,71 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_SPARSE_FILE_WRITER_HPP
+#define FTP_SPARSE_FILE_WRITER_HPP
+
+#include <fstream>
+#include <string>
+#include <cstdint>
+
+namespace ftp::detail
+{
+
+/* Writes a file skipping all-zero blocks, so that the file system can
+ * allocate holes for them instead of writing zeros to disk.
+ */
+class sparse_file_writer
+{
+public:
+    /* If 'offset' is not zero, the existing file is continued from it
+     * instead of being truncated.
+     */
+    explicit sparse_file_writer(const std::string & path, std::uint64_t offset = 0);
+
+    sparse_file_writer(const sparse_file_writer &) = delete;
+
+    sparse_file_writer & operator=(const sparse_file_writer &) = delete;
+
+    bool is_open() const;
+
+    void write(const char *data, std::size_t size);
+
+    void close();
+
+    std::uint64_t size() const;
+
+    static constexpr std::size_t block_size = 4096;
+
+private:
+    static bool is_zero_block(const char *data, std::size_t size);
+
+    std::string path_;
+    std::ofstream file_;
+    std::uint64_t size_;
+    bool seek_pending_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_SPARSE_FILE_WRITER_HPP
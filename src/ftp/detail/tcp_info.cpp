@@ -0,0 +1,75 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tcp_info.hpp"
+
+#ifdef __linux__
+#include <linux/tcp.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+
+namespace ftp::detail
+{
+
+using std::chrono::microseconds;
+
+#ifdef __linux__
+
+bool sample_tcp_info(int socket, tcp_sample & sample)
+{
+    struct tcp_info info = {};
+    socklen_t length = sizeof(info);
+
+    /* Older kernels fill a shorter structure, the rest stays zero. */
+    if (getsockopt(socket, IPPROTO_TCP, TCP_INFO, &info, &length) != 0)
+    {
+        return false;
+    }
+
+    sample.rtt = microseconds(info.tcpi_rtt);
+    sample.rtt_variance = microseconds(info.tcpi_rttvar);
+    sample.receive_rtt = microseconds(info.tcpi_rcv_rtt);
+    sample.congestion_window = info.tcpi_snd_cwnd;
+    sample.mss = info.tcpi_snd_mss;
+    sample.retransmits = info.tcpi_total_retrans;
+    sample.delivery_rate = info.tcpi_delivery_rate;
+    sample.application_limited = info.tcpi_delivery_rate_app_limited;
+    sample.busy_time = microseconds(info.tcpi_busy_time);
+    sample.rwnd_limited = microseconds(info.tcpi_rwnd_limited);
+    sample.sndbuf_limited = microseconds(info.tcpi_sndbuf_limited);
+
+    return true;
+}
+
+#else
+
+bool sample_tcp_info(int /* socket */, tcp_sample & /* sample */)
+{
+    return false;
+}
+
+#endif
+
+} // namespace ftp::detail
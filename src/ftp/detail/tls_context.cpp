@@ -0,0 +1,141 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "tls_context.hpp"
+#include "tls_session_cache.hpp"
+#include "connection_exception.hpp"
+
+namespace ftp::detail
+{
+
+using std::string;
+using std::uint16_t;
+using std::to_string;
+
+tls_context::tls_context(const tls_options & options)
+    : context_(SSL_CTX_new(TLS_client_method())),
+      verify_peer_(options.verify_peer),
+      session_resumption_(options.session_resumption),
+      trusted_certificates_(options.verify_peer ? options.ca_file : "*")
+{
+    if (!context_)
+    {
+        throw connection_exception("Cannot create TLS context");
+    }
+
+    SSL_CTX_set_min_proto_version(context_, TLS1_2_VERSION);
+
+#ifdef SSL_OP_IGNORE_UNEXPECTED_EOF
+    /* Many servers close data connections without sending close_notify. */
+    SSL_CTX_set_options(context_, SSL_OP_IGNORE_UNEXPECTED_EOF);
+#endif
+
+#ifdef SSL_OP_ENABLE_KTLS
+    if (options.kernel_tls)
+    {
+        SSL_CTX_set_options(context_, SSL_OP_ENABLE_KTLS);
+    }
+#endif
+
+    if (session_resumption_)
+    {
+        /* Sessions are kept in tls_session_cache rather than in this context,
+         * so that they are shared by all clients.
+         */
+        SSL_CTX_set_session_cache_mode(context_, SSL_SESS_CACHE_CLIENT | SSL_SESS_CACHE_NO_INTERNAL_STORE);
+        SSL_CTX_sess_set_new_cb(context_, store_session);
+    }
+    else
+    {
+        SSL_CTX_set_options(context_, SSL_OP_NO_TICKET);
+    }
+
+    if (verify_peer_)
+    {
+        int result;
+
+        if (options.ca_file.empty())
+        {
+            result = SSL_CTX_set_default_verify_paths(context_);
+        }
+        else
+        {
+            result = SSL_CTX_load_verify_locations(context_, options.ca_file.c_str(), nullptr);
+        }
+
+        if (result != 1)
+        {
+            SSL_CTX_free(context_);
+            throw connection_exception("Cannot load trusted certificates");
+        }
+
+        SSL_CTX_set_verify(context_, SSL_VERIFY_PEER, nullptr);
+    }
+}
+
+tls_context::~tls_context()
+{
+    SSL_CTX_free(context_);
+}
+
+SSL_CTX * tls_context::native_handle() const
+{
+    return context_;
+}
+
+bool tls_context::verify_peer() const
+{
+    return verify_peer_;
+}
+
+bool tls_context::session_resumption() const
+{
+    return session_resumption_;
+}
+
+string tls_context::session_key(const string & hostname, uint16_t port) const
+{
+    return hostname + ":" + to_string(port) + " " + trusted_certificates_;
+}
+
+/* Called by OpenSSL when a session is established, and in TLS 1.3 for each
+ * session ticket. tls_stream keeps the cache key in the application data.
+ */
+int tls_context::store_session(SSL *ssl, SSL_SESSION *session)
+{
+    const string *key = static_cast<const string *>(SSL_get_app_data(ssl));
+
+    if (!key || key->empty())
+    {
+        return 0;
+    }
+
+    tls_session_cache::instance().put(*key, session);
+
+    /* Keep the reference. */
+    return 1;
+}
+
+} // namespace ftp::detail
@@ -0,0 +1,70 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_TLS_CONTEXT_HPP
+#define FTP_TLS_CONTEXT_HPP
+
+#include "../tls_options.hpp"
+#include <openssl/ssl.h>
+#include <string>
+#include <cstdint>
+
+namespace ftp::detail
+{
+
+class tls_context
+{
+public:
+    explicit tls_context(const tls_options & options);
+
+    tls_context(const tls_context &) = delete;
+
+    tls_context & operator=(const tls_context &) = delete;
+
+    ~tls_context();
+
+    SSL_CTX * native_handle() const;
+
+    bool verify_peer() const;
+
+    bool session_resumption() const;
+
+    /* Key of sessions with the server in tls_session_cache. A resumed
+     * session skips certificate verification, so sessions are only shared
+     * between contexts that trust the same certificates.
+     */
+    std::string session_key(const std::string & hostname, std::uint16_t port) const;
+
+private:
+    static int store_session(SSL *ssl, SSL_SESSION *session);
+
+    SSL_CTX *context_;
+    bool verify_peer_;
+    bool session_resumption_;
+    std::string trusted_certificates_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_TLS_CONTEXT_HPP
@@ -0,0 +1,144 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "tls_session_cache.hpp"
+#include <ctime>
+
+namespace ftp::detail
+{
+
+using std::string;
+using std::uint64_t;
+using std::lock_guard;
+using std::mutex;
+
+static bool is_expired(const SSL_SESSION *session)
+{
+    return SSL_SESSION_get_time(session) + SSL_SESSION_get_timeout(session) <= std::time(nullptr);
+}
+
+tls_session_cache & tls_session_cache::instance()
+{
+    static tls_session_cache cache;
+    return cache;
+}
+
+tls_session_cache::tls_session_cache()
+    : hits_(0),
+      misses_(0)
+{
+}
+
+tls_session_cache::~tls_session_cache()
+{
+    clear();
+}
+
+SSL_SESSION * tls_session_cache::get(const string & key)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    auto it = sessions_.find(key);
+
+    if (it == sessions_.end())
+    {
+        return nullptr;
+    }
+
+    SSL_SESSION *session = it->second;
+
+    if (!SSL_SESSION_is_resumable(session) || is_expired(session))
+    {
+        SSL_SESSION_free(session);
+        sessions_.erase(it);
+        return nullptr;
+    }
+
+    SSL_SESSION_up_ref(session);
+
+    return session;
+}
+
+void tls_session_cache::put(const string & key, SSL_SESSION *session)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    auto [it, inserted] = sessions_.try_emplace(key, session);
+
+    if (!inserted)
+    {
+        SSL_SESSION_free(it->second);
+        it->second = session;
+    }
+}
+
+void tls_session_cache::remove(const string & key)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    auto it = sessions_.find(key);
+
+    if (it != sessions_.end())
+    {
+        SSL_SESSION_free(it->second);
+        sessions_.erase(it);
+    }
+}
+
+void tls_session_cache::clear()
+{
+    lock_guard<mutex> lock(mutex_);
+
+    for (auto & [key, session] : sessions_)
+    {
+        SSL_SESSION_free(session);
+    }
+
+    sessions_.clear();
+}
+
+void tls_session_cache::record_handshake(bool resumed)
+{
+    if (resumed)
+    {
+        hits_.fetch_add(1, std::memory_order_relaxed);
+    }
+    else
+    {
+        misses_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint64_t tls_session_cache::hits() const
+{
+    return hits_.load(std::memory_order_relaxed);
+}
+
+uint64_t tls_session_cache::misses() const
+{
+    return misses_.load(std::memory_order_relaxed);
+}
+
+} // namespace ftp::detail
@@ -0,0 +1,84 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_TLS_SESSION_CACHE_HPP
+#define FTP_TLS_SESSION_CACHE_HPP
+
+#include <openssl/ssl.h>
+#include <atomic>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+
+namespace ftp::detail
+{
+
+/* Process-wide cache of client TLS sessions, the latest one per server.
+ * OpenSSL stores a session as soon as it is established or a session ticket
+ * arrives, and the next handshake with the same server, whether on a data
+ * connection or by another client, offers it for resumption.
+ */
+class tls_session_cache
+{
+public:
+    static tls_session_cache & instance();
+
+    tls_session_cache(const tls_session_cache &) = delete;
+
+    tls_session_cache & operator=(const tls_session_cache &) = delete;
+
+    /* Returns a new reference to the session, or nullptr if there is no
+     * resumable one.
+     */
+    SSL_SESSION * get(const std::string & key);
+
+    /* Takes over the reference to the session. */
+    void put(const std::string & key, SSL_SESSION *session);
+
+    void remove(const std::string & key);
+
+    void clear();
+
+    /* Handshakes that resumed a session and full ones. */
+    void record_handshake(bool resumed);
+
+    std::uint64_t hits() const;
+
+    std::uint64_t misses() const;
+
+private:
+    tls_session_cache();
+
+    ~tls_session_cache();
+
+    std::mutex mutex_;
+    std::unordered_map<std::string, SSL_SESSION *> sessions_;
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> misses_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_TLS_SESSION_CACHE_HPP
@@ -0,0 +1,532 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "tls_stream.hpp"
+#include "tls_session_cache.hpp"
+#include <boost/asio/ssl/error.hpp>
+#include <openssl/err.h>
+#include <openssl/x509v3.h>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <poll.h>
+
+#ifdef __linux__
+#include <sys/sendfile.h>
+#endif
+
+namespace ftp::detail
+{
+
+using std::string;
+using std::size_t;
+using std::uint64_t;
+using boost::asio::ip::tcp;
+using boost::system::error_code;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+/* How often waiting operations check for cancellation. */
+static const milliseconds cancellation_check_interval(100);
+
+const short tls_stream::readable = POLLIN;
+const short tls_stream::writable = POLLOUT;
+
+/* OpenSSL writes to the socket without MSG_NOSIGNAL, as well as sendfile(),
+ * so writing to a connection closed by the server raises SIGPIPE. Block it
+ * in the current thread for the duration of a write, and discard it if it
+ * has been raised, instead of changing the process-wide disposition.
+ */
+class sigpipe_guard
+{
+public:
+    sigpipe_guard()
+    {
+        sigemptyset(&sigpipe_);
+        sigaddset(&sigpipe_, SIGPIPE);
+
+        sigset_t pending;
+        sigpending(&pending);
+        was_pending_ = sigismember(&pending, SIGPIPE) == 1;
+
+        pthread_sigmask(SIG_BLOCK, &sigpipe_, &old_mask_);
+    }
+
+    sigpipe_guard(const sigpipe_guard &) = delete;
+
+    sigpipe_guard & operator=(const sigpipe_guard &) = delete;
+
+    ~sigpipe_guard()
+    {
+        int saved_errno = errno;
+
+        sigset_t pending;
+        sigpending(&pending);
+
+        if (!was_pending_ && sigismember(&pending, SIGPIPE) == 1)
+        {
+#ifdef __linux__
+            struct timespec zero = {0, 0};
+            sigtimedwait(&sigpipe_, nullptr, &zero);
+#else
+            int signal;
+            sigwait(&sigpipe_, &signal);
+#endif
+        }
+
+        pthread_sigmask(SIG_SETMASK, &old_mask_, nullptr);
+
+        errno = saved_errno;
+    }
+
+private:
+    sigset_t sigpipe_;
+    sigset_t old_mask_;
+    bool was_pending_;
+};
+
+tls_stream::tls_stream(tcp::socket & socket)
+    : socket_(socket),
+      ssl_(nullptr),
+      idle_timeout_(milliseconds::zero()),
+      deadline_(steady_clock::time_point::max()),
+      cancelled_(nullptr)
+{
+}
+
+tls_stream::~tls_stream()
+{
+    if (ssl_)
+    {
+        SSL_free(ssl_);
+    }
+}
+
+void tls_stream::handshake(const tls_context & context,
+                           const string & hostname,
+                           const string & session_key,
+                           error_code & ec)
+{
+    if (!ready(ec))
+    {
+        return;
+    }
+
+    ERR_clear_error();
+
+    ssl_ = SSL_new(context.native_handle());
+
+    if (!ssl_)
+    {
+        ec.assign(ERR_get_error(), boost::asio::error::get_ssl_category());
+        return;
+    }
+
+    SSL_set_fd(ssl_, socket_.native_handle());
+
+    error_code address_ec;
+    boost::asio::ip::make_address(hostname, address_ec);
+    bool is_ip_address = !address_ec;
+
+    /* Literal IP addresses are not permitted in SNI. */
+    if (!is_ip_address)
+    {
+        SSL_set_tlsext_host_name(ssl_, hostname.c_str());
+    }
+
+    if (context.verify_peer())
+    {
+        X509_VERIFY_PARAM *param = SSL_get0_param(ssl_);
+
+        if (is_ip_address)
+        {
+            X509_VERIFY_PARAM_set1_ip_asc(param, hostname.c_str());
+        }
+        else
+        {
+            X509_VERIFY_PARAM_set1_host(param, hostname.c_str(), 0);
+        }
+    }
+
+    tls_session_cache & cache = tls_session_cache::instance();
+
+    if (context.session_resumption())
+    {
+        session_key_ = session_key;
+        SSL_set_app_data(ssl_, &session_key_);
+
+        SSL_SESSION *session = cache.get(session_key_);
+
+        if (session)
+        {
+            SSL_set_session(ssl_, session);
+            SSL_SESSION_free(session);
+        }
+    }
+
+    sigpipe_guard guard;
+
+    for (;;)
+    {
+        ERR_clear_error();
+        errno = 0;
+
+        int result = SSL_connect(ssl_);
+
+        if (result == 1)
+        {
+            cache.record_handshake(is_resumed());
+            ec.clear();
+            return;
+        }
+
+        if (!wait(result, ec))
+        {
+            /* Don't offer the session again if it caused the failure. */
+            if (SSL_session_reused(ssl_))
+            {
+                cache.remove(session_key_);
+            }
+
+            SSL_free(ssl_);
+            ssl_ = nullptr;
+            return;
+        }
+    }
+}
+
+bool tls_stream::is_secure() const
+{
+    return ssl_ != nullptr;
+}
+
+bool tls_stream::is_resumed() const
+{
+    return ssl_ && SSL_session_reused(ssl_) == 1;
+}
+
+void tls_stream::set_timeouts(milliseconds idle_timeout, steady_clock::time_point deadline)
+{
+    idle_timeout_ = idle_timeout;
+    deadline_ = deadline;
+}
+
+void tls_stream::set_cancellation(const std::atomic<bool> *cancelled)
+{
+    cancelled_ = cancelled;
+}
+
+bool tls_stream::is_kernel_tls() const
+{
+#ifdef BIO_get_ktls_send
+    return ssl_ && BIO_get_ktls_send(SSL_get_wbio(ssl_));
+#else
+    return false;
+#endif
+}
+
+size_t tls_stream::send_file(int fd, uint64_t offset, size_t size, error_code & ec)
+{
+#ifdef __linux__
+    if (!ready(ec))
+    {
+        return 0;
+    }
+
+    sigpipe_guard guard;
+
+    for (;;)
+    {
+        errno = 0;
+
+        if (ssl_)
+        {
+#ifdef BIO_get_ktls_send
+            ERR_clear_error();
+
+            ossl_ssize_t len = SSL_sendfile(ssl_, fd, offset, size, 0);
+
+            if (len >= 0)
+            {
+                ec.clear();
+                return len;
+            }
+
+            if (!wait(static_cast<int>(len), ec))
+            {
+                return 0;
+            }
+
+            continue;
+#else
+            break;
+#endif
+        }
+
+        off_t file_offset = offset;
+        ssize_t len = ::sendfile(socket_.native_handle(), fd, &file_offset, size);
+
+        if (len >= 0)
+        {
+            ec.clear();
+            return len;
+        }
+
+        if (errno == EAGAIN)
+        {
+            if (!wait_socket(writable, ec))
+            {
+                return 0;
+            }
+        }
+        else if (errno != EINTR)
+        {
+            ec.assign(errno, boost::system::system_category());
+            return 0;
+        }
+    }
+#endif
+
+    ec = boost::asio::error::operation_not_supported;
+    return 0;
+}
+
+bool tls_stream::can_send_file() const
+{
+#ifdef __linux__
+    return !ssl_ || is_kernel_tls();
+#else
+    return false;
+#endif
+}
+
+void tls_stream::shutdown(error_code & ec)
+{
+    ec.clear();
+
+    if (!ssl_)
+    {
+        return;
+    }
+
+    sigpipe_guard guard;
+
+    ERR_clear_error();
+    errno = 0;
+
+    /* Don't wait for close_notify from the server. */
+    int result = SSL_shutdown(ssl_);
+
+    if (result < 0)
+    {
+        int error = SSL_get_error(ssl_, result);
+
+        if (error == SSL_ERROR_SYSCALL && errno != 0)
+        {
+            ec.assign(errno, boost::system::system_category());
+        }
+        else
+        {
+            ec.assign(ERR_get_error(), boost::asio::error::get_ssl_category());
+        }
+    }
+
+    SSL_free(ssl_);
+    ssl_ = nullptr;
+}
+
+/* The public read_some() and write_some() have already called ready(). */
+size_t tls_stream::read(const boost::asio::mutable_buffer & buffer, error_code & ec)
+{
+    for (;;)
+    {
+        ERR_clear_error();
+        errno = 0;
+
+        size_t len = 0;
+        int result = SSL_read_ex(ssl_, buffer.data(), buffer.size(), &len);
+
+        if (result == 1)
+        {
+            ec.clear();
+            return len;
+        }
+
+        if (!wait(result, ec))
+        {
+            return 0;
+        }
+    }
+}
+
+size_t tls_stream::write(const boost::asio::const_buffer & buffer, error_code & ec)
+{
+    sigpipe_guard guard;
+
+    for (;;)
+    {
+        ERR_clear_error();
+        errno = 0;
+
+        size_t len = 0;
+        int result = SSL_write_ex(ssl_, buffer.data(), buffer.size(), &len);
+
+        if (result == 1)
+        {
+            ec.clear();
+            return len;
+        }
+
+        if (!wait(result, ec))
+        {
+            return 0;
+        }
+    }
+}
+
+/* Returns true if the operation should be repeated. */
+bool tls_stream::wait(int result, error_code & ec)
+{
+    int error = SSL_get_error(ssl_, result);
+
+    if (error == SSL_ERROR_WANT_READ)
+    {
+        return wait_socket(readable, ec);
+    }
+    else if (error == SSL_ERROR_WANT_WRITE)
+    {
+        return wait_socket(writable, ec);
+    }
+    else if (error == SSL_ERROR_ZERO_RETURN)
+    {
+        ec = boost::asio::error::eof;
+    }
+    else if (error == SSL_ERROR_SYSCALL && ERR_peek_error() == 0)
+    {
+        if (errno != 0)
+        {
+            ec.assign(errno, boost::system::system_category());
+        }
+        else
+        {
+            ec = boost::asio::error::eof;
+        }
+    }
+    else
+    {
+        ec.assign(ERR_get_error(), boost::asio::error::get_ssl_category());
+    }
+
+    return false;
+}
+
+bool tls_stream::ready(error_code & ec)
+{
+    if (cancelled_ && cancelled_->load(std::memory_order_relaxed))
+    {
+        ec = boost::asio::error::operation_aborted;
+        return false;
+    }
+
+    if (deadline_ != steady_clock::time_point::max() && steady_clock::now() >= deadline_)
+    {
+        ec = boost::asio::error::timed_out;
+        return false;
+    }
+
+    if (!socket_.non_blocking())
+    {
+        socket_.non_blocking(true, ec);
+
+        if (ec)
+        {
+            return false;
+        }
+    }
+
+    ec.clear();
+    return true;
+}
+
+/* Returns true when the socket is ready, false on timeout, cancellation or
+ * error.
+ */
+bool tls_stream::wait_socket(short events, error_code & ec)
+{
+    steady_clock::time_point limit = deadline_;
+
+    if (idle_timeout_ > milliseconds::zero())
+    {
+        limit = std::min(limit, steady_clock::now() + idle_timeout_);
+    }
+
+    for (;;)
+    {
+        if (cancelled_ && cancelled_->load(std::memory_order_relaxed))
+        {
+            ec = boost::asio::error::operation_aborted;
+            return false;
+        }
+
+        int timeout = -1;
+
+        if (limit != steady_clock::time_point::max())
+        {
+            steady_clock::time_point now = steady_clock::now();
+
+            if (now >= limit)
+            {
+                ec = boost::asio::error::timed_out;
+                return false;
+            }
+
+            /* Round up, so that the timeout doesn't spin at zero. */
+            milliseconds left = std::chrono::ceil<milliseconds>(limit - now);
+            timeout = static_cast<int>(std::min<milliseconds::rep>(left.count(), INT32_MAX));
+        }
+
+        if (cancelled_)
+        {
+            int interval = static_cast<int>(cancellation_check_interval.count());
+            timeout = timeout < 0 ? interval : std::min(timeout, interval);
+        }
+
+        struct pollfd fd = {socket_.native_handle(), events, 0};
+        int result = ::poll(&fd, 1, timeout);
+
+        if (result > 0)
+        {
+            ec.clear();
+            return true;
+        }
+        else if (result < 0 && errno != EINTR)
+        {
+            ec.assign(errno, boost::system::system_category());
+            return false;
+        }
+    }
+}
+
+} // namespace ftp::detail
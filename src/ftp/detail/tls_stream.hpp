@@ -0,0 +1,197 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_TLS_STREAM_HPP
+#define FTP_TLS_STREAM_HPP
+
+#include "tls_context.hpp"
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/buffer.hpp>
+#include <openssl/ssl.h>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <cstdint>
+
+namespace ftp::detail
+{
+
+/* Synchronous stream over a connected TCP socket. It passes data through as
+ * is until TLS is started, and encrypts it afterwards. Meets the requirements
+ * of Boost.Asio SyncReadStream and SyncWriteStream, so it can be used with
+ * read(), read_until() and write().
+ *
+ * OpenSSL works with the socket directly rather than through memory BIOs,
+ * so that it can hand encryption over to the kernel (kTLS).
+ *
+ * The socket is switched to non-blocking mode, and the stream waits for it
+ * with poll(), so that operations can time out or be cancelled.
+ */
+class tls_stream
+{
+public:
+    explicit tls_stream(boost::asio::ip::tcp::socket & socket);
+
+    tls_stream(const tls_stream &) = delete;
+
+    tls_stream & operator=(const tls_stream &) = delete;
+
+    ~tls_stream();
+
+    /* Offers the cached session for 'session_key' to the server, and stores
+     * new sessions under it.
+     */
+    void handshake(const tls_context & context,
+                   const std::string & hostname,
+                   const std::string & session_key,
+                   boost::system::error_code & ec);
+
+    bool is_secure() const;
+
+    /* The last handshake resumed a session. */
+    bool is_resumed() const;
+
+    /* Operations fail with 'timed_out' after waiting for the socket longer
+     * than 'idle_timeout', or once 'deadline' has passed. A zero timeout
+     * means no limit.
+     */
+    void set_timeouts(std::chrono::milliseconds idle_timeout, std::chrono::steady_clock::time_point deadline);
+
+    /* Operations fail with 'operation_aborted' once the flag is set. */
+    void set_cancellation(const std::atomic<bool> *cancelled);
+
+    /* Encryption of sent data is done by the kernel. */
+    bool is_kernel_tls() const;
+
+    template<typename MutableBufferSequence>
+    std::size_t read_some(const MutableBufferSequence & buffers, boost::system::error_code & ec)
+    {
+        if (!ready(ec))
+        {
+            return 0;
+        }
+
+        if (!ssl_)
+        {
+            for (;;)
+            {
+                std::size_t len = socket_.read_some(buffers, ec);
+
+                if (ec != boost::asio::error::would_block || !wait_socket(readable, ec))
+                {
+                    return len;
+                }
+            }
+        }
+
+        for (auto it = boost::asio::buffer_sequence_begin(buffers);
+             it != boost::asio::buffer_sequence_end(buffers); ++it)
+        {
+            boost::asio::mutable_buffer buffer(*it);
+
+            if (buffer.size() > 0)
+            {
+                return read(buffer, ec);
+            }
+        }
+
+        ec.clear();
+        return 0;
+    }
+
+    template<typename ConstBufferSequence>
+    std::size_t write_some(const ConstBufferSequence & buffers, boost::system::error_code & ec)
+    {
+        if (!ready(ec))
+        {
+            return 0;
+        }
+
+        if (!ssl_)
+        {
+            for (;;)
+            {
+                std::size_t len = socket_.write_some(buffers, ec);
+
+                if (ec != boost::asio::error::would_block || !wait_socket(writable, ec))
+                {
+                    return len;
+                }
+            }
+        }
+
+        for (auto it = boost::asio::buffer_sequence_begin(buffers);
+             it != boost::asio::buffer_sequence_end(buffers); ++it)
+        {
+            boost::asio::const_buffer buffer(*it);
+
+            if (buffer.size() > 0)
+            {
+                return write(buffer, ec);
+            }
+        }
+
+        ec.clear();
+        return 0;
+    }
+
+    /* Sends up to 'size' bytes of the file without copying them to user
+     * space. Available on Linux for plain connections and for kernel TLS.
+     */
+    std::size_t send_file(int fd, std::uint64_t offset, std::size_t size, boost::system::error_code & ec);
+
+    bool can_send_file() const;
+
+    /* Sends close_notify and stops encryption. */
+    void shutdown(boost::system::error_code & ec);
+
+private:
+    std::size_t read(const boost::asio::mutable_buffer & buffer, boost::system::error_code & ec);
+
+    std::size_t write(const boost::asio::const_buffer & buffer, boost::system::error_code & ec);
+
+    bool wait(int result, boost::system::error_code & ec);
+
+    /* Checks cancellation and the deadline, and makes the socket
+     * non-blocking.
+     */
+    bool ready(boost::system::error_code & ec);
+
+    bool wait_socket(short events, boost::system::error_code & ec);
+
+    static const short readable;
+
+    static const short writable;
+
+    boost::asio::ip::tcp::socket & socket_;
+    SSL *ssl_;
+    std::string session_key_;
+    std::chrono::milliseconds idle_timeout_;
+    std::chrono::steady_clock::time_point deadline_;
+    const std::atomic<bool> *cancelled_;
+};
+
+} // namespace ftp::detail
+#endif //FTP_TLS_STREAM_HPP
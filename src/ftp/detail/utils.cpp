@@ -22,7 +22,22 @@
  * SOFTWARE.
  */
 
+#include "utils.hpp"
+
 namespace ftp::detail::utils
 {
 
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+steady_clock::time_point deadline_after(milliseconds timeout)
+{
+    if (timeout <= milliseconds::zero())
+    {
+        return steady_clock::time_point::max();
+    }
+
+    return steady_clock::now() + timeout;
+}
+
 } // namespace ftp::detail::utils
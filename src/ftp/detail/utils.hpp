@@ -26,6 +26,7 @@
 #define FTP_UTILS_HPP
 
 #include <string>
+#include <chrono>
 #include <boost/format.hpp>
 
 namespace ftp::detail::utils
@@ -39,5 +40,8 @@ std::string format(const std::string & fmt, Args && ...args)
     return f.str();
 }
 
+/* A zero timeout means no deadline. */
+std::chrono::steady_clock::time_point deadline_after(std::chrono::milliseconds timeout);
+
 } // namespace ftp::detail::utils
 #endif //FTP_UTILS_HPP
@@ -0,0 +1,256 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "flight_recorder.hpp"
+#include "ftp_exception.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <istream>
+#include <ostream>
+
+namespace ftp
+{
+
+using std::string;
+using std::vector;
+using std::lock_guard;
+using std::mutex;
+using std::uint8_t;
+using std::uint16_t;
+using std::uint32_t;
+using std::uint64_t;
+using std::int64_t;
+using std::size_t;
+using std::chrono::system_clock;
+using std::chrono::nanoseconds;
+
+static const char dump_magic[8] = { 'F', 'T', 'P', 'F', 'L', 'T', '0', '1' };
+
+flight_recorder::flight_recorder(size_t capacity)
+    : records_(std::max<size_t>(capacity, 1)),
+      next_(0),
+      size_(0)
+{
+}
+
+void flight_recorder::record_connect(const string & hostname, uint16_t port)
+{
+    push(flight_event::kind::connect, 0, port, hostname.data(), hostname.size());
+}
+
+void flight_recorder::record_command(const string & command)
+{
+    /* RFC 959: PASS and ACCT carry the password and the account. */
+    if (command.compare(0, 5, "PASS ") == 0 || command.compare(0, 5, "ACCT ") == 0)
+    {
+        push(flight_event::kind::command, 0, 0, command.data(), 4);
+        return;
+    }
+
+    push(flight_event::kind::command, 0, 0, command.data(), command.size());
+}
+
+void flight_recorder::record_reply(uint16_t status_code)
+{
+    push(flight_event::kind::reply, status_code, 0, nullptr, 0);
+}
+
+void flight_recorder::record_transfer(uint64_t bytes, bool completed)
+{
+    push(flight_event::kind::transfer, completed ? 1 : 0, bytes, nullptr, 0);
+}
+
+void flight_recorder::record_reset()
+{
+    push(flight_event::kind::reset, 0, 0, nullptr, 0);
+}
+
+void flight_recorder::push(flight_event::kind type, uint16_t code, uint64_t bytes,
+                           const char *text, size_t length)
+{
+    int64_t time = std::chrono::duration_cast<nanoseconds>(system_clock::now().time_since_epoch()).count();
+
+    lock_guard<mutex> lock(mutex_);
+
+    record & record = records_[next_];
+
+    record.time = time;
+    record.bytes = bytes;
+    record.code = code;
+    record.type = static_cast<uint8_t>(type);
+    record.length = static_cast<uint8_t>(std::min(length, sizeof(record.text)));
+
+    if (record.length > 0)
+    {
+        std::memcpy(record.text, text, record.length);
+    }
+
+    next_ = (next_ + 1) % records_.size();
+    size_ = std::min(size_ + 1, records_.size());
+}
+
+vector<flight_event> flight_recorder::events() const
+{
+    lock_guard<mutex> lock(mutex_);
+
+    vector<flight_event> events;
+    events.reserve(size_);
+
+    size_t first = (next_ + records_.size() - size_) % records_.size();
+
+    for (size_t i = 0; i < size_; i++)
+    {
+        events.push_back(to_event(records_[(first + i) % records_.size()]));
+    }
+
+    return events;
+}
+
+void flight_recorder::dump(std::ostream & out) const
+{
+    vector<record> records;
+
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        size_t first = (next_ + records_.size() - size_) % records_.size();
+
+        for (size_t i = 0; i < size_; i++)
+        {
+            records.push_back(records_[(first + i) % records_.size()]);
+        }
+    }
+
+    uint32_t count = static_cast<uint32_t>(records.size());
+
+    out.write(dump_magic, sizeof(dump_magic));
+    out.write(reinterpret_cast<const char *>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char *>(records.data()),
+              static_cast<std::streamsize>(records.size() * sizeof(record)));
+
+    if (!out)
+    {
+        throw ftp_exception("Cannot write flight record.");
+    }
+}
+
+void flight_recorder::clear()
+{
+    lock_guard<mutex> lock(mutex_);
+
+    next_ = 0;
+    size_ = 0;
+}
+
+vector<flight_event> flight_recorder::load(std::istream & in)
+{
+    char magic[sizeof(dump_magic)];
+    uint32_t count = 0;
+
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char *>(&count), sizeof(count));
+
+    if (!in || std::memcmp(magic, dump_magic, sizeof(magic)) != 0)
+    {
+        throw ftp_exception("Not a flight record.");
+    }
+
+    vector<flight_event> events;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        record record;
+
+        if (!in.read(reinterpret_cast<char *>(&record), sizeof(record)))
+        {
+            throw ftp_exception("Flight record is truncated.");
+        }
+
+        if (record.type < static_cast<uint8_t>(flight_event::kind::connect) ||
+            record.type > static_cast<uint8_t>(flight_event::kind::reset) ||
+            record.length > sizeof(record.text))
+        {
+            throw ftp_exception("Flight record is corrupted.");
+        }
+
+        events.push_back(to_event(record));
+    }
+
+    return events;
+}
+
+flight_event flight_recorder::to_event(const record & record)
+{
+    flight_event event;
+
+    event.time = system_clock::time_point(std::chrono::duration_cast<system_clock::duration>(nanoseconds(record.time)));
+    event.type = static_cast<flight_event::kind>(record.type);
+    event.code = record.code;
+    event.bytes = record.bytes;
+    event.text.assign(record.text, record.length);
+
+    return event;
+}
+
+string flight_recorder::to_string(const flight_event & event)
+{
+    std::time_t seconds = system_clock::to_time_t(event.time);
+    int64_t microseconds = std::chrono::duration_cast<std::chrono::microseconds>(
+        event.time.time_since_epoch()).count() % 1000000;
+    std::tm tm = {};
+
+    gmtime_r(&seconds, &tm);
+
+    char time[40];
+    size_t length = std::strftime(time, sizeof(time), "%Y-%m-%d %H:%M:%S", &tm);
+    std::snprintf(time + length, sizeof(time) - length, ".%06lld", static_cast<long long>(microseconds));
+
+    string result = time;
+
+    switch (event.type)
+    {
+    case flight_event::kind::connect:
+        result += " connect " + event.text + ":" + std::to_string(event.bytes);
+        break;
+    case flight_event::kind::command:
+        result += " > " + event.text;
+        break;
+    case flight_event::kind::reply:
+        result += " < " + std::to_string(event.code);
+        break;
+    case flight_event::kind::transfer:
+        result += " transfer " + std::to_string(event.bytes) + " bytes" +
+                  (event.code ? "" : ", aborted");
+        break;
+    case flight_event::kind::reset:
+        result += " connection reset";
+        break;
+    }
+
+    return result;
+}
+
+} // namespace ftp
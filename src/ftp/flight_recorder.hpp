@@ -0,0 +1,128 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_FLIGHT_RECORDER_HPP
+#define FTP_FLIGHT_RECORDER_HPP
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iosfwd>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace ftp
+{
+
+struct flight_event
+{
+    enum class kind : std::uint8_t
+    {
+        /* text is the host, bytes the port. */
+        connect = 1,
+        /* text is the command, with credentials redacted. */
+        command = 2,
+        /* code is the status code. */
+        reply = 3,
+        /* bytes is the size of the data, code is 1 if it completed. */
+        transfer = 4,
+        /* The connection was dropped after an error. */
+        reset = 5
+    };
+
+    std::chrono::system_clock::time_point time;
+    kind type;
+    std::uint16_t code;
+    std::uint64_t bytes;
+    std::string text;
+};
+
+/* The last events of a session, kept in a fixed-size ring of 64-byte
+ * records, so that a failed session can be examined afterwards. Recording
+ * doesn't allocate, texts longer than 44 bytes are truncated.
+ *
+ * Dumps are a header followed by the records, oldest first, in host byte
+ * order. ftp_flight_decoder prints them as timelines.
+ */
+class flight_recorder
+{
+public:
+    static constexpr std::size_t default_capacity = 256;
+
+    explicit flight_recorder(std::size_t capacity = default_capacity);
+
+    flight_recorder(const flight_recorder &) = delete;
+
+    flight_recorder & operator=(const flight_recorder &) = delete;
+
+    void record_connect(const std::string & hostname, std::uint16_t port);
+
+    /* The arguments of PASS and ACCT are not recorded. */
+    void record_command(const std::string & command);
+
+    void record_reply(std::uint16_t status_code);
+
+    void record_transfer(std::uint64_t bytes, bool completed);
+
+    void record_reset();
+
+    std::vector<flight_event> events() const;
+
+    void dump(std::ostream & out) const;
+
+    void clear();
+
+    /* Throws ftp_exception if the dump is malformed. */
+    static std::vector<flight_event> load(std::istream & in);
+
+    /* E.g. "2020-05-01 10:00:00.123456 > RETR file.txt", the time in UTC. */
+    static std::string to_string(const flight_event & event);
+
+private:
+    struct record
+    {
+        std::int64_t time;
+        std::uint64_t bytes;
+        std::uint16_t code;
+        std::uint8_t type;
+        std::uint8_t length;
+        char text[44];
+    };
+
+    static_assert(sizeof(record) == 64, "Records are dumped as is.");
+
+    void push(flight_event::kind type, std::uint16_t code, std::uint64_t bytes,
+              const char *text, std::size_t length);
+
+    static flight_event to_event(const record & record);
+
+    mutable std::mutex mutex_;
+    std::vector<record> records_;
+    std::size_t next_;
+    std::size_t size_;
+};
+
+} // namespace ftp
+#endif //FTP_FLIGHT_RECORDER_HPP
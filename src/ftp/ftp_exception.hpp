@@ -35,6 +35,7 @@ class ftp_exception : public std::exception
 {
 public:
     explicit ftp_exception(const detail::connection_exception & ex)
+        : error_(ex.code())
     {
         message_ = ex.what();
     }
@@ -50,8 +51,17 @@ public:
         return message_.c_str();
     }
 
+    /* The error of the connection that caused the exception, if any, e.g.
+     * boost::asio::error::timed_out for a transfer that timed out.
+     */
+    const boost::system::error_code & code() const noexcept
+    {
+        return error_;
+    }
+
 private:
     std::string message_;
+    boost::system::error_code error_;
 };
 
 } // namespace ftp
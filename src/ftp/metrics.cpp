@@ -0,0 +1,286 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "metrics.hpp"
+#include <algorithm>
+#include <cstring>
+#include <iterator>
+#include <sstream>
+
+namespace ftp
+{
+
+using std::string;
+using std::size_t;
+using std::uint16_t;
+using std::uint64_t;
+using std::ostringstream;
+using std::chrono::nanoseconds;
+using detail::latency_histogram;
+
+/* The verbs sent by the client, in alphabetical order, then the rest. */
+static const char *verb_names[] = {
+    "ABOR", "APPE", "AUTH", "CWD", "DELE", "EPSV", "LIST", "MKD", "NLST",
+    "NOOP", "PASS", "PASV", "PBSZ", "PORT", "PROT", "PWD", "QUIT", "REST",
+    "RETR", "RMD", "SIZE", "STAT", "STOR", "SYST", "TYPE", "USER", "OTHER"
+};
+
+metrics & metrics::instance()
+{
+    static metrics metrics;
+    return metrics;
+}
+
+metrics::metrics()
+{
+    static_assert(std::size(verb_names) == verbs);
+
+    reset();
+}
+
+metrics::snapshot metrics::get() const
+{
+    snapshot snapshot;
+
+    for (size_t i = 0; i < verbs; i++)
+    {
+        if (commands_[i].count() > 0)
+        {
+            snapshot.commands[verb_names[i]] = get(commands_[i]);
+        }
+    }
+
+    snapshot.data_connections = get(data_connections_);
+    snapshot.transfer_durations = get(transfer_durations_);
+    snapshot.bytes_sent = bytes_sent_.load(std::memory_order_relaxed);
+    snapshot.bytes_received = bytes_received_.load(std::memory_order_relaxed);
+    snapshot.transfers = transfers_.load(std::memory_order_relaxed);
+    snapshot.failed_transfers = failed_transfers_.load(std::memory_order_relaxed);
+    snapshot.reconnects = reconnects_.load(std::memory_order_relaxed);
+
+    for (size_t i = 0; i < replies_.size(); i++)
+    {
+        snapshot.replies[i] = replies_[i].load(std::memory_order_relaxed);
+    }
+
+    return snapshot;
+}
+
+static double seconds(nanoseconds duration)
+{
+    return std::chrono::duration<double>(duration).count();
+}
+
+static void write_summary(ostringstream & out,
+                          const string & name,
+                          const string & labels,
+                          const metrics::latency & latency)
+{
+    string separator = labels.empty() ? "" : ",";
+
+    out << name << "{" << labels << separator << "quantile=\"0.5\"} " << seconds(latency.p50) << "\n"
+        << name << "{" << labels << separator << "quantile=\"0.9\"} " << seconds(latency.p90) << "\n"
+        << name << "{" << labels << separator << "quantile=\"0.99\"} " << seconds(latency.p99) << "\n"
+        << name << "_sum{" << labels << "} " << seconds(latency.sum) << "\n"
+        << name << "_count{" << labels << "} " << latency.count << "\n";
+}
+
+string metrics::prometheus() const
+{
+    snapshot snapshot = get();
+    ostringstream out;
+
+    out << "# HELP ftp_command_duration_seconds Time from sending a command to receiving its reply.\n"
+        << "# TYPE ftp_command_duration_seconds summary\n";
+
+    for (const auto & [verb, latency] : snapshot.commands)
+    {
+        write_summary(out, "ftp_command_duration_seconds", "verb=\"" + verb + "\"", latency);
+    }
+
+    out << "# HELP ftp_data_connection_duration_seconds Time to set up a data connection.\n"
+        << "# TYPE ftp_data_connection_duration_seconds summary\n";
+    write_summary(out, "ftp_data_connection_duration_seconds", "", snapshot.data_connections);
+
+    out << "# HELP ftp_transfer_duration_seconds Time to transfer the data of a file or a listing.\n"
+        << "# TYPE ftp_transfer_duration_seconds summary\n";
+    write_summary(out, "ftp_transfer_duration_seconds", "", snapshot.transfer_durations);
+
+    out << "# HELP ftp_sent_bytes_total Bytes sent over data connections.\n"
+        << "# TYPE ftp_sent_bytes_total counter\n"
+        << "ftp_sent_bytes_total " << snapshot.bytes_sent << "\n"
+        << "# HELP ftp_received_bytes_total Bytes received over data connections.\n"
+        << "# TYPE ftp_received_bytes_total counter\n"
+        << "ftp_received_bytes_total " << snapshot.bytes_received << "\n"
+        << "# HELP ftp_transfers_total Data transfers by result.\n"
+        << "# TYPE ftp_transfers_total counter\n"
+        << "ftp_transfers_total{result=\"completed\"} " << snapshot.transfers - snapshot.failed_transfers << "\n"
+        << "ftp_transfers_total{result=\"failed\"} " << snapshot.failed_transfers << "\n"
+        << "# HELP ftp_reconnects_total Reconnections by retried transfers.\n"
+        << "# TYPE ftp_reconnects_total counter\n"
+        << "ftp_reconnects_total " << snapshot.reconnects << "\n"
+        << "# HELP ftp_replies_total Server replies by class.\n"
+        << "# TYPE ftp_replies_total counter\n";
+
+    for (size_t i = 0; i < snapshot.replies.size(); i++)
+    {
+        out << "ftp_replies_total{class=\"" << i + 1 << "xx\"} " << snapshot.replies[i] << "\n";
+    }
+
+    return out.str();
+}
+
+static void write_latency(ostringstream & out, const metrics::latency & latency)
+{
+    out << "{\"count\":" << latency.count
+        << ",\"sum_ns\":" << latency.sum.count()
+        << ",\"p50_ns\":" << latency.p50.count()
+        << ",\"p90_ns\":" << latency.p90.count()
+        << ",\"p99_ns\":" << latency.p99.count()
+        << ",\"max_ns\":" << latency.max.count() << "}";
+}
+
+string metrics::json() const
+{
+    snapshot snapshot = get();
+    ostringstream out;
+
+    out << "{\"commands\":{";
+
+    bool first = true;
+
+    for (const auto & [verb, latency] : snapshot.commands)
+    {
+        out << (first ? "" : ",") << "\"" << verb << "\":";
+        write_latency(out, latency);
+        first = false;
+    }
+
+    out << "},\"data_connections\":";
+    write_latency(out, snapshot.data_connections);
+    out << ",\"transfer_durations\":";
+    write_latency(out, snapshot.transfer_durations);
+
+    out << ",\"bytes_sent\":" << snapshot.bytes_sent
+        << ",\"bytes_received\":" << snapshot.bytes_received
+        << ",\"transfers\":" << snapshot.transfers
+        << ",\"failed_transfers\":" << snapshot.failed_transfers
+        << ",\"reconnects\":" << snapshot.reconnects
+        << ",\"replies\":{";
+
+    for (size_t i = 0; i < snapshot.replies.size(); i++)
+    {
+        out << (i == 0 ? "" : ",") << "\"" << i + 1 << "xx\":" << snapshot.replies[i];
+    }
+
+    out << "}}";
+
+    return out.str();
+}
+
+void metrics::reset()
+{
+    for (latency_histogram & histogram : commands_)
+    {
+        histogram.reset();
+    }
+
+    data_connections_.reset();
+    transfer_durations_.reset();
+    bytes_sent_.store(0, std::memory_order_relaxed);
+    bytes_received_.store(0, std::memory_order_relaxed);
+    transfers_.store(0, std::memory_order_relaxed);
+    failed_transfers_.store(0, std::memory_order_relaxed);
+    reconnects_.store(0, std::memory_order_relaxed);
+
+    for (std::atomic<uint64_t> & replies : replies_)
+    {
+        replies.store(0, std::memory_order_relaxed);
+    }
+}
+
+void metrics::record_command(const string & command, nanoseconds latency)
+{
+    commands_[verb_index(command)].record(latency.count());
+}
+
+void metrics::record_reply(uint16_t status_code)
+{
+    if (status_code >= 100 && status_code < 600)
+    {
+        replies_[status_code / 100 - 1].fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void metrics::record_data_connection(nanoseconds latency)
+{
+    data_connections_.record(latency.count());
+}
+
+void metrics::record_transfer(nanoseconds duration, bool succeeded)
+{
+    transfer_durations_.record(duration.count());
+    transfers_.fetch_add(1, std::memory_order_relaxed);
+
+    if (!succeeded)
+    {
+        failed_transfers_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void metrics::record_reconnect()
+{
+    reconnects_.fetch_add(1, std::memory_order_relaxed);
+}
+
+size_t metrics::verb_index(const string & command)
+{
+    size_t length = std::min(command.find(' '), command.size());
+
+    for (size_t i = 0; i < verbs - 1; i++)
+    {
+        if (std::strlen(verb_names[i]) == length && command.compare(0, length, verb_names[i]) == 0)
+        {
+            return i;
+        }
+    }
+
+    return verbs - 1;
+}
+
+metrics::latency metrics::get(const latency_histogram & histogram)
+{
+    latency latency;
+
+    latency.count = histogram.count();
+    latency.sum = nanoseconds(histogram.sum());
+    latency.p50 = nanoseconds(histogram.value_at(0.5));
+    latency.p90 = nanoseconds(histogram.value_at(0.9));
+    latency.p99 = nanoseconds(histogram.value_at(0.99));
+    latency.max = nanoseconds(histogram.max());
+
+    return latency;
+}
+
+} // namespace ftp
@@ -0,0 +1,157 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_METRICS_HPP
+#define FTP_METRICS_HPP
+
+#include "detail/latency_histogram.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <map>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp
+{
+
+/* Process-wide metrics of all clients. Recording is lock-free and takes a
+ * few nanoseconds, reading takes a consistent enough snapshot while clients
+ * keep recording.
+ */
+class metrics
+{
+public:
+    struct latency
+    {
+        latency()
+            : count(0),
+              sum(0),
+              p50(0),
+              p90(0),
+              p99(0),
+              max(0)
+        {
+        }
+
+        std::uint64_t count;
+        std::chrono::nanoseconds sum;
+        std::chrono::nanoseconds p50;
+        std::chrono::nanoseconds p90;
+        std::chrono::nanoseconds p99;
+        std::chrono::nanoseconds max;
+    };
+
+    struct snapshot
+    {
+        snapshot()
+            : bytes_sent(0),
+              bytes_received(0),
+              transfers(0),
+              failed_transfers(0),
+              reconnects(0),
+              replies{}
+        {
+        }
+
+        /* From sending a command to receiving its reply, by verb. Verbs the
+         * client doesn't use are counted as "OTHER".
+         */
+        std::map<std::string, latency> commands;
+
+        /* From EPSV to the reply to the transfer command. */
+        latency data_connections;
+
+        /* From the reply to the transfer command to the end of the data. */
+        latency transfer_durations;
+
+        std::uint64_t bytes_sent;
+        std::uint64_t bytes_received;
+        std::uint64_t transfers;
+        std::uint64_t failed_transfers;
+        std::uint64_t reconnects;
+
+        /* Replies by class, 1yz to 5yz. */
+        std::array<std::uint64_t, 5> replies;
+    };
+
+    static metrics & instance();
+
+    metrics(const metrics &) = delete;
+
+    metrics & operator=(const metrics &) = delete;
+
+    snapshot get() const;
+
+    /* Text exposition format, version 0.0.4. */
+    std::string prometheus() const;
+
+    std::string json() const;
+
+    void reset();
+
+    /* Used by the clients. */
+    void record_command(const std::string & command, std::chrono::nanoseconds latency);
+
+    void record_reply(std::uint16_t status_code);
+
+    void record_data_connection(std::chrono::nanoseconds latency);
+
+    void record_transfer(std::chrono::nanoseconds duration, bool succeeded);
+
+    void record_reconnect();
+
+    void add_bytes_sent(std::size_t size)
+    {
+        bytes_sent_.fetch_add(size, std::memory_order_relaxed);
+    }
+
+    void add_bytes_received(std::size_t size)
+    {
+        bytes_received_.fetch_add(size, std::memory_order_relaxed);
+    }
+
+private:
+    metrics();
+
+    static std::size_t verb_index(const std::string & command);
+
+    static latency get(const detail::latency_histogram & histogram);
+
+    static constexpr std::size_t verbs = 27;
+
+    std::array<detail::latency_histogram, verbs> commands_;
+    detail::latency_histogram data_connections_;
+    detail::latency_histogram transfer_durations_;
+    std::atomic<std::uint64_t> bytes_sent_;
+    std::atomic<std::uint64_t> bytes_received_;
+    std::atomic<std::uint64_t> transfers_;
+    std::atomic<std::uint64_t> failed_transfers_;
+    std::atomic<std::uint64_t> reconnects_;
+    std::array<std::atomic<std::uint64_t>, 5> replies_;
+};
+
+} // namespace ftp
+#endif //FTP_METRICS_HPP
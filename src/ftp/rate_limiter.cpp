@@ -0,0 +1,194 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "rate_limiter.hpp"
+#include <algorithm>
+#include <thread>
+#include <unordered_map>
+
+namespace ftp
+{
+
+using std::string;
+using std::size_t;
+using std::uint64_t;
+using std::shared_ptr;
+using std::make_shared;
+using std::mutex;
+using std::lock_guard;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+
+/* Tokens accumulate for at most this long while a limiter is idle. */
+static const std::chrono::duration<double> max_burst(0.1);
+
+/* How often waiting transfers check for cancellation. */
+static const nanoseconds cancellation_check_interval = std::chrono::milliseconds(100);
+
+rate_limiter::rate_limiter(uint64_t bytes_per_second, shared_ptr<rate_limiter> parent)
+    : rate_(bytes_per_second),
+      parent_(std::move(parent)),
+      tokens_(0),
+      updated_(steady_clock::now())
+{
+}
+
+void rate_limiter::set_rate(uint64_t bytes_per_second)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    /* Don't let a limiter that has been unlimited for a while, or had a
+     * higher rate, start with a huge burst.
+     */
+    tokens_ = std::min(tokens_, bytes_per_second * max_burst.count());
+    updated_ = steady_clock::now();
+
+    rate_.store(bytes_per_second, std::memory_order_relaxed);
+}
+
+uint64_t rate_limiter::rate() const
+{
+    return rate_.load(std::memory_order_relaxed);
+}
+
+const shared_ptr<rate_limiter> & rate_limiter::parent() const
+{
+    return parent_;
+}
+
+bool rate_limiter::is_limited() const
+{
+    for (const rate_limiter *limiter = this; limiter; limiter = limiter->parent_.get())
+    {
+        if (limiter->rate_.load(std::memory_order_relaxed) != unlimited)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void rate_limiter::acquire(size_t size, const std::atomic<bool> *cancelled)
+{
+    nanoseconds wait = nanoseconds::zero();
+    steady_clock::time_point now;
+    bool limited = false;
+
+    for (rate_limiter *limiter = this; limiter; limiter = limiter->parent_.get())
+    {
+        if (limiter->rate_.load(std::memory_order_relaxed) == unlimited)
+        {
+            continue;
+        }
+
+        if (!limited)
+        {
+            now = steady_clock::now();
+            limited = true;
+        }
+
+        /* Reserve at every level at once and wait for the slowest one. */
+        wait = std::max(wait, limiter->reserve(size, now));
+    }
+
+    if (wait <= nanoseconds::zero())
+    {
+        return;
+    }
+
+    steady_clock::time_point until = now + wait;
+
+    for (;;)
+    {
+        if (cancelled && cancelled->load(std::memory_order_relaxed))
+        {
+            return;
+        }
+
+        now = steady_clock::now();
+
+        if (now >= until)
+        {
+            return;
+        }
+
+        std::this_thread::sleep_for(std::min<nanoseconds>(until - now, cancellation_check_interval));
+    }
+}
+
+nanoseconds rate_limiter::reserve(size_t size, steady_clock::time_point now)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    uint64_t rate = rate_.load(std::memory_order_relaxed);
+
+    if (rate == unlimited)
+    {
+        return nanoseconds::zero();
+    }
+
+    if (now > updated_)
+    {
+        double elapsed = std::chrono::duration<double>(now - updated_).count();
+
+        tokens_ = std::min(tokens_ + elapsed * rate, rate * max_burst.count());
+        updated_ = now;
+    }
+
+    tokens_ -= static_cast<double>(size);
+
+    if (tokens_ >= 0)
+    {
+        return nanoseconds::zero();
+    }
+
+    return std::chrono::duration_cast<nanoseconds>(std::chrono::duration<double>(-tokens_ / rate));
+}
+
+const shared_ptr<rate_limiter> & rate_limiter::global()
+{
+    static const shared_ptr<rate_limiter> limiter = make_shared<rate_limiter>();
+    return limiter;
+}
+
+shared_ptr<rate_limiter> rate_limiter::for_host(const string & hostname)
+{
+    static mutex hosts_mutex;
+    static std::unordered_map<string, shared_ptr<rate_limiter>> hosts;
+
+    lock_guard<mutex> lock(hosts_mutex);
+
+    shared_ptr<rate_limiter> & limiter = hosts[hostname];
+
+    if (!limiter)
+    {
+        limiter = make_shared<rate_limiter>(unlimited, global());
+    }
+
+    return limiter;
+}
+
+} // namespace ftp
@@ -0,0 +1,95 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_RATE_LIMITER_HPP
+#define FTP_RATE_LIMITER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp
+{
+
+/* Token bucket limiting the transfer rate in bytes per second. Limiters
+ * form a tree: the data passing through a limiter also counts against its
+ * parent, so every transfer is limited by its own rate, the rate of its
+ * host and the global rate, whichever is the lowest.
+ *
+ * Transfers reserve tokens chunk by chunk and wait for their turn, so the
+ * transfers sharing a parent get equal shares of its rate. A bucket may go
+ * into debt, which is paid off by waiting. Limits can be changed at any
+ * time, and unlimited limiters cost an atomic load per chunk.
+ */
+class rate_limiter
+{
+public:
+    explicit rate_limiter(std::uint64_t bytes_per_second = unlimited,
+                          std::shared_ptr<rate_limiter> parent = nullptr);
+
+    rate_limiter(const rate_limiter &) = delete;
+
+    rate_limiter & operator=(const rate_limiter &) = delete;
+
+    void set_rate(std::uint64_t bytes_per_second);
+
+    std::uint64_t rate() const;
+
+    const std::shared_ptr<rate_limiter> & parent() const;
+
+    /* Whether this limiter or one of its parents has a rate. */
+    bool is_limited() const;
+
+    /* Waits until 'size' bytes may be transferred. Returns early once the
+     * 'cancelled' flag is set.
+     */
+    void acquire(std::size_t size, const std::atomic<bool> *cancelled = nullptr);
+
+    /* The root of all limiters. */
+    static const std::shared_ptr<rate_limiter> & global();
+
+    /* Limiter shared by all transfers from or to the host, a child of the
+     * global one.
+     */
+    static std::shared_ptr<rate_limiter> for_host(const std::string & hostname);
+
+    static constexpr std::uint64_t unlimited = 0;
+
+private:
+    std::chrono::nanoseconds reserve(std::size_t size, std::chrono::steady_clock::time_point now);
+
+    std::atomic<std::uint64_t> rate_;
+    std::shared_ptr<rate_limiter> parent_;
+    std::mutex mutex_;
+    double tokens_;
+    std::chrono::steady_clock::time_point updated_;
+};
+
+} // namespace ftp
+#endif //FTP_RATE_LIMITER_HPP
@@ -0,0 +1,250 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include "resolver_cache.hpp"
+
+namespace ftp
+{
+
+using std::string;
+using std::to_string;
+using std::uint16_t;
+using std::uint64_t;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::chrono::seconds;
+using std::chrono::steady_clock;
+using boost::asio::ip::tcp;
+using boost::system::error_code;
+
+resolver_cache & resolver_cache::instance()
+{
+    static resolver_cache cache;
+    return cache;
+}
+
+resolver_cache::resolver_cache()
+    : stopped_(false),
+      ttl_(default_ttl),
+      negative_ttl_(default_negative_ttl),
+      hits_(0),
+      misses_(0)
+{
+}
+
+resolver_cache::~resolver_cache()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopped_ = true;
+    }
+
+    requested_.notify_all();
+
+    if (prefetch_thread_.joinable())
+    {
+        prefetch_thread_.join();
+    }
+}
+
+void resolver_cache::configure(seconds ttl, seconds negative_ttl)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    ttl_ = ttl;
+    negative_ttl_ = negative_ttl;
+}
+
+resolver_cache::endpoints_t resolver_cache::resolve(const string & hostname, uint16_t port, error_code & ec)
+{
+    string key = make_key(hostname, port);
+    unique_lock<mutex> lock(mutex_);
+
+    if (!start_resolving(key, lock))
+    {
+        const entry & entry = entries_[key];
+
+        hits_.fetch_add(1, std::memory_order_relaxed);
+        ec = entry.error;
+
+        return entry.endpoints;
+    }
+
+    misses_.fetch_add(1, std::memory_order_relaxed);
+    lock.unlock();
+
+    endpoints_t endpoints = do_resolve(hostname, port, ec);
+
+    finish_resolving(key, endpoints, ec);
+
+    return endpoints;
+}
+
+void resolver_cache::prefetch(const string & hostname, uint16_t port)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        if (!prefetch_thread_.joinable())
+        {
+            prefetch_thread_ = std::thread(&resolver_cache::run_prefetch, this);
+        }
+
+        requests_.push_back(request{hostname, port});
+    }
+
+    requested_.notify_one();
+}
+
+void resolver_cache::clear()
+{
+    lock_guard<mutex> lock(mutex_);
+
+    /* Keep entries being resolved, their lookups are still waiting. */
+    for (auto it = entries_.begin(); it != entries_.end();)
+    {
+        if (it->second.resolving)
+        {
+            ++it;
+        }
+        else
+        {
+            it = entries_.erase(it);
+        }
+    }
+}
+
+uint64_t resolver_cache::hits() const
+{
+    return hits_.load(std::memory_order_relaxed);
+}
+
+uint64_t resolver_cache::misses() const
+{
+    return misses_.load(std::memory_order_relaxed);
+}
+
+bool resolver_cache::start_resolving(const string & key, unique_lock<mutex> & lock)
+{
+    for (;;)
+    {
+        auto it = entries_.find(key);
+
+        if (it == entries_.end())
+        {
+            break;
+        }
+
+        if (it->second.resolving)
+        {
+            resolved_.wait(lock);
+            continue;
+        }
+
+        if (steady_clock::now() < it->second.expires)
+        {
+            return false;
+        }
+
+        break;
+    }
+
+    entries_[key].resolving = true;
+
+    return true;
+}
+
+void resolver_cache::finish_resolving(const string & key, const endpoints_t & endpoints, const error_code & ec)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        entry & entry = entries_[key];
+
+        entry.endpoints = endpoints;
+        entry.error = ec;
+        entry.expires = steady_clock::now() + (ec ? negative_ttl_ : ttl_);
+        entry.resolving = false;
+    }
+
+    resolved_.notify_all();
+}
+
+resolver_cache::endpoints_t resolver_cache::do_resolve(const string & hostname, uint16_t port, error_code & ec)
+{
+    boost::asio::io_context io_context;
+    tcp::resolver resolver(io_context);
+
+    tcp::resolver::results_type results = resolver.resolve(hostname, to_string(port), ec);
+
+    if (ec)
+    {
+        return endpoints_t();
+    }
+
+    return endpoints_t(results.begin(), results.end());
+}
+
+string resolver_cache::make_key(const string & hostname, uint16_t port)
+{
+    return hostname + ":" + to_string(port);
+}
+
+void resolver_cache::run_prefetch()
+{
+    unique_lock<mutex> lock(mutex_);
+
+    for (;;)
+    {
+        requested_.wait(lock, [this]() { return stopped_ || !requests_.empty(); });
+
+        if (stopped_)
+        {
+            return;
+        }
+
+        request request = requests_.front();
+        requests_.pop_front();
+
+        string key = make_key(request.hostname, request.port);
+
+        if (!start_resolving(key, lock))
+        {
+            continue;
+        }
+
+        lock.unlock();
+
+        error_code ec;
+        endpoints_t endpoints = do_resolve(request.hostname, request.port, ec);
+
+        finish_resolving(key, endpoints, ec);
+
+        lock.lock();
+    }
+}
+
+} // namespace ftp
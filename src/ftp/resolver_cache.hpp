@@ -0,0 +1,134 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_RESOLVER_CACHE_HPP
+#define FTP_RESOLVER_CACHE_HPP
+
+#include <boost/asio/ip/tcp.hpp>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstdint>
+
+namespace ftp
+{
+
+/* Process-wide cache of resolved server addresses, shared by all clients.
+ * Failed resolutions are cached as well, for a shorter time. Concurrent
+ * lookups of the same uncached host wait for a single resolution.
+ */
+class resolver_cache
+{
+public:
+    using endpoints_t = std::vector<boost::asio::ip::tcp::endpoint>;
+
+    static resolver_cache & instance();
+
+    resolver_cache(const resolver_cache &) = delete;
+
+    resolver_cache & operator=(const resolver_cache &) = delete;
+
+    /* The system resolver doesn't report DNS record TTLs, so every entry
+     * lives for the same time. A zero TTL disables caching.
+     */
+    void configure(std::chrono::seconds ttl, std::chrono::seconds negative_ttl);
+
+    endpoints_t resolve(const std::string & hostname, std::uint16_t port, boost::system::error_code & ec);
+
+    /* Resolves the host in the background unless it's already cached.
+     * Returns immediately.
+     */
+    void prefetch(const std::string & hostname, std::uint16_t port);
+
+    void clear();
+
+    std::uint64_t hits() const;
+
+    std::uint64_t misses() const;
+
+    static constexpr std::chrono::seconds default_ttl = std::chrono::seconds(60);
+
+    static constexpr std::chrono::seconds default_negative_ttl = std::chrono::seconds(10);
+
+private:
+    struct entry
+    {
+        entry()
+            : resolving(false)
+        {
+        }
+
+        endpoints_t endpoints;
+        boost::system::error_code error;
+        std::chrono::steady_clock::time_point expires;
+        bool resolving;
+    };
+
+    struct request
+    {
+        std::string hostname;
+        std::uint16_t port;
+    };
+
+    resolver_cache();
+
+    ~resolver_cache();
+
+    /* Returns false if the host is cached or being resolved. Otherwise,
+     * marks it as being resolved.
+     */
+    bool start_resolving(const std::string & key, std::unique_lock<std::mutex> & lock);
+
+    void finish_resolving(const std::string & key,
+                          const endpoints_t & endpoints,
+                          const boost::system::error_code & ec);
+
+    static endpoints_t do_resolve(const std::string & hostname, std::uint16_t port, boost::system::error_code & ec);
+
+    static std::string make_key(const std::string & hostname, std::uint16_t port);
+
+    void run_prefetch();
+
+    mutable std::mutex mutex_;
+    std::condition_variable resolved_;
+    std::condition_variable requested_;
+    std::unordered_map<std::string, entry> entries_;
+    std::deque<request> requests_;
+    std::thread prefetch_thread_;
+    bool stopped_;
+    std::chrono::seconds ttl_;
+    std::chrono::seconds negative_ttl_;
+    std::atomic<std::uint64_t> hits_;
+    std::atomic<std::uint64_t> misses_;
+};
+
+} // namespace ftp
+#endif //FTP_RESOLVER_CACHE_HPP
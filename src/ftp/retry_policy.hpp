@@ -0,0 +1,66 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_RETRY_POLICY_HPP
+#define FTP_RETRY_POLICY_HPP
+
+#include <chrono>
+
+namespace ftp
+{
+
+/* Describes how resumable transfers are retried after a connection failure,
+ * a timeout or a transient negative (4yz) reply. The delay before each next
+ * attempt is multiplied by 'backoff_factor' and limited by 'max_delay'.
+ */
+struct retry_policy
+{
+    retry_policy()
+        : max_attempts(1),
+          initial_delay(std::chrono::milliseconds(500)),
+          max_delay(std::chrono::seconds(30)),
+          backoff_factor(2.0)
+    {
+    }
+
+    retry_policy(unsigned int attempts,
+                 std::chrono::milliseconds delay,
+                 std::chrono::milliseconds delay_limit = std::chrono::seconds(30),
+                 double factor = 2.0)
+        : max_attempts(attempts),
+          initial_delay(delay),
+          max_delay(delay_limit),
+          backoff_factor(factor)
+    {
+    }
+
+    unsigned int max_attempts;
+    std::chrono::milliseconds initial_delay;
+    std::chrono::milliseconds max_delay;
+    double backoff_factor;
+};
+
+} // namespace ftp
+#endif //FTP_RETRY_POLICY_HPP
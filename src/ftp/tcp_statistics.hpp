@@ -0,0 +1,116 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_TCP_STATISTICS_HPP
+#define FTP_TCP_STATISTICS_HPP
+
+#include <chrono>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp
+{
+
+/* The kernel's view of a data connection at one point, from TCP_INFO.
+ * Congestion and the limited times describe sending, so they matter for
+ * uploads. Downloads are better judged by receive_rtt.
+ */
+struct tcp_sample
+{
+    tcp_sample()
+        : elapsed(0),
+          rtt(0),
+          rtt_variance(0),
+          receive_rtt(0),
+          congestion_window(0),
+          mss(0),
+          retransmits(0),
+          delivery_rate(0),
+          application_limited(false),
+          busy_time(0),
+          rwnd_limited(0),
+          sndbuf_limited(0)
+    {
+    }
+
+    /* Since the data connection was opened. */
+    std::chrono::microseconds elapsed;
+
+    std::chrono::microseconds rtt;
+    std::chrono::microseconds rtt_variance;
+    std::chrono::microseconds receive_rtt;
+
+    /* In segments of mss bytes. */
+    std::uint32_t congestion_window;
+    std::uint32_t mss;
+
+    /* Segments retransmitted since the connection was opened. */
+    std::uint32_t retransmits;
+
+    /* Bytes per second, as recently measured by the kernel. */
+    std::uint64_t delivery_rate;
+
+    /* The delivery rate was measured while the application didn't have
+     * enough data to send.
+     */
+    bool application_limited;
+
+    /* Time spent sending, and the parts of it limited by the receive window
+     * of the peer and by the send buffer. The time the connection wasn't
+     * busy, it waited for the application.
+     */
+    std::chrono::microseconds busy_time;
+    std::chrono::microseconds rwnd_limited;
+    std::chrono::microseconds sndbuf_limited;
+};
+
+/* TCP_INFO of the last data connection, sampled when it was opened, every
+ * sample_interval while data flows and when it was closed.
+ */
+struct tcp_statistics
+{
+    tcp_statistics()
+        : available(false),
+          socket_buffer_size(0)
+    {
+    }
+
+    static constexpr std::chrono::seconds sample_interval = std::chrono::seconds(1);
+
+    /* False where TCP_INFO isn't supported, then the samples are empty. */
+    bool available;
+
+    /* The smaller of SO_SNDBUF and SO_RCVBUF as granted by the kernel, which
+     * caps what was asked for. Zero if the buffers were left to autotuning.
+     */
+    std::size_t socket_buffer_size;
+
+    tcp_sample start;
+    std::vector<tcp_sample> samples;
+    tcp_sample end;
+};
+
+} // namespace ftp
+#endif //FTP_TCP_STATISTICS_HPP
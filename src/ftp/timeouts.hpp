@@ -0,0 +1,68 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_TIMEOUTS_HPP
+#define FTP_TIMEOUTS_HPP
+
+#include <chrono>
+
+namespace ftp
+{
+
+/* Limits on how long the client waits for the server. Zero means no limit.
+ *
+ * 'connect' applies to opening control and data connections, 'reply' to
+ * sending a command and waiting for its reply, 'data_idle' to a data
+ * connection making no progress, and 'transfer' to a whole data transfer.
+ */
+struct timeouts
+{
+    timeouts()
+        : connect(std::chrono::seconds(30)),
+          reply(std::chrono::seconds(60)),
+          data_idle(std::chrono::seconds(60)),
+          transfer(std::chrono::milliseconds::zero())
+    {
+    }
+
+    timeouts(std::chrono::milliseconds connect_timeout,
+             std::chrono::milliseconds reply_timeout,
+             std::chrono::milliseconds data_idle_timeout,
+             std::chrono::milliseconds transfer_timeout = std::chrono::milliseconds::zero())
+        : connect(connect_timeout),
+          reply(reply_timeout),
+          data_idle(data_idle_timeout),
+          transfer(transfer_timeout)
+    {
+    }
+
+    std::chrono::milliseconds connect;
+    std::chrono::milliseconds reply;
+    std::chrono::milliseconds data_idle;
+    std::chrono::milliseconds transfer;
+};
+
+} // namespace ftp
+#endif //FTP_TIMEOUTS_HPP
@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#ifndef FTP_TLS_OPTIONS_HPP
+#define FTP_TLS_OPTIONS_HPP
+
+#include <string>
+
+namespace ftp
+{
+
+struct tls_options
+{
+    tls_options()
+        : verify_peer(true),
+          kernel_tls(true),
+          session_resumption(true)
+    {
+    }
+
+    /* Verify the server certificate and that it matches the hostname. */
+    bool verify_peer;
+
+    /* File with trusted CA certificates in PEM format. If empty, the system
+     * default locations are used.
+     */
+    std::string ca_file;
+
+    /* Let the kernel encrypt data (kTLS) if the system supports it, so that
+     * files can still be sent with sendfile().
+     */
+    bool kernel_tls;
+
+    /* Resume TLS sessions on data connections and on later connections to
+     * the same server instead of doing a full handshake each time.
+     */
+    bool session_resumption;
+};
+
+} // namespace ftp
+#endif //FTP_TLS_OPTIONS_HPP
@@ -0,0 +1,149 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "tracing.hpp"
+#include "ftp_exception.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+
+namespace ftp
+{
+
+using std::string;
+using std::ostringstream;
+using std::lock_guard;
+using std::mutex;
+
+static string json_string(const string & value)
+{
+    string result = "\"";
+
+    for (char c : value)
+    {
+        switch (c)
+        {
+        case '"':
+            result += "\\\"";
+            break;
+        case '\\':
+            result += "\\\\";
+            break;
+        case '\n':
+            result += "\\n";
+            break;
+        case '\r':
+            result += "\\r";
+            break;
+        case '\t':
+            result += "\\t";
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20)
+            {
+                char escaped[7];
+                std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                result += escaped;
+            }
+            else
+            {
+                result += c;
+            }
+        }
+    }
+
+    return result + "\"";
+}
+
+json_lines_exporter::json_lines_exporter(const string & path)
+    : file_(path, std::ios_base::app)
+{
+    if (!file_)
+    {
+        throw ftp_exception("Cannot open file '%1%'.", path);
+    }
+}
+
+void json_lines_exporter::export_span(const trace_span & span)
+{
+    string line = to_json(span);
+
+    lock_guard<mutex> lock(mutex_);
+
+    file_ << line << "\n";
+    file_.flush();
+}
+
+string json_lines_exporter::to_json(const trace_span & span)
+{
+    ostringstream out;
+
+    int64_t start = std::chrono::duration_cast<std::chrono::microseconds>(span.start.time_since_epoch()).count();
+
+    out << "{\"operation\":" << json_string(span.operation)
+        << ",\"target\":" << json_string(span.target)
+        << ",\"start_us\":" << start
+        << ",\"duration_ns\":" << span.duration.count()
+        << ",\"succeeded\":" << (span.succeeded ? "true" : "false");
+
+    if (!span.error.empty())
+    {
+        out << ",\"error\":" << json_string(span.error);
+    }
+
+    if (span.tcp)
+    {
+        const tcp_sample & tcp = span.tcp.value();
+
+        out << ",\"tcp\":{\"rtt_us\":" << tcp.rtt.count()
+            << ",\"rtt_variance_us\":" << tcp.rtt_variance.count()
+            << ",\"receive_rtt_us\":" << tcp.receive_rtt.count()
+            << ",\"congestion_window\":" << tcp.congestion_window
+            << ",\"mss\":" << tcp.mss
+            << ",\"retransmits\":" << tcp.retransmits
+            << ",\"delivery_rate\":" << tcp.delivery_rate
+            << ",\"application_limited\":" << (tcp.application_limited ? "true" : "false")
+            << ",\"busy_us\":" << tcp.busy_time.count()
+            << ",\"rwnd_limited_us\":" << tcp.rwnd_limited.count()
+            << ",\"sndbuf_limited_us\":" << tcp.sndbuf_limited.count() << "}";
+    }
+
+    out << ",\"phases\":[";
+
+    for (size_t i = 0; i < span.phases.size(); i++)
+    {
+        const trace_phase & phase = span.phases[i];
+
+        out << (i == 0 ? "" : ",")
+            << "{\"name\":" << json_string(phase.name)
+            << ",\"start_ns\":" << phase.start.count()
+            << ",\"duration_ns\":" << phase.duration.count() << "}";
+    }
+
+    out << "]}";
+
+    return out.str();
+}
+
+} // namespace ftp
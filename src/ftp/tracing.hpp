@@ -0,0 +1,100 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_TRACING_HPP
+#define FTP_TRACING_HPP
+
+#include "tcp_statistics.hpp"
+#include <chrono>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace ftp
+{
+
+/* A part of an operation, e.g. "resolve", "connect", "EPSV" (a command and
+ * its reply), "data_connect", "first_byte", "transfer" or "final_reply".
+ * Phases follow each other, each starts where the previous one ended.
+ */
+struct trace_phase
+{
+    std::string name;
+
+    /* Since the start of the span. */
+    std::chrono::nanoseconds start;
+
+    std::chrono::nanoseconds duration;
+};
+
+/* A client operation, e.g. "open" or "download". */
+struct trace_span
+{
+    std::string operation;
+
+    /* The host for "open", the file for transfers. */
+    std::string target;
+
+    std::chrono::system_clock::time_point start;
+    std::chrono::nanoseconds duration;
+    std::vector<trace_phase> phases;
+    bool succeeded;
+
+    /* At the end of the last data connection, where TCP_INFO is supported. */
+    std::optional<tcp_sample> tcp;
+
+    /* The message of the exception that ended the operation, if any. */
+    std::string error;
+};
+
+class trace_exporter
+{
+public:
+    /* Called by the thread that ran the operation, possibly by several
+     * clients at once.
+     */
+    virtual void export_span(const trace_span & span) = 0;
+
+    virtual ~trace_exporter() = default;
+};
+
+/* Appends a JSON object per span to a file, one per line. */
+class json_lines_exporter : public trace_exporter
+{
+public:
+    explicit json_lines_exporter(const std::string & path);
+
+    void export_span(const trace_span & span) override;
+
+    static std::string to_json(const trace_span & span);
+
+private:
+    std::mutex mutex_;
+    std::ofstream file_;
+};
+
+} // namespace ftp
+#endif //FTP_TRACING_HPP
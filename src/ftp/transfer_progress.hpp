@@ -0,0 +1,63 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_TRANSFER_PROGRESS_HPP
+#define FTP_TRANSFER_PROGRESS_HPP
+
+#include <chrono>
+#include <optional>
+#include <cstdint>
+
+namespace ftp
+{
+
+struct transfer_progress
+{
+    transfer_progress()
+        : bytes(0),
+          rate(0),
+          average_rate(0),
+          elapsed(std::chrono::milliseconds::zero())
+    {
+    }
+
+    /* Bytes transferred so far, not counting the part of a resumed file
+     * transferred before.
+     */
+    std::uint64_t bytes;
+
+    /* Bytes to transfer, if known. */
+    std::optional<std::uint64_t> total;
+
+    /* Bytes per second over the last progress interval. */
+    double rate;
+
+    /* Bytes per second since the transfer started. */
+    double average_rate;
+
+    std::chrono::milliseconds elapsed;
+};
+
+} // namespace ftp
+#endif //FTP_TRANSFER_PROGRESS_HPP
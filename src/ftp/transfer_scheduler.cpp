@@ -0,0 +1,667 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "transfer_scheduler.hpp"
+#include "ftp_exception.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <filesystem>
+
+namespace ftp
+{
+
+using std::string;
+using std::size_t;
+using std::uint16_t;
+using std::uint64_t;
+using std::vector;
+using std::future;
+using std::optional;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::chrono::steady_clock;
+
+/* RFC 959: 421 Service not available, closing control connection. */
+static const uint16_t service_not_available = 421;
+
+struct transfer_scheduler::worker : public client::event_observer
+{
+    worker()
+        : session(this),
+          port(0),
+          last_status_code(0)
+    {
+    }
+
+    void on_reply(const string & reply) override
+    {
+        if (reply.size() >= 3 && std::all_of(reply.begin(), reply.begin() + 3,
+                                              [](unsigned char c) { return std::isdigit(c); }))
+        {
+            last_status_code = static_cast<uint16_t>(std::stoi(reply.substr(0, 3)));
+        }
+    }
+
+    client session;
+
+    /* The host of the open session, empty if there is none. */
+    string hostname;
+    uint16_t port;
+    string username;
+
+    uint16_t last_status_code;
+
+    /* The tuner and the transport when the job started. */
+    std::shared_ptr<auto_tuner> tuner;
+    std::shared_ptr<ftp::transport> transport;
+
+    std::thread thread;
+};
+
+transfer_scheduler::transfer_scheduler(size_t workers, size_t max_sessions_per_host)
+    : default_max_sessions_(std::max<size_t>(max_sessions_per_host, 1)),
+      retry_policy_(5, std::chrono::seconds(1)),
+      batches_(0),
+      running_(0),
+      paused_(false),
+      stopped_(false)
+{
+    workers = std::max<size_t>(workers, 1);
+
+    for (size_t i = 0; i < workers; i++)
+    {
+        workers_.push_back(std::make_unique<worker>());
+    }
+
+    for (const auto & worker : workers_)
+    {
+        worker->thread = std::thread(&transfer_scheduler::run, this, std::ref(*worker));
+    }
+}
+
+transfer_scheduler::~transfer_scheduler()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        stopped_ = true;
+    }
+
+    changed_.notify_all();
+
+    for (const auto & worker : workers_)
+    {
+        worker->thread.join();
+        disconnect(*worker);
+    }
+
+    for (queued_job & queued : queue_)
+    {
+        queued.promise.set_exception(std::make_exception_ptr(ftp_exception("Transfer scheduler is stopped.")));
+    }
+}
+
+future<bool> transfer_scheduler::submit(const job & job)
+{
+    return std::move(submit(vector<struct job>{job}).front());
+}
+
+vector<future<bool>> transfer_scheduler::submit(const vector<job> & batch)
+{
+    vector<future<bool>> futures;
+    futures.reserve(batch.size());
+
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        uint64_t batch_id = batches_++;
+
+        for (const job & job : batch)
+        {
+            queued_job queued;
+            queued.job = job;
+            queued.batch = batch_id;
+            queued.attempts = 0;
+            queued.size_state = queued_job::sizing::known;
+
+            if (job.size == 0 && job.type == job::direction::upload)
+            {
+                std::error_code ec;
+                uint64_t size = std::filesystem::file_size(job.local_file, ec);
+
+                if (!ec)
+                {
+                    queued.job.size = size;
+                }
+            }
+            else if (job.size == 0)
+            {
+                queued.size_state = queued_job::sizing::unknown;
+            }
+
+            futures.push_back(queued.promise.get_future());
+
+            /* Keep the queue in the order the jobs run in. */
+            auto position = std::upper_bound(queue_.begin(), queue_.end(), queued, runs_before);
+            queue_.insert(position, std::move(queued));
+        }
+    }
+
+    changed_.notify_all();
+
+    return futures;
+}
+
+void transfer_scheduler::set_max_sessions(const string & hostname, size_t sessions)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        host & host = get_host(hostname);
+        host.max_sessions = std::max<size_t>(sessions, 1);
+        host.refusals = 0;
+    }
+
+    changed_.notify_all();
+}
+
+size_t transfer_scheduler::max_sessions(const string & hostname) const
+{
+    lock_guard<mutex> lock(mutex_);
+
+    auto it = hosts_.find(hostname);
+
+    if (it == hosts_.end())
+    {
+        return default_max_sessions_;
+    }
+
+    return it->second.max_sessions;
+}
+
+void transfer_scheduler::set_retry_policy(const retry_policy & policy)
+{
+    lock_guard<mutex> lock(mutex_);
+    retry_policy_ = policy;
+}
+
+void transfer_scheduler::set_completion_handler(const completion_handler & handler)
+{
+    lock_guard<mutex> lock(mutex_);
+    completion_handler_ = handler;
+}
+
+void transfer_scheduler::set_auto_tuner(const std::shared_ptr<auto_tuner> & tuner)
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        auto_tuner_ = tuner;
+    }
+
+    changed_.notify_all();
+}
+
+void transfer_scheduler::set_transport(const std::shared_ptr<transport> & transport)
+{
+    lock_guard<mutex> lock(mutex_);
+    transport_ = transport;
+}
+
+void transfer_scheduler::pause()
+{
+    lock_guard<mutex> lock(mutex_);
+    paused_ = true;
+}
+
+void transfer_scheduler::resume()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+        paused_ = false;
+    }
+
+    changed_.notify_all();
+}
+
+void transfer_scheduler::wait()
+{
+    unique_lock<mutex> lock(mutex_);
+
+    done_.wait(lock, [this]() { return queue_.empty() && running_ == 0; });
+}
+
+void transfer_scheduler::run(worker & worker)
+{
+    unique_lock<mutex> lock(mutex_);
+
+    while (!stopped_)
+    {
+        optional<steady_clock::time_point> wake_up;
+        auto it = paused_ ? queue_.end() : next_job(worker, steady_clock::now(), wake_up);
+
+        if (it == queue_.end())
+        {
+            if (wake_up)
+            {
+                changed_.wait_until(lock, *wake_up);
+            }
+            else
+            {
+                changed_.wait(lock);
+            }
+
+            continue;
+        }
+
+        if (it->size_state == queued_job::sizing::unknown)
+        {
+            size_downloads(worker, it, lock);
+            continue;
+        }
+
+        queued_job queued = std::move(*it);
+        queue_.erase(it);
+        running_++;
+
+        /* The session with another host, if any, gives its place to the
+         * new one.
+         */
+        bool reconnect = worker.hostname != queued.job.hostname;
+
+        if (reconnect)
+        {
+            if (!worker.hostname.empty())
+            {
+                get_host(worker.hostname).sessions--;
+            }
+
+            get_host(queued.job.hostname).sessions++;
+        }
+
+        worker.tuner = auto_tuner_;
+        worker.transport = transport_;
+
+        lock.unlock();
+
+        if (reconnect)
+        {
+            /* Let the freed place be taken. */
+            changed_.notify_all();
+            disconnect(worker);
+        }
+
+        worker.hostname = queued.job.hostname;
+
+        outcome result = outcome::failed;
+        std::exception_ptr exception;
+
+        try
+        {
+            result = transfer(worker, queued.job);
+        }
+        catch (const ftp_exception &)
+        {
+            exception = std::current_exception();
+            disconnect(worker);
+        }
+
+        if (result == outcome::refused)
+        {
+            disconnect(worker);
+        }
+
+        bool connected = is_connected(worker);
+
+        lock.lock();
+
+        host & host = get_host(queued.job.hostname);
+
+        if (!connected)
+        {
+            host.sessions--;
+            worker.hostname.clear();
+        }
+
+        if (result == outcome::refused)
+        {
+            /* The server accepted the other sessions. */
+            host.max_sessions = std::max<size_t>(std::min(host.max_sessions, host.sessions), 1);
+            host.refusals++;
+
+            double delay = retry_policy_.initial_delay.count() *
+                           std::pow(retry_policy_.backoff_factor, host.refusals - 1);
+            delay = std::min(delay, static_cast<double>(retry_policy_.max_delay.count()));
+
+            host.retry_after = steady_clock::now() + std::chrono::milliseconds(static_cast<std::int64_t>(delay));
+
+            if (++queued.attempts < retry_policy_.max_attempts)
+            {
+                auto position = std::upper_bound(queue_.begin(), queue_.end(), queued, runs_before);
+                queue_.insert(position, std::move(queued));
+                running_--;
+                changed_.notify_all();
+                continue;
+            }
+        }
+        else if (result == outcome::succeeded)
+        {
+            host.refusals = 0;
+
+            if (worker.tuner)
+            {
+                worker.tuner->record_transfer(queued.job.hostname,
+                                              worker.session.progress().bytes,
+                                              worker.session.last_tcp_statistics(),
+                                              host.sessions);
+            }
+        }
+
+        completion_handler handler = completion_handler_;
+
+        lock.unlock();
+
+        bool succeeded = result == outcome::succeeded;
+
+        if (exception)
+        {
+            queued.promise.set_exception(exception);
+        }
+        else
+        {
+            queued.promise.set_value(succeeded);
+        }
+
+        if (handler)
+        {
+            handler(queued.job, succeeded);
+        }
+
+        lock.lock();
+
+        running_--;
+        changed_.notify_all();
+        done_.notify_all();
+    }
+}
+
+std::list<transfer_scheduler::queued_job>::iterator
+transfer_scheduler::next_job(const worker & worker,
+                             steady_clock::time_point now,
+                             optional<steady_clock::time_point> & wake_up)
+{
+    for (auto it = queue_.begin(); it != queue_.end(); ++it)
+    {
+        if (it->size_state == queued_job::sizing::pending)
+        {
+            continue;
+        }
+
+        const string & hostname = it->job.hostname;
+        host & host = get_host(hostname);
+
+        if (host.retry_after > now)
+        {
+            if (!wake_up || host.retry_after < *wake_up)
+            {
+                wake_up = host.retry_after;
+            }
+
+            continue;
+        }
+
+        /* The worker's own session takes no new place. */
+        if (worker.hostname == hostname || host.sessions < session_limit(hostname, host))
+        {
+            return it;
+        }
+    }
+
+    return queue_.end();
+}
+
+void transfer_scheduler::size_downloads(worker & worker,
+                                        std::list<queued_job>::iterator first,
+                                        unique_lock<mutex> & lock)
+{
+    const job job = first->job;
+    uint64_t batch = first->batch;
+    vector<string> remote_files;
+
+    for (queued_job & queued : queue_)
+    {
+        if (queued.size_state == queued_job::sizing::unknown && queued.batch == batch &&
+            same_session(queued.job, job))
+        {
+            queued.size_state = queued_job::sizing::pending;
+            remote_files.push_back(queued.job.remote_file);
+        }
+    }
+
+    /* The session takes a place with the host, as a transfer does. */
+    bool reconnect = worker.hostname != job.hostname;
+
+    if (reconnect)
+    {
+        if (!worker.hostname.empty())
+        {
+            get_host(worker.hostname).sessions--;
+        }
+
+        get_host(job.hostname).sessions++;
+    }
+
+    worker.tuner = auto_tuner_;
+    worker.transport = transport_;
+
+    lock.unlock();
+
+    if (reconnect)
+    {
+        changed_.notify_all();
+        disconnect(worker);
+    }
+
+    worker.hostname = job.hostname;
+
+    std::unordered_map<string, uint64_t> sizes;
+
+    try
+    {
+        if (connect(worker, job) == outcome::succeeded)
+        {
+            for (const string & remote_file : remote_files)
+            {
+                if (optional<uint64_t> size = worker.session.file_size(remote_file))
+                {
+                    sizes[remote_file] = *size;
+                }
+            }
+        }
+    }
+    catch (const ftp_exception &)
+    {
+        disconnect(worker);
+    }
+
+    /* The transfers report their own errors. */
+    bool connected = is_connected(worker);
+
+    lock.lock();
+
+    if (!connected)
+    {
+        get_host(job.hostname).sessions--;
+        worker.hostname.clear();
+    }
+
+    for (queued_job & queued : queue_)
+    {
+        if (queued.size_state == queued_job::sizing::pending && queued.batch == batch &&
+            same_session(queued.job, job))
+        {
+            auto it = sizes.find(queued.job.remote_file);
+
+            if (it != sizes.end())
+            {
+                queued.job.size = it->second;
+            }
+
+            queued.size_state = queued_job::sizing::known;
+        }
+    }
+
+    /* Stable, the order of submission is kept for equal sizes. */
+    queue_.sort(runs_before);
+
+    changed_.notify_all();
+}
+
+transfer_scheduler::outcome transfer_scheduler::connect(worker & worker, const job & job)
+{
+    worker.last_status_code = 0;
+
+    if (is_connected(worker) && (worker.port != job.port || worker.username != job.username))
+    {
+        disconnect(worker);
+    }
+
+    if (!is_connected(worker))
+    {
+        worker.port = job.port;
+        worker.username.clear();
+        worker.session.set_transport(worker.transport);
+
+        if (!worker.session.open(job.hostname, job.port) ||
+            !worker.session.login(job.username, job.password) ||
+            !worker.session.binary())
+        {
+            return worker.last_status_code == service_not_available ? outcome::refused : outcome::failed;
+        }
+
+        worker.username = job.username;
+    }
+
+    return outcome::succeeded;
+}
+
+transfer_scheduler::outcome transfer_scheduler::transfer(worker & worker, const job & job)
+{
+    outcome connected = connect(worker, job);
+
+    if (connected != outcome::succeeded)
+    {
+        return connected;
+    }
+
+    worker.session.set_socket_buffer_size(worker.tuner ? worker.tuner->get(job.hostname).socket_buffer_size : 0);
+
+    bool succeeded = job.type == job::direction::upload ?
+                     worker.session.upload(job.local_file, job.remote_file) :
+                     worker.session.download(job.remote_file, job.local_file);
+
+    if (succeeded)
+    {
+        return outcome::succeeded;
+    }
+
+    return worker.last_status_code == service_not_available ? outcome::refused : outcome::failed;
+}
+
+size_t transfer_scheduler::session_limit(const string & hostname, const host & host) const
+{
+    if (!auto_tuner_)
+    {
+        return host.max_sessions;
+    }
+
+    return std::min(host.max_sessions, auto_tuner_->get(hostname).sessions);
+}
+
+bool transfer_scheduler::is_connected(worker & worker)
+{
+    try
+    {
+        return worker.session.is_open();
+    }
+    catch (const ftp_exception &)
+    {
+        return false;
+    }
+}
+
+void transfer_scheduler::disconnect(worker & worker)
+{
+    try
+    {
+        if (worker.session.is_open())
+        {
+            worker.session.close();
+        }
+    }
+    catch (const ftp_exception &)
+    {
+        /* The connection is reset anyway. */
+    }
+}
+
+transfer_scheduler::host & transfer_scheduler::get_host(const string & hostname)
+{
+    auto it = hosts_.find(hostname);
+
+    if (it == hosts_.end())
+    {
+        host host;
+        host.max_sessions = default_max_sessions_;
+        host.sessions = 0;
+        host.refusals = 0;
+
+        it = hosts_.emplace(hostname, host).first;
+    }
+
+    return it->second;
+}
+
+bool transfer_scheduler::runs_before(const queued_job & lhs, const queued_job & rhs)
+{
+    if (lhs.job.priority != rhs.job.priority)
+    {
+        return lhs.job.priority > rhs.job.priority;
+    }
+
+    if (lhs.batch != rhs.batch)
+    {
+        return lhs.batch < rhs.batch;
+    }
+
+    /* Largest first, the order of submission otherwise. */
+    return lhs.job.size > rhs.job.size;
+}
+
+bool transfer_scheduler::same_session(const job & lhs, const job & rhs)
+{
+    return lhs.hostname == rhs.hostname && lhs.port == rhs.port && lhs.username == rhs.username;
+}
+
+} // namespace ftp
@@ -0,0 +1,232 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_TRANSFER_SCHEDULER_HPP
+#define FTP_TRANSFER_SCHEDULER_HPP
+
+#include "auto_tuner.hpp"
+#include "client.hpp"
+#include "retry_policy.hpp"
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp
+{
+
+/* Runs uploads and downloads on a pool of workers, each with its own client.
+ * Jobs with a higher priority run first. The jobs of a batch run largest
+ * first, which shortens the time until the whole batch is done.
+ *
+ * The number of sessions with each host is limited. When a server refuses a
+ * session with 421, the scheduler lowers the limit of the host to the number
+ * of sessions the server did accept, backs off and retries the job. A worker
+ * keeps its session open for the next job on the same host.
+ *
+ * With an auto_tuner, the tuner picks the number of sessions with each host,
+ * within the limit above, and the socket buffer size of the transfers.
+ */
+class transfer_scheduler
+{
+public:
+    struct job
+    {
+        enum class direction
+        {
+            upload,
+            download
+        };
+
+        job()
+            : type(direction::download),
+              port(21),
+              priority(0),
+              size(0)
+        {
+        }
+
+        direction type;
+        std::string hostname;
+        std::uint16_t port;
+        std::string username;
+        std::string password;
+        std::string local_file;
+        std::string remote_file;
+
+        /* Higher runs first. */
+        int priority;
+
+        /* Used to order a batch. If it's not set, the size of a local file
+         * to upload is found out, and the sizes of the files to download are
+         * asked from the server before the first download of the batch from
+         * the host starts.
+         */
+        std::uint64_t size;
+    };
+
+    using completion_handler = std::function<void(const job & job, bool succeeded)>;
+
+    explicit transfer_scheduler(std::size_t workers = default_workers,
+                                std::size_t max_sessions_per_host = default_max_sessions_per_host);
+
+    transfer_scheduler(const transfer_scheduler &) = delete;
+
+    transfer_scheduler & operator=(const transfer_scheduler &) = delete;
+
+    /* Waits for the running jobs. The queued jobs fail with ftp_exception. */
+    ~transfer_scheduler();
+
+    /* The future holds the result of client::upload() or client::download(),
+     * or the ftp_exception they threw.
+     */
+    std::future<bool> submit(const job & job);
+
+    std::vector<std::future<bool>> submit(const std::vector<job> & batch);
+
+    void set_max_sessions(const std::string & hostname, std::size_t sessions);
+
+    std::size_t max_sessions(const std::string & hostname) const;
+
+    /* How jobs refused with 421 are retried. */
+    void set_retry_policy(const retry_policy & policy);
+
+    /* Learns from the jobs that succeed. nullptr turns tuning off. */
+    void set_auto_tuner(const std::shared_ptr<auto_tuner> & tuner);
+
+    /* Carries the sessions opened from now on, see client::set_transport(). */
+    void set_transport(const std::shared_ptr<transport> & transport);
+
+    /* Called by a worker after each job. */
+    void set_completion_handler(const completion_handler & handler);
+
+    /* Running jobs are not interrupted. */
+    void pause();
+
+    void resume();
+
+    /* Waits until all submitted jobs are done. */
+    void wait();
+
+    static constexpr std::size_t default_workers = 4;
+
+    static constexpr std::size_t default_max_sessions_per_host = 2;
+
+private:
+    struct queued_job
+    {
+        enum class sizing
+        {
+            known,
+            unknown,
+
+            /* Being asked from the server, the job waits. */
+            pending
+        };
+
+        struct job job;
+        std::uint64_t batch;
+        unsigned int attempts;
+        sizing size_state;
+        std::promise<bool> promise;
+    };
+
+    struct host
+    {
+        std::size_t max_sessions;
+        std::size_t sessions;
+        unsigned int refusals;
+        std::chrono::steady_clock::time_point retry_after;
+    };
+
+    struct worker;
+
+    enum class outcome
+    {
+        succeeded,
+        failed,
+        refused
+    };
+
+    void run(worker & worker);
+
+    /* Returns the first job the worker can start, or the end of the queue.
+     * 'wake_up' is set to the end of the earliest backoff that holds a job.
+     */
+    std::list<queued_job>::iterator next_job(const worker & worker,
+                                             std::chrono::steady_clock::time_point now,
+                                             std::optional<std::chrono::steady_clock::time_point> & wake_up);
+
+    /* Asks the server for the sizes of the downloads of the batch of
+     * 'first' from its host, and reorders the queue. Called and returns
+     * with the lock held.
+     */
+    void size_downloads(worker & worker, std::list<queued_job>::iterator first, std::unique_lock<std::mutex> & lock);
+
+    /* Opens a session with the host of the job unless the worker has one. */
+    outcome connect(worker & worker, const job & job);
+
+    outcome transfer(worker & worker, const job & job);
+
+    std::size_t session_limit(const std::string & hostname, const host & host) const;
+
+    static bool is_connected(worker & worker);
+
+    static void disconnect(worker & worker);
+
+    host & get_host(const std::string & hostname);
+
+    static bool runs_before(const queued_job & lhs, const queued_job & rhs);
+
+    static bool same_session(const job & lhs, const job & rhs);
+
+    mutable std::mutex mutex_;
+    std::condition_variable changed_;
+    std::condition_variable done_;
+    std::list<queued_job> queue_;
+    std::unordered_map<std::string, host> hosts_;
+    std::vector<std::unique_ptr<worker>> workers_;
+    std::size_t default_max_sessions_;
+    retry_policy retry_policy_;
+    completion_handler completion_handler_;
+    std::shared_ptr<auto_tuner> auto_tuner_;
+    std::shared_ptr<transport> transport_;
+    std::uint64_t batches_;
+    std::size_t running_;
+    bool paused_;
+    bool stopped_;
+};
+
+} // namespace ftp
+#endif //FTP_TRANSFER_SCHEDULER_HPP
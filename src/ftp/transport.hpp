@@ -0,0 +1,90 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_TRANSPORT_HPP
+#define FTP_TRANSPORT_HPP
+
+#include "tcp_statistics.hpp"
+#include <boost/system/error_code.hpp>
+#include <memory>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp
+{
+
+/* A connected byte stream of a transport. Used by one thread at a time. */
+class transport_stream
+{
+public:
+    virtual ~transport_stream() = default;
+
+    /* Waits for data, and fails with 'eof' at the end of it. */
+    virtual std::size_t read_some(char *data, std::size_t size, boost::system::error_code & ec) = 0;
+
+    virtual std::size_t write_some(const char *data, std::size_t size, boost::system::error_code & ec) = 0;
+
+    /* Sends the end of data, the peer can still send. */
+    virtual void shutdown_send(boost::system::error_code & ec) = 0;
+
+    /* With 'reset', the peer takes the connection for broken rather than
+     * closed.
+     */
+    virtual void close(bool reset) = 0;
+
+    /* The address of the peer, used for the data connections of the
+     * session.
+     */
+    virtual std::string remote_ip() const = 0;
+
+    /* Fills the sample, elapsed included, as TCP_INFO would. Returns false
+     * if the transport can't tell.
+     */
+    virtual bool sample(tcp_sample & /* sample */) const
+    {
+        return false;
+    }
+};
+
+/* Carries the control and data connections of a client instead of TCP
+ * sockets, e.g. a simulated network. TLS, sendfile() and the timeouts
+ * are not available on a transport, the cancellation of transfers is.
+ */
+class transport
+{
+public:
+    virtual ~transport() = default;
+
+    /* 'socket_buffer_size' is the one of client::set_socket_buffer_size(),
+     * zero for the control connection.
+     */
+    virtual std::unique_ptr<transport_stream> connect(const std::string & hostname,
+                                                      std::uint16_t port,
+                                                      std::size_t socket_buffer_size,
+                                                      boost::system::error_code & ec) = 0;
+};
+
+} // namespace ftp
+#endif //FTP_TRANSPORT_HPP
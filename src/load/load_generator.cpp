@@ -0,0 +1,329 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "load_generator.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+using std::string;
+using std::optional;
+using std::size_t;
+using std::uint64_t;
+using std::chrono::steady_clock;
+
+/* A session that can't log in waits before it tries again. */
+static const std::chrono::milliseconds reconnect_delay(100);
+
+static std::chrono::microseconds to_microseconds(uint64_t nanoseconds)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::nanoseconds(nanoseconds));
+}
+
+static double to_milliseconds(std::chrono::microseconds duration)
+{
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+void print_report(std::ostream & stream, const load_report & report)
+{
+    uint64_t count = 0;
+    uint64_t errors = 0;
+    uint64_t bytes = 0;
+
+    for (const operation_report & operation : report.operations)
+    {
+        count += operation.count;
+        errors += operation.errors;
+        bytes += operation.bytes;
+    }
+
+    double seconds = std::max(report.elapsed.count(), 1e-9);
+    char line[256];
+
+    std::snprintf(line, sizeof(line), "Sessions: %zu, elapsed: %.2f s\n", report.sessions, report.elapsed.count());
+    stream << line;
+
+    std::snprintf(line, sizeof(line), "Operations: %llu (%.1f/s), errors: %llu (%.2f%%)\n",
+                  static_cast<unsigned long long>(count), count / seconds,
+                  static_cast<unsigned long long>(errors), count > 0 ? 100.0 * errors / count : 0.0);
+    stream << line;
+
+    std::snprintf(line, sizeof(line), "Throughput: %.2f MB/s\n\n", bytes / seconds / 1e6);
+    stream << line;
+
+    std::snprintf(line, sizeof(line), "%-10s %10s %8s %8s %9s %10s %10s %10s %10s %10s\n",
+                  "operation", "count", "errors", "error %", "ops/s", "MB/s", "p50 ms", "p90 ms", "p99 ms", "max ms");
+    stream << line;
+
+    for (size_t i = 0; i < operation_count; i++)
+    {
+        const operation_report & operation = report.operations[i];
+
+        if (operation.count == 0)
+        {
+            continue;
+        }
+
+        std::snprintf(line, sizeof(line), "%-10s %10llu %8llu %8.2f %9.1f %10.2f %10.2f %10.2f %10.2f %10.2f\n",
+                      to_string(static_cast<enum operation>(i)),
+                      static_cast<unsigned long long>(operation.count),
+                      static_cast<unsigned long long>(operation.errors),
+                      100.0 * operation.errors / operation.count,
+                      operation.count / seconds,
+                      operation.bytes / seconds / 1e6,
+                      to_milliseconds(operation.p50),
+                      to_milliseconds(operation.p90),
+                      to_milliseconds(operation.p99),
+                      to_milliseconds(operation.max));
+        stream << line;
+    }
+}
+
+load_generator::load_generator(const load_options & options)
+    : options_(options),
+      started_(0)
+{
+    std::filesystem::path directory = std::filesystem::temp_directory_path() /
+                                      ("ftp_load_" + std::to_string(::getpid()));
+
+    std::filesystem::create_directories(directory);
+    local_directory_ = directory.string();
+
+    if (options_.mix[static_cast<size_t>(operation::upload)] > 0)
+    {
+        /* A hole reads as zeros, so the file takes no space. */
+        upload_file_ = (directory / "upload").string();
+        std::ofstream(upload_file_, std::ios_base::binary).close();
+        std::filesystem::resize_file(upload_file_, options_.upload_size);
+    }
+}
+
+load_generator::~load_generator()
+{
+    std::error_code ignored;
+    std::filesystem::remove_all(local_directory_, ignored);
+}
+
+load_report load_generator::run()
+{
+    steady_clock::time_point start = steady_clock::now();
+    deadline_ = start + options_.duration;
+
+    std::vector<std::thread> sessions;
+
+    for (size_t i = 0; i < options_.sessions; i++)
+    {
+        sessions.emplace_back(&load_generator::run_session, this, i);
+    }
+
+    for (std::thread & session : sessions)
+    {
+        session.join();
+    }
+
+    load_report report;
+    report.sessions = options_.sessions;
+    report.elapsed = steady_clock::now() - start;
+
+    for (size_t i = 0; i < operation_count; i++)
+    {
+        const statistics & statistics = statistics_[i];
+        operation_report & operation = report.operations[i];
+
+        operation.count = statistics.latency.count();
+        operation.errors = statistics.errors;
+        operation.bytes = statistics.bytes;
+        operation.p50 = to_microseconds(statistics.latency.value_at(0.5));
+        operation.p90 = to_microseconds(statistics.latency.value_at(0.9));
+        operation.p99 = to_microseconds(statistics.latency.value_at(0.99));
+        operation.max = to_microseconds(statistics.latency.max());
+    }
+
+    return report;
+}
+
+void load_generator::run_session(size_t session)
+{
+    std::seed_seq seed{options_.seed, static_cast<unsigned int>(session)};
+    std::mt19937 random(seed);
+    std::discrete_distribution<size_t> mix(options_.mix.begin(), options_.mix.end());
+
+    ftp::client client;
+    bool connected = false;
+
+    while (next_operation())
+    {
+        auto operation = static_cast<enum operation>(mix(random));
+
+        /* Reconnecting is reported as a login. */
+        if (!connected && operation != operation::login)
+        {
+            steady_clock::time_point start = steady_clock::now();
+            connected = connect(client);
+
+            record(operation::login, steady_clock::now() - start, connected ? optional<uint64_t>(0) : std::nullopt);
+
+            if (!connected)
+            {
+                std::this_thread::sleep_for(reconnect_delay);
+                continue;
+            }
+        }
+
+        steady_clock::time_point start = steady_clock::now();
+        optional<uint64_t> bytes;
+
+        try
+        {
+            bytes = perform(operation, client, session);
+        }
+        catch (const ftp::ftp_exception &)
+        {
+            /* The client has dropped the connection. */
+        }
+
+        record(operation, steady_clock::now() - start, bytes);
+
+        if (operation == operation::login)
+        {
+            connected = bytes.has_value();
+        }
+        else if (!bytes)
+        {
+            try
+            {
+                connected = client.is_open();
+            }
+            catch (const ftp::ftp_exception &)
+            {
+                connected = false;
+            }
+        }
+    }
+
+    try
+    {
+        if (connected)
+        {
+            client.close();
+        }
+    }
+    catch (const ftp::ftp_exception &)
+    {
+    }
+}
+
+bool load_generator::next_operation()
+{
+    if (options_.count)
+    {
+        return started_.fetch_add(1) < *options_.count;
+    }
+
+    return steady_clock::now() < deadline_;
+}
+
+optional<uint64_t> load_generator::perform(operation operation, ftp::client & client, size_t session)
+{
+    switch (operation)
+    {
+        case operation::login:
+        {
+            if (client.is_open())
+            {
+                client.close();
+            }
+
+            return connect(client) ? optional<uint64_t>(0) : std::nullopt;
+        }
+        case operation::list:
+        {
+            return client.ls() ? optional<uint64_t>(0) : std::nullopt;
+        }
+        case operation::upload:
+        {
+            string remote_file = "ftp_load_" + std::to_string(session);
+
+            if (!client.upload(upload_file_, remote_file))
+            {
+                return std::nullopt;
+            }
+
+            return options_.upload_size;
+        }
+        case operation::download:
+        {
+            string local_file = local_directory_ + "/download_" + std::to_string(session);
+
+            std::filesystem::remove(local_file);
+
+            if (!client.download(options_.download_file, local_file))
+            {
+                return std::nullopt;
+            }
+
+            return std::filesystem::file_size(local_file);
+        }
+    }
+
+    return std::nullopt;
+}
+
+bool load_generator::connect(ftp::client & client)
+{
+    try
+    {
+        return client.open(options_.hostname, options_.port) &&
+               client.login(options_.username, options_.password) &&
+               client.binary();
+    }
+    catch (const ftp::ftp_exception &)
+    {
+        return false;
+    }
+}
+
+void load_generator::record(operation operation,
+                            steady_clock::duration latency,
+                            optional<uint64_t> bytes)
+{
+    statistics & statistics = statistics_[static_cast<size_t>(operation)];
+
+    statistics.latency.record(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(latency).count()));
+
+    if (bytes)
+    {
+        statistics.bytes += *bytes;
+    }
+    else
+    {
+        statistics.errors++;
+    }
+}
@@ -0,0 +1,135 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_LOAD_GENERATOR_HPP
+#define FTP_LOAD_GENERATOR_HPP
+
+#include "load_options.hpp"
+#include "ftp/client.hpp"
+#include "ftp/detail/latency_histogram.hpp"
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <ostream>
+#include <string>
+
+/* The result of each kind of operation. */
+struct operation_report
+{
+    operation_report()
+        : count(0),
+          errors(0),
+          bytes(0),
+          p50(0),
+          p90(0),
+          p99(0),
+          max(0)
+    {
+    }
+
+    std::uint64_t count;
+
+    /* Failed operations, also counted in 'count'. */
+    std::uint64_t errors;
+
+    /* Transferred by the operations that succeeded. */
+    std::uint64_t bytes;
+
+    /* Latency percentiles of all operations. */
+    std::chrono::microseconds p50;
+    std::chrono::microseconds p90;
+    std::chrono::microseconds p99;
+    std::chrono::microseconds max;
+};
+
+struct load_report
+{
+    load_report()
+        : sessions(0),
+          elapsed(0)
+    {
+    }
+
+    std::size_t sessions;
+    std::chrono::duration<double> elapsed;
+    std::array<operation_report, operation_count> operations;
+};
+
+void print_report(std::ostream & stream, const load_report & report);
+
+/* Runs the sessions of the load, each on its own thread with its own
+ * ftp::client. A session logs in once, then draws operations from the
+ * mix: login reconnects, list lists the working directory, upload stores
+ * a file of the session and download fetches the download file. A session
+ * that loses its connection logs in again before the next operation.
+ */
+class load_generator
+{
+public:
+    explicit load_generator(const load_options & options);
+
+    load_generator(const load_generator &) = delete;
+
+    load_generator & operator=(const load_generator &) = delete;
+
+    ~load_generator();
+
+    load_report run();
+
+private:
+    struct statistics
+    {
+        statistics()
+            : errors(0),
+              bytes(0)
+        {
+        }
+
+        ftp::detail::latency_histogram latency;
+        std::atomic<std::uint64_t> errors;
+        std::atomic<std::uint64_t> bytes;
+    };
+
+    void run_session(std::size_t session);
+
+    /* Returns false once the load is over. */
+    bool next_operation();
+
+    /* Returns the bytes transferred, or nothing if the operation failed. */
+    std::optional<std::uint64_t> perform(operation operation, ftp::client & client, std::size_t session);
+
+    bool connect(ftp::client & client);
+
+    void record(operation operation, std::chrono::steady_clock::duration latency, std::optional<std::uint64_t> bytes);
+
+    load_options options_;
+    std::string local_directory_;
+    std::string upload_file_;
+    std::chrono::steady_clock::time_point deadline_;
+    std::atomic<std::uint64_t> started_;
+    std::array<statistics, operation_count> statistics_;
+};
+
+#endif //FTP_LOAD_GENERATOR_HPP
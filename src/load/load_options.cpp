@@ -0,0 +1,201 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "load_options.hpp"
+#include "load_exception.hpp"
+#include <boost/lexical_cast/try_lexical_convert.hpp>
+#include <numeric>
+
+using std::string;
+using std::uint64_t;
+
+const char *load_usage =
+    "Usage: ftp_load [option value]... hostname [port]\n"
+    "\n"
+    "  --user name            default anonymous\n"
+    "  --password password\n"
+    "  --sessions n           concurrent sessions, default 4\n"
+    "  --duration seconds     default 10\n"
+    "  --count n              stop after n operations instead\n"
+    "  --mix weights          e.g. login=1,list=2,upload=1,download=4,\n"
+    "                         default login=1,list=1\n"
+    "  --upload-size bytes    default 1048576\n"
+    "  --download-file path   the remote file to download\n"
+    "  --seed n               default 1\n";
+
+const char * to_string(operation operation)
+{
+    switch (operation)
+    {
+        case operation::login:
+            return "login";
+        case operation::list:
+            return "list";
+        case operation::upload:
+            return "upload";
+        case operation::download:
+            return "download";
+    }
+
+    return "unknown";
+}
+
+template<typename T>
+static T parse_number(const string & option, const string & value)
+{
+    T number;
+
+    if (value.empty() || value[0] == '-' || !boost::conversion::try_lexical_convert(value, number))
+    {
+        throw load_exception("Invalid value '%1%' of %2%.", value, option);
+    }
+
+    return number;
+}
+
+static void parse_mix(const string & value, load_options & options)
+{
+    options.mix.fill(0);
+
+    size_t start = 0;
+
+    while (start <= value.size())
+    {
+        size_t end = value.find(',', start);
+
+        if (end == string::npos)
+        {
+            end = value.size();
+        }
+
+        string weight = value.substr(start, end - start);
+        size_t equals = weight.find('=');
+        bool found = false;
+
+        for (size_t i = 0; i < operation_count; i++)
+        {
+            if (equals != string::npos && weight.compare(0, equals, to_string(static_cast<operation>(i))) == 0)
+            {
+                options.mix[i] = parse_number<unsigned int>("--mix", weight.substr(equals + 1));
+                found = true;
+            }
+        }
+
+        if (!found)
+        {
+            throw load_exception("Invalid operation weight '%1%' in --mix.", weight);
+        }
+
+        start = end + 1;
+    }
+
+    if (std::accumulate(options.mix.begin(), options.mix.end(), 0u) == 0)
+    {
+        throw load_exception("The weights of --mix are all zero.");
+    }
+}
+
+load_options parse_load_options(int argc, const char * const argv[])
+{
+    load_options options;
+    int i = 1;
+
+    for (; i < argc && string(argv[i]).compare(0, 2, "--") == 0; i += 2)
+    {
+        string option = argv[i];
+
+        if (i + 1 == argc)
+        {
+            throw load_exception("Missing value of %1%.", option);
+        }
+
+        string value = argv[i + 1];
+
+        if (option == "--user")
+        {
+            options.username = value;
+        }
+        else if (option == "--password")
+        {
+            options.password = value;
+        }
+        else if (option == "--sessions")
+        {
+            options.sessions = parse_number<size_t>(option, value);
+
+            if (options.sessions == 0)
+            {
+                throw load_exception("At least one session is needed.");
+            }
+        }
+        else if (option == "--duration")
+        {
+            options.duration = std::chrono::milliseconds(static_cast<std::chrono::milliseconds::rep>(
+                parse_number<double>(option, value) * 1000));
+        }
+        else if (option == "--count")
+        {
+            options.count = parse_number<uint64_t>(option, value);
+        }
+        else if (option == "--mix")
+        {
+            parse_mix(value, options);
+        }
+        else if (option == "--upload-size")
+        {
+            options.upload_size = parse_number<uint64_t>(option, value);
+        }
+        else if (option == "--download-file")
+        {
+            options.download_file = value;
+        }
+        else if (option == "--seed")
+        {
+            options.seed = parse_number<unsigned int>(option, value);
+        }
+        else
+        {
+            throw load_exception("Unknown option '%1%'.", option);
+        }
+    }
+
+    if (i == argc || argc - i > 2)
+    {
+        throw load_exception("Expected a hostname and optionally a port.");
+    }
+
+    options.hostname = argv[i];
+
+    if (i + 1 < argc)
+    {
+        options.port = parse_number<std::uint16_t>("the port", argv[i + 1]);
+    }
+
+    if (options.mix[static_cast<size_t>(operation::download)] > 0 && options.download_file.empty())
+    {
+        throw load_exception("Downloads need --download-file.");
+    }
+
+    return options;
+}
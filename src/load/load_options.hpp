@@ -0,0 +1,96 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_LOAD_OPTIONS_HPP
+#define FTP_LOAD_OPTIONS_HPP
+
+#include <array>
+#include <chrono>
+#include <optional>
+#include <string>
+#include <cstddef>
+#include <cstdint>
+
+enum class operation
+{
+    login,
+    list,
+    upload,
+    download
+};
+
+static constexpr std::size_t operation_count = 4;
+
+const char * to_string(operation operation);
+
+struct load_options
+{
+    load_options()
+        : port(21),
+          username("anonymous"),
+          sessions(4),
+          duration(std::chrono::seconds(10)),
+          mix{{1, 1, 0, 0}},
+          upload_size(1024 * 1024),
+          seed(1)
+    {
+    }
+
+    std::string hostname;
+    std::uint16_t port;
+    std::string username;
+    std::string password;
+
+    std::size_t sessions;
+
+    /* The load runs for the duration, or until 'count' operations are
+     * done if it's set.
+     */
+    std::chrono::milliseconds duration;
+    std::optional<std::uint64_t> count;
+
+    /* The weight of each operation, indexed by operation. */
+    std::array<unsigned int, operation_count> mix;
+
+    /* The size of the files uploaded. */
+    std::uint64_t upload_size;
+
+    /* The remote file to download, required if downloads are in the mix. */
+    std::string download_file;
+
+    /* The operations of each session are drawn from a generator seeded with
+     * the seed and the number of the session, so runs can be repeated.
+     */
+    unsigned int seed;
+};
+
+/* Usage: ftp_load [option value]... hostname [port]
+ *
+ * Throws load_exception if the arguments are invalid.
+ */
+load_options parse_load_options(int argc, const char * const argv[]);
+
+extern const char *load_usage;
+
+#endif //FTP_LOAD_OPTIONS_HPP
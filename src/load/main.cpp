@@ -0,0 +1,65 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "load_exception.hpp"
+#include "load_generator.hpp"
+#include "load_options.hpp"
+#include <iostream>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::exception;
+
+/* Drives concurrent sessions against an FTP server and reports operations
+ * per second, throughput, latency percentiles and error rates.
+ */
+int main(int argc, char *argv[])
+{
+    load_options options;
+
+    try
+    {
+        options = parse_load_options(argc, argv);
+    }
+    catch (const load_exception & ex)
+    {
+        cerr << ex.what() << endl << endl << load_usage;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        load_generator generator(options);
+
+        print_report(cout, generator.run());
+    }
+    catch (const exception & ex)
+    {
+        cerr << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
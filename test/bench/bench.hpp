@@ -0,0 +1,61 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_BENCH_HPP
+#define FTP_BENCH_HPP
+
+#include <benchmark/benchmark.h>
+#include <string>
+#include <cstdint>
+#include "ftp/client.hpp"
+
+/* Both servers are started by main() before the benchmarks run. */
+inline const std::string ftp_server_dir = "bench_server";
+inline const std::string tls_server_dir = "bench_tls_server";
+inline const std::string local_dir = "bench_local";
+inline const std::string downloads_dir = "bench_downloads";
+inline const std::string cert_file = "../ftp/server/keycert.pem";
+inline const std::uint16_t tls_port = 2123;
+inline const std::uint16_t port = 2127;
+
+/* Creates the files of the TLS benchmarks. */
+void prepare_tls_bench();
+
+/* Opens a binary session with the plain server. Skips the benchmark with an
+ * error and returns false if it fails.
+ */
+inline bool open_session(ftp::client & client, benchmark::State & state)
+{
+    if (!client.open("localhost", port) ||
+        !client.login("user", "password") ||
+        !client.binary())
+    {
+        state.SkipWithError("Cannot start FTP session.");
+        return false;
+    }
+
+    return true;
+}
+
+#endif //FTP_BENCH_HPP
@@ -0,0 +1,78 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <boost/process.hpp>
+#include <filesystem>
+#include "bench.hpp"
+
+using std::to_string;
+
+/* Reports are machine-readable with the options of Google Benchmark, e.g.
+ *
+ *     ftp_bench --benchmark_out=bench.json --benchmark_out_format=json
+ *
+ * and can be diffed across builds with its tools/compare.py.
+ */
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+
+    if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    {
+        return 1;
+    }
+
+    std::filesystem::create_directory(ftp_server_dir);
+    std::filesystem::create_directory(local_dir);
+    prepare_tls_bench();
+
+    boost::filesystem::path pythonPath = boost::process::search_path("python3");
+
+    /* Usage: python server.py port home_directory [certfile] */
+    boost::process::child server(pythonPath,
+                                 "../ftp/server/server.py", to_string(port),
+                                 ftp_server_dir,
+                                 boost::process::std_out > boost::process::null,
+                                 boost::process::std_err > boost::process::null);
+
+    boost::process::child tls_server(pythonPath,
+                                     "../ftp/server/server.py", to_string(tls_port),
+                                     tls_server_dir, cert_file,
+                                     boost::process::std_out > boost::process::null,
+                                     boost::process::std_err > boost::process::null);
+
+    /* Wait for 2s to allow the servers to start. */
+    server.wait_for(std::chrono::seconds(2));
+
+    benchmark::RunSpecifiedBenchmarks();
+
+    server.terminate();
+    tls_server.terminate();
+    std::filesystem::remove_all(ftp_server_dir);
+    std::filesystem::remove_all(tls_server_dir);
+    std::filesystem::remove_all(local_dir);
+    std::filesystem::remove_all(downloads_dir);
+
+    return 0;
+}
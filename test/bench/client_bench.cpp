@@ -0,0 +1,371 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/write.hpp>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <thread>
+#include "bench.hpp"
+#include "ftp/detail/control_connection.hpp"
+#include "test_server.hpp"
+
+using std::string;
+using std::to_string;
+using std::uint64_t;
+
+using boost::asio::ip::tcp;
+
+/* Files of the given size, sparse so that even the largest ones are created
+ * at once. Both sides read them like any other file.
+ */
+static string create_file(const string & directory, uint64_t size)
+{
+    string path = directory + "/file_" + to_string(size);
+
+    if (!std::filesystem::exists(path))
+    {
+        std::ofstream(path, std::ios_base::binary);
+        std::filesystem::resize_file(path, size);
+    }
+
+    return path;
+}
+
+/* 1 KiB to 4 GiB. Filter out the largest sizes with --benchmark_filter if
+ * there is not enough disk space for two copies.
+ */
+static void file_sizes(benchmark::internal::Benchmark *benchmark)
+{
+    benchmark->ArgName("bytes")->Unit(benchmark::kMillisecond)->UseRealTime();
+
+    for (int64_t size = 1024; size <= (int64_t(4) << 30); size *= 16)
+    {
+        benchmark->Arg(size);
+    }
+
+    benchmark->Arg(int64_t(4) << 30);
+}
+
+static void BM_Upload(benchmark::State & state)
+{
+    uint64_t size = state.range(0);
+    string local_file = create_file(local_dir, size);
+    ftp::client client;
+
+    if (!open_session(client, state))
+    {
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        if (!client.upload(local_file, "upload"))
+        {
+            state.SkipWithError("Cannot upload file.");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+
+    client.close();
+}
+
+BENCHMARK(BM_Upload)->Apply(file_sizes);
+
+static void BM_Download(benchmark::State & state)
+{
+    uint64_t size = state.range(0);
+    string remote_file = std::filesystem::path(create_file(ftp_server_dir, size)).filename();
+    string local_file = downloads_dir + "/" + remote_file;
+    ftp::client client;
+
+    std::filesystem::create_directory(downloads_dir);
+
+    if (!open_session(client, state))
+    {
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::filesystem::remove(local_file);
+        state.ResumeTiming();
+
+        if (!client.download(remote_file, local_file))
+        {
+            state.SkipWithError("Cannot download file.");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+
+    std::filesystem::remove(local_file);
+    client.close();
+}
+
+BENCHMARK(BM_Download)->Apply(file_sizes);
+
+/* The same against the in-process server, which doesn't limit the client. */
+static void BM_InProcessUpload(benchmark::State & state)
+{
+    uint64_t size = state.range(0);
+    string local_file = create_file(local_dir, size);
+    ftp::test::server server;
+    ftp::client client;
+
+    server.set_keep_uploads(false);
+
+    if (!client.open("127.0.0.1", server.port()) ||
+        !client.login("user", "password") ||
+        !client.binary())
+    {
+        state.SkipWithError("Cannot start FTP session.");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        if (!client.upload(local_file, "upload"))
+        {
+            state.SkipWithError("Cannot upload file.");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+
+    client.close();
+}
+
+BENCHMARK(BM_InProcessUpload)->Apply(file_sizes);
+
+static void BM_InProcessDownload(benchmark::State & state)
+{
+    uint64_t size = state.range(0);
+    string local_file = downloads_dir + "/in_process";
+    ftp::test::server server;
+    ftp::client client;
+
+    server.add_synthetic_file("file", size);
+    std::filesystem::create_directory(downloads_dir);
+
+    if (!client.open("127.0.0.1", server.port()) ||
+        !client.login("user", "password") ||
+        !client.binary())
+    {
+        state.SkipWithError("Cannot start FTP session.");
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        std::filesystem::remove(local_file);
+        state.ResumeTiming();
+
+        if (!client.download("file", local_file))
+        {
+            state.SkipWithError("Cannot download file.");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * size);
+
+    std::filesystem::remove(local_file);
+    client.close();
+}
+
+BENCHMARK(BM_InProcessDownload)->Apply(file_sizes);
+
+/* A data connection and a transfer command per file, so the round trips
+ * dominate.
+ */
+static void BM_SmallFileUploads(benchmark::State & state)
+{
+    string local_file = create_file(local_dir, 1024);
+    ftp::client client;
+
+    if (!open_session(client, state))
+    {
+        return;
+    }
+
+    uint64_t i = 0;
+
+    for (auto _ : state)
+    {
+        if (!client.upload(local_file, "small_" + to_string(i++ % 100)))
+        {
+            state.SkipWithError("Cannot upload file.");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+
+    client.close();
+}
+
+BENCHMARK(BM_SmallFileUploads)->UseRealTime();
+
+static void BM_List(benchmark::State & state)
+{
+    int64_t entries = state.range(0);
+    string directory = "list_" + to_string(entries);
+    string path = ftp_server_dir + "/" + directory;
+
+    if (!std::filesystem::exists(path))
+    {
+        std::filesystem::create_directory(path);
+
+        for (int64_t i = 0; i < entries; i++)
+        {
+            std::ofstream(path + "/file_" + to_string(i));
+        }
+    }
+
+    ftp::client client;
+
+    if (!open_session(client, state))
+    {
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        if (!client.ls(directory))
+        {
+            state.SkipWithError("Cannot list directory.");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations() * entries);
+
+    client.close();
+}
+
+BENCHMARK(BM_List)
+    ->ArgName("entries")
+    ->Arg(1000)
+    ->Arg(10000)
+    ->Arg(100000)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+/* A command and its reply, nothing else. */
+static void BM_CommandRoundTrip(benchmark::State & state)
+{
+    ftp::client client;
+
+    if (!open_session(client, state))
+    {
+        return;
+    }
+
+    for (auto _ : state)
+    {
+        if (!client.noop())
+        {
+            state.SkipWithError("Cannot send NOOP.");
+            break;
+        }
+    }
+
+    client.close();
+}
+
+BENCHMARK(BM_CommandRoundTrip)->Unit(benchmark::kMicrosecond)->UseRealTime();
+
+/* Receives replies of the given number of lines from a peer that sends them
+ * as fast as they are read, so that reading and parsing is measured rather
+ * than the server.
+ */
+static void BM_ReplyParsing(benchmark::State & state)
+{
+    int64_t lines = state.range(0);
+    string reply;
+
+    if (lines == 1)
+    {
+        reply = "200 Command okay.\r\n";
+    }
+    else
+    {
+        reply = "211-Status of the server:\r\n";
+
+        for (int64_t i = 2; i < lines; i++)
+        {
+            reply += " Connected to 127.0.0.1, logged in as user, TYPE: Binary.\r\n";
+        }
+
+        reply += "211 End of status.\r\n";
+    }
+
+    string replies;
+
+    while (replies.size() < 64 * 1024)
+    {
+        replies += reply;
+    }
+
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+    tcp::socket peer(io_context);
+
+    std::thread sender([&]()
+    {
+        boost::system::error_code ec;
+
+        acceptor.accept(peer, ec);
+
+        /* Until the connection is closed. */
+        while (!ec)
+        {
+            boost::asio::write(peer, boost::asio::buffer(replies), ec);
+        }
+    });
+
+    ftp::detail::control_connection connection;
+
+    connection.open("127.0.0.1", acceptor.local_endpoint().port());
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(connection.recv());
+    }
+
+    state.SetBytesProcessed(state.iterations() * reply.size());
+
+    connection.close();
+    sender.join();
+}
+
+BENCHMARK(BM_ReplyParsing)->ArgName("lines")->Arg(1)->Arg(10)->UseRealTime();
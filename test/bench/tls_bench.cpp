@@ -0,0 +1,108 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include "bench.hpp"
+#include "ftp/detail/tls_session_cache.hpp"
+
+using std::string;
+using std::to_string;
+
+using ftp::detail::tls_session_cache;
+
+static const int small_files = 1000;
+
+/* Downloads 'small_files' files of 1 KiB over one FTPS session, which means
+ * a TLS handshake per file. The first argument enables session resumption.
+ */
+static void BM_TlsSmallFileDownloads(benchmark::State & state)
+{
+    ftp::tls_options options;
+    options.ca_file = cert_file;
+    options.session_resumption = state.range(0) != 0;
+
+    uint64_t hits = tls_session_cache::instance().hits();
+
+    for (auto _ : state)
+    {
+        state.PauseTiming();
+        tls_session_cache::instance().clear();
+        std::filesystem::remove_all(downloads_dir);
+        std::filesystem::create_directory(downloads_dir);
+        state.ResumeTiming();
+
+        ftp::client client;
+
+        client.set_tls_options(options);
+
+        if (!client.open("localhost", tls_port) ||
+            !client.auth_tls() ||
+            !client.login("user", "password") ||
+            !client.binary())
+        {
+            state.SkipWithError("Cannot start FTPS session.");
+            break;
+        }
+
+        for (int i = 0; i < small_files; ++i)
+        {
+            string file = "file_" + to_string(i);
+
+            if (!client.download(file, downloads_dir + "/" + file))
+            {
+                state.SkipWithError("Cannot download file.");
+                break;
+            }
+        }
+
+        client.close();
+    }
+
+    state.counters["files"] = benchmark::Counter(state.iterations() * small_files,
+                                                 benchmark::Counter::kIsRate);
+    state.counters["resumed"] = benchmark::Counter(tls_session_cache::instance().hits() - hits,
+                                                   benchmark::Counter::kAvgIterations);
+}
+
+BENCHMARK(BM_TlsSmallFileDownloads)
+    ->ArgName("resumption")
+    ->Arg(0)
+    ->Arg(1)
+    ->Iterations(3)
+    ->Unit(benchmark::kMillisecond)
+    ->UseRealTime();
+
+void prepare_tls_bench()
+{
+    std::filesystem::create_directory(tls_server_dir);
+
+    for (int i = 0; i < small_files; ++i)
+    {
+        std::ofstream file(tls_server_dir + "/file_" + to_string(i), std::ios_base::binary);
+        file << string(1024, 'x');
+    }
+}
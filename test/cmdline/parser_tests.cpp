@@ -62,6 +62,12 @@ TEST(ParserTest, ParseCommandTest)
     EXPECT_EQ(pair(command::get, vector{"/ public / dir 1 /  file_name  "s, "tmp/dir 2/file"s}),
               parse_command("get \"/ public / dir 1 /  file_name  \" \"tmp/dir 2/file\""));
 
+    EXPECT_EQ(pair(command::reput, vector{"local_file"s, "remote_file"s}),
+              parse_command("reput local_file remote_file"));
+
+    EXPECT_EQ(pair(command::reget, vector{"remote_file"s, "local_file"s}),
+              parse_command("reget remote_file local_file"));
+
     EXPECT_EQ(pair(command::pwd, vector<string>{}),
               parse_command("pwd"));
 
@@ -83,6 +89,9 @@ TEST(ParserTest, ParseCommandTest)
     EXPECT_EQ(pair(command::binary, vector<string>{}),
               parse_command("binary"));
 
+    EXPECT_EQ(pair(command::ascii, vector<string>{}),
+              parse_command("ascii"));
+
     EXPECT_EQ(pair(command::size, vector<string>{"filename"s}),
               parse_command("size filename"));
 
@@ -0,0 +1,140 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <random>
+#include "ftp/detail/ascii_conversion.hpp"
+
+using std::string;
+
+static string to_crlf(const string & data, size_t chunk_size)
+{
+    string result;
+    string buffer(2 * chunk_size, '\0');
+    bool last_cr = false;
+
+    for (size_t pos = 0; pos < data.size(); pos += chunk_size)
+    {
+        string chunk = data.substr(pos, chunk_size);
+
+        std::copy(chunk.begin(), chunk.end(), buffer.begin() + chunk_size);
+        size_t len = ftp::detail::lf_to_crlf(buffer.data(), chunk_size, chunk.size(), last_cr);
+        result.append(buffer.data(), len);
+    }
+
+    return result;
+}
+
+static string to_lf(const string & data, size_t chunk_size)
+{
+    string result;
+    string buffer(chunk_size + 1, '\0');
+    bool cr_pending = false;
+
+    for (size_t pos = 0; pos < data.size(); pos += chunk_size)
+    {
+        string chunk = data.substr(pos, chunk_size);
+        char *begin = buffer.data() + 1;
+
+        std::copy(chunk.begin(), chunk.end(), begin);
+        size_t len = chunk.size();
+
+        if (cr_pending)
+        {
+            *--begin = '\r';
+            ++len;
+        }
+
+        len = ftp::detail::crlf_to_lf(begin, len, cr_pending);
+        result.append(begin, len);
+    }
+
+    if (cr_pending)
+    {
+        result.push_back('\r');
+    }
+
+    return result;
+}
+
+TEST(AsciiConversionTest, LfToCrlfTest)
+{
+    EXPECT_EQ("", to_crlf("", 16));
+    EXPECT_EQ("\r\n", to_crlf("\n", 16));
+    EXPECT_EQ("\r\n\r\n", to_crlf("\n\n", 1));
+    EXPECT_EQ("line 1\r\nline 2\r\n", to_crlf("line 1\nline 2\n", 64));
+    EXPECT_EQ("crlf is kept\r\n\r\n", to_crlf("crlf is kept\r\n\n", 64));
+    EXPECT_EQ("the 16-byte line\r\nand CR\r\n at the chunk end\r\n",
+              to_crlf("the 16-byte line\nand CR\r\n at the chunk end\n", 23));
+}
+
+TEST(AsciiConversionTest, CrlfToLfTest)
+{
+    EXPECT_EQ("", to_lf("", 16));
+    EXPECT_EQ("\n", to_lf("\r\n", 16));
+    EXPECT_EQ("\n", to_lf("\r\n", 1));
+    EXPECT_EQ("line 1\nline 2\n", to_lf("line 1\r\nline 2\r\n", 64));
+    EXPECT_EQ("lone\rcr\r", to_lf("lone\rcr\r", 64));
+    EXPECT_EQ("\r\r\n", to_lf("\r\r\r\n", 3));
+}
+
+TEST(AsciiConversionTest, RandomChunksTest)
+{
+    std::mt19937 generator(42);
+    std::uniform_int_distribution<int> symbol(0, 9);
+    string data;
+
+    for (int i = 0; i < 100000; ++i)
+    {
+        int value = symbol(generator);
+        data.push_back(value == 0 ? '\n' : value == 1 ? '\r' : static_cast<char>('a' + value));
+    }
+
+    string expected_crlf;
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        if (data[i] == '\n' && (i == 0 || data[i - 1] != '\r'))
+        {
+            expected_crlf.push_back('\r');
+        }
+
+        expected_crlf.push_back(data[i]);
+    }
+
+    string expected_lf;
+    for (size_t i = 0; i < data.size(); ++i)
+    {
+        if (!(data[i] == '\r' && i + 1 < data.size() && data[i + 1] == '\n'))
+        {
+            expected_lf.push_back(data[i]);
+        }
+    }
+
+    for (size_t chunk_size : {1, 2, 15, 16, 17, 63, 4096})
+    {
+        EXPECT_EQ(expected_crlf, to_crlf(data, chunk_size)) << "chunk size: " << chunk_size;
+        EXPECT_EQ(expected_lf, to_lf(data, chunk_size)) << "chunk size: " << chunk_size;
+    }
+}
@@ -0,0 +1,190 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include "ftp/auto_tuner.hpp"
+#include "ftp/ftp_exception.hpp"
+
+using ftp::auto_tuner;
+using ftp::tcp_statistics;
+using std::chrono::microseconds;
+using std::chrono::milliseconds;
+using std::chrono::seconds;
+
+static tcp_statistics statistics(milliseconds rtt)
+{
+    tcp_statistics tcp;
+
+    tcp.available = true;
+    tcp.end.elapsed = seconds(1);
+    tcp.end.rtt = rtt;
+    tcp.end.busy_time = seconds(1);
+
+    return tcp;
+}
+
+TEST(AutoTunerTest, SocketBufferTest)
+{
+    auto_tuner tuner;
+
+    tuner.set_autotuning_limit(64 * 1024);
+
+    EXPECT_EQ(0u, tuner.get("host").socket_buffer_size);
+
+    /* 1 MB/s over 10 ms is 10 KB in flight, autotuning gets there. */
+    tuner.record_transfer("near", 1000000, statistics(milliseconds(10)), 1);
+
+    EXPECT_EQ(10000u, tuner.get("near").bandwidth_delay_product);
+    EXPECT_EQ(0u, tuner.get("near").socket_buffer_size);
+
+    /* 10 MB/s over 10 ms is 100 KB in flight. */
+    tuner.record_transfer("host", 10000000, statistics(milliseconds(10)), 1);
+
+    EXPECT_EQ(100000u, tuner.get("host").bandwidth_delay_product);
+    EXPECT_EQ(200000u, tuner.get("host").socket_buffer_size);
+
+    /* Held back by the send buffer for half of the time. */
+    tcp_statistics limited = statistics(milliseconds(10));
+    limited.socket_buffer_size = 200000;
+    limited.end.sndbuf_limited = milliseconds(500);
+
+    tuner.record_transfer("host", 5000000, limited, 1);
+
+    EXPECT_EQ(100000u, tuner.get("host").bandwidth_delay_product);
+    EXPECT_EQ(400000u, tuner.get("host").socket_buffer_size);
+
+    /* The kernel grants less, which is the most to ask for, however
+     * limited the transfer is.
+     */
+    limited.socket_buffer_size = 300000;
+
+    tuner.record_transfer("host", 5000000, limited, 1);
+
+    EXPECT_EQ(300000u, tuner.get("host").socket_buffer_size);
+
+    /* Less than autotuning reaches is worse than no explicit size at all. */
+    limited.socket_buffer_size = 32 * 1024;
+
+    tuner.record_transfer("host", 5000000, limited, 1);
+
+    EXPECT_EQ(0u, tuner.get("host").socket_buffer_size);
+
+    /* Nothing to learn without TCP_INFO. */
+    tuner.record_transfer("other", 10000000, tcp_statistics(), 1);
+
+    EXPECT_EQ(0u, tuner.get("other").bandwidth_delay_product);
+}
+
+TEST(AutoTunerTest, SessionRampTest)
+{
+    auto_tuner tuner(4);
+
+    EXPECT_EQ(1u, tuner.get("host").sessions);
+
+    for (unsigned int i = 0; i < auto_tuner::transfers_per_level; i++)
+    {
+        tuner.record_transfer("host", 10000000, statistics(milliseconds(10)), 1);
+    }
+
+    EXPECT_EQ(2u, tuner.get("host").sessions);
+
+    /* Transfers at another level don't count. */
+    tuner.record_transfer("host", 1000, statistics(milliseconds(10)), 1);
+
+    /* 16 MB/s in total is worth the second session. */
+    for (unsigned int i = 0; i < auto_tuner::transfers_per_level; i++)
+    {
+        tuner.record_transfer("host", 8000000, statistics(milliseconds(10)), 2);
+    }
+
+    EXPECT_EQ(3u, tuner.get("host").sessions);
+
+    /* 16.5 MB/s is not worth the third one. */
+    for (unsigned int i = 0; i < auto_tuner::transfers_per_level; i++)
+    {
+        tuner.record_transfer("host", 5500000, statistics(milliseconds(10)), 3);
+    }
+
+    EXPECT_EQ(2u, tuner.get("host").sessions);
+
+    /* Settled while the throughput stays the same. */
+    for (unsigned int i = 0; i < auto_tuner::transfers_per_level; i++)
+    {
+        tuner.record_transfer("host", 8200000, statistics(milliseconds(10)), 2);
+    }
+
+    EXPECT_EQ(2u, tuner.get("host").sessions);
+
+    /* The path got faster, so more sessions may be worth it now. */
+    for (unsigned int i = 0; i < auto_tuner::transfers_per_level; i++)
+    {
+        tuner.record_transfer("host", 20000000, statistics(milliseconds(10)), 2);
+    }
+
+    EXPECT_EQ(3u, tuner.get("host").sessions);
+}
+
+TEST(AutoTunerTest, SaveLoadTest)
+{
+    const std::string path = "auto_tuner_settings";
+
+    {
+        auto_tuner tuner;
+
+        tuner.set_autotuning_limit(64 * 1024);
+
+        EXPECT_FALSE(tuner.load(path));
+
+        for (unsigned int i = 0; i < auto_tuner::transfers_per_level; i++)
+        {
+            tuner.record_transfer("host", 10000000, statistics(milliseconds(10)), 1);
+        }
+
+        tuner.save(path);
+    }
+
+    auto_tuner tuner;
+
+    EXPECT_TRUE(tuner.load(path));
+    EXPECT_EQ(2u, tuner.get("host").sessions);
+    EXPECT_EQ(200000u, tuner.get("host").socket_buffer_size);
+    EXPECT_EQ(100000u, tuner.get("host").bandwidth_delay_product);
+
+    /* The loaded level is only the start, the ramp goes on from there. */
+    for (unsigned int i = 0; i < auto_tuner::transfers_per_level; i++)
+    {
+        tuner.record_transfer("host", 10000000, statistics(milliseconds(10)), 2);
+    }
+
+    EXPECT_EQ(3u, tuner.get("host").sessions);
+
+    std::ofstream(path) << "host two 0 0\n";
+
+    EXPECT_THROW(tuner.load(path), ftp::ftp_exception);
+
+    std::filesystem::remove(path);
+}
@@ -0,0 +1,123 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <future>
+#include <optional>
+#include "ftp/buffer_pool.hpp"
+
+using ftp::buffer_pool;
+
+class BufferPoolTest : public ::testing::Test
+{
+protected:
+    void TearDown() override
+    {
+        buffer_pool::instance().configure(buffer_pool::default_buffer_size,
+                                          buffer_pool::default_memory_budget);
+    }
+};
+
+TEST_F(BufferPoolTest, AlignmentTest)
+{
+    buffer_pool & pool = buffer_pool::instance();
+
+    pool.configure(10000, 1024 * 1024);
+
+    buffer_pool::buffer buffer = pool.acquire();
+
+    EXPECT_EQ(12288, buffer.size());
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(buffer.data()) % buffer_pool::page_size);
+}
+
+TEST_F(BufferPoolTest, ReuseTest)
+{
+    buffer_pool & pool = buffer_pool::instance();
+
+    pool.configure(4096, 1024 * 1024);
+
+    char *data;
+    {
+        buffer_pool::buffer buffer = pool.acquire();
+        data = buffer.data();
+    }
+
+    buffer_pool::buffer buffer = pool.acquire();
+
+    EXPECT_EQ(data, buffer.data());
+    EXPECT_EQ(4096, pool.allocated());
+}
+
+TEST_F(BufferPoolTest, MemoryBudgetTest)
+{
+    buffer_pool & pool = buffer_pool::instance();
+
+    pool.configure(4096, 8192);
+
+    std::optional<buffer_pool::buffer> first(pool.acquire());
+    buffer_pool::buffer second = pool.acquire();
+
+    std::future<size_t> third = std::async(std::launch::async, [&pool]()
+    {
+        return pool.acquire().size();
+    });
+
+    /* The budget is exhausted, the third transfer has to wait. */
+    EXPECT_EQ(std::future_status::timeout, third.wait_for(std::chrono::milliseconds(100)));
+    EXPECT_EQ(8192, pool.allocated());
+
+    first.reset();
+
+    EXPECT_EQ(4096, third.get());
+    EXPECT_EQ(8192, pool.allocated());
+}
+
+TEST_F(BufferPoolTest, AcquireManyTest)
+{
+    buffer_pool & pool = buffer_pool::instance();
+
+    pool.configure(4096, 3 * 4096);
+
+    std::optional<buffer_pool::buffer> first(pool.acquire());
+
+    std::future<size_t> rest = std::async(std::launch::async, [&pool]()
+    {
+        return pool.acquire(3).size();
+    });
+
+    /* The buffers are taken all at once, not one by one while the first
+     * one is still in use.
+     */
+    EXPECT_EQ(std::future_status::timeout, rest.wait_for(std::chrono::milliseconds(100)));
+    EXPECT_EQ(4096, pool.allocated());
+
+    first.reset();
+
+    EXPECT_EQ(3, rest.get());
+    EXPECT_EQ(3 * 4096, pool.allocated());
+
+    /* More buffers than the budget holds are taken once none is in use. */
+    EXPECT_EQ(4, pool.acquire(4).size());
+}
@@ -0,0 +1,110 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <cstring>
+#include <future>
+#include "ftp/detail/chunk_window.hpp"
+
+using ftp::detail::chunk_window;
+
+TEST(ChunkWindowTest, ReadTest)
+{
+    chunk_window window(2, 1);
+    const char *data;
+    size_t size;
+
+    std::strcpy(window.prepare(), "first");
+    window.commit(6);
+
+    ASSERT_EQ(chunk_window::status::available, window.read(0, 0, data, size));
+    EXPECT_EQ(6u, size);
+    EXPECT_STREQ("first", data);
+
+    /* The reader sends its own copy of the chunk. */
+    EXPECT_EQ(window.reader_buffer(0), data);
+
+    std::strcpy(window.prepare(), "second");
+    window.commit(7);
+    window.close();
+
+    ASSERT_EQ(chunk_window::status::available, window.read(0, 1, data, size));
+    EXPECT_STREQ("second", data);
+
+    EXPECT_EQ(chunk_window::status::end, window.read(0, 2, data, size));
+}
+
+TEST(ChunkWindowTest, EvictionTest)
+{
+    chunk_window window(2, 2);
+    const char *data;
+    size_t size;
+
+    for (uint64_t i = 0; i < 4; i++)
+    {
+        window.prepare();
+        window.commit(window.chunk_size());
+
+        ASSERT_EQ(chunk_window::status::available, window.read(0, i, data, size));
+    }
+
+    /* The second reader hasn't read anything, but the producer keeps pace
+     * with the first one.
+     */
+    EXPECT_EQ(chunk_window::status::evicted, window.read(1, 0, data, size));
+    window.finish(1);
+
+    window.cancel();
+
+    EXPECT_EQ(chunk_window::status::cancelled, window.read(0, 4, data, size));
+    EXPECT_EQ(nullptr, window.prepare());
+}
+
+TEST(ChunkWindowTest, LeaderTest)
+{
+    chunk_window window(2, 1);
+    const char *data;
+    size_t size;
+
+    for (int i = 0; i < 2; i++)
+    {
+        window.prepare();
+        window.commit(window.chunk_size());
+    }
+
+    std::future<char *> next = std::async(std::launch::async, [&window]() { return window.prepare(); });
+
+    /* The only reader hasn't copied the chunk about to be overwritten. */
+    EXPECT_EQ(std::future_status::timeout, next.wait_for(std::chrono::milliseconds(100)));
+
+    ASSERT_EQ(chunk_window::status::available, window.read(0, 0, data, size));
+    EXPECT_NE(nullptr, next.get());
+
+    /* Nobody waits for a finished reader. */
+    window.commit(window.chunk_size());
+    window.finish(0);
+
+    EXPECT_NE(nullptr, window.prepare());
+}
@@ -24,10 +24,19 @@
 
 #include <gtest/gtest.h>
 #include <boost/process.hpp>
+#include <algorithm>
 #include <filesystem>
+#include <fstream>
+#include <future>
 #include <regex>
+#include <sstream>
+#include <thread>
 #include "ftp/client.hpp"
+#include "ftp/flight_recorder.hpp"
 #include "ftp/ftp_exception.hpp"
+#include "ftp/metrics.hpp"
+#include "ftp/tracing.hpp"
+#include "test_server.hpp"
 
 using std::regex;
 using std::string;
@@ -464,6 +473,52 @@ TEST_F(FtpClientTest, BinaryTest)
               observer.get_replies());
 }
 
+TEST_F(FtpClientTest, AsciiTest)
+{
+    TestFtpObserver observer;
+    ftp::client client(&observer);
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.ascii());
+    EXPECT_TRUE(client.close());
+
+    EXPECT_EQ(CRLF("220 FTP server is ready.",
+                   "331 Username ok, send password.",
+                   "230 Login successful.",
+                   "200 Type set to: ASCII.",
+                   "221 Goodbye."),
+              observer.get_replies());
+}
+
+TEST_F(FtpClientTest, AsciiTransferTest)
+{
+    {
+        std::ofstream file("downloads/crlf.txt", std::ios_base::binary);
+        file << "line 1\r\nline 2\r\n";
+    }
+
+    ftp::client client;
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("downloads/crlf.txt", "crlf.txt"));
+
+    /* The server stores files with LF line endings. */
+    EXPECT_TRUE(client.ascii());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+    EXPECT_TRUE(client.download("war_and_peace.txt", "downloads/war_and_peace.txt"));
+    EXPECT_TRUE(client.download("crlf.txt", "downloads/lf.txt"));
+    EXPECT_TRUE(client.close());
+
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "test_server/war_and_peace.txt"));
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "downloads/war_and_peace.txt"));
+
+    std::ifstream file("downloads/lf.txt", std::ios_base::binary);
+    EXPECT_EQ("line 1\nline 2\n", string(std::istreambuf_iterator<char>(file), {}));
+}
+
 TEST_F(FtpClientTest, UploadTest)
 {
     ftp::client client;
@@ -545,6 +600,479 @@ TEST_F(FtpClientTest, DownloadTest)
     EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "downloads/war_and_peace.txt"));
 }
 
+TEST_F(FtpClientTest, FxpTest)
+{
+    const string destination_dir = "fxp_test_server";
+    std::filesystem::create_directory(destination_dir);
+
+    /* The destination server. */
+    boost::process::child destination_server(boost::process::search_path("python3"),
+                                             "../ftp/server/server.py", "2126", destination_dir);
+    destination_server.wait_for(std::chrono::seconds(2));
+
+    ftp::client source;
+    ftp::client destination;
+
+    EXPECT_TRUE(source.open("localhost", 2121));
+    EXPECT_TRUE(source.login("user", "password"));
+    EXPECT_TRUE(source.binary());
+    EXPECT_TRUE(source.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+
+    EXPECT_TRUE(destination.open("localhost", 2126));
+    EXPECT_TRUE(destination.login("user", "password"));
+    EXPECT_TRUE(destination.binary());
+
+    EXPECT_TRUE(source.fxp("war_and_peace.txt", destination, "copy.txt"));
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", destination_dir + "/copy.txt"));
+
+    /* Both sessions stay usable after a failed transfer. */
+    EXPECT_FALSE(source.fxp("nonexistent.txt", destination, "nonexistent.txt"));
+    EXPECT_TRUE(source.pwd());
+    EXPECT_TRUE(destination.pwd());
+
+    EXPECT_THROW(source.fxp("war_and_peace.txt", source, "copy.txt"), ftp_exception);
+
+    EXPECT_TRUE(source.close());
+    EXPECT_TRUE(destination.close());
+
+    destination_server.terminate();
+    std::filesystem::remove_all(destination_dir);
+}
+
+TEST_F(FtpClientTest, CopyTest)
+{
+    ftp::client source;
+    ftp::client destination;
+
+    EXPECT_TRUE(source.open("localhost", 2121));
+    EXPECT_TRUE(source.login("user", "password"));
+    EXPECT_TRUE(source.binary());
+    EXPECT_TRUE(source.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+
+    EXPECT_TRUE(destination.open("localhost", 2121));
+    EXPECT_TRUE(destination.login("user", "password"));
+    EXPECT_TRUE(destination.binary());
+    EXPECT_TRUE(destination.mkdir("copies"));
+
+    EXPECT_TRUE(source.copy("war_and_peace.txt", destination, "copies/war_and_peace.txt"));
+    EXPECT_TRUE(source.download("copies/war_and_peace.txt", "downloads/war_and_peace.txt"));
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "downloads/war_and_peace.txt"));
+
+    /* Both sessions stay usable after a failed copy. */
+    EXPECT_FALSE(source.copy("nonexistent.txt", destination, "copies/nonexistent.txt"));
+    EXPECT_FALSE(source.copy("war_and_peace.txt", destination, "nonexistent/war_and_peace.txt"));
+    EXPECT_TRUE(source.pwd());
+    EXPECT_TRUE(destination.pwd());
+
+    EXPECT_TRUE(source.close());
+    EXPECT_TRUE(destination.close());
+}
+
+TEST_F(FtpClientTest, FanOutUploadTest)
+{
+    ftp::client fast;
+    ftp::client slow;
+    ftp::client failing;
+    ftp::client closed;
+
+    for (ftp::client * client : {&fast, &slow, &failing})
+    {
+        EXPECT_TRUE(client->open("localhost", 2121));
+        EXPECT_TRUE(client->login("user", "password"));
+        EXPECT_TRUE(client->binary());
+    }
+
+    /* Falls behind the window and reads the file by itself. */
+    slow.set_rate_limit(16 * 1024 * 1024);
+
+    std::vector<ftp::client::upload_result> results =
+            ftp::client::upload("../ftp/test_data/war_and_peace.txt",
+                                {{&fast, "fast.txt"},
+                                 {&slow, "slow.txt"},
+                                 {&failing, "nonexistent/failing.txt"},
+                                 {&closed, "closed.txt"}});
+
+    ASSERT_EQ(4u, results.size());
+    EXPECT_TRUE(results[0].succeeded);
+    EXPECT_TRUE(results[1].succeeded);
+    EXPECT_FALSE(results[2].succeeded);
+    EXPECT_TRUE(results[2].error.empty());
+    EXPECT_FALSE(results[3].succeeded);
+    EXPECT_EQ("Connection is not open.", results[3].error);
+
+    EXPECT_TRUE(fast.download("fast.txt", "downloads/fast.txt"));
+    EXPECT_TRUE(fast.download("slow.txt", "downloads/slow.txt"));
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "downloads/fast.txt"));
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "downloads/slow.txt"));
+
+    EXPECT_TRUE(failing.pwd());
+    EXPECT_TRUE(slow.close());
+    EXPECT_TRUE(fast.close());
+}
+
+TEST(FtpClientFanOutTest, SlowTargetTest)
+{
+    const string path = "fan_out.bin";
+    string content(3 * 1024 * 1024, '\0');
+
+    for (size_t i = 0; i < content.size(); i++)
+    {
+        content[i] = static_cast<char>((i * 7919 + i / 4093) % 251);
+    }
+
+    std::ofstream(path, std::ios_base::binary) << content;
+
+    ftp::test::server fast_server;
+    ftp::test::server slow_server;
+    ftp::client fast;
+    ftp::client slow;
+
+    ASSERT_TRUE(fast.open("127.0.0.1", fast_server.port()));
+    ASSERT_TRUE(slow.open("127.0.0.1", slow_server.port()));
+
+    for (ftp::client * client : {&fast, &slow})
+    {
+        ASSERT_TRUE(client->login("user", "password"));
+        ASSERT_TRUE(client->binary());
+    }
+
+    /* About three seconds, far behind the window of a few chunks. */
+    slow.set_rate_limit(1024 * 1024);
+
+    std::future<std::vector<ftp::client::upload_result>> upload = std::async(std::launch::async, [&]()
+    {
+        return ftp::client::upload(path, {{&fast, "file"}, {&slow, "file"}});
+    });
+
+    /* The fast target completes its transfer while the slow one, evicted
+     * from the window, still sends the rest of the file by itself.
+     */
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+
+    while (fast_server.file_size("file") != content.size() && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(content.size(), fast_server.file_size("file"));
+    EXPECT_EQ(std::future_status::timeout, upload.wait_for(std::chrono::seconds(0)));
+
+    std::vector<ftp::client::upload_result> results = upload.get();
+
+    ASSERT_EQ(2u, results.size());
+    EXPECT_TRUE(results[0].succeeded);
+    EXPECT_TRUE(results[1].succeeded);
+    EXPECT_TRUE(fast_server.file("file") == content);
+    EXPECT_TRUE(slow_server.file("file") == content);
+
+    std::filesystem::remove(path);
+}
+
+TEST(FtpClientCopyTest, DestinationFailureTest)
+{
+    ftp::test::server source_server;
+    ftp::test::server destination_server;
+    ftp::client source;
+    ftp::client destination;
+
+    /* Larger than the socket buffers, the source still sends it when the
+     * destination fails.
+     */
+    source_server.add_synthetic_file("file", 64 * 1024 * 1024);
+
+    ASSERT_TRUE(source.open("127.0.0.1", source_server.port()));
+    ASSERT_TRUE(destination.open("127.0.0.1", destination_server.port()));
+
+    for (ftp::client * client : {&source, &destination})
+    {
+        ASSERT_TRUE(client->login("user", "password"));
+        ASSERT_TRUE(client->binary());
+    }
+
+    /* The destination's session is gone once the source has accepted RETR. */
+    destination_server.stop();
+
+    EXPECT_THROW(source.copy("file", destination, "file"), ftp_exception);
+
+    /* The source's transfer was aborted, its replies still match. */
+    EXPECT_EQ(std::optional<std::uint64_t>(64 * 1024 * 1024), source.file_size("file"));
+    EXPECT_TRUE(source.ls());
+    EXPECT_TRUE(source.close());
+}
+
+TEST_F(FtpClientTest, ProgressTest)
+{
+    class ProgressObserver : public ftp::client::event_observer
+    {
+    public:
+        void on_reply(const string & /* reply */) override
+        {
+        }
+
+        void on_progress(const ftp::transfer_progress & progress) override
+        {
+            m_calls++;
+            m_last = progress;
+        }
+
+        int m_calls = 0;
+        ftp::transfer_progress m_last;
+    };
+
+    ProgressObserver observer;
+    ftp::client client(&observer);
+    const uint64_t size = std::filesystem::file_size("../ftp/test_data/war_and_peace.txt");
+
+    client.set_progress_interval(std::chrono::milliseconds(20));
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+
+    EXPECT_GE(observer.m_calls, 1);
+    EXPECT_EQ(size, observer.m_last.bytes);
+    EXPECT_EQ(size, observer.m_last.total);
+
+    /* About 0.4 seconds at 8 MB/s. */
+    observer.m_calls = 0;
+    client.set_rate_limit(8 * 1024 * 1024);
+
+    std::atomic<uint64_t> polled(0);
+    std::thread poller([&]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        polled = client.progress().bytes;
+    });
+
+    EXPECT_TRUE(client.download("war_and_peace.txt", "downloads/war_and_peace.txt"));
+    poller.join();
+
+    EXPECT_GT(observer.m_calls, 5);
+    EXPECT_EQ(size, observer.m_last.bytes);
+    EXPECT_GT(observer.m_last.average_rate, 0);
+    EXPECT_GT(polled, 0u);
+    EXPECT_LT(polled, size);
+    EXPECT_EQ(size, client.progress().bytes);
+
+    /* The clock stops when the transfer completes. */
+    std::chrono::milliseconds elapsed = client.progress().elapsed;
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    EXPECT_EQ(elapsed, client.progress().elapsed);
+    EXPECT_EQ(observer.m_last.elapsed, elapsed);
+
+    EXPECT_TRUE(client.close());
+}
+
+TEST_F(FtpClientTest, MetricsTest)
+{
+    ftp::metrics::instance().reset();
+
+    ftp::client client;
+    const uint64_t size = std::filesystem::file_size("../ftp/test_data/war_and_peace.txt");
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+    EXPECT_TRUE(client.download("war_and_peace.txt", "downloads/war_and_peace.txt"));
+    EXPECT_FALSE(client.download("nonexistent.txt", "downloads/nonexistent.txt"));
+    EXPECT_TRUE(client.close());
+
+    ftp::metrics::snapshot snapshot = ftp::metrics::instance().get();
+
+    EXPECT_EQ(1u, snapshot.commands["STOR"].count);
+    EXPECT_EQ(2u, snapshot.commands["RETR"].count);
+    EXPECT_EQ(3u, snapshot.commands["EPSV"].count);
+    EXPECT_EQ(1u, snapshot.commands["TYPE"].count);
+    EXPECT_GT(snapshot.commands["USER"].p50.count(), 0);
+    EXPECT_EQ(2u, snapshot.data_connections.count);
+    EXPECT_EQ(2u, snapshot.transfers);
+    EXPECT_EQ(0u, snapshot.failed_transfers);
+    EXPECT_EQ(size, snapshot.bytes_sent);
+    EXPECT_EQ(size, snapshot.bytes_received);
+    EXPECT_EQ(1u, snapshot.replies[4]);
+}
+
+TEST_F(FtpClientTest, TracingTest)
+{
+    class MemoryExporter : public ftp::trace_exporter
+    {
+    public:
+        void export_span(const ftp::trace_span & span) override
+        {
+            m_spans.push_back(span);
+        }
+
+        std::vector<ftp::trace_span> m_spans;
+    };
+
+    auto exporter = std::make_shared<MemoryExporter>();
+    ftp::client client;
+
+    client.set_trace_exporter(exporter);
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+    EXPECT_TRUE(client.download("war_and_peace.txt", "downloads/war_and_peace.txt"));
+    EXPECT_FALSE(client.download("nonexistent.txt", "downloads/nonexistent.txt"));
+
+    client.set_trace_exporter(nullptr);
+
+    EXPECT_TRUE(client.ls());
+    EXPECT_TRUE(client.close());
+
+    /* binary() and ls() are not traced. */
+    ASSERT_EQ(5u, exporter->m_spans.size());
+
+    auto phases = [](const ftp::trace_span & span)
+    {
+        std::vector<string> names;
+
+        for (const ftp::trace_phase & phase : span.phases)
+        {
+            names.push_back(phase.name);
+        }
+
+        return names;
+    };
+
+    const ftp::trace_span & open = exporter->m_spans[0];
+
+    EXPECT_EQ("open", open.operation);
+    EXPECT_EQ("localhost", open.target);
+    EXPECT_TRUE(open.succeeded);
+    EXPECT_EQ((std::vector<string>{ "resolve", "connect", "greeting" }), phases(open));
+
+    const ftp::trace_span & download = exporter->m_spans[3];
+
+    EXPECT_EQ("download", download.operation);
+    EXPECT_EQ("war_and_peace.txt", download.target);
+    EXPECT_TRUE(download.succeeded);
+    EXPECT_EQ((std::vector<string>{ "EPSV", "data_connect", "RETR", "first_byte", "transfer", "final_reply" }),
+              phases(download));
+
+    std::chrono::nanoseconds total(0);
+
+    for (const ftp::trace_phase & phase : download.phases)
+    {
+        EXPECT_EQ(total, phase.start);
+        total += phase.duration;
+    }
+
+    EXPECT_LE(total, download.duration);
+
+#ifdef __linux__
+    ASSERT_TRUE(download.tcp);
+    EXPECT_GT(download.tcp->mss, 0u);
+#endif
+
+    const ftp::trace_span & failed = exporter->m_spans[4];
+
+    EXPECT_FALSE(failed.succeeded);
+    EXPECT_TRUE(failed.error.empty());
+}
+
+TEST_F(FtpClientTest, FlightRecordTest)
+{
+    ftp::client client;
+
+    client.set_flight_record_directory(string("downloads"));
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_FALSE(client.download("nonexistent.txt", "downloads/nonexistent.txt"));
+    EXPECT_TRUE(client.close());
+
+    std::vector<ftp::flight_event> events = client.flight_record().events();
+
+    ASSERT_GE(events.size(), 6u);
+    EXPECT_EQ(ftp::flight_event::kind::connect, events[0].type);
+    EXPECT_EQ("localhost", events[0].text);
+    EXPECT_EQ(220, events[1].code);
+    EXPECT_EQ("USER user", events[2].text);
+    EXPECT_EQ("PASS", events[4].text);
+    EXPECT_EQ("QUIT", events[events.size() - 2].text);
+
+    /* Nothing is dumped unless the connection fails. */
+    auto dumps = [&]()
+    {
+        size_t count = 0;
+
+        for (const auto & entry : std::filesystem::directory_iterator("downloads"))
+        {
+            count += entry.path().extension() == ".flight";
+        }
+
+        return count;
+    };
+
+    EXPECT_EQ(0u, dumps());
+
+    /* No server listens on this port. */
+    EXPECT_THROW(client.open("localhost", 2120), ftp_exception);
+    EXPECT_EQ(1u, dumps());
+    EXPECT_EQ(ftp::flight_event::kind::reset, client.flight_record().events().back().type);
+}
+
+TEST_F(FtpClientTest, TcpStatisticsTest)
+{
+    ftp::client client;
+
+    EXPECT_FALSE(client.last_tcp_statistics().available);
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+
+    /* About 1.6 seconds at 2 MB/s, so that there is a periodic sample. */
+    client.set_rate_limit(2 * 1024 * 1024);
+
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+
+    const ftp::tcp_statistics & statistics = client.last_tcp_statistics();
+
+#ifdef __linux__
+    ASSERT_TRUE(statistics.available);
+    EXPECT_GT(statistics.start.mss, 0u);
+    EXPECT_GE(statistics.samples.size(), 1u);
+    EXPECT_GT(statistics.end.congestion_window, 0u);
+    EXPECT_GT(statistics.end.rtt.count(), 0);
+    EXPECT_GE(statistics.end.elapsed, statistics.samples.back().elapsed);
+    EXPECT_GE(statistics.samples.front().elapsed, std::chrono::seconds(1));
+#else
+    EXPECT_FALSE(statistics.available);
+#endif
+
+    EXPECT_TRUE(client.close());
+}
+
+TEST_F(FtpClientTest, RateLimitTest)
+{
+    ftp::client client;
+
+    /* war_and_peace.txt takes about 0.4 seconds at 8 MB/s. */
+    client.set_rate_limit(8 * 1024 * 1024);
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    EXPECT_TRUE(client.download("war_and_peace.txt", "downloads/war_and_peace.txt"));
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(300));
+
+    client.set_rate_limit(ftp::rate_limiter::unlimited);
+
+    EXPECT_TRUE(client.close());
+
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "downloads/war_and_peace.txt"));
+}
+
 TEST_F(FtpClientTest, DownloadNonexistentFileTest)
 {
     TestFtpObserver observer;
@@ -592,6 +1120,189 @@ TEST_F(FtpClientTest, DownloadFileAlreadyExistsTest)
     EXPECT_TRUE(client.close());
 }
 
+TEST_F(FtpClientTest, SparseDownloadTest)
+{
+    {
+        std::ofstream file("downloads/sparse", std::ios_base::binary);
+        string zeros(1024 * 1024, '\0');
+
+        file << "head" << zeros << "middle" << zeros << zeros;
+    }
+
+    ftp::client client;
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("downloads/sparse", "sparse"));
+    client.set_sparse_download(true);
+    EXPECT_TRUE(client.download("sparse", "downloads/sparse_copy"));
+    EXPECT_TRUE(client.close());
+
+    EXPECT_TRUE(compareFiles("downloads/sparse", "downloads/sparse_copy"));
+}
+
+TEST_F(FtpClientTest, ResumeDownloadTest)
+{
+    {
+        std::ifstream src("../ftp/test_data/war_and_peace.txt", std::ios_base::binary);
+        std::ofstream dst("downloads/war_and_peace.txt", std::ios_base::binary);
+        string head(1000000, '\0');
+
+        src.read(head.data(), head.size());
+        dst.write(head.data(), src.gcount());
+    }
+
+    TestFtpObserver observer;
+    ftp::client client(&observer);
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+    EXPECT_TRUE(client.resume_download("war_and_peace.txt", "downloads/war_and_peace.txt"));
+    EXPECT_TRUE(client.close());
+
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "downloads/war_and_peace.txt"));
+    EXPECT_NE(string::npos, observer.get_replies().find("350 Restarting at position 1000000."));
+}
+
+TEST_F(FtpClientTest, ResumeUploadTest)
+{
+    {
+        std::ifstream src("../ftp/test_data/war_and_peace.txt", std::ios_base::binary);
+        std::ofstream dst("downloads/war_and_peace_head.txt", std::ios_base::binary);
+        string head(1000000, '\0');
+
+        src.read(head.data(), head.size());
+        dst.write(head.data(), src.gcount());
+    }
+
+    ftp::client client;
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("downloads/war_and_peace_head.txt", "war_and_peace.txt"));
+    EXPECT_TRUE(client.resume_upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+    EXPECT_TRUE(client.resume_upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+    EXPECT_TRUE(client.resume_upload("../ftp/test_data/war_and_peace.txt", "new_war_and_peace.txt"));
+    EXPECT_TRUE(client.close());
+
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "test_server/war_and_peace.txt"));
+    EXPECT_TRUE(compareFiles("../ftp/test_data/war_and_peace.txt", "test_server/new_war_and_peace.txt"));
+}
+
+TEST_F(FtpClientTest, AbortTest)
+{
+    /* Cancel the download as soon as the server starts it. */
+    class AbortingObserver : public ftp::client::event_observer
+    {
+    public:
+        explicit AbortingObserver(ftp::client & client)
+            : m_client(client)
+        {
+        }
+
+        void on_reply(const string & reply) override
+        {
+            /* 125 or 150, depending on whether the data connection is
+             * already open.
+             */
+            if (reply.rfind("125 ", 0) == 0 || reply.rfind("150 ", 0) == 0)
+            {
+                m_client.abort();
+            }
+        }
+
+    private:
+        ftp::client & m_client;
+    };
+
+    ftp::client client;
+    AbortingObserver observer(client);
+    TestFtpObserver replies;
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+
+    client.subscribe(&observer);
+    client.subscribe(&replies);
+
+    EXPECT_FALSE(client.download("war_and_peace.txt", "downloads/war_and_peace.txt"));
+
+    client.unsubscribe(&observer);
+
+    /* The session is still usable. */
+    EXPECT_TRUE(client.pwd());
+    EXPECT_TRUE(client.close());
+
+    EXPECT_NE(string::npos, replies.get_replies().find("200 I successfully done nothin'."));
+    EXPECT_NE(string::npos, replies.get_replies().find("257 \"/\" is the current directory."));
+}
+
+TEST_F(FtpClientTest, TransferTimeoutTest)
+{
+    ftp::client client;
+    bool catched = false;
+
+    EXPECT_TRUE(client.open("localhost", 2121));
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+
+    ftp::timeouts timeouts;
+    timeouts.transfer = std::chrono::milliseconds(1);
+    client.set_timeouts(timeouts);
+
+    try
+    {
+        client.download("war_and_peace.txt", "downloads/war_and_peace.txt");
+    }
+    catch (const ftp_exception & ex)
+    {
+        catched = true;
+        EXPECT_NE(string::npos, string(ex.what()).find("Connection timed out"));
+    }
+
+    EXPECT_TRUE(catched);
+
+    /* The transfer is aborted, but the session is still usable. */
+    EXPECT_TRUE(client.is_open());
+    EXPECT_TRUE(client.noop());
+    EXPECT_TRUE(client.close());
+}
+
+TEST_F(FtpClientTest, ReplyTimeoutTest)
+{
+    /* Accepts connections, but never replies. */
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::acceptor acceptor(io_context,
+            boost::asio::ip::tcp::endpoint(boost::asio::ip::make_address("127.0.0.1"), 2124));
+
+    ftp::client client;
+    bool catched = false;
+
+    client.set_timeouts(ftp::timeouts(std::chrono::seconds(1),
+                                      std::chrono::milliseconds(200),
+                                      std::chrono::seconds(1)));
+
+    try
+    {
+        client.open("127.0.0.1", 2124);
+    }
+    catch (const ftp_exception & ex)
+    {
+        catched = true;
+        EXPECT_STREQ("Cannot receive reply: Connection timed out", ex.what());
+    }
+
+    EXPECT_TRUE(catched);
+    EXPECT_FALSE(client.is_open());
+}
+
 TEST_F(FtpClientTest, StatTest)
 {
     ftp::client client;
@@ -653,3 +1364,158 @@ TEST_F(FtpClientTest, SystemTest)
                    "221 Goodbye."),
               observer.get_replies());
 }
+
+/* Retries against the in-process server, which can drop a session in the
+ * middle of a transfer.
+ */
+class FtpClientRetryTest : public ::testing::Test
+{
+protected:
+    class CountingObserver : public ftp::client::event_observer
+    {
+    public:
+        void on_reply(const string & reply) override
+        {
+            m_replies.push_back(reply.substr(0, reply.find("\r\n")));
+        }
+
+        size_t count(const string & reply) const
+        {
+            return std::count(m_replies.begin(), m_replies.end(), reply);
+        }
+
+    private:
+        std::vector<string> m_replies;
+    };
+
+    void SetUp() override
+    {
+        std::filesystem::create_directory(m_localDir);
+
+        /* Not a repeated pattern, so that a misplaced block shows. */
+        m_content.resize(3 * 1024 * 1024);
+
+        for (size_t i = 0; i < m_content.size(); i++)
+        {
+            m_content[i] = static_cast<char>((i * 7919 + i / 4093) % 251);
+        }
+
+        ASSERT_TRUE(m_client.open("127.0.0.1", m_server.port()));
+        ASSERT_TRUE(m_client.login("user", "password"));
+        ASSERT_TRUE(m_client.binary());
+        ASSERT_TRUE(m_client.cd("dir"));
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_localDir);
+    }
+
+    static string readFile(const string & path)
+    {
+        std::ifstream file(path, std::ios_base::binary);
+        std::ostringstream content;
+        content << file.rdbuf();
+
+        return content.str();
+    }
+
+    const string m_localDir = "retry_local";
+    string m_content;
+    ftp::test::server m_server;
+    CountingObserver m_observer;
+    ftp::client m_client{&m_observer};
+};
+
+TEST_F(FtpClientRetryTest, ResumeDownloadTest)
+{
+    m_server.add_file("dir/file", m_content);
+    m_server.fail_transfers(1024 * 1024 + 17, 2);
+    m_client.set_retry_policy(ftp::retry_policy(3, std::chrono::milliseconds(100)));
+
+    auto start = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(m_client.resume_download("file", m_localDir + "/file"));
+
+    /* Waits 100 ms, then 200 ms. */
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(300));
+    EXPECT_EQ(m_content, readFile(m_localDir + "/file"));
+
+    /* Each reconnection logs in and restores the type and the directory. */
+    EXPECT_EQ(3u, m_server.session_count());
+    EXPECT_EQ(3u, m_observer.count("230 Login successful."));
+    EXPECT_EQ(3u, m_observer.count("200 Type set to I."));
+    EXPECT_EQ(3u, m_observer.count("250 Directory changed to /dir."));
+    EXPECT_TRUE(m_client.close());
+}
+
+TEST_F(FtpClientRetryTest, ResumeUploadTest)
+{
+    {
+        std::ofstream file(m_localDir + "/file", std::ios_base::binary);
+        file << m_content;
+    }
+
+    m_server.fail_transfers(1024 * 1024 + 17, 2);
+    m_client.set_retry_policy(ftp::retry_policy(3, std::chrono::milliseconds(10)));
+
+    EXPECT_TRUE(m_client.resume_upload(m_localDir + "/file", "file"));
+    EXPECT_EQ(m_content, m_server.file("dir/file"));
+    EXPECT_EQ(3u, m_server.session_count());
+    EXPECT_TRUE(m_client.close());
+}
+
+TEST_F(FtpClientRetryTest, TimeoutTest)
+{
+    m_server.add_file("dir/file", m_content);
+    m_server.fail_transfers(1024 * 1024, 2, ftp::test::server::failure::stall);
+    m_client.set_timeouts(ftp::timeouts(std::chrono::seconds(5), std::chrono::seconds(5),
+                                        std::chrono::milliseconds(200)));
+    m_client.set_retry_policy(ftp::retry_policy(3, std::chrono::milliseconds(10)));
+
+    EXPECT_TRUE(m_client.resume_download("file", m_localDir + "/file"));
+    EXPECT_EQ(m_content, readFile(m_localDir + "/file"));
+
+    /* The timed out transfers are aborted, the session is kept. */
+    EXPECT_EQ(1u, m_server.session_count());
+    EXPECT_EQ(2u, m_observer.count("426 Connection closed; transfer aborted."));
+    EXPECT_TRUE(m_client.close());
+}
+
+TEST_F(FtpClientRetryTest, AttemptsExhaustedTest)
+{
+    m_server.add_file("dir/file", m_content);
+    m_server.fail_transfers(1024 * 1024, 2);
+    m_client.set_retry_policy(ftp::retry_policy(2, std::chrono::milliseconds(10)));
+
+    EXPECT_THROW(m_client.resume_download("file", m_localDir + "/file"), ftp_exception);
+    EXPECT_EQ(2u * 1024 * 1024, std::filesystem::file_size(m_localDir + "/file"));
+
+    /* The next attempt picks up where the last one stopped. */
+    ASSERT_TRUE(m_client.open("127.0.0.1", m_server.port()));
+    ASSERT_TRUE(m_client.login("user", "password"));
+    ASSERT_TRUE(m_client.binary());
+    ASSERT_TRUE(m_client.cd("dir"));
+    EXPECT_TRUE(m_client.resume_download("file", m_localDir + "/file"));
+    EXPECT_EQ(m_content, readFile(m_localDir + "/file"));
+}
+
+TEST_F(FtpClientRetryTest, AsciiResumeTest)
+{
+    m_server.add_file("dir/file", "line 1\r\nline 2\r\n");
+
+    {
+        std::ofstream file(m_localDir + "/file", std::ios_base::binary);
+        file << "line 1\n";
+    }
+
+    ASSERT_TRUE(m_client.ascii());
+
+    EXPECT_THROW(m_client.resume_download("file", m_localDir + "/file"), ftp_exception);
+    EXPECT_THROW(m_client.resume_upload(m_localDir + "/file", "file"), ftp_exception);
+
+    /* Nothing is transferred. */
+    EXPECT_EQ("line 1\n", readFile(m_localDir + "/file"));
+    EXPECT_EQ("line 1\r\nline 2\r\n", m_server.file("dir/file"));
+    EXPECT_TRUE(m_client.is_open());
+}
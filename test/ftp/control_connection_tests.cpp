@@ -0,0 +1,110 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <vector>
+#include "ftp/detail/connection_exception.hpp"
+#include "ftp/detail/control_connection.hpp"
+#include "test_server.hpp"
+
+using ftp::detail::control_connection;
+using ftp::detail::interleave_address_families;
+using boost::asio::ip::make_address;
+using boost::asio::ip::tcp;
+using std::vector;
+
+static tcp::endpoint endpoint(const char *address)
+{
+    return tcp::endpoint(make_address(address), 21);
+}
+
+/* A port on which nothing listens. */
+static std::uint16_t closed_port()
+{
+    boost::asio::io_context io_context;
+    tcp::acceptor acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+
+    return acceptor.local_endpoint().port();
+}
+
+TEST(InterleaveAddressFamiliesTest, MixedTest)
+{
+    vector<tcp::endpoint> addresses = {endpoint("2001:db8::1"), endpoint("2001:db8::2"),
+                                       endpoint("2001:db8::3"), endpoint("192.0.2.1"),
+                                       endpoint("192.0.2.2")};
+
+    vector<tcp::endpoint> expected = {endpoint("2001:db8::1"), endpoint("192.0.2.1"),
+                                      endpoint("2001:db8::2"), endpoint("192.0.2.2"),
+                                      endpoint("2001:db8::3")};
+
+    EXPECT_EQ(expected, interleave_address_families(addresses));
+}
+
+TEST(InterleaveAddressFamiliesTest, IPv4FirstTest)
+{
+    vector<tcp::endpoint> addresses = {endpoint("192.0.2.1"), endpoint("2001:db8::1"),
+                                       endpoint("192.0.2.2"), endpoint("192.0.2.3")};
+
+    vector<tcp::endpoint> expected = {endpoint("192.0.2.1"), endpoint("2001:db8::1"),
+                                      endpoint("192.0.2.2"), endpoint("192.0.2.3")};
+
+    EXPECT_EQ(expected, interleave_address_families(addresses));
+}
+
+TEST(InterleaveAddressFamiliesTest, SingleFamilyTest)
+{
+    vector<tcp::endpoint> v4 = {endpoint("192.0.2.1"), endpoint("192.0.2.2"), endpoint("192.0.2.3")};
+    vector<tcp::endpoint> v6 = {endpoint("2001:db8::1"), endpoint("2001:db8::2")};
+
+    EXPECT_EQ(v4, interleave_address_families(v4));
+    EXPECT_EQ(v6, interleave_address_families(v6));
+}
+
+TEST(InterleaveAddressFamiliesTest, EmptyTest)
+{
+    EXPECT_TRUE(interleave_address_families({}).empty());
+}
+
+TEST(ControlConnectionTest, FallbackTest)
+{
+    ftp::test::server server;
+    tcp::endpoint refused(boost::asio::ip::address_v4::loopback(), closed_port());
+    tcp::endpoint listening(boost::asio::ip::address_v4::loopback(), server.port());
+    control_connection connection;
+
+    connection.open({refused, listening});
+
+    ASSERT_TRUE(connection.is_open());
+    EXPECT_EQ(220, connection.recv().status_code);
+}
+
+TEST(ControlConnectionTest, AllRefusedTest)
+{
+    tcp::endpoint refused(boost::asio::ip::address_v4::loopback(), closed_port());
+    control_connection connection;
+
+    EXPECT_THROW(connection.open({refused, refused}), ftp::detail::connection_exception);
+    EXPECT_THROW(connection.open(vector<tcp::endpoint>()), ftp::detail::connection_exception);
+    EXPECT_FALSE(connection.is_open());
+}
@@ -0,0 +1,122 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include "ftp/flight_recorder.hpp"
+#include "ftp/ftp_exception.hpp"
+
+using ftp::flight_event;
+using ftp::flight_recorder;
+using std::string;
+using std::vector;
+
+TEST(FlightRecorderTest, WrapAroundTest)
+{
+    flight_recorder recorder(4);
+
+    for (uint16_t code = 1; code <= 6; code++)
+    {
+        recorder.record_reply(code);
+    }
+
+    vector<flight_event> events = recorder.events();
+
+    ASSERT_EQ(4u, events.size());
+    EXPECT_EQ(3, events[0].code);
+    EXPECT_EQ(6, events[3].code);
+    EXPECT_LE(events[0].time, events[3].time);
+
+    recorder.clear();
+
+    EXPECT_TRUE(recorder.events().empty());
+}
+
+TEST(FlightRecorderTest, RedactionTest)
+{
+    flight_recorder recorder;
+
+    recorder.record_command("USER user");
+    recorder.record_command("PASS secret");
+    recorder.record_command("ACCT secret");
+    recorder.record_command("RETR " + string(100, 'a'));
+
+    vector<flight_event> events = recorder.events();
+
+    ASSERT_EQ(4u, events.size());
+    EXPECT_EQ("USER user", events[0].text);
+    EXPECT_EQ("PASS", events[1].text);
+    EXPECT_EQ("ACCT", events[2].text);
+    EXPECT_EQ("RETR " + string(39, 'a'), events[3].text);
+}
+
+TEST(FlightRecorderTest, DumpLoadTest)
+{
+    flight_recorder recorder;
+
+    recorder.record_connect("localhost", 2121);
+    recorder.record_command("RETR file.txt");
+    recorder.record_reply(150);
+    recorder.record_transfer(1024, false);
+    recorder.record_reset();
+
+    std::stringstream dump;
+    recorder.dump(dump);
+
+    vector<flight_event> events = flight_recorder::load(dump);
+
+    ASSERT_EQ(5u, events.size());
+    EXPECT_EQ(flight_event::kind::connect, events[0].type);
+    EXPECT_EQ("localhost", events[0].text);
+    EXPECT_EQ(2121u, events[0].bytes);
+    EXPECT_EQ(flight_event::kind::transfer, events[3].type);
+    EXPECT_EQ(1024u, events[3].bytes);
+    EXPECT_EQ(recorder.events()[4].time, events[4].time);
+
+    string line = flight_recorder::to_string(events[1]);
+
+    EXPECT_EQ(" > RETR file.txt", line.substr(26));
+    EXPECT_EQ(" transfer 1024 bytes, aborted", flight_recorder::to_string(events[3]).substr(26));
+}
+
+TEST(FlightRecorderTest, LoadMalformedTest)
+{
+    std::stringstream garbage("not a flight record");
+
+    EXPECT_THROW(flight_recorder::load(garbage), ftp::ftp_exception);
+
+    flight_recorder recorder;
+    recorder.record_reply(200);
+
+    std::stringstream dump;
+    recorder.dump(dump);
+
+    string truncated = dump.str();
+    truncated.resize(truncated.size() - 1);
+
+    std::stringstream truncated_dump(truncated);
+
+    EXPECT_THROW(flight_recorder::load(truncated_dump), ftp::ftp_exception);
+}
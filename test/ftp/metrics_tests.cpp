@@ -0,0 +1,127 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include "ftp/metrics.hpp"
+
+using ftp::metrics;
+using ftp::detail::latency_histogram;
+using std::chrono::nanoseconds;
+using std::chrono::microseconds;
+
+TEST(LatencyHistogramTest, QuantileTest)
+{
+    latency_histogram histogram;
+
+    for (uint64_t value = 1; value <= 100000; value++)
+    {
+        histogram.record(value);
+    }
+
+    EXPECT_EQ(100000u, histogram.count());
+    EXPECT_EQ(100000u, histogram.max());
+    EXPECT_EQ(uint64_t(100000) * 100001 / 2, histogram.sum());
+
+    /* Each value is known within 1/16 of itself. */
+    EXPECT_NEAR(50000.0, histogram.value_at(0.5), 50000.0 / 16);
+    EXPECT_NEAR(99000.0, histogram.value_at(0.99), 99000.0 / 16);
+    EXPECT_EQ(100000u, histogram.value_at(1.0));
+    EXPECT_EQ(1u, histogram.value_at(0.0));
+
+    histogram.reset();
+
+    EXPECT_EQ(0u, histogram.count());
+    EXPECT_EQ(0u, histogram.value_at(0.5));
+}
+
+TEST(LatencyHistogramTest, LargeValueTest)
+{
+    latency_histogram histogram;
+
+    histogram.record(UINT64_MAX);
+    histogram.record(0);
+
+    EXPECT_EQ(UINT64_MAX, histogram.value_at(1.0));
+    EXPECT_EQ(0u, histogram.value_at(0.5));
+}
+
+class MetricsTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        metrics::instance().reset();
+    }
+};
+
+TEST_F(MetricsTest, RecordTest)
+{
+    metrics & metrics = metrics::instance();
+
+    metrics.record_command("RETR file.txt", microseconds(100));
+    metrics.record_command("RETR other.txt", microseconds(300));
+    metrics.record_command("XCRC file.txt", microseconds(1));
+    metrics.record_reply(226);
+    metrics.record_reply(550);
+    metrics.record_transfer(microseconds(10), true);
+    metrics.record_transfer(microseconds(20), false);
+    metrics.add_bytes_sent(10);
+    metrics.add_bytes_received(20);
+
+    metrics::snapshot snapshot = metrics.get();
+
+    ASSERT_EQ(2u, snapshot.commands.size());
+    EXPECT_EQ(2u, snapshot.commands["RETR"].count);
+    EXPECT_EQ(microseconds(400), snapshot.commands["RETR"].sum);
+    EXPECT_EQ(1u, snapshot.commands["OTHER"].count);
+    EXPECT_EQ(1u, snapshot.replies[1]);
+    EXPECT_EQ(1u, snapshot.replies[4]);
+    EXPECT_EQ(2u, snapshot.transfers);
+    EXPECT_EQ(1u, snapshot.failed_transfers);
+    EXPECT_EQ(10u, snapshot.bytes_sent);
+    EXPECT_EQ(20u, snapshot.bytes_received);
+}
+
+TEST_F(MetricsTest, FormatTest)
+{
+    metrics & metrics = metrics::instance();
+
+    metrics.record_command("STOR file.txt", microseconds(500));
+    metrics.record_reply(150);
+
+    std::string prometheus = metrics.prometheus();
+
+    EXPECT_NE(std::string::npos, prometheus.find("# TYPE ftp_command_duration_seconds summary\n"));
+    EXPECT_NE(std::string::npos, prometheus.find("ftp_command_duration_seconds_count{verb=\"STOR\"} 1\n"));
+    EXPECT_NE(std::string::npos, prometheus.find("ftp_replies_total{class=\"1xx\"} 1\n"));
+    EXPECT_NE(std::string::npos, prometheus.find("ftp_transfers_total{result=\"failed\"} 0\n"));
+
+    std::string json = metrics.json();
+
+    EXPECT_EQ('{', json.front());
+    EXPECT_EQ('}', json.back());
+    EXPECT_NE(std::string::npos, json.find("\"STOR\":{\"count\":1,\"sum_ns\":500000,"));
+    EXPECT_NE(std::string::npos, json.find("\"replies\":{\"1xx\":1,\"2xx\":0,"));
+}
@@ -0,0 +1,158 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "ftp/rate_limiter.hpp"
+
+using ftp::rate_limiter;
+using std::make_shared;
+using std::shared_ptr;
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+
+static milliseconds acquire_chunks(rate_limiter & limiter, int count, size_t size)
+{
+    steady_clock::time_point start = steady_clock::now();
+
+    for (int i = 0; i < count; i++)
+    {
+        limiter.acquire(size);
+    }
+
+    return duration_cast<milliseconds>(steady_clock::now() - start);
+}
+
+TEST(RateLimiterTest, UnlimitedTest)
+{
+    rate_limiter limiter;
+
+    EXPECT_EQ(rate_limiter::unlimited, limiter.rate());
+    EXPECT_LT(acquire_chunks(limiter, 1000, 1024 * 1024), milliseconds(100));
+}
+
+TEST(RateLimiterTest, RateTest)
+{
+    rate_limiter limiter(1000000);
+
+    milliseconds elapsed = acquire_chunks(limiter, 10, 50000);
+
+    EXPECT_GE(elapsed, milliseconds(400));
+    EXPECT_LT(elapsed, milliseconds(1500));
+}
+
+TEST(RateLimiterTest, ParentTest)
+{
+    shared_ptr<rate_limiter> parent = make_shared<rate_limiter>(1000000);
+    rate_limiter child(rate_limiter::unlimited, parent);
+
+    milliseconds elapsed = acquire_chunks(child, 10, 50000);
+
+    EXPECT_GE(elapsed, milliseconds(400));
+    EXPECT_LT(elapsed, milliseconds(1500));
+}
+
+TEST(RateLimiterTest, IsLimitedTest)
+{
+    shared_ptr<rate_limiter> grandparent = make_shared<rate_limiter>();
+    shared_ptr<rate_limiter> parent = make_shared<rate_limiter>(rate_limiter::unlimited, grandparent);
+    rate_limiter child(rate_limiter::unlimited, parent);
+
+    EXPECT_FALSE(child.is_limited());
+
+    grandparent->set_rate(1000000);
+    EXPECT_TRUE(child.is_limited());
+    EXPECT_FALSE(rate_limiter(rate_limiter::unlimited).is_limited());
+
+    grandparent->set_rate(rate_limiter::unlimited);
+    child.set_rate(1000);
+    EXPECT_TRUE(child.is_limited());
+    EXPECT_FALSE(parent->is_limited());
+}
+
+TEST(RateLimiterTest, SharedParentTest)
+{
+    shared_ptr<rate_limiter> parent = make_shared<rate_limiter>(1000000);
+    rate_limiter first(rate_limiter::unlimited, parent);
+    rate_limiter second(rate_limiter::unlimited, parent);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    std::thread thread([&]() { acquire_chunks(second, 5, 50000); });
+    acquire_chunks(first, 5, 50000);
+    thread.join();
+
+    milliseconds elapsed = duration_cast<milliseconds>(steady_clock::now() - start);
+
+    EXPECT_GE(elapsed, milliseconds(400));
+    EXPECT_LT(elapsed, milliseconds(1500));
+}
+
+TEST(RateLimiterTest, SetRateTest)
+{
+    rate_limiter limiter(1000);
+
+    limiter.set_rate(rate_limiter::unlimited);
+
+    EXPECT_EQ(rate_limiter::unlimited, limiter.rate());
+    EXPECT_LT(acquire_chunks(limiter, 10, 1024 * 1024), milliseconds(100));
+
+    limiter.set_rate(1000000);
+
+    EXPECT_EQ(1000000u, limiter.rate());
+    EXPECT_GE(acquire_chunks(limiter, 10, 50000), milliseconds(400));
+}
+
+TEST(RateLimiterTest, CancellationTest)
+{
+    rate_limiter limiter(1000);
+    std::atomic<bool> cancelled(false);
+
+    std::thread thread([&]()
+    {
+        std::this_thread::sleep_for(milliseconds(100));
+        cancelled = true;
+    });
+
+    steady_clock::time_point start = steady_clock::now();
+
+    /* Would wait for 10 seconds. */
+    limiter.acquire(10000, &cancelled);
+
+    thread.join();
+
+    EXPECT_LT(steady_clock::now() - start, milliseconds(1000));
+}
+
+TEST(RateLimiterTest, ForHostTest)
+{
+    shared_ptr<rate_limiter> limiter = rate_limiter::for_host("rate-limiter-test");
+
+    EXPECT_EQ(limiter, rate_limiter::for_host("rate-limiter-test"));
+    EXPECT_NE(limiter, rate_limiter::for_host("another-rate-limiter-test"));
+    EXPECT_EQ(rate_limiter::global(), limiter->parent());
+    EXPECT_EQ(nullptr, rate_limiter::global()->parent());
+}
@@ -0,0 +1,115 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "ftp/resolver_cache.hpp"
+
+using ftp::resolver_cache;
+using boost::system::error_code;
+
+class ResolverCacheTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        resolver_cache::instance().clear();
+    }
+
+    void TearDown() override
+    {
+        resolver_cache::instance().configure(resolver_cache::default_ttl,
+                                             resolver_cache::default_negative_ttl);
+    }
+};
+
+TEST_F(ResolverCacheTest, HitTest)
+{
+    resolver_cache & cache = resolver_cache::instance();
+    uint64_t hits = cache.hits();
+    uint64_t misses = cache.misses();
+    error_code ec;
+
+    resolver_cache::endpoints_t first = cache.resolve("localhost", 21, ec);
+    EXPECT_FALSE(ec);
+
+    resolver_cache::endpoints_t second = cache.resolve("localhost", 21, ec);
+    EXPECT_FALSE(ec);
+
+    EXPECT_FALSE(first.empty());
+    EXPECT_EQ(first, second);
+    EXPECT_EQ(21, first.front().port());
+    EXPECT_EQ(hits + 1, cache.hits());
+    EXPECT_EQ(misses + 1, cache.misses());
+
+    /* Another port is another entry. */
+    cache.resolve("localhost", 2121, ec);
+    EXPECT_EQ(misses + 2, cache.misses());
+}
+
+TEST_F(ResolverCacheTest, NegativeCacheTest)
+{
+    resolver_cache & cache = resolver_cache::instance();
+    uint64_t hits = cache.hits();
+    error_code ec;
+
+    EXPECT_TRUE(cache.resolve("nonexistent.invalid", 21, ec).empty());
+    EXPECT_TRUE(ec);
+
+    ec.clear();
+
+    EXPECT_TRUE(cache.resolve("nonexistent.invalid", 21, ec).empty());
+    EXPECT_TRUE(ec);
+    EXPECT_EQ(hits + 1, cache.hits());
+}
+
+TEST_F(ResolverCacheTest, ZeroTtlTest)
+{
+    resolver_cache & cache = resolver_cache::instance();
+    uint64_t misses = cache.misses();
+    error_code ec;
+
+    cache.configure(std::chrono::seconds(0), std::chrono::seconds(0));
+
+    cache.resolve("localhost", 21, ec);
+    cache.resolve("localhost", 21, ec);
+
+    EXPECT_EQ(misses + 2, cache.misses());
+}
+
+TEST_F(ResolverCacheTest, PrefetchTest)
+{
+    resolver_cache & cache = resolver_cache::instance();
+    uint64_t misses = cache.misses();
+    error_code ec;
+
+    cache.prefetch("localhost", 21);
+
+    /* Wait for the background resolution. */
+    std::this_thread::sleep_for(std::chrono::milliseconds(500));
+
+    EXPECT_FALSE(cache.resolve("localhost", 21, ec).empty());
+    EXPECT_EQ(misses, cache.misses());
+}
@@ -0,0 +1,107 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <thread>
+#include "ftp/detail/ring_buffer.hpp"
+
+using ftp::buffer_pool;
+using ftp::detail::ring_buffer;
+
+TEST(RingBufferTest, TransferTest)
+{
+    ring_buffer ring(buffer_pool::instance().acquire());
+    const size_t total = 10 * buffer_pool::instance().buffer_size() + 123;
+
+    std::thread producer([&]()
+    {
+        size_t produced = 0;
+
+        while (produced < total)
+        {
+            char *data;
+            size_t size = std::min(ring.prepare(data), total - produced);
+
+            /* Odd sizes make the regions wrap around unevenly. */
+            size = std::min<size_t>(size, 1000);
+
+            for (size_t i = 0; i < size; i++)
+            {
+                data[i] = static_cast<char>((produced + i) % 251);
+            }
+
+            ring.commit(size);
+            produced += size;
+        }
+
+        ring.close();
+    });
+
+    size_t consumed = 0;
+    bool in_order = true;
+
+    for (;;)
+    {
+        const char *data;
+        size_t size = ring.peek(data);
+
+        if (size == 0)
+        {
+            break;
+        }
+
+        for (size_t i = 0; i < size; i++)
+        {
+            in_order = in_order && data[i] == static_cast<char>((consumed + i) % 251);
+        }
+
+        ring.consume(size);
+        consumed += size;
+    }
+
+    producer.join();
+
+    EXPECT_TRUE(in_order);
+    EXPECT_EQ(total, consumed);
+    EXPECT_FALSE(ring.is_cancelled());
+}
+
+TEST(RingBufferTest, CancelTest)
+{
+    ring_buffer ring(buffer_pool::instance().acquire());
+
+    std::thread consumer([&]()
+    {
+        const char *data;
+        EXPECT_EQ(0u, ring.peek(data));
+    });
+
+    ring.cancel();
+    consumer.join();
+
+    char *data;
+    EXPECT_EQ(0u, ring.prepare(data));
+    EXPECT_TRUE(ring.is_cancelled());
+}
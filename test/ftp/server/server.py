@@ -27,12 +27,22 @@ from pyftpdlib.handlers import FTPHandler
 from pyftpdlib.servers import FTPServer
 
 def main():
-    if len(sys.argv) != 3:
-        print("Usage: server.py port home_directory")
+    args = sys.argv[1:]
+    max_cons_per_ip = 0
+
+    # Sessions over the limit are refused with 421.
+    if "--max-cons-per-ip" in args:
+        index = args.index("--max-cons-per-ip")
+        max_cons_per_ip = int(args[index + 1])
+        del args[index:index + 2]
+
+    if len(args) != 2 and len(args) != 3:
+        print("Usage: server.py port home_directory [certfile] [--max-cons-per-ip count]")
         return
 
-    port = sys.argv[1]
-    home_directory = sys.argv[2]
+    port = args[0]
+    home_directory = args[1]
+    certfile = args[2] if len(args) == 3 else None
 
     # Add user with the following permissions:
     #   e - change directory (CWD, CDUP commands)
@@ -46,12 +56,26 @@ def main():
     authorizer = DummyAuthorizer()
     authorizer.add_user("user", "password", home_directory, perm = "elradfmw")
 
-    handler = FTPHandler
+    if certfile:
+        # Explicit FTPS (AUTH TLS), requires pyOpenSSL.
+        from OpenSSL import SSL
+        from pyftpdlib.handlers import TLS_FTPHandler
+
+        context = SSL.Context(SSL.TLS_METHOD)
+        context.use_certificate_chain_file(certfile)
+        context.use_privatekey_file(certfile)
+
+        handler = TLS_FTPHandler
+        handler.ssl_context = context
+    else:
+        handler = FTPHandler
+
     handler.authorizer = authorizer
     handler.banner = "FTP server is ready."
 
     address = ("localhost", port)
     server = FTPServer(address, handler)
+    server.max_cons_per_ip = max_cons_per_ip
     server.serve_forever()
 
 if __name__ == "__main__":
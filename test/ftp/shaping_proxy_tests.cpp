@@ -0,0 +1,240 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <thread>
+#include <vector>
+#include "ftp/client.hpp"
+#include "shaping_proxy.hpp"
+#include "test_server.hpp"
+
+using std::string;
+using std::chrono::milliseconds;
+using std::chrono::steady_clock;
+
+class ShapingProxyTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::filesystem::create_directory(m_localDir);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_localDir);
+    }
+
+    void connect(const ftp::test::shaping & shaping)
+    {
+        m_proxy = std::make_unique<ftp::test::shaping_proxy>("127.0.0.1", m_server.port(), shaping);
+
+        ASSERT_TRUE(m_client.open("127.0.0.1", m_proxy->port()));
+        ASSERT_TRUE(m_client.login("user", "password"));
+        ASSERT_TRUE(m_client.binary());
+    }
+
+    const string m_localDir = "shaping_proxy_local";
+    ftp::test::server m_server;
+    std::unique_ptr<ftp::test::shaping_proxy> m_proxy;
+    ftp::client m_client;
+};
+
+TEST_F(ShapingProxyTest, RttTest)
+{
+    ftp::test::shaping shaping;
+    shaping.rtt = milliseconds(100);
+
+    connect(shaping);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    EXPECT_TRUE(m_client.noop());
+    EXPECT_GE(steady_clock::now() - start, milliseconds(100));
+}
+
+TEST_F(ShapingProxyTest, HandshakeTest)
+{
+    ftp::test::shaping shaping;
+    shaping.rtt = milliseconds(100);
+
+    m_server.add_file("file", "content");
+
+    connect(shaping);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    /* EPSV, the handshake of the data connection, and RETR with the data. */
+    EXPECT_TRUE(m_client.download("file", m_localDir + "/file"));
+    EXPECT_GE(steady_clock::now() - start, milliseconds(300));
+}
+
+TEST_F(ShapingProxyTest, JitterTest)
+{
+    ftp::test::shaping shaping;
+    shaping.jitter = milliseconds(50);
+
+    /* Not a repeated pattern, so that a misplaced chunk shows. */
+    string content(1024 * 1024, '\0');
+
+    for (size_t i = 0; i < content.size(); i++)
+    {
+        content[i] = static_cast<char>((i * 7919 + i / 4093) % 251);
+    }
+
+    m_server.add_file("file", content);
+
+    connect(shaping);
+
+    std::vector<steady_clock::duration> round_trips;
+
+    for (int i = 0; i < 10; i++)
+    {
+        steady_clock::time_point start = steady_clock::now();
+
+        EXPECT_TRUE(m_client.noop());
+        round_trips.push_back(steady_clock::now() - start);
+    }
+
+    auto [shortest, longest] = std::minmax_element(round_trips.begin(), round_trips.end());
+
+    /* Up to the jitter in each direction, different every time. */
+    EXPECT_LT(*longest, milliseconds(150));
+    EXPECT_GT(*longest - *shortest, milliseconds(5));
+
+    /* The delayed chunks are still passed on in order. */
+    EXPECT_TRUE(m_client.download("file", m_localDir + "/file"));
+
+    std::ifstream file(m_localDir + "/file", std::ios_base::binary);
+    std::ostringstream downloaded;
+    downloaded << file.rdbuf();
+
+    EXPECT_TRUE(downloaded.str() == content);
+}
+
+TEST_F(ShapingProxyTest, TransferTest)
+{
+    const uint64_t size = 3 * 1024 * 1024 + 7;
+
+    m_server.add_synthetic_file("synthetic", size);
+
+    connect(ftp::test::shaping());
+
+    /* The data connection goes through the proxy as well. */
+    EXPECT_TRUE(m_client.download("synthetic", m_localDir + "/synthetic"));
+    EXPECT_EQ(size, std::filesystem::file_size(m_localDir + "/synthetic"));
+
+    EXPECT_TRUE(m_client.upload(m_localDir + "/synthetic", "uploaded"));
+    EXPECT_EQ(size, m_server.file_size("uploaded"));
+    EXPECT_TRUE(m_client.noop());
+}
+
+TEST_F(ShapingProxyTest, BandwidthTest)
+{
+    ftp::test::shaping shaping;
+    shaping.bandwidth = 1024 * 1024;
+
+    m_server.add_synthetic_file("synthetic", 512 * 1024);
+
+    connect(shaping);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    EXPECT_TRUE(m_client.download("synthetic", m_localDir + "/synthetic"));
+
+    steady_clock::duration elapsed = steady_clock::now() - start;
+
+    EXPECT_GE(elapsed, milliseconds(450));
+    EXPECT_LT(elapsed, milliseconds(5000));
+}
+
+TEST_F(ShapingProxyTest, SharedBandwidthTest)
+{
+    ftp::test::shaping shaping;
+    shaping.shared_bandwidth = 1024 * 1024;
+
+    m_server.add_synthetic_file("synthetic", 512 * 1024);
+
+    connect(shaping);
+
+    ftp::client other;
+
+    ASSERT_TRUE(other.open("127.0.0.1", m_proxy->port()));
+    ASSERT_TRUE(other.login("user", "password"));
+    ASSERT_TRUE(other.binary());
+
+    steady_clock::time_point start = steady_clock::now();
+
+    std::thread download([&]()
+    {
+        EXPECT_TRUE(other.download("synthetic", m_localDir + "/other"));
+    });
+
+    EXPECT_TRUE(m_client.download("synthetic", m_localDir + "/synthetic"));
+    download.join();
+
+    /* Half a second each on links of their own, a second on the shared one. */
+    EXPECT_GE(steady_clock::now() - start, milliseconds(950));
+}
+
+TEST_F(ShapingProxyTest, StallTest)
+{
+    ftp::test::shaping shaping;
+    shaping.bandwidth = 1024 * 1024;
+    shaping.stall_interval = milliseconds(10);
+    shaping.stall_duration = milliseconds(50);
+
+    m_server.add_synthetic_file("synthetic", 512 * 1024);
+
+    connect(shaping);
+
+    steady_clock::time_point start = steady_clock::now();
+
+    EXPECT_TRUE(m_client.download("synthetic", m_localDir + "/synthetic"));
+    EXPECT_EQ(512u * 1024, std::filesystem::file_size(m_localDir + "/synthetic"));
+
+    /* Half a second at the bandwidth, plus at least one stall. */
+    EXPECT_GE(steady_clock::now() - start, milliseconds(550));
+}
+
+TEST_F(ShapingProxyTest, StopTest)
+{
+    ftp::test::shaping shaping;
+    shaping.rtt = milliseconds(10);
+
+    connect(shaping);
+
+    uint16_t port = m_proxy->port();
+
+    /* Returns although the session is still open. */
+    m_proxy->stop();
+
+    ftp::client client;
+
+    EXPECT_THROW(client.open("127.0.0.1", port), ftp::ftp_exception);
+}
@@ -0,0 +1,408 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <thread>
+#include "ftp/auto_tuner.hpp"
+#include "ftp/client.hpp"
+#include "simulated_network.hpp"
+
+using std::string;
+using std::shared_ptr;
+using std::chrono::milliseconds;
+using std::chrono::nanoseconds;
+using std::chrono::seconds;
+using ftp::test::simulated_network;
+
+class SimulatedNetworkTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::filesystem::create_directory(m_localDir);
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_localDir);
+    }
+
+    static shared_ptr<simulated_network> network(milliseconds latency, std::uint64_t bandwidth, std::size_t window = 0)
+    {
+        simulated_network::link link;
+        link.latency = latency;
+        link.bandwidth = bandwidth;
+        link.window = window;
+        link.think_time = milliseconds(1);
+
+        return std::make_shared<simulated_network>(link);
+    }
+
+    static void connect(ftp::client & client, const shared_ptr<simulated_network> & network)
+    {
+        client.set_transport(network);
+
+        ASSERT_TRUE(client.open("server"));
+        ASSERT_TRUE(client.login("user", "password"));
+        ASSERT_TRUE(client.binary());
+    }
+
+    /* The virtual time the download takes. */
+    nanoseconds download(ftp::client & client, const shared_ptr<simulated_network> & network, const string & file)
+    {
+        std::filesystem::remove(m_localDir + "/" + file);
+
+        nanoseconds start = network->now();
+
+        EXPECT_TRUE(client.download(file, m_localDir + "/" + file));
+
+        return network->now() - start;
+    }
+
+    const string m_localDir = "simulated_network_local";
+};
+
+TEST_F(SimulatedNetworkTest, DownloadTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(10), 1000000);
+    network->add_synthetic_file("file", 10000000);
+
+    ftp::client client;
+    connect(client, network);
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    /* 10 s at 1 MB/s, and a few round trips. */
+    nanoseconds elapsed = download(client, network, "file");
+
+    EXPECT_GE(elapsed, seconds(10));
+    EXPECT_LT(elapsed, milliseconds(10200));
+    EXPECT_LT(std::chrono::steady_clock::now() - start, seconds(5));
+
+    std::ifstream file(m_localDir + "/file", std::ios_base::binary);
+    string head(28, '\0');
+    file.read(head.data(), head.size());
+
+    EXPECT_EQ("abcdefghijklmnopqrstuvwxyzab", head);
+    EXPECT_EQ(10000000u, std::filesystem::file_size(m_localDir + "/file"));
+}
+
+TEST_F(SimulatedNetworkTest, DeterminismTest)
+{
+    nanoseconds elapsed[2];
+
+    for (nanoseconds & time : elapsed)
+    {
+        auto network = SimulatedNetworkTest::network(milliseconds(7), 3000000);
+        network->add_synthetic_file("file", 1234567);
+
+        std::thread thread([&]()
+        {
+            ftp::client client;
+            connect(client, network);
+            download(client, network, "file");
+            client.close();
+        });
+
+        thread.join();
+
+        time = network->elapsed();
+    }
+
+    EXPECT_EQ(elapsed[0], elapsed[1]);
+}
+
+TEST_F(SimulatedNetworkTest, UploadTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(10), 1000000);
+
+    ftp::client client;
+    connect(client, network);
+
+    string content(1000000, 'x');
+    std::ofstream(m_localDir + "/file", std::ios_base::binary) << content;
+
+    nanoseconds start = network->now();
+
+    EXPECT_TRUE(client.upload(m_localDir + "/file", "uploaded"));
+
+    nanoseconds elapsed = network->now() - start;
+
+    EXPECT_GE(elapsed, seconds(1));
+    EXPECT_LT(elapsed, milliseconds(1200));
+    EXPECT_EQ(content, network->file("uploaded"));
+}
+
+TEST_F(SimulatedNetworkTest, ThinkTimeTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(10), 0);
+    network->set_think_time("NOOP", milliseconds(500));
+
+    ftp::client client;
+    connect(client, network);
+
+    nanoseconds start = network->now();
+
+    EXPECT_TRUE(client.noop());
+    EXPECT_EQ(milliseconds(521), network->now() - start);
+
+    start = network->now();
+
+    EXPECT_TRUE(client.system());
+    EXPECT_EQ(milliseconds(21), network->now() - start);
+}
+
+/* 64 KiB per 100 ms round trip is 655360 bytes per second. */
+TEST_F(SimulatedNetworkTest, WindowTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(50), 10000000, 64 * 1024);
+    network->add_synthetic_file("file", 6553600);
+
+    ftp::client client;
+    connect(client, network);
+
+    nanoseconds elapsed = download(client, network, "file");
+
+    EXPECT_GE(elapsed, seconds(10));
+    EXPECT_LT(elapsed, milliseconds(10500));
+
+    const ftp::tcp_statistics & tcp = client.last_tcp_statistics();
+
+    ASSERT_TRUE(tcp.available);
+    EXPECT_EQ(milliseconds(100), tcp.end.rtt);
+    EXPECT_EQ(655360u, tcp.end.delivery_rate);
+    EXPECT_GT(tcp.end.rwnd_limited, std::chrono::microseconds::zero());
+
+    /* A larger buffer opens the window up to the bandwidth. */
+    client.set_socket_buffer_size(4 * 1024 * 1024);
+
+    elapsed = download(client, network, "file");
+
+    EXPECT_LT(elapsed, milliseconds(1000));
+    EXPECT_EQ(10000000u, client.last_tcp_statistics().end.delivery_rate);
+    EXPECT_EQ(std::chrono::microseconds::zero(), client.last_tcp_statistics().end.rwnd_limited);
+}
+
+TEST_F(SimulatedNetworkTest, AutoTunerTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(50), 10000000, 64 * 1024);
+    network->add_synthetic_file("file", 6553600);
+
+    ftp::auto_tuner tuner;
+    ftp::client client;
+    connect(client, network);
+
+    /* The window of the link is all autotuning would reach. */
+    tuner.set_autotuning_limit(64 * 1024);
+
+    nanoseconds first = download(client, network, "file");
+    tuner.record_transfer("server", 6553600, client.last_tcp_statistics(), 1);
+
+    /* The window, as the round trips of the transfer count as well. */
+    EXPECT_NEAR(65536.0, static_cast<double>(tuner.get("server").bandwidth_delay_product), 2048.0);
+    EXPECT_GT(tuner.get("server").socket_buffer_size, 64u * 1024);
+
+    client.set_socket_buffer_size(tuner.get("server").socket_buffer_size);
+
+    nanoseconds second = download(client, network, "file");
+
+    EXPECT_LT(second, first);
+}
+
+/* The throughput of a short transfer underestimates the BDP, but all of
+ * its time was limited by the window, so the tuner doubles the buffer.
+ */
+TEST_F(SimulatedNetworkTest, BufferLimitedTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(50), 10000000, 64 * 1024);
+    network->add_synthetic_file("file", 128 * 1024);
+
+    ftp::auto_tuner tuner;
+    ftp::client client;
+    connect(client, network);
+
+    /* The window of the link is all autotuning would reach. */
+    tuner.set_autotuning_limit(64 * 1024);
+
+    download(client, network, "file");
+
+    const ftp::tcp_statistics & tcp = client.last_tcp_statistics();
+
+    ASSERT_TRUE(tcp.available);
+    EXPECT_GT(tcp.end.busy_time, std::chrono::microseconds::zero());
+    EXPECT_EQ(tcp.end.busy_time, tcp.end.rwnd_limited);
+
+    tuner.record_transfer("server", 128 * 1024, tcp, 1);
+
+    EXPECT_LT(2 * tuner.get("server").bandwidth_delay_product, 128u * 1024);
+    EXPECT_EQ(128u * 1024, tuner.get("server").socket_buffer_size);
+}
+
+TEST_F(SimulatedNetworkTest, MaxSessionsTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(1), 0);
+    network->set_max_sessions(1);
+
+    ftp::client first;
+    ftp::client second;
+
+    first.set_transport(network);
+    second.set_transport(network);
+
+    EXPECT_TRUE(first.open("server"));
+    EXPECT_FALSE(second.open("server"));
+    EXPECT_TRUE(first.close());
+    EXPECT_TRUE(second.open("server"));
+    EXPECT_EQ(3u, network->sessions());
+}
+
+TEST_F(SimulatedNetworkTest, AbortTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(10), 1000000);
+    network->add_synthetic_file("file", 1000000000);
+
+    ftp::client client;
+    connect(client, network);
+
+    std::thread abort([&]()
+    {
+        while (client.progress().bytes == 0)
+        {
+            std::this_thread::yield();
+        }
+
+        client.abort();
+    });
+
+    EXPECT_FALSE(client.download("file", m_localDir + "/file"));
+
+    abort.join();
+
+    /* The session is still usable. */
+    EXPECT_TRUE(client.noop());
+}
+
+TEST_F(SimulatedNetworkTest, SessionsTest)
+{
+    auto network = SimulatedNetworkTest::network(milliseconds(20), 1000000);
+    network->add_file("file", "content");
+
+    const int threads = 8;
+    const int sessions = 125;
+    nanoseconds elapsed[threads];
+    std::vector<std::thread> workers;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < threads; i++)
+    {
+        workers.emplace_back([&, i]()
+        {
+            for (int j = 0; j < sessions; j++)
+            {
+                ftp::client client;
+                connect(client, network);
+                EXPECT_TRUE(client.ls());
+                EXPECT_TRUE(client.close());
+            }
+
+            elapsed[i] = network->now();
+        });
+    }
+
+    for (std::thread & worker : workers)
+    {
+        worker.join();
+    }
+
+    /* The threads ran at the same time in virtual time, and took as long. */
+    for (nanoseconds time : elapsed)
+    {
+        EXPECT_EQ(elapsed[0], time);
+    }
+
+    EXPECT_EQ(elapsed[0], network->elapsed());
+    EXPECT_GT(network->elapsed(), seconds(sessions / 10));
+    EXPECT_EQ(1000u, network->sessions());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, seconds(10));
+}
+
+TEST_F(SimulatedNetworkTest, SharedLinkTest)
+{
+    simulated_network::link link;
+    link.latency = milliseconds(10);
+    link.bandwidth = 1000000;
+    link.shared_bandwidth = 1000000;
+
+    auto network = std::make_shared<simulated_network>(link);
+    network->add_synthetic_file("file", 1000000);
+
+    nanoseconds elapsed[2];
+    std::promise<void> connected[2];
+    std::promise<void> start;
+    std::shared_future<void> started = start.get_future().share();
+    std::vector<std::thread> workers;
+
+    for (int i = 0; i < 2; i++)
+    {
+        workers.emplace_back([&, i]()
+        {
+            ftp::client client;
+            connect(client, network);
+
+            /* Both sessions are open before either downloads. */
+            connected[i].set_value();
+            started.wait();
+
+            string local_file = m_localDir + "/file_" + std::to_string(i);
+
+            EXPECT_TRUE(client.download("file", local_file));
+            EXPECT_EQ(1000000u, std::filesystem::file_size(local_file));
+
+            elapsed[i] = network->now();
+        });
+    }
+
+    for (std::promise<void> & session : connected)
+    {
+        session.get_future().wait();
+    }
+
+    start.set_value();
+
+    for (std::thread & worker : workers)
+    {
+        worker.join();
+    }
+
+    /* Each connection could take all of the link, together they take it
+     * twice as long.
+     */
+    EXPECT_GE(network->elapsed(), seconds(2));
+    EXPECT_LT(network->elapsed(), milliseconds(2300));
+    EXPECT_EQ(network->elapsed(), std::max(elapsed[0], elapsed[1]));
+}
@@ -0,0 +1,223 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <filesystem>
+#include <fstream>
+#include <future>
+#include <sstream>
+#include <thread>
+#include "ftp/client.hpp"
+#include "test_server.hpp"
+
+using std::string;
+
+class TestServerTest : public ::testing::Test
+{
+protected:
+    void SetUp() override
+    {
+        std::filesystem::create_directory(m_localDir);
+
+        ASSERT_TRUE(m_client.open("127.0.0.1", m_server.port()));
+        ASSERT_TRUE(m_client.login("user", "password"));
+        ASSERT_TRUE(m_client.binary());
+    }
+
+    void TearDown() override
+    {
+        std::filesystem::remove_all(m_localDir);
+    }
+
+    static string readFile(const string & path)
+    {
+        std::ifstream file(path, std::ios_base::binary);
+        std::ostringstream content;
+        content << file.rdbuf();
+
+        return content.str();
+    }
+
+    const string m_localDir = "test_server_local";
+    ftp::test::server m_server;
+    ftp::client m_client;
+};
+
+TEST_F(TestServerTest, DownloadTest)
+{
+    const uint64_t size = 10 * 1024 * 1024 + 7;
+
+    m_server.add_synthetic_file("synthetic", size);
+    m_server.add_file("dir/file", "content");
+
+    EXPECT_TRUE(m_client.download("synthetic", m_localDir + "/synthetic"));
+    EXPECT_TRUE(m_client.download("dir/file", m_localDir + "/file"));
+    EXPECT_FALSE(m_client.download("nonexistent", m_localDir + "/nonexistent"));
+
+    string content = readFile(m_localDir + "/synthetic");
+
+    ASSERT_EQ(size, content.size());
+    EXPECT_EQ("abcdefghijklmnopqrstuvwxyzab", content.substr(0, 28));
+    EXPECT_EQ(static_cast<char>('a' + (size - 1) % 26), content.back());
+    EXPECT_EQ("content", readFile(m_localDir + "/file"));
+}
+
+TEST_F(TestServerTest, UploadTest)
+{
+    std::ofstream(m_localDir + "/file", std::ios_base::binary) << "uploaded content";
+
+    EXPECT_TRUE(m_client.upload(m_localDir + "/file", "file"));
+    EXPECT_EQ("uploaded content", m_server.file("file"));
+
+    m_server.set_keep_uploads(false);
+
+    EXPECT_TRUE(m_client.upload(m_localDir + "/file", "dropped"));
+    EXPECT_FALSE(m_server.file("dropped"));
+    EXPECT_EQ(16u, m_server.file_size("dropped"));
+}
+
+TEST_F(TestServerTest, ResumeTest)
+{
+    m_server.add_file("file", "0123456789");
+
+    std::ofstream(m_localDir + "/file", std::ios_base::binary) << "0123";
+
+    EXPECT_TRUE(m_client.resume_download("file", m_localDir + "/file"));
+    EXPECT_EQ("0123456789", readFile(m_localDir + "/file"));
+
+    /* SIZE, then APPE of the rest. */
+    m_server.add_file("partial", "01234");
+    std::ofstream(m_localDir + "/partial", std::ios_base::binary) << "0123456789";
+
+    EXPECT_TRUE(m_client.resume_upload(m_localDir + "/partial", "partial"));
+    EXPECT_EQ("0123456789", m_server.file("partial"));
+}
+
+TEST_F(TestServerTest, ListTest)
+{
+    m_server.add_file("dir/a", "1");
+    m_server.add_file("dir/b", "22");
+    m_server.add_file("other", "");
+
+    EXPECT_TRUE(m_client.ls(string("dir")));
+    EXPECT_TRUE(m_client.ls());
+    EXPECT_TRUE(m_client.size("dir/b"));
+    EXPECT_FALSE(m_client.size("dir/c"));
+}
+
+TEST_F(TestServerTest, ReplyDelayTest)
+{
+    m_server.set_reply_delay("NOOP", std::chrono::milliseconds(100));
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(m_client.noop());
+    EXPECT_GE(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+
+    start = std::chrono::steady_clock::now();
+
+    EXPECT_TRUE(m_client.system());
+    EXPECT_LT(std::chrono::steady_clock::now() - start, std::chrono::milliseconds(100));
+}
+
+TEST_F(TestServerTest, LoginTest)
+{
+    ftp::client client;
+
+    EXPECT_TRUE(client.open("127.0.0.1", m_server.port()));
+    EXPECT_FALSE(client.login("user", "wrong"));
+    EXPECT_FALSE(client.pwd());
+    EXPECT_TRUE(client.close());
+}
+
+TEST_F(TestServerTest, AbortTest)
+{
+    m_server.add_synthetic_file("huge", uint64_t(1) << 40);
+
+    std::thread aborter([&]()
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        m_client.abort();
+    });
+
+    EXPECT_FALSE(m_client.download("huge", m_localDir + "/huge"));
+    aborter.join();
+
+    EXPECT_TRUE(m_client.noop());
+}
+
+TEST_F(TestServerTest, ReapTest)
+{
+    for (int i = 0; i < 10; i++)
+    {
+        ftp::client client;
+
+        ASSERT_TRUE(client.open("127.0.0.1", m_server.port()));
+        EXPECT_TRUE(client.close());
+    }
+
+    /* The sessions that ended are joined as new ones come in, or here. */
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+
+    while (m_server.open_sessions() > 1 && std::chrono::steady_clock::now() < deadline)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+
+    EXPECT_EQ(1u, m_server.open_sessions());
+    EXPECT_EQ(11u, m_server.session_count());
+}
+
+TEST_F(TestServerTest, StopTest)
+{
+    m_server.add_file("file", "content");
+
+    /* A session that waits for a data connection which never comes. */
+    boost::asio::io_context io_context;
+    boost::asio::ip::tcp::socket socket(io_context);
+    boost::asio::streambuf replies;
+
+    socket.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address_v4::loopback(), m_server.port()));
+    boost::asio::write(socket, boost::asio::buffer(string("USER user\r\nPASS password\r\nEPSV\r\nRETR file\r\n")));
+
+    std::istream stream(&replies);
+    string reply;
+
+    /* The greeting, the login, EPSV and the preliminary reply to RETR. */
+    for (int i = 0; i < 5; i++)
+    {
+        boost::asio::read_until(socket, replies, "\r\n");
+        std::getline(stream, reply);
+    }
+
+    EXPECT_EQ("150", reply.substr(0, 3));
+
+    std::future<void> stopped = std::async(std::launch::async, [&]() { m_server.stop(); });
+
+    EXPECT_EQ(std::future_status::ready, stopped.wait_for(std::chrono::seconds(2)));
+}
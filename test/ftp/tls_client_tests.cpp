@@ -0,0 +1,264 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+
+#include <gtest/gtest.h>
+#include <boost/process.hpp>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include "ftp/client.hpp"
+#include "ftp/ftp_exception.hpp"
+#include "ftp/detail/tls_session_cache.hpp"
+
+using std::string;
+using std::ifstream;
+using std::istreambuf_iterator;
+
+using ftp::ftp_exception;
+using ftp::detail::tls_session_cache;
+
+class FtpsClientTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        std::filesystem::create_directory(m_downloadsDir);
+        std::filesystem::create_directory(m_ftpServerDir);
+        boost::filesystem::path pythonPath = boost::process::search_path("python3");
+
+        /* Usage: python server.py port home_directory [certfile] */
+        m_ftpServerProcess = boost::process::child(pythonPath,
+                                                   "../ftp/server/server.py", "2122",
+                                                   m_ftpServerDir, m_certFile);
+
+        /* Wait for 2s to allow the server to start. */
+        m_ftpServerProcess.wait_for(std::chrono::seconds(2));
+    }
+
+    static void TearDownTestSuite()
+    {
+        m_ftpServerProcess.terminate();
+        std::filesystem::remove_all(m_ftpServerDir);
+        std::filesystem::remove_all(m_downloadsDir);
+    }
+
+    void TearDown() override
+    {
+        for (const auto & path : std::filesystem::directory_iterator(m_ftpServerDir))
+        {
+            std::filesystem::remove_all(path);
+        }
+
+        for (const auto & path : std::filesystem::directory_iterator(m_downloadsDir))
+        {
+            std::filesystem::remove_all(path);
+        }
+    }
+
+    static string readFile(const string & path)
+    {
+        ifstream file(path, ifstream::binary);
+
+        return string(istreambuf_iterator<char>(file), {});
+    }
+
+    /* The server certificate is self-signed. */
+    static ftp::tls_options trustServer()
+    {
+        ftp::tls_options options;
+        options.ca_file = m_certFile;
+
+        return options;
+    }
+
+    template<typename ...Strings>
+    static string CRLF(Strings && ...strings)
+    {
+        return (... + (strings + string("\r\n")));
+    }
+
+    class TestFtpObserver : public ftp::client::event_observer
+    {
+    public:
+        void on_reply(const string & reply) override
+        {
+            m_replies.append(reply);
+        }
+
+        const string & get_replies() const
+        {
+            return m_replies;
+        }
+
+    private:
+        string m_replies;
+    };
+
+    static const string m_certFile;
+
+private:
+    static const string m_downloadsDir;
+    static const string m_ftpServerDir;
+    static boost::process::child m_ftpServerProcess;
+};
+
+const string FtpsClientTest::m_certFile = "../ftp/server/keycert.pem";
+const string FtpsClientTest::m_downloadsDir = "tls_downloads";
+const string FtpsClientTest::m_ftpServerDir = "tls_test_server";
+boost::process::child FtpsClientTest::m_ftpServerProcess;
+
+TEST_F(FtpsClientTest, AuthTlsTest)
+{
+    TestFtpObserver observer;
+    ftp::client client(&observer);
+
+    client.set_tls_options(trustServer());
+
+    EXPECT_TRUE(client.open("localhost", 2122));
+    EXPECT_TRUE(client.auth_tls());
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.close());
+
+    EXPECT_EQ(CRLF("220 FTP server is ready.",
+                   "234 AUTH TLS successful.",
+                   "200 PBSZ=0 successful.",
+                   "200 Protection set to Private",
+                   "331 Username ok, send password.",
+                   "230 Login successful.",
+                   "221 Goodbye."),
+              observer.get_replies());
+}
+
+TEST_F(FtpsClientTest, TransferTest)
+{
+    ftp::client client;
+
+    client.set_tls_options(trustServer());
+
+    EXPECT_TRUE(client.open("localhost", 2122));
+    EXPECT_TRUE(client.auth_tls());
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.binary());
+    EXPECT_TRUE(client.upload("../ftp/test_data/war_and_peace.txt", "war_and_peace.txt"));
+    EXPECT_TRUE(client.download("war_and_peace.txt", "tls_downloads/war_and_peace.txt"));
+    EXPECT_TRUE(client.ls());
+    EXPECT_TRUE(client.close());
+
+    string expected = readFile("../ftp/test_data/war_and_peace.txt");
+
+    EXPECT_EQ(expected, readFile("tls_test_server/war_and_peace.txt"));
+    EXPECT_EQ(expected, readFile("tls_downloads/war_and_peace.txt"));
+}
+
+TEST_F(FtpsClientTest, UntrustedCertificateTest)
+{
+    ftp::client client;
+    bool catched = false;
+
+    EXPECT_TRUE(client.open("localhost", 2122));
+
+    try
+    {
+        client.auth_tls();
+    }
+    catch (const ftp_exception &)
+    {
+        catched = true;
+    }
+
+    EXPECT_TRUE(catched);
+    EXPECT_FALSE(client.is_open());
+}
+
+TEST_F(FtpsClientTest, IpAddressTest)
+{
+    ftp::client client;
+
+    client.set_tls_options(trustServer());
+
+    /* The certificate is issued for 'localhost' and '127.0.0.1'. */
+    EXPECT_TRUE(client.open("127.0.0.1", 2122));
+    EXPECT_TRUE(client.auth_tls());
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.close());
+}
+
+TEST_F(FtpsClientTest, SessionResumptionTest)
+{
+    {
+        std::ofstream file("tls_test_server/small.txt");
+        file << "small file";
+    }
+
+    tls_session_cache::instance().clear();
+    uint64_t hits = tls_session_cache::instance().hits();
+
+    ftp::client client;
+
+    client.set_tls_options(trustServer());
+
+    EXPECT_TRUE(client.open("localhost", 2122));
+    EXPECT_TRUE(client.auth_tls());
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.download("small.txt", "tls_downloads/small1.txt"));
+    EXPECT_TRUE(client.download("small.txt", "tls_downloads/small2.txt"));
+    EXPECT_TRUE(client.close());
+
+    /* Data connections resume the session of the control connection. */
+    EXPECT_EQ(hits + 2, tls_session_cache::instance().hits());
+
+    /* So does the next control connection to the server. */
+    EXPECT_TRUE(client.open("localhost", 2122));
+    EXPECT_TRUE(client.auth_tls());
+    EXPECT_TRUE(client.close());
+
+    EXPECT_EQ(hits + 3, tls_session_cache::instance().hits());
+    EXPECT_EQ("small file", readFile("tls_downloads/small2.txt"));
+}
+
+TEST_F(FtpsClientTest, NoSessionResumptionTest)
+{
+    {
+        std::ofstream file("tls_test_server/small.txt");
+        file << "small file";
+    }
+
+    ftp::tls_options options = trustServer();
+    options.session_resumption = false;
+
+    ftp::client client;
+
+    client.set_tls_options(options);
+
+    uint64_t hits = tls_session_cache::instance().hits();
+
+    EXPECT_TRUE(client.open("localhost", 2122));
+    EXPECT_TRUE(client.auth_tls());
+    EXPECT_TRUE(client.login("user", "password"));
+    EXPECT_TRUE(client.download("small.txt", "tls_downloads/small.txt"));
+    EXPECT_TRUE(client.close());
+
+    EXPECT_EQ(hits, tls_session_cache::instance().hits());
+}
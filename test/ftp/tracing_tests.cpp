@@ -0,0 +1,92 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include "ftp/tracing.hpp"
+
+using ftp::trace_span;
+using ftp::trace_phase;
+using ftp::json_lines_exporter;
+using std::chrono::nanoseconds;
+
+TEST(TracingTest, ToJsonTest)
+{
+    trace_span span;
+
+    span.operation = "download";
+    span.target = "dir/\"file\"\n.txt";
+    span.start = std::chrono::system_clock::time_point(std::chrono::seconds(1));
+    span.duration = nanoseconds(3000);
+    span.phases.push_back(trace_phase{ "EPSV", nanoseconds(0), nanoseconds(1000) });
+    span.phases.push_back(trace_phase{ "RETR", nanoseconds(1000), nanoseconds(2000) });
+    span.succeeded = true;
+
+    EXPECT_EQ("{\"operation\":\"download\",\"target\":\"dir/\\\"file\\\"\\n.txt\","
+              "\"start_us\":1000000,\"duration_ns\":3000,\"succeeded\":true,"
+              "\"phases\":[{\"name\":\"EPSV\",\"start_ns\":0,\"duration_ns\":1000},"
+              "{\"name\":\"RETR\",\"start_ns\":1000,\"duration_ns\":2000}]}",
+              json_lines_exporter::to_json(span));
+}
+
+TEST(TracingTest, ToJsonTcpTest)
+{
+    trace_span span;
+
+    span.operation = "upload";
+    span.target = "file.txt";
+    span.start = std::chrono::system_clock::time_point();
+    span.duration = nanoseconds(5);
+    span.succeeded = true;
+    span.tcp = ftp::tcp_sample();
+    span.tcp->rtt = std::chrono::microseconds(120);
+    span.tcp->congestion_window = 10;
+    span.tcp->mss = 1448;
+    span.tcp->application_limited = true;
+    span.tcp->busy_time = std::chrono::microseconds(900);
+
+    EXPECT_EQ("{\"operation\":\"upload\",\"target\":\"file.txt\","
+              "\"start_us\":0,\"duration_ns\":5,\"succeeded\":true,"
+              "\"tcp\":{\"rtt_us\":120,\"rtt_variance_us\":0,\"receive_rtt_us\":0,"
+              "\"congestion_window\":10,\"mss\":1448,\"retransmits\":0,\"delivery_rate\":0,"
+              "\"application_limited\":true,\"busy_us\":900,\"rwnd_limited_us\":0,"
+              "\"sndbuf_limited_us\":0},\"phases\":[]}",
+              json_lines_exporter::to_json(span));
+}
+
+TEST(TracingTest, ToJsonErrorTest)
+{
+    trace_span span;
+
+    span.operation = "open";
+    span.target = "localhost";
+    span.start = std::chrono::system_clock::time_point();
+    span.duration = nanoseconds(5);
+    span.succeeded = false;
+    span.error = "Connection refused\x01";
+
+    EXPECT_EQ("{\"operation\":\"open\",\"target\":\"localhost\","
+              "\"start_us\":0,\"duration_ns\":5,\"succeeded\":false,"
+              "\"error\":\"Connection refused\\u0001\",\"phases\":[]}",
+              json_lines_exporter::to_json(span));
+}
@@ -0,0 +1,366 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <boost/process.hpp>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include "ftp/transfer_scheduler.hpp"
+#include "ftp/ftp_exception.hpp"
+#include "simulated_network.hpp"
+
+using std::string;
+using std::vector;
+using std::future;
+using std::ofstream;
+
+using ftp::transfer_scheduler;
+
+class TransferSchedulerTest : public ::testing::Test
+{
+protected:
+    static void SetUpTestSuite()
+    {
+        std::filesystem::create_directory(m_localDir);
+        std::filesystem::create_directory(m_ftpServerDir);
+        boost::filesystem::path pythonPath = boost::process::search_path("python3");
+
+        /* The server refuses a third session with 421. */
+        m_ftpServerProcess = boost::process::child(pythonPath,
+                                                   "../ftp/server/server.py", "2125",
+                                                   m_ftpServerDir, "--max-cons-per-ip", "2");
+
+        /* Wait for 2s to allow the server to start. */
+        m_ftpServerProcess.wait_for(std::chrono::seconds(2));
+    }
+
+    static void TearDownTestSuite()
+    {
+        m_ftpServerProcess.terminate();
+        std::filesystem::remove_all(m_ftpServerDir);
+        std::filesystem::remove_all(m_localDir);
+    }
+
+    void TearDown() override
+    {
+        for (const auto & path : std::filesystem::directory_iterator(m_ftpServerDir))
+        {
+            std::filesystem::remove_all(path);
+        }
+
+        for (const auto & path : std::filesystem::directory_iterator(m_localDir))
+        {
+            std::filesystem::remove_all(path);
+        }
+    }
+
+    static string createFile(const string & name, size_t size)
+    {
+        string path = m_localDir + "/" + name;
+        ofstream file(path, ofstream::binary);
+        file << string(size, 'x');
+
+        return path;
+    }
+
+    static transfer_scheduler::job upload(const string & local_file, const string & remote_file, int priority = 0)
+    {
+        transfer_scheduler::job job;
+        job.type = transfer_scheduler::job::direction::upload;
+        job.hostname = "localhost";
+        job.port = 2125;
+        job.username = "user";
+        job.password = "password";
+        job.local_file = local_file;
+        job.remote_file = remote_file;
+        job.priority = priority;
+
+        return job;
+    }
+
+    static const string m_localDir;
+
+private:
+    static const string m_ftpServerDir;
+    static boost::process::child m_ftpServerProcess;
+};
+
+const string TransferSchedulerTest::m_localDir = "scheduler_local";
+const string TransferSchedulerTest::m_ftpServerDir = "scheduler_test_server";
+boost::process::child TransferSchedulerTest::m_ftpServerProcess;
+
+TEST_F(TransferSchedulerTest, TransferTest)
+{
+    transfer_scheduler scheduler(2);
+    vector<transfer_scheduler::job> uploads;
+    vector<transfer_scheduler::job> downloads;
+
+    for (int i = 0; i < 4; i++)
+    {
+        string name = "file_" + std::to_string(i);
+        uploads.push_back(upload(createFile(name, 1000 * (i + 1)), name));
+
+        transfer_scheduler::job download = uploads.back();
+        download.type = transfer_scheduler::job::direction::download;
+        download.local_file = m_localDir + "/downloaded_" + name;
+        downloads.push_back(download);
+    }
+
+    for (future<bool> & result : scheduler.submit(uploads))
+    {
+        EXPECT_TRUE(result.get());
+    }
+
+    for (future<bool> & result : scheduler.submit(downloads))
+    {
+        EXPECT_TRUE(result.get());
+    }
+
+    for (int i = 0; i < 4; i++)
+    {
+        EXPECT_EQ(1000u * (i + 1), std::filesystem::file_size(downloads[i].local_file));
+    }
+}
+
+TEST_F(TransferSchedulerTest, OrderTest)
+{
+    transfer_scheduler scheduler(1);
+    std::mutex mutex;
+    vector<string> order;
+
+    scheduler.set_completion_handler([&](const transfer_scheduler::job & job, bool succeeded)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(job.remote_file);
+        EXPECT_TRUE(succeeded);
+    });
+
+    scheduler.pause();
+
+    scheduler.submit({upload(createFile("small", 100), "small"),
+                      upload(createFile("large", 10000), "large"),
+                      upload(createFile("medium", 1000), "medium")});
+    scheduler.submit(upload(createFile("next_batch", 100000), "next_batch"));
+    scheduler.submit(upload(createFile("urgent", 10), "urgent", 1));
+
+    scheduler.resume();
+    scheduler.wait();
+
+    EXPECT_EQ(vector<string>({"urgent", "large", "medium", "small", "next_batch"}), order);
+}
+
+TEST_F(TransferSchedulerTest, DownloadOrderTest)
+{
+    transfer_scheduler scheduler(1);
+    std::mutex mutex;
+    vector<string> order;
+
+    for (future<bool> & result : scheduler.submit({upload(createFile("small", 100), "small"),
+                                                   upload(createFile("large", 10000), "large"),
+                                                   upload(createFile("medium", 1000), "medium")}))
+    {
+        EXPECT_TRUE(result.get());
+    }
+
+    scheduler.set_completion_handler([&](const transfer_scheduler::job & job, bool)
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        order.push_back(job.remote_file);
+    });
+
+    vector<transfer_scheduler::job> downloads;
+
+    /* The size of a missing file is unknown, it runs last. */
+    for (const string & name : {"missing", "small", "large", "medium"})
+    {
+        transfer_scheduler::job download = upload("", name);
+        download.type = transfer_scheduler::job::direction::download;
+        download.local_file = m_localDir + "/downloaded_" + name;
+        downloads.push_back(download);
+    }
+
+    scheduler.pause();
+    scheduler.submit(downloads);
+    scheduler.resume();
+    scheduler.wait();
+
+    EXPECT_EQ(vector<string>({"large", "medium", "small", "missing"}), order);
+    EXPECT_EQ(10000u, std::filesystem::file_size(m_localDir + "/downloaded_large"));
+}
+
+TEST_F(TransferSchedulerTest, RefusedSessionTest)
+{
+    transfer_scheduler scheduler(4, 4);
+    scheduler.set_retry_policy(ftp::retry_policy(20, std::chrono::milliseconds(50), std::chrono::milliseconds(500)));
+
+    vector<transfer_scheduler::job> uploads;
+
+    for (int i = 0; i < 8; i++)
+    {
+        string name = "file_" + std::to_string(i);
+        uploads.push_back(upload(createFile(name, 100000), name));
+    }
+
+    for (future<bool> & result : scheduler.submit(uploads))
+    {
+        EXPECT_TRUE(result.get());
+    }
+
+    EXPECT_GE(scheduler.max_sessions("localhost"), 1u);
+    EXPECT_LE(scheduler.max_sessions("localhost"), 2u);
+}
+
+TEST_F(TransferSchedulerTest, FailedTransferTest)
+{
+    transfer_scheduler scheduler(1);
+
+    transfer_scheduler::job job = upload(m_localDir + "/nonexistent", "nonexistent");
+
+    EXPECT_THROW(scheduler.submit(job).get(), ftp::ftp_exception);
+
+    job.type = transfer_scheduler::job::direction::download;
+    job.local_file = m_localDir + "/nonexistent";
+
+    EXPECT_FALSE(scheduler.submit(job).get());
+}
+
+TEST_F(TransferSchedulerTest, AutoTunerTest)
+{
+    transfer_scheduler scheduler(4, 4);
+    auto tuner = std::make_shared<ftp::auto_tuner>();
+
+    scheduler.set_auto_tuner(tuner);
+
+    vector<transfer_scheduler::job> uploads;
+
+    for (int i = 0; i < 9; i++)
+    {
+        string name = "file_" + std::to_string(i);
+        uploads.push_back(upload(createFile(name, 1000000), name));
+    }
+
+    /* One session at a time until the first level is measured, then the
+     * tuner ramps up to two.
+     */
+    for (int i = 0; i < 3; i++)
+    {
+        EXPECT_TRUE(scheduler.submit(uploads[i]).get());
+    }
+
+#ifdef __linux__
+    ftp::auto_tuner::settings settings = tuner->get("localhost");
+
+    EXPECT_EQ(2u, settings.sessions);
+    EXPECT_GT(settings.bandwidth_delay_product, 0u);
+#endif
+
+    vector<future<bool>> results =
+            scheduler.submit(vector<transfer_scheduler::job>(uploads.begin() + 3, uploads.end()));
+
+    for (future<bool> & result : results)
+    {
+        EXPECT_TRUE(result.get());
+    }
+}
+
+/* Each session could take all of the shared link, so two sessions take as
+ * long as one, and the time shows it, not only the sizes and sessions.
+ */
+TEST_F(TransferSchedulerTest, TransportTest)
+{
+    transfer_scheduler scheduler(4, 2);
+
+    ftp::test::simulated_network::link link;
+    link.latency = std::chrono::milliseconds(1);
+    link.bandwidth = 1000000;
+    link.shared_bandwidth = 1000000;
+
+    auto network = std::make_shared<ftp::test::simulated_network>(link);
+
+    scheduler.set_transport(network);
+
+    vector<transfer_scheduler::job> uploads;
+
+    for (int i = 0; i < 6; i++)
+    {
+        string name = "file_" + std::to_string(i);
+        uploads.push_back(upload(createFile(name, 1000000), name));
+    }
+
+    for (future<bool> & result : scheduler.submit(uploads))
+    {
+        EXPECT_TRUE(result.get());
+    }
+
+    for (int i = 0; i < 6; i++)
+    {
+        EXPECT_EQ(1000000u, network->file_size("file_" + std::to_string(i)));
+    }
+
+    /* Sessions stay open for the next jobs. */
+    EXPECT_GE(network->sessions(), 1u);
+    EXPECT_LE(network->sessions(), 2u);
+
+    EXPECT_GE(network->elapsed(), std::chrono::seconds(6));
+    EXPECT_LT(network->elapsed(), std::chrono::milliseconds(6500));
+}
+
+/* A session gets 1 MB/s of the 2.5 MB/s link, so the tuner ramps up to the
+ * third session, which still adds more than min_gain, and stops there.
+ */
+TEST_F(TransferSchedulerTest, SimulatedRampTest)
+{
+    transfer_scheduler scheduler(4, 4);
+    auto tuner = std::make_shared<ftp::auto_tuner>(4);
+
+    ftp::test::simulated_network::link link;
+    link.latency = std::chrono::milliseconds(1);
+    link.bandwidth = 1000000;
+    link.shared_bandwidth = 2500000;
+
+    auto network = std::make_shared<ftp::test::simulated_network>(link);
+
+    scheduler.set_transport(network);
+    scheduler.set_auto_tuner(tuner);
+
+    vector<transfer_scheduler::job> uploads;
+
+    for (int i = 0; i < 24; i++)
+    {
+        string name = "file_" + std::to_string(i);
+        uploads.push_back(upload(createFile(name, 1000000), name));
+    }
+
+    for (future<bool> & result : scheduler.submit(uploads))
+    {
+        EXPECT_TRUE(result.get());
+    }
+
+    EXPECT_EQ(3u, tuner->get("localhost").sessions);
+
+    /* Faster than one session at a time, no faster than the link. */
+    EXPECT_GE(network->elapsed(), std::chrono::milliseconds(9600));
+    EXPECT_LT(network->elapsed(), std::chrono::seconds(16));
+}
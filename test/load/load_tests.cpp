@@ -0,0 +1,176 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+#include "load/load_exception.hpp"
+#include "load/load_generator.hpp"
+#include "load/load_options.hpp"
+#include "test_server.hpp"
+
+using std::string;
+using std::vector;
+
+static load_options parse(vector<const char *> arguments)
+{
+    arguments.insert(arguments.begin(), "ftp_load");
+
+    return parse_load_options(static_cast<int>(arguments.size()), arguments.data());
+}
+
+static const operation_report & report_of(const load_report & report, operation operation)
+{
+    return report.operations[static_cast<size_t>(operation)];
+}
+
+TEST(LoadOptionsTest, DefaultsTest)
+{
+    load_options options = parse({"localhost"});
+
+    EXPECT_EQ("localhost", options.hostname);
+    EXPECT_EQ(21, options.port);
+    EXPECT_EQ("anonymous", options.username);
+    EXPECT_EQ(4u, options.sessions);
+    EXPECT_EQ(std::chrono::seconds(10), options.duration);
+    EXPECT_FALSE(options.count);
+    EXPECT_EQ(1u, options.mix[static_cast<size_t>(operation::login)]);
+    EXPECT_EQ(1u, options.mix[static_cast<size_t>(operation::list)]);
+    EXPECT_EQ(0u, options.mix[static_cast<size_t>(operation::upload)]);
+    EXPECT_EQ(0u, options.mix[static_cast<size_t>(operation::download)]);
+}
+
+TEST(LoadOptionsTest, ParseTest)
+{
+    load_options options = parse({"--user", "user", "--password", "password",
+                                  "--sessions", "16", "--duration", "2.5",
+                                  "--mix", "list=2,upload=1,download=4",
+                                  "--upload-size", "4096", "--download-file", "file",
+                                  "--seed", "7", "ftp.example.com", "2121"});
+
+    EXPECT_EQ("ftp.example.com", options.hostname);
+    EXPECT_EQ(2121, options.port);
+    EXPECT_EQ("user", options.username);
+    EXPECT_EQ("password", options.password);
+    EXPECT_EQ(16u, options.sessions);
+    EXPECT_EQ(std::chrono::milliseconds(2500), options.duration);
+    EXPECT_EQ(0u, options.mix[static_cast<size_t>(operation::login)]);
+    EXPECT_EQ(2u, options.mix[static_cast<size_t>(operation::list)]);
+    EXPECT_EQ(1u, options.mix[static_cast<size_t>(operation::upload)]);
+    EXPECT_EQ(4u, options.mix[static_cast<size_t>(operation::download)]);
+    EXPECT_EQ(4096u, options.upload_size);
+    EXPECT_EQ("file", options.download_file);
+    EXPECT_EQ(7u, options.seed);
+
+    EXPECT_EQ(100u, parse({"--count", "100", "localhost"}).count);
+}
+
+TEST(LoadOptionsTest, InvalidTest)
+{
+    EXPECT_THROW(parse({}), load_exception);
+    EXPECT_THROW(parse({"localhost", "21", "extra"}), load_exception);
+    EXPECT_THROW(parse({"localhost", "port"}), load_exception);
+    EXPECT_THROW(parse({"--sessions", "0", "localhost"}), load_exception);
+    EXPECT_THROW(parse({"--sessions", "-1", "localhost"}), load_exception);
+    EXPECT_THROW(parse({"--unknown", "1", "localhost"}), load_exception);
+    EXPECT_THROW(parse({"--mix", "list=1,delete=1", "localhost"}), load_exception);
+    EXPECT_THROW(parse({"--mix", "list=0", "localhost"}), load_exception);
+    EXPECT_THROW(parse({"--mix", "download=1", "localhost"}), load_exception);
+    EXPECT_THROW(parse({"--sessions"}), load_exception);
+}
+
+TEST(LoadGeneratorTest, CountTest)
+{
+    ftp::test::server server;
+    server.add_synthetic_file("file", 64 * 1024);
+
+    load_options options = parse({"--user", "user", "--password", "password",
+                                  "--sessions", "3", "--count", "60",
+                                  "--mix", "login=1,list=1,upload=1,download=1",
+                                  "--upload-size", "1000", "--download-file", "file",
+                                  "127.0.0.1"});
+    options.port = server.port();
+
+    load_report report = load_generator(options).run();
+
+    uint64_t count = 0;
+
+    for (const operation_report & operation : report.operations)
+    {
+        count += operation.count;
+        EXPECT_EQ(0u, operation.errors);
+        EXPECT_LE(operation.p50, operation.p99);
+        EXPECT_LE(operation.p99, operation.max);
+    }
+
+    /* Each session's first login is reported too. */
+    EXPECT_EQ(60u + 3u, count);
+    EXPECT_EQ(3u, report.sessions);
+
+    const operation_report & upload = report_of(report, operation::upload);
+    EXPECT_EQ(upload.count * 1000, upload.bytes);
+
+    const operation_report & download = report_of(report, operation::download);
+    EXPECT_EQ(download.count * 64 * 1024, download.bytes);
+
+    std::ostringstream stream;
+    print_report(stream, report);
+    EXPECT_NE(string::npos, stream.str().find("Operations: 63"));
+    EXPECT_NE(string::npos, stream.str().find("download"));
+}
+
+TEST(LoadGeneratorTest, ErrorTest)
+{
+    ftp::test::server server;
+
+    load_options options = parse({"--user", "user", "--password", "password",
+                                  "--sessions", "2", "--count", "10",
+                                  "--mix", "download=1", "--download-file", "missing",
+                                  "127.0.0.1"});
+    options.port = server.port();
+
+    load_report report = load_generator(options).run();
+
+    const operation_report & download = report_of(report, operation::download);
+    EXPECT_EQ(10u, download.count);
+    EXPECT_EQ(10u, download.errors);
+    EXPECT_EQ(0u, download.bytes);
+    EXPECT_EQ(0u, report_of(report, operation::login).errors);
+}
+
+TEST(LoadGeneratorTest, DurationTest)
+{
+    ftp::test::server server;
+
+    load_options options = parse({"--user", "user", "--password", "password",
+                                  "--sessions", "2", "--duration", "0.3",
+                                  "127.0.0.1"});
+    options.port = server.port();
+
+    load_report report = load_generator(options).run();
+
+    EXPECT_GE(report.elapsed, std::chrono::milliseconds(300));
+    EXPECT_GT(report_of(report, operation::list).count, 0u);
+    EXPECT_GT(report_of(report, operation::login).count, 2u);
+}
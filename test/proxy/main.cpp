@@ -0,0 +1,119 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "shaping_proxy.hpp"
+#include <csignal>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using std::cerr;
+using std::cout;
+using std::endl;
+using std::exception;
+using std::string;
+
+static const char *usage =
+    " listen_port server_host server_port"
+    " [--rtt ms] [--jitter ms] [--bandwidth bytes_per_second]"
+    " [--stall-interval ms] [--stall-duration ms]";
+
+/* Forwards FTP sessions through connections with added latency, limited
+ * bandwidth and stalls, until interrupted.
+ *
+ * Usage: ftp_proxy listen_port server_host server_port [option value]...
+ */
+int main(int argc, char *argv[])
+{
+    if (argc < 4 || argc % 2 != 0)
+    {
+        cerr << "Usage: " << argv[0] << usage << endl;
+        return EXIT_FAILURE;
+    }
+
+    try
+    {
+        ftp::test::shaping shaping;
+
+        for (int i = 4; i < argc; i += 2)
+        {
+            string option = argv[i];
+            unsigned long long value = std::stoull(argv[i + 1]);
+
+            if (option == "--rtt")
+            {
+                shaping.rtt = std::chrono::milliseconds(value);
+            }
+            else if (option == "--jitter")
+            {
+                shaping.jitter = std::chrono::milliseconds(value);
+            }
+            else if (option == "--bandwidth")
+            {
+                shaping.bandwidth = value;
+            }
+            else if (option == "--stall-interval")
+            {
+                shaping.stall_interval = std::chrono::milliseconds(value);
+            }
+            else if (option == "--stall-duration")
+            {
+                shaping.stall_duration = std::chrono::milliseconds(value);
+            }
+            else
+            {
+                cerr << "Unknown option '" << option << "'." << endl;
+                cerr << "Usage: " << argv[0] << usage << endl;
+                return EXIT_FAILURE;
+            }
+        }
+
+        sigset_t signals;
+        sigemptyset(&signals);
+        sigaddset(&signals, SIGINT);
+        sigaddset(&signals, SIGTERM);
+
+        /* Block the signals in the proxy threads too, they are taken below. */
+        pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+        ftp::test::shaping_proxy proxy(argv[2],
+                                       static_cast<std::uint16_t>(std::stoul(argv[3])),
+                                       shaping,
+                                       static_cast<std::uint16_t>(std::stoul(argv[1])));
+
+        cout << "Listening on 127.0.0.1:" << proxy.port() << endl;
+
+        int signal;
+        sigwait(&signals, &signal);
+
+        proxy.stop();
+    }
+    catch (const exception & ex)
+    {
+        cerr << ex.what() << endl;
+        return EXIT_FAILURE;
+    }
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,586 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "shaping_proxy.hpp"
+#include <boost/asio/connect.hpp>
+#include <boost/asio/write.hpp>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <random>
+#include <regex>
+#include <stdexcept>
+#include <vector>
+#include <sys/socket.h>
+
+namespace ftp::test
+{
+
+using std::string;
+using std::uint16_t;
+using std::uint64_t;
+using std::size_t;
+using std::lock_guard;
+using std::unique_lock;
+using std::mutex;
+using std::chrono::steady_clock;
+using std::chrono::milliseconds;
+
+using boost::asio::ip::tcp;
+
+/* The most data sent at once, which is how finely bandwidth and stalls
+ * apply.
+ */
+static const size_t piece_size = 16 * 1024;
+
+/* The most data a direction holds, the sender is held back beyond that. */
+static const size_t max_queued = 4 * 1024 * 1024;
+
+/* Wakes up a thread blocked on the socket, which closing doesn't do. */
+template <typename Socket>
+static void shutdown_socket(Socket & socket)
+{
+    if (socket.is_open())
+    {
+        ::shutdown(socket.native_handle(), SHUT_RDWR);
+    }
+}
+
+/* The shared bandwidth of one direction. Pieces of data of all connections
+ * take turns in the order they come, like packets queued at a bottleneck.
+ */
+class shaping_proxy::bottleneck
+{
+public:
+    explicit bottleneck(uint64_t bandwidth)
+        : bandwidth_(bandwidth),
+          next_send_(steady_clock::now())
+    {
+    }
+
+    /* Waits for the turn of the piece. */
+    void send(size_t size)
+    {
+        steady_clock::time_point turn;
+
+        {
+            lock_guard<mutex> lock(mutex_);
+
+            turn = std::max(next_send_, steady_clock::now());
+            next_send_ = turn + std::chrono::duration_cast<steady_clock::duration>(
+                                    std::chrono::duration<double>(static_cast<double>(size) / bandwidth_));
+        }
+
+        std::this_thread::sleep_until(turn);
+    }
+
+private:
+    uint64_t bandwidth_;
+    mutex mutex_;
+    steady_clock::time_point next_send_;
+};
+
+/* One direction of a connection. The reader queues the data with the time
+ * it's due, the writer sends it then, at the allowed rate.
+ */
+class shaping_proxy::link
+{
+public:
+    using rewriter = std::function<string(const string & line)>;
+
+    link(tcp::socket & from,
+         tcp::socket & to,
+         const struct shaping & shaping,
+         bottleneck *shared,
+         const rewriter & rewrite)
+        : from_(from),
+          to_(to),
+          shaping_(shaping),
+          shared_(shared),
+          rewrite_(rewrite),
+          queued_(0),
+          closed_(false),
+          failed_(false),
+          random_(std::random_device()())
+    {
+    }
+
+    void read()
+    {
+        std::vector<char> buffer(64 * 1024);
+        std::uniform_int_distribution<milliseconds::rep> jitter(0, shaping_.jitter.count());
+        steady_clock::time_point last_release;
+
+        for (;;)
+        {
+            boost::system::error_code ec;
+            size_t size = from_.read_some(boost::asio::buffer(buffer), ec);
+
+            if (ec)
+            {
+                break;
+            }
+
+            string data(buffer.data(), size);
+
+            if (rewrite_)
+            {
+                data = rewrite_lines(data);
+
+                if (data.empty())
+                {
+                    continue;
+                }
+            }
+
+            steady_clock::time_point release = steady_clock::now() + shaping_.rtt / 2 + milliseconds(jitter(random_));
+
+            /* The handshake. */
+            if (last_release == steady_clock::time_point())
+            {
+                release += shaping_.rtt;
+            }
+
+            /* TCP doesn't reorder the stream. */
+            release = std::max(release, last_release);
+            last_release = release;
+
+            unique_lock<mutex> lock(mutex_);
+
+            changed_.wait(lock, [this]() { return queued_ < max_queued || failed_; });
+
+            if (failed_)
+            {
+                break;
+            }
+
+            queued_ += data.size();
+            queue_.push_back(chunk{release, std::move(data)});
+            changed_.notify_all();
+        }
+
+        lock_guard<mutex> lock(mutex_);
+
+        if (!line_.empty())
+        {
+            queue_.push_back(chunk{steady_clock::now() + shaping_.rtt / 2, std::move(line_)});
+        }
+
+        closed_ = true;
+        changed_.notify_all();
+    }
+
+    void write()
+    {
+        std::exponential_distribution<double> stalls(shaping_.stall_interval.count() > 0 ?
+                                                     1.0 / shaping_.stall_interval.count() : 1.0);
+        steady_clock::time_point next_send = steady_clock::now();
+        steady_clock::time_point next_stall = next_send + milliseconds(static_cast<milliseconds::rep>(stalls(random_)));
+
+        for (;;)
+        {
+            chunk chunk;
+
+            {
+                unique_lock<mutex> lock(mutex_);
+
+                changed_.wait(lock, [this]() { return !queue_.empty() || closed_; });
+
+                if (queue_.empty())
+                {
+                    break;
+                }
+
+                chunk = std::move(queue_.front());
+                queue_.pop_front();
+                queued_ -= chunk.data.size();
+                changed_.notify_all();
+            }
+
+            std::this_thread::sleep_until(chunk.release);
+
+            for (size_t offset = 0; offset < chunk.data.size(); offset += piece_size)
+            {
+                size_t size = std::min(piece_size, chunk.data.size() - offset);
+
+                if (shaping_.bandwidth > 0)
+                {
+                    std::this_thread::sleep_until(next_send);
+
+                    next_send = std::max(next_send, steady_clock::now()) +
+                                std::chrono::duration_cast<steady_clock::duration>(
+                                    std::chrono::duration<double>(static_cast<double>(size) / shaping_.bandwidth));
+                }
+
+                if (shared_)
+                {
+                    shared_->send(size);
+                }
+
+                if (shaping_.stall_interval.count() > 0 && steady_clock::now() >= next_stall)
+                {
+                    std::this_thread::sleep_for(shaping_.stall_duration);
+
+                    next_stall = steady_clock::now() +
+                                 milliseconds(static_cast<milliseconds::rep>(stalls(random_)));
+                }
+
+                boost::system::error_code ec;
+                boost::asio::write(to_, boost::asio::buffer(chunk.data.data() + offset, size), ec);
+
+                if (ec)
+                {
+                    fail();
+                    return;
+                }
+            }
+        }
+
+        /* Pass the end of data on. */
+        boost::system::error_code ignored;
+        to_.shutdown(tcp::socket::shutdown_send, ignored);
+    }
+
+private:
+    struct chunk
+    {
+        steady_clock::time_point release;
+        string data;
+    };
+
+    /* Only complete lines are rewritten and passed on. */
+    string rewrite_lines(const string & data)
+    {
+        line_ += data;
+
+        string result;
+        size_t start = 0;
+
+        for (size_t end = line_.find("\r\n"); end != string::npos; end = line_.find("\r\n", start))
+        {
+            result += rewrite_(line_.substr(start, end - start)) + "\r\n";
+            start = end + 2;
+        }
+
+        line_.erase(0, start);
+
+        return result;
+    }
+
+    void fail()
+    {
+        {
+            lock_guard<mutex> lock(mutex_);
+            failed_ = true;
+            changed_.notify_all();
+        }
+
+        shutdown_socket(from_);
+        shutdown_socket(to_);
+    }
+
+    tcp::socket & from_;
+    tcp::socket & to_;
+    struct shaping shaping_;
+    bottleneck *shared_;
+    rewriter rewrite_;
+    mutex mutex_;
+    std::condition_variable changed_;
+    std::deque<chunk> queue_;
+    size_t queued_;
+    bool closed_;
+    bool failed_;
+    string line_;
+    std::mt19937 random_;
+};
+
+struct shaping_proxy::connection
+{
+    explicit connection(boost::asio::io_context & io_context)
+        : client(io_context),
+          server(io_context),
+          finished(0)
+    {
+    }
+
+    tcp::socket client;
+    tcp::socket server;
+    std::unique_ptr<link> upstream;
+    std::unique_ptr<link> downstream;
+    std::vector<std::thread> threads;
+    std::atomic<size_t> finished;
+};
+
+struct shaping_proxy::listener
+{
+    listener(boost::asio::io_context & io_context, const tcp::endpoint & server, bool control)
+        : acceptor(io_context, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0)),
+          server(server),
+          control(control),
+          done(false)
+    {
+    }
+
+    tcp::acceptor acceptor;
+    tcp::endpoint server;
+    bool control;
+    std::thread thread;
+    std::atomic<bool> done;
+};
+
+shaping_proxy::shaping_proxy(const string & server_host,
+                             uint16_t server_port,
+                             const struct shaping & shaping,
+                             uint16_t port)
+    : shaping_(shaping),
+      port_(0),
+      stopped_(false)
+{
+    tcp::resolver resolver(io_context_);
+    server_ = *resolver.resolve(server_host, std::to_string(server_port)).begin();
+
+    if (shaping.shared_bandwidth > 0)
+    {
+        upstream_ = std::make_unique<bottleneck>(shaping.shared_bandwidth);
+        downstream_ = std::make_unique<bottleneck>(shaping.shared_bandwidth);
+    }
+
+    auto listener = std::make_unique<struct listener>(io_context_, server_, true);
+
+    if (port != 0)
+    {
+        listener->acceptor = tcp::acceptor(io_context_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), port));
+    }
+
+    port_ = listener->acceptor.local_endpoint().port();
+    listener->thread = std::thread(&shaping_proxy::accept, this, std::ref(*listener));
+    listeners_.push_back(std::move(listener));
+}
+
+shaping_proxy::~shaping_proxy()
+{
+    stop();
+}
+
+uint16_t shaping_proxy::port() const
+{
+    return port_;
+}
+
+void shaping_proxy::stop()
+{
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        if (stopped_.exchange(true))
+        {
+            return;
+        }
+
+        for (const auto & listener : listeners_)
+        {
+            shutdown_socket(listener->acceptor);
+        }
+
+        for (const auto & connection : connections_)
+        {
+            shutdown_socket(connection->client);
+            shutdown_socket(connection->server);
+        }
+    }
+
+    /* No threads are started once stopped. */
+    for (const auto & listener : listeners_)
+    {
+        listener->thread.join();
+    }
+
+    for (const auto & connection : connections_)
+    {
+        for (std::thread & thread : connection->threads)
+        {
+            thread.join();
+        }
+    }
+
+    listeners_.clear();
+    connections_.clear();
+}
+
+void shaping_proxy::accept(listener & listener)
+{
+    do
+    {
+        tcp::socket client(io_context_);
+        boost::system::error_code ec;
+
+        listener.acceptor.accept(client, ec);
+
+        if (ec)
+        {
+            if (stopped_)
+            {
+                break;
+            }
+
+            continue;
+        }
+
+        forward(client, listener.server, listener.control);
+    }
+    while (listener.control && !stopped_);
+
+    listener.done = true;
+}
+
+void shaping_proxy::forward(tcp::socket & client, const tcp::endpoint & server, bool control)
+{
+    auto connection = std::make_unique<struct connection>(io_context_);
+    boost::system::error_code ec;
+
+    connection->client = std::move(client);
+    connection->server.connect(server, ec);
+
+    if (ec)
+    {
+        return;
+    }
+
+    link::rewriter rewrite;
+
+    if (control)
+    {
+        rewrite = [this](const string & line) { return rewrite_reply(line); };
+    }
+
+    connection->upstream = std::make_unique<link>(connection->client, connection->server, shaping_,
+                                                  upstream_.get(), nullptr);
+    connection->downstream = std::make_unique<link>(connection->server, connection->client, shaping_,
+                                                    downstream_.get(), rewrite);
+
+    lock_guard<mutex> lock(mutex_);
+
+    if (stopped_)
+    {
+        return;
+    }
+
+    reap();
+
+    struct connection & started = *connection;
+
+    for (link *link : {started.upstream.get(), started.downstream.get()})
+    {
+        started.threads.emplace_back([link, &started]() { link->read(); started.finished++; });
+        started.threads.emplace_back([link, &started]() { link->write(); started.finished++; });
+    }
+
+    connections_.push_back(std::move(connection));
+}
+
+string shaping_proxy::rewrite_reply(const string & reply)
+{
+    static const std::regex epsv(R"(^229 .*\(\|\|\|(\d+)\|\).*$)");
+    static const std::regex pasv(R"(^227 .*\((\d+),(\d+),(\d+),(\d+),(\d+),(\d+)\).*$)");
+
+    std::smatch match;
+
+    if (std::regex_match(reply, match, epsv))
+    {
+        tcp::endpoint server(server_.address(), static_cast<uint16_t>(std::stoi(match[1])));
+        uint16_t port = listen(server, false);
+
+        return "229 Entering extended passive mode (|||" + std::to_string(port) + "|).";
+    }
+
+    if (std::regex_match(reply, match, pasv))
+    {
+        string host = match.str(1) + "." + match.str(2) + "." + match.str(3) + "." + match.str(4);
+        int server_port = std::stoi(match[5]) * 256 + std::stoi(match[6]);
+
+        tcp::endpoint server(boost::asio::ip::make_address(host), static_cast<uint16_t>(server_port));
+        uint16_t port = listen(server, false);
+
+        return "227 Entering passive mode (127,0,0,1," + std::to_string(port / 256) + "," +
+               std::to_string(port % 256) + ").";
+    }
+
+    return reply;
+}
+
+uint16_t shaping_proxy::listen(const tcp::endpoint & server, bool control)
+{
+    auto listener = std::make_unique<struct listener>(io_context_, server, control);
+    uint16_t port = listener->acceptor.local_endpoint().port();
+
+    lock_guard<mutex> lock(mutex_);
+
+    if (stopped_)
+    {
+        return 0;
+    }
+
+    reap();
+
+    listener->thread = std::thread(&shaping_proxy::accept, this, std::ref(*listener));
+    listeners_.push_back(std::move(listener));
+
+    return port;
+}
+
+void shaping_proxy::reap()
+{
+    for (auto it = listeners_.begin(); it != listeners_.end();)
+    {
+        if ((*it)->done)
+        {
+            (*it)->thread.join();
+            it = listeners_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    for (auto it = connections_.begin(); it != connections_.end();)
+    {
+        if ((*it)->finished == (*it)->threads.size())
+        {
+            for (std::thread & thread : (*it)->threads)
+            {
+                thread.join();
+            }
+
+            it = connections_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+} // namespace ftp::test
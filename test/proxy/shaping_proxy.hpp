@@ -0,0 +1,155 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_SHAPING_PROXY_HPP
+#define FTP_SHAPING_PROXY_HPP
+
+#include <boost/asio/ip/tcp.hpp>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <cstdint>
+
+namespace ftp::test
+{
+
+/* How a shaping_proxy degrades the connections. Each direction of each
+ * connection is shaped on its own, like a path with a dedicated link, and
+ * may share a bottleneck with the other connections of the proxy as well.
+ */
+struct shaping
+{
+    shaping()
+        : rtt(0),
+          jitter(0),
+          bandwidth(0),
+          shared_bandwidth(0),
+          stall_interval(0),
+          stall_duration(0)
+    {
+    }
+
+    /* Added to the round trip time, half in each direction. The first data
+     * of each direction of a connection waits another round trip, which is
+     * what the handshake costs.
+     */
+    std::chrono::milliseconds rtt;
+
+    /* Each chunk of data is delayed by up to this much more, without
+     * reordering the stream.
+     */
+    std::chrono::milliseconds jitter;
+
+    /* Bytes per second in each direction, 0 means unlimited. */
+    std::uint64_t bandwidth;
+
+    /* Bytes per second in each direction, shared by all connections of the
+     * proxy, e.g. the sessions of a client and their data connections. 0
+     * means unlimited.
+     */
+    std::uint64_t shared_bandwidth;
+
+    /* Every stall_interval on average, a direction stops for stall_duration,
+     * like TCP waiting for a lost packet to be retransmitted. 0 means no
+     * stalls.
+     */
+    std::chrono::milliseconds stall_interval;
+    std::chrono::milliseconds stall_duration;
+};
+
+/* Forwards FTP sessions to a server through shaped connections. Replies to
+ * EPSV and PASV are rewritten to ports of the proxy, so that the data
+ * connections are shaped as well. TLS control connections can't be
+ * rewritten and are not supported.
+ *
+ * Nothing but sockets and threads is used, so it works without root and
+ * without tc.
+ */
+class shaping_proxy
+{
+public:
+    /* Listens on 127.0.0.1, on an ephemeral port unless one is given. */
+    shaping_proxy(const std::string & server_host,
+                  std::uint16_t server_port,
+                  const struct shaping & shaping,
+                  std::uint16_t port = 0);
+
+    shaping_proxy(const shaping_proxy &) = delete;
+
+    shaping_proxy & operator=(const shaping_proxy &) = delete;
+
+    ~shaping_proxy();
+
+    std::uint16_t port() const;
+
+    /* Closes all connections. Called by the destructor. */
+    void stop();
+
+private:
+    class bottleneck;
+
+    class link;
+
+    struct connection;
+
+    struct listener;
+
+    /* Accepts control connections until stopped, or a single data
+     * connection.
+     */
+    void accept(listener & listener);
+
+    void forward(boost::asio::ip::tcp::socket & client,
+                 const boost::asio::ip::tcp::endpoint & server,
+                 bool control);
+
+    /* Replaces the port in replies to EPSV and PASV with a new listener. */
+    std::string rewrite_reply(const std::string & reply);
+
+    /* Returns 0 if stopped. */
+    std::uint16_t listen(const boost::asio::ip::tcp::endpoint & server, bool control);
+
+    /* Joins the threads that are done. */
+    void reap();
+
+    struct shaping shaping_;
+    boost::asio::io_context io_context_;
+    boost::asio::ip::tcp::endpoint server_;
+    std::uint16_t port_;
+    std::mutex mutex_;
+    std::list<std::unique_ptr<listener>> listeners_;
+    std::list<std::unique_ptr<connection>> connections_;
+
+    /* nullptr without a shared bandwidth. */
+    std::unique_ptr<bottleneck> upstream_;
+    std::unique_ptr<bottleneck> downstream_;
+    std::atomic<bool> stopped_;
+};
+
+} // namespace ftp::test
+#endif //FTP_SHAPING_PROXY_HPP
@@ -0,0 +1,961 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "test_server.hpp"
+#include <boost/asio/read_until.hpp>
+#include <boost/asio/streambuf.hpp>
+#include <boost/asio/write.hpp>
+#include <algorithm>
+#include <cctype>
+#include <istream>
+#include <limits>
+#include <vector>
+#include <sys/socket.h>
+
+namespace ftp::test
+{
+
+using std::string;
+using std::uint16_t;
+using std::uint64_t;
+using std::size_t;
+using std::lock_guard;
+using std::mutex;
+using std::shared_ptr;
+using std::optional;
+using std::chrono::milliseconds;
+
+using boost::asio::ip::tcp;
+
+/* Byte i of a synthetic file is 'a' + i % 26. */
+static const size_t pattern_size = 26 * 40960;
+
+static const string & pattern()
+{
+    static const string pattern = []()
+    {
+        string pattern(pattern_size, 'a');
+
+        for (size_t i = 0; i < pattern_size; i++)
+        {
+            pattern[i] = static_cast<char>('a' + i % 26);
+        }
+
+        return pattern;
+    }();
+
+    return pattern;
+}
+
+/* The most sent or received between checks for ABOR. */
+static const size_t chunk_size = 1024 * 1024;
+
+/* Wakes up a thread blocked on the connected socket, which closing doesn't
+ * do.
+ */
+static void shutdown_socket(tcp::socket & socket)
+{
+    if (socket.is_open())
+    {
+        ::shutdown(socket.native_handle(), SHUT_RDWR);
+    }
+}
+
+/* Wakes up a thread blocked in accept() by connecting to the acceptor.
+ * Shutting a listening socket down only does that on Linux.
+ */
+static void wake_up(const tcp::acceptor & acceptor)
+{
+    boost::asio::io_context io_context;
+    tcp::socket socket(io_context);
+    boost::system::error_code ec;
+    tcp::endpoint endpoint = acceptor.local_endpoint(ec);
+
+    if (!ec)
+    {
+        socket.connect(endpoint, ec);
+    }
+}
+
+class server::session
+{
+public:
+    session(server & server, tcp::socket socket)
+        : server_(server),
+          control_(std::move(socket)),
+          data_(nullptr),
+          logged_in_(false),
+          offset_(0),
+          aborted_(false),
+          dropped_(false),
+          stopped_(false),
+          finished_(false),
+          thread_(&session::run, this)
+    {
+    }
+
+    session(const session &) = delete;
+
+    session & operator=(const session &) = delete;
+
+    ~session()
+    {
+        thread_.join();
+    }
+
+    /* The thread is done and only needs to be joined. */
+    bool finished() const
+    {
+        return finished_;
+    }
+
+    void stop()
+    {
+        lock_guard<mutex> lock(mutex_);
+
+        stopped_ = true;
+        shutdown_socket(control_);
+
+        if (data_acceptor_)
+        {
+            wake_up(*data_acceptor_);
+        }
+
+        if (data_)
+        {
+            shutdown_socket(*data_);
+        }
+    }
+
+private:
+    void run()
+    {
+        reply("", "220 FTP server is ready.");
+
+        string line;
+
+        while (read_command(line))
+        {
+            string verb = line.substr(0, line.find(' '));
+            string argument = verb.size() < line.size() ? line.substr(verb.size() + 1) : string();
+
+            std::transform(verb.begin(), verb.end(), verb.begin(),
+                           [](unsigned char c) { return static_cast<char>(std::toupper(c)); });
+
+            if (!handle(verb, argument) || dropped_)
+            {
+                break;
+            }
+        }
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            boost::system::error_code ignored;
+            control_.close(ignored);
+        }
+
+        finished_ = true;
+    }
+
+    /* Returns false once the session is over. */
+    bool handle(const string & verb, const string & argument)
+    {
+        if (verb == "QUIT")
+        {
+            reply(verb, "221 Goodbye.");
+            return false;
+        }
+        else if (verb == "NOOP")
+        {
+            reply(verb, "200 NOOP command successful.");
+        }
+        else if (verb == "SYST")
+        {
+            reply(verb, "215 UNIX Type: L8");
+        }
+        else if (verb == "USER")
+        {
+            logged_in_ = false;
+            username_ = argument;
+            reply(verb, "331 Username ok, send password.");
+        }
+        else if (verb == "PASS")
+        {
+            logged_in_ = server_.is_valid_login(username_, argument);
+            reply(verb, logged_in_ ? "230 Login successful." : "530 Authentication failed.");
+        }
+        else if (verb == "ABOR")
+        {
+            reply(verb, aborted_ ? "226 ABOR command successful." : "225 No transfer to abort.");
+            aborted_ = false;
+        }
+        else if (!logged_in_)
+        {
+            reply(verb, "530 Log in with USER and PASS first.");
+        }
+        else if (verb == "PWD")
+        {
+            reply(verb, "257 \"/" + directory_ + "\" is the current directory.");
+        }
+        else if (verb == "CWD" || verb == "CDUP")
+        {
+            change_directory(verb == "CDUP" ? ".." : argument);
+            reply(verb, "250 Directory changed to /" + directory_ + ".");
+        }
+        else if (verb == "TYPE")
+        {
+            if (argument == "A" || argument == "I" || argument == "L 8")
+            {
+                reply(verb, "200 Type set to " + argument + ".");
+            }
+            else
+            {
+                reply(verb, "504 Unsupported type '" + argument + "'.");
+            }
+        }
+        else if (verb == "EPSV" || verb == "PASV")
+        {
+            passive(verb);
+        }
+        else if (verb == "REST")
+        {
+            try
+            {
+                offset_ = std::stoull(argument);
+                reply(verb, "350 Restarting at position " + argument + ".");
+            }
+            catch (const std::exception &)
+            {
+                reply(verb, "501 Invalid REST parameter.");
+            }
+        }
+        else if (verb == "SIZE")
+        {
+            optional<uint64_t> size = server_.file_size(path(argument));
+
+            reply(verb, size ? "213 " + std::to_string(*size) : "550 No such file.");
+        }
+        else if (verb == "RETR")
+        {
+            retr(verb, path(argument));
+        }
+        else if (verb == "STOR" || verb == "APPE")
+        {
+            stor(verb, path(argument));
+        }
+        else if (verb == "LIST" || verb == "MLSD")
+        {
+            list(verb, path(argument));
+        }
+        else
+        {
+            reply(verb, "502 Command not implemented.");
+        }
+
+        return true;
+    }
+
+    /* Names are relative to the working directory unless they start with
+     * a slash.
+     */
+    string path(const string & name) const
+    {
+        if (!name.empty() && name[0] == '/')
+        {
+            return name.substr(1);
+        }
+
+        if (directory_.empty() || name.empty())
+        {
+            return directory_.empty() ? name : directory_;
+        }
+
+        return directory_ + "/" + name;
+    }
+
+    void change_directory(const string & directory)
+    {
+        if (directory == "..")
+        {
+            size_t slash = directory_.rfind('/');
+            directory_.erase(slash == string::npos ? 0 : slash);
+            return;
+        }
+
+        directory_ = path(directory);
+
+        while (!directory_.empty() && directory_.back() == '/')
+        {
+            directory_.pop_back();
+        }
+    }
+
+    void passive(const string & verb)
+    {
+        auto acceptor = std::make_unique<tcp::acceptor>(server_.io_context_,
+                                                        tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+        uint16_t port = acceptor->local_endpoint().port();
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            data_acceptor_ = std::move(acceptor);
+        }
+
+        if (verb == "EPSV")
+        {
+            reply(verb, "229 Entering extended passive mode (|||" + std::to_string(port) + "|).");
+        }
+        else
+        {
+            reply(verb, "227 Entering passive mode (127,0,0,1," + std::to_string(port / 256) + "," +
+                        std::to_string(port % 256) + ").");
+        }
+    }
+
+    void retr(const string & verb, const string & name)
+    {
+        optional<file_entry> file = server_.find_file(name);
+        uint64_t offset = std::exchange(offset_, 0);
+
+        if (!file)
+        {
+            reply(verb, "550 No such file.");
+            return;
+        }
+
+        offset = std::min(offset, file->size);
+
+        optional<transfer_failure> failing = server_.take_failure();
+        uint64_t end = failing ? std::min(file->size, offset + failing->bytes) : file->size;
+
+        transfer(verb, "150 Opening data connection for " + name + " (" + std::to_string(file->size) + " bytes).",
+                 [&](tcp::socket & data)
+        {
+            boost::system::error_code ec;
+
+            while (offset < end && !ec)
+            {
+                size_t size = static_cast<size_t>(std::min<uint64_t>(end - offset, chunk_size));
+
+                if (file->content)
+                {
+                    boost::asio::write(data, boost::asio::buffer(file->content->data() + offset, size), ec);
+                }
+                else
+                {
+                    size_t start = static_cast<size_t>(offset % pattern_size);
+                    size = std::min(size, pattern_size - start);
+                    boost::asio::write(data, boost::asio::buffer(pattern().data() + start, size), ec);
+                }
+
+                offset += size;
+
+                if (abort_requested())
+                {
+                    return false;
+                }
+            }
+
+            if (failing)
+            {
+                return fail(failing->how);
+            }
+
+            return !ec;
+        });
+    }
+
+    void stor(const string & verb, const string & name)
+    {
+        uint64_t offset = std::exchange(offset_, 0);
+        optional<file_entry> existing = server_.find_file(name);
+        bool keep = server_.keeps_uploads();
+
+        uint64_t size = 0;
+        string content;
+
+        if (existing)
+        {
+            size = verb == "APPE" ? existing->size : std::min(offset, existing->size);
+
+            if (keep)
+            {
+                content = contents(*existing, size);
+            }
+        }
+
+        optional<transfer_failure> failing = server_.take_failure();
+        uint64_t end = failing ? size + failing->bytes : std::numeric_limits<uint64_t>::max();
+
+        /* Like most servers, keep what was received, even if incomplete. */
+        auto store = [&]()
+        {
+            if (keep)
+            {
+                server_.add_file(name, content);
+            }
+            else
+            {
+                server_.add_synthetic_file(name, size);
+            }
+        };
+
+        transfer(verb, "150 Opening data connection for " + name + ".", [&](tcp::socket & data)
+        {
+            std::vector<char> buffer(chunk_size);
+            boost::system::error_code ec;
+
+            for (;;)
+            {
+                size_t limit = static_cast<size_t>(std::min<uint64_t>(buffer.size(), end - size));
+                size_t received = data.read_some(boost::asio::buffer(buffer.data(), limit), ec);
+
+                if (keep)
+                {
+                    content.append(buffer.data(), received);
+                }
+
+                size += received;
+
+                if (ec)
+                {
+                    break;
+                }
+
+                /* Stored before the connection drops, so that the client
+                 * finds it when it reconnects.
+                 */
+                if (size == end)
+                {
+                    if (failing->how == failure::disconnect)
+                    {
+                        store();
+                    }
+
+                    return fail(failing->how);
+                }
+
+                if (abort_requested())
+                {
+                    return false;
+                }
+            }
+
+            return ec == boost::asio::error::eof;
+        });
+
+        if (!dropped_)
+        {
+            store();
+        }
+    }
+
+    void list(const string & verb, const string & directory)
+    {
+        string listing;
+        string prefix = directory.empty() || directory == "/" ? string() : directory + "/";
+
+        for (const auto & [name, size] : server_.list_files(prefix))
+        {
+            if (verb == "MLSD")
+            {
+                listing += "type=file;size=" + std::to_string(size) + "; " + name + "\r\n";
+            }
+            else
+            {
+                listing += "-rw-r--r-- 1 user user " + std::to_string(size) + " Jan 01 00:00 " + name + "\r\n";
+            }
+        }
+
+        transfer(verb, "150 Opening data connection for the listing.", [&](tcp::socket & data)
+        {
+            boost::system::error_code ec;
+
+            boost::asio::write(data, boost::asio::buffer(listing), ec);
+
+            return !ec;
+        });
+    }
+
+    /* Accepts the data connection of the last EPSV or PASV and runs the
+     * transfer, which returns false if it fails or is aborted.
+     */
+    template <typename Transfer>
+    void transfer(const string & verb, const string & preliminary_reply, const Transfer & transfer)
+    {
+        bool passive;
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            passive = data_acceptor_ != nullptr;
+        }
+
+        if (!passive)
+        {
+            reply(verb, "425 Use PASV or EPSV first.");
+            return;
+        }
+
+        reply(verb, preliminary_reply);
+
+        tcp::socket data(server_.io_context_);
+        boost::system::error_code ec;
+
+        /* The client connects before it sends the command. */
+        data_acceptor_->accept(data, ec);
+
+        bool stopped;
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            data_acceptor_.reset();
+            data_ = &data;
+            stopped = stopped_;
+        }
+
+        /* The data connection may be the one that woke the session up. */
+        bool completed = !ec && !stopped && transfer(data);
+
+        if (completed)
+        {
+            data.shutdown(tcp::socket::shutdown_send, ec);
+        }
+
+        {
+            lock_guard<mutex> lock(mutex_);
+            data_ = nullptr;
+            data.close(ec);
+        }
+
+        if (dropped_)
+        {
+            return;
+        }
+
+        if (completed)
+        {
+            reply(verb, "226 Transfer complete.");
+        }
+        else
+        {
+            aborted_ = true;
+            reply(verb, "426 Connection closed; transfer aborted.");
+        }
+    }
+
+    /* Returns false, for the transfer to fail. */
+    bool fail(failure how)
+    {
+        if (how == failure::disconnect)
+        {
+            dropped_ = true;
+            return false;
+        }
+
+        string line;
+
+        while (read_line(line))
+        {
+            pending_.push_back(line);
+
+            if (line.compare(0, 4, "ABOR") == 0)
+            {
+                break;
+            }
+        }
+
+        return false;
+    }
+
+    /* Commands that arrive during a transfer, other than ABOR, wait for the
+     * end of it.
+     */
+    bool abort_requested()
+    {
+        boost::system::error_code ec;
+
+        if (buffer_.size() == 0 && control_.available(ec) == 0 && !ec)
+        {
+            return false;
+        }
+
+        string line;
+
+        if (!read_line(line))
+        {
+            return true;
+        }
+
+        if (line.compare(0, 4, "ABOR") == 0)
+        {
+            pending_.push_back(line);
+            return true;
+        }
+
+        pending_.push_back(line);
+
+        return false;
+    }
+
+    bool read_command(string & line)
+    {
+        if (!pending_.empty())
+        {
+            line = pending_.front();
+            pending_.erase(pending_.begin());
+            return true;
+        }
+
+        return read_line(line);
+    }
+
+    bool read_line(string & line)
+    {
+        boost::system::error_code ec;
+
+        boost::asio::read_until(control_, buffer_, "\r\n", ec);
+
+        if (ec)
+        {
+            return false;
+        }
+
+        std::istream stream(&buffer_);
+        std::getline(stream, line);
+
+        if (!line.empty() && line.back() == '\r')
+        {
+            line.pop_back();
+        }
+
+        return true;
+    }
+
+    void reply(const string & verb, const string & reply)
+    {
+        milliseconds delay = server_.reply_delay(verb);
+
+        if (delay > milliseconds::zero())
+        {
+            std::this_thread::sleep_for(delay);
+        }
+
+        boost::system::error_code ignored;
+        boost::asio::write(control_, boost::asio::buffer(reply + "\r\n"), ignored);
+    }
+
+    static string contents(const file_entry & file, uint64_t size)
+    {
+        if (file.content)
+        {
+            return file.content->substr(0, size);
+        }
+
+        string content;
+        content.reserve(size);
+
+        for (uint64_t i = 0; i < size; i++)
+        {
+            content += static_cast<char>('a' + i % 26);
+        }
+
+        return content;
+    }
+
+    server & server_;
+    mutex mutex_;
+    tcp::socket control_;
+    boost::asio::streambuf buffer_;
+    std::vector<string> pending_;
+    std::unique_ptr<tcp::acceptor> data_acceptor_;
+    tcp::socket *data_;
+    string username_;
+    bool logged_in_;
+    uint64_t offset_;
+    bool aborted_;
+
+    /* Set when a failing transfer ends the session. */
+    bool dropped_;
+    bool stopped_;
+    string directory_;
+    std::atomic<bool> finished_;
+    std::thread thread_;
+};
+
+server::server(uint16_t port)
+    : acceptor_(io_context_, tcp::endpoint(boost::asio::ip::address_v4::loopback(), port)),
+      username_("user"),
+      password_("password"),
+      keep_uploads_(true),
+      reply_delay_(milliseconds::zero()),
+      failure_{0, failure::disconnect},
+      failures_(0),
+      session_count_(0),
+      stopped_(false)
+{
+    accept_thread_ = std::thread(&server::accept, this);
+}
+
+server::~server()
+{
+    stop();
+}
+
+uint16_t server::port() const
+{
+    return acceptor_.local_endpoint().port();
+}
+
+void server::set_credentials(const string & username, const string & password)
+{
+    lock_guard<mutex> lock(mutex_);
+    username_ = username;
+    password_ = password;
+}
+
+void server::add_file(const string & name, const string & content)
+{
+    lock_guard<mutex> lock(mutex_);
+    files_[name] = file_entry{std::make_shared<const string>(content), content.size()};
+}
+
+void server::add_synthetic_file(const string & name, uint64_t size)
+{
+    lock_guard<mutex> lock(mutex_);
+    files_[name] = file_entry{nullptr, size};
+}
+
+void server::remove_file(const string & name)
+{
+    lock_guard<mutex> lock(mutex_);
+    files_.erase(name);
+}
+
+optional<string> server::file(const string & name) const
+{
+    optional<file_entry> file = find_file(name);
+
+    if (!file || !file->content)
+    {
+        return std::nullopt;
+    }
+
+    return *file->content;
+}
+
+optional<uint64_t> server::file_size(const string & name) const
+{
+    optional<file_entry> file = find_file(name);
+
+    if (!file)
+    {
+        return std::nullopt;
+    }
+
+    return file->size;
+}
+
+void server::set_keep_uploads(bool keep)
+{
+    lock_guard<mutex> lock(mutex_);
+    keep_uploads_ = keep;
+}
+
+void server::set_reply_delay(milliseconds delay)
+{
+    lock_guard<mutex> lock(mutex_);
+    reply_delay_ = delay;
+}
+
+void server::set_reply_delay(const string & command, milliseconds delay)
+{
+    lock_guard<mutex> lock(mutex_);
+    command_delays_[command] = delay;
+}
+
+void server::fail_transfers(uint64_t bytes, unsigned int count, failure how)
+{
+    lock_guard<mutex> lock(mutex_);
+    failure_ = transfer_failure{bytes, how};
+    failures_ = count;
+}
+
+size_t server::session_count() const
+{
+    return session_count_;
+}
+
+void server::stop()
+{
+    if (stopped_.exchange(true))
+    {
+        return;
+    }
+
+    wake_up(acceptor_);
+    accept_thread_.join();
+
+    std::list<std::unique_ptr<session>> sessions;
+
+    {
+        lock_guard<mutex> lock(mutex_);
+        sessions.swap(sessions_);
+    }
+
+    for (const auto & session : sessions)
+    {
+        session->stop();
+    }
+
+    /* Joins the session threads. */
+    sessions.clear();
+}
+
+size_t server::open_sessions()
+{
+    lock_guard<mutex> lock(mutex_);
+    reap();
+
+    return sessions_.size();
+}
+
+void server::accept()
+{
+    for (;;)
+    {
+        tcp::socket socket(io_context_);
+        boost::system::error_code ec;
+
+        acceptor_.accept(socket, ec);
+
+        /* The connection of stop() only wakes the thread up. */
+        if (stopped_)
+        {
+            break;
+        }
+
+        if (ec)
+        {
+            continue;
+        }
+
+        session_count_++;
+
+        lock_guard<mutex> lock(mutex_);
+        reap();
+        sessions_.push_back(std::make_unique<session>(*this, std::move(socket)));
+    }
+}
+
+void server::reap()
+{
+    for (auto it = sessions_.begin(); it != sessions_.end();)
+    {
+        if ((*it)->finished())
+        {
+            /* Joins the thread, which is done. */
+            it = sessions_.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+}
+
+optional<server::file_entry> server::find_file(const string & name) const
+{
+    lock_guard<mutex> lock(mutex_);
+
+    auto it = files_.find(name);
+
+    if (it == files_.end())
+    {
+        return std::nullopt;
+    }
+
+    return it->second;
+}
+
+std::vector<std::pair<string, uint64_t>> server::list_files(const string & prefix) const
+{
+    lock_guard<mutex> lock(mutex_);
+
+    std::vector<std::pair<string, uint64_t>> files;
+
+    for (auto it = files_.lower_bound(prefix); it != files_.end(); ++it)
+    {
+        if (it->first.compare(0, prefix.size(), prefix) != 0)
+        {
+            break;
+        }
+
+        string name = it->first.substr(prefix.size());
+
+        /* Files of subdirectories are not listed. */
+        if (name.find('/') == string::npos)
+        {
+            files.emplace_back(name, it->second.size);
+        }
+    }
+
+    return files;
+}
+
+bool server::is_valid_login(const string & username, const string & password) const
+{
+    lock_guard<mutex> lock(mutex_);
+    return username == username_ && password == password_;
+}
+
+bool server::keeps_uploads() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return keep_uploads_;
+}
+
+milliseconds server::reply_delay(const string & command) const
+{
+    lock_guard<mutex> lock(mutex_);
+
+    auto it = command_delays_.find(command);
+
+    return it == command_delays_.end() ? reply_delay_ : it->second;
+}
+
+optional<server::transfer_failure> server::take_failure()
+{
+    lock_guard<mutex> lock(mutex_);
+
+    if (failures_ == 0)
+    {
+        return std::nullopt;
+    }
+
+    failures_--;
+
+    return failure_;
+}
+
+} // namespace ftp::test
@@ -0,0 +1,185 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_TEST_SERVER_HPP
+#define FTP_TEST_SERVER_HPP
+
+#include <boost/asio/ip/tcp.hpp>
+#include <atomic>
+#include <chrono>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp::test
+{
+
+/* A minimal FTP server that runs in the test process and serves files from
+ * memory, so that transfers are limited by the client rather than the
+ * server. Each session runs on its own thread.
+ *
+ * Supported commands: USER, PASS, TYPE, EPSV, PASV, RETR, STOR, REST, APPE,
+ * LIST, MLSD, SIZE, CWD, CDUP, ABOR, NOOP, SYST, PWD and QUIT. There are no
+ * directories, "dir/file" is just a name, and LIST or MLSD of "dir" shows
+ * the files whose names start with "dir/". CWD to any directory succeeds
+ * and prefixes the names that follow. ASCII transfers are sent as is.
+ *
+ * https://tools.ietf.org/html/rfc959
+ * https://tools.ietf.org/html/rfc2428 (EPSV)
+ * https://tools.ietf.org/html/rfc3659 (REST, SIZE, MLSD)
+ */
+class server
+{
+public:
+    /* How a failing transfer fails. */
+    enum class failure
+    {
+        /* Closes the session, control connection included, like a broken
+         * link.
+         */
+        disconnect,
+
+        /* Stops sending or receiving data, without closing anything, until
+         * the client sends ABOR.
+         */
+        stall
+    };
+
+    /* Listens on 127.0.0.1, on an ephemeral port unless one is given. */
+    explicit server(std::uint16_t port = 0);
+
+    server(const server &) = delete;
+
+    server & operator=(const server &) = delete;
+
+    ~server();
+
+    std::uint16_t port() const;
+
+    /* The user that may log in, "user" with "password" by default. */
+    void set_credentials(const std::string & username, const std::string & password);
+
+    void add_file(const std::string & name, const std::string & content);
+
+    /* Filled with a repeated pattern that takes no memory, for transfers of
+     * any size.
+     */
+    void add_synthetic_file(const std::string & name, std::uint64_t size);
+
+    void remove_file(const std::string & name);
+
+    /* The content of a file that isn't synthetic. */
+    std::optional<std::string> file(const std::string & name) const;
+
+    std::optional<std::uint64_t> file_size(const std::string & name) const;
+
+    /* When off, uploads are read and dropped, and stored as synthetic files
+     * of the same size. On by default.
+     */
+    void set_keep_uploads(bool keep);
+
+    /* Delays every reply, the greeting included. */
+    void set_reply_delay(std::chrono::milliseconds delay);
+
+    /* Delays the replies to the command, e.g. "RETR", instead. */
+    void set_reply_delay(const std::string & command, std::chrono::milliseconds delay);
+
+    /* The next 'count' transfers of files fail after 'bytes' bytes of data.
+     * What an upload has sent by then is kept.
+     */
+    void fail_transfers(std::uint64_t bytes, unsigned int count = 1, failure how = failure::disconnect);
+
+    /* The number of sessions accepted so far. */
+    std::size_t session_count() const;
+
+    /* The number of sessions that haven't ended yet. */
+    std::size_t open_sessions();
+
+    /* Closes all sessions. Called by the destructor. */
+    void stop();
+
+private:
+    struct file_entry
+    {
+        /* nullptr for synthetic files. */
+        std::shared_ptr<const std::string> content;
+        std::uint64_t size;
+    };
+
+    class session;
+
+    void accept();
+
+    /* Joins the threads of the sessions that have ended. Called with the
+     * mutex held.
+     */
+    void reap();
+
+    std::optional<file_entry> find_file(const std::string & name) const;
+
+    /* The files whose names start with the prefix, without it. */
+    std::vector<std::pair<std::string, std::uint64_t>> list_files(const std::string & prefix) const;
+
+    bool is_valid_login(const std::string & username, const std::string & password) const;
+
+    bool keeps_uploads() const;
+
+    std::chrono::milliseconds reply_delay(const std::string & command) const;
+
+    struct transfer_failure
+    {
+        std::uint64_t bytes;
+        failure how;
+    };
+
+    /* Returns how the next transfer fails, if it does. */
+    std::optional<transfer_failure> take_failure();
+
+    mutable std::mutex mutex_;
+    boost::asio::io_context io_context_;
+    boost::asio::ip::tcp::acceptor acceptor_;
+    std::thread accept_thread_;
+    std::list<std::unique_ptr<session>> sessions_;
+    std::map<std::string, file_entry> files_;
+    std::string username_;
+    std::string password_;
+    bool keep_uploads_;
+    std::chrono::milliseconds reply_delay_;
+    std::map<std::string, std::chrono::milliseconds> command_delays_;
+    transfer_failure failure_;
+    unsigned int failures_;
+    std::atomic<std::size_t> session_count_;
+    std::atomic<bool> stopped_;
+};
+
+} // namespace ftp::test
+#endif //FTP_TEST_SERVER_HPP
@@ -0,0 +1,1324 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "simulated_network.hpp"
+#include <boost/asio/error.hpp>
+#include <algorithm>
+#include <cmath>
+#include <condition_variable>
+#include <cstring>
+#include <deque>
+#include <utility>
+
+namespace ftp::test
+{
+
+using std::string;
+using std::size_t;
+using std::uint16_t;
+using std::uint64_t;
+using std::optional;
+using std::shared_ptr;
+using std::make_shared;
+using std::mutex;
+using std::lock_guard;
+using std::chrono::microseconds;
+using std::chrono::nanoseconds;
+using std::chrono::steady_clock;
+using boost::system::error_code;
+
+/* TEST-NET-1, RFC 5737. */
+static const char *server_ip = "192.0.2.1";
+
+static const uint16_t first_passive_port = 1024;
+
+static const std::uint32_t mss = 1448;
+
+static const size_t pattern_size = 26 * 2520;
+
+/* The content of synthetic files, 'a' + offset % 26. */
+static const string & pattern()
+{
+    static const string pattern = []()
+    {
+        string pattern;
+        pattern.reserve(pattern_size);
+
+        for (size_t i = 0; i < pattern_size; i++)
+        {
+            pattern += static_cast<char>('a' + i % 26);
+        }
+
+        return pattern;
+    }();
+
+    return pattern;
+}
+
+/* The time 'bytes' take to pass a link of 'rate' bytes per second. */
+static nanoseconds transmission_time(uint64_t bytes, uint64_t rate)
+{
+    if (rate == 0)
+    {
+        return nanoseconds::zero();
+    }
+
+    return nanoseconds(static_cast<nanoseconds::rep>(static_cast<double>(bytes) * 1e9 / static_cast<double>(rate)));
+}
+
+/* Data on its way to the client. */
+struct simulated_network::segment
+{
+    /* When the first 'bytes' bytes have arrived. */
+    nanoseconds arrival(uint64_t bytes) const
+    {
+        return start + transmission_time(bytes, rate);
+    }
+
+    void copy(char *data, size_t size) const
+    {
+        uint64_t position = offset + consumed;
+
+        if (content)
+        {
+            std::memcpy(data, content->data() + position, size);
+            return;
+        }
+
+        for (size_t copied = 0; copied < size;)
+        {
+            size_t start = static_cast<size_t>((position + copied) % 26);
+            size_t length = std::min(size - copied, pattern_size - start);
+
+            std::memcpy(data + copied, pattern().data() + start, length);
+            copied += length;
+        }
+    }
+
+    nanoseconds start;
+    uint64_t rate;
+
+    /* nullptr for the pattern of synthetic files. */
+    shared_ptr<const string> content;
+    uint64_t offset;
+    uint64_t size;
+    uint64_t consumed;
+
+    /* The reply that completes a download, replaced if it's aborted. */
+    bool completion;
+};
+
+struct simulated_network::connection
+{
+    connection(bool control, uint64_t rate, bool window_limited, nanoseconds opened)
+        : control(control),
+          rate(rate),
+          window_limited(window_limited),
+          opened(opened),
+          thread(std::this_thread::get_id()),
+          arrived_until(0),
+          sending_until(opened),
+          send_closed(false),
+          closed(false)
+    {
+    }
+
+    bool control;
+    uint64_t rate;
+    bool window_limited;
+    nanoseconds opened;
+
+    /* The thread of the client that opened it. */
+    std::thread::id thread;
+
+    /* The session of a control connection lives as long as it does. */
+    shared_ptr<simulated_network::session> owner;
+    std::weak_ptr<simulated_network::session> session;
+
+    /* Toward the client, and when the end of data arrives. */
+    std::deque<segment> incoming;
+    optional<nanoseconds> end;
+
+    /* When the data read so far has arrived, over a shared link. */
+    nanoseconds arrived_until;
+
+    /* Toward the server. */
+    nanoseconds sending_until;
+    bool send_closed;
+    bool closed;
+    string line;
+};
+
+/* The server side of a session. Runs under the lock of the network, at the
+ * times the client's data arrives.
+ */
+/* The shared bandwidth, on a timeline per direction. The threads run at
+ * their own pace, so each piece of data is sent once the other threads with
+ * open connections have got as far in virtual time, and takes its fair
+ * share of what's left of the bandwidth from then on. A thread that hasn't
+ * used the network for a while in real time waits on something else, e.g.
+ * for the next job, and doesn't hold the others up. It comes back at their
+ * time.
+ */
+class simulated_network::shared_link
+{
+public:
+    shared_link(const simulated_network & network, uint64_t bandwidth)
+        : network_(network),
+          upstream_(bandwidth),
+          downstream_(bandwidth),
+          flows_(0)
+    {
+    }
+
+    void open(const connection & connection)
+    {
+        participants_[connection.thread].connections++;
+
+        /* Which way a data connection goes is only known once it's used,
+         * so both directions share among all of them.
+         */
+        if (!connection.control)
+        {
+            flows_++;
+        }
+    }
+
+    void close(const connection & connection)
+    {
+        auto it = participants_.find(connection.thread);
+
+        if (it != participants_.end() && --it->second.connections == 0)
+        {
+            participants_.erase(it);
+        }
+
+        if (!connection.control)
+        {
+            flows_--;
+        }
+
+        progress_.notify_all();
+    }
+
+    /* Called with the clock of the current thread whenever it uses the
+     * network, 'created' the first time.
+     */
+    void resume(nanoseconds & clock, bool created)
+    {
+        auto it = participants_.find(std::this_thread::get_id());
+        steady_clock::time_point now = steady_clock::now();
+
+        if (created || (it != participants_.end() && idle(it->second, now)))
+        {
+            clock = std::max(clock, frontier(now));
+        }
+
+        if (it != participants_.end())
+        {
+            it->second.last_seen = now;
+        }
+    }
+
+    nanoseconds upload(std::unique_lock<mutex> & lock, const connection & flow,
+                       nanoseconds start, uint64_t bytes, uint64_t rate)
+    {
+        return send(lock, upstream_, flow, start, bytes, rate);
+    }
+
+    nanoseconds download(std::unique_lock<mutex> & lock, const connection & flow,
+                         nanoseconds start, uint64_t bytes, uint64_t rate)
+    {
+        return send(lock, downstream_, flow, start, bytes, rate);
+    }
+
+private:
+    /* The bandwidth in use over time. */
+    class timeline
+    {
+    public:
+        explicit timeline(uint64_t bandwidth)
+            : bandwidth_(bandwidth)
+        {
+        }
+
+        /* Sends 'bytes' from 'start' on, at most at 'rate', and returns
+         * when the last byte has passed.
+         */
+        nanoseconds send(nanoseconds start, uint64_t bytes, uint64_t rate)
+        {
+            double remaining = static_cast<double>(bytes);
+            auto it = split(start);
+            nanoseconds end = start;
+
+            while (remaining > 0)
+            {
+                auto next = std::next(it);
+                uint64_t taken = std::min(rate, bandwidth_ - std::min(it->second, bandwidth_));
+
+                if (taken > 0)
+                {
+                    nanoseconds needed(static_cast<nanoseconds::rep>(
+                            std::ceil(remaining * 1e9 / static_cast<double>(taken))));
+
+                    /* The last time in use is followed by the idle link. */
+                    if (next == used_.end() || it->first + needed <= next->first)
+                    {
+                        end = it->first + needed;
+                        split(end);
+                        it->second += taken;
+                        break;
+                    }
+
+                    remaining -= static_cast<double>(taken) *
+                                 static_cast<double>((next->first - it->first).count()) / 1e9;
+                    it->second += taken;
+                }
+
+                it = next;
+                end = it->first;
+            }
+
+            merge(start, end);
+
+            return end;
+        }
+
+        uint64_t bandwidth() const
+        {
+            return bandwidth_;
+        }
+
+    private:
+        /* Makes 'time' the start of an interval of the same use. */
+        std::map<nanoseconds, uint64_t>::iterator split(nanoseconds time)
+        {
+            auto it = used_.upper_bound(time);
+            uint64_t used = it == used_.begin() ? 0 : std::prev(it)->second;
+
+            return used_.emplace(time, used).first;
+        }
+
+        /* Joins the neighbouring intervals of the same use around [from, to]. */
+        void merge(nanoseconds from, nanoseconds to)
+        {
+            auto it = used_.lower_bound(from);
+
+            if (it != used_.begin())
+            {
+                --it;
+            }
+
+            while (it != used_.end() && it->first <= to)
+            {
+                auto next = std::next(it);
+
+                if (next != used_.end() && next->second == it->second)
+                {
+                    used_.erase(next);
+                }
+                else
+                {
+                    it = next;
+                }
+            }
+        }
+
+        uint64_t bandwidth_;
+
+        /* The bandwidth in use from each time on, until the next one. */
+        std::map<nanoseconds, uint64_t> used_;
+    };
+
+    struct participant
+    {
+        std::size_t connections = 0;
+        steady_clock::time_point last_seen = steady_clock::now();
+
+        /* Where it waits to send from. */
+        nanoseconds waiting_from = nanoseconds::zero();
+    };
+
+    static constexpr std::chrono::milliseconds idle_after{50};
+
+    static bool idle(const participant & participant, steady_clock::time_point now)
+    {
+        return now - participant.last_seen > idle_after;
+    }
+
+    nanoseconds time(const std::pair<const std::thread::id, participant> & participant) const
+    {
+        auto it = network_.clocks_.find(participant.first);
+        nanoseconds clock = it == network_.clocks_.end() ? nanoseconds::zero() : it->second;
+
+        return std::max(clock, participant.second.waiting_from);
+    }
+
+    /* The time of the slowest busy thread, or of the fastest one if none
+     * is busy.
+     */
+    nanoseconds frontier(steady_clock::time_point now) const
+    {
+        optional<nanoseconds> slowest;
+
+        for (const auto & participant : participants_)
+        {
+            if (participant.first != std::this_thread::get_id() && !idle(participant.second, now))
+            {
+                slowest = std::min(slowest.value_or(nanoseconds::max()), time(participant));
+            }
+        }
+
+        if (slowest)
+        {
+            return *slowest;
+        }
+
+        nanoseconds fastest = nanoseconds::zero();
+
+        for (const auto & [thread, clock] : network_.clocks_)
+        {
+            fastest = std::max(fastest, clock);
+        }
+
+        return fastest;
+    }
+
+    /* 'rate' 0 means the connection has no limit of its own. */
+    nanoseconds send(std::unique_lock<mutex> & lock, timeline & direction, const connection & flow,
+                     nanoseconds start, uint64_t bytes, uint64_t rate)
+    {
+        participant & self = participants_[flow.thread];
+        self.waiting_from = start;
+        progress_.notify_all();
+
+        for (;;)
+        {
+            steady_clock::time_point now = steady_clock::now();
+            bool behind = false;
+
+            self.last_seen = now;
+
+            for (const auto & participant : participants_)
+            {
+                if (participant.first != flow.thread && !idle(participant.second, now) && time(participant) < start)
+                {
+                    behind = true;
+                    break;
+                }
+            }
+
+            if (!behind)
+            {
+                break;
+            }
+
+            /* Often enough not to look idle itself. */
+            progress_.wait_for(lock, idle_after / 2);
+        }
+
+        uint64_t share = std::max<uint64_t>(direction.bandwidth() / std::max<std::size_t>(flows_, 1), 1);
+
+        return direction.send(start, bytes, rate > 0 ? std::min(rate, share) : share);
+    }
+
+    const simulated_network & network_;
+    timeline upstream_;
+    timeline downstream_;
+
+    /* The threads with open connections, and how many are data ones. */
+    std::map<std::thread::id, participant> participants_;
+    std::size_t flows_;
+    std::condition_variable progress_;
+};
+
+class simulated_network::session : public std::enable_shared_from_this<session>
+{
+public:
+    session(simulated_network & network, connection & control)
+        : network_(network),
+          control_(control),
+          logged_in_(false),
+          offset_(0),
+          aborted_(false),
+          counted_(false),
+          busy_until_(0)
+    {
+    }
+
+    /* 'accepted' is when the server accepted the connection. */
+    void greet(nanoseconds accepted, bool refused)
+    {
+        nanoseconds time = reply_time("", accepted);
+
+        if (refused)
+        {
+            control_.end = reply("421 Too many sessions.", time);
+            return;
+        }
+
+        counted_ = true;
+        reply("220 FTP server is ready.", time);
+    }
+
+    /* Ends the session, the client has closed the control connection. */
+    void close()
+    {
+        if (counted_)
+        {
+            counted_ = false;
+            network_.open_sessions_--;
+        }
+
+        if (passive_port_)
+        {
+            network_.passive_ports_.erase(*passive_port_);
+        }
+    }
+
+    void receive_command(const char *data, size_t size, nanoseconds arrival)
+    {
+        control_.line.append(data, size);
+
+        for (size_t end = control_.line.find("\r\n"); end != string::npos; end = control_.line.find("\r\n"))
+        {
+            string line = control_.line.substr(0, end);
+            control_.line.erase(0, end + 2);
+
+            size_t space = line.find(' ');
+            string verb = line.substr(0, space);
+            string argument = space == string::npos ? string() : line.substr(space + 1);
+
+            handle(verb, argument, arrival);
+        }
+    }
+
+    void accept(const shared_ptr<connection> & data)
+    {
+        passive_port_.reset();
+        data_ = data;
+    }
+
+    void receive_data(connection & data, const char *bytes, size_t size)
+    {
+        if (!transfer_ || !transfer_->upload || transfer_->data != &data)
+        {
+            return;
+        }
+
+        if (transfer_->keep)
+        {
+            transfer_->content.append(bytes, size);
+        }
+
+        transfer_->size += size;
+    }
+
+    /* The client has sent the end of an upload. */
+    void end_of_data(connection & data, nanoseconds arrival)
+    {
+        if (transfer_ && transfer_->upload && transfer_->data == &data)
+        {
+            nanoseconds time = finish_upload(true, arrival);
+
+            /* The server closes its side as well. */
+            data.end = time + network_.link_.latency;
+        }
+    }
+
+    /* Before the end of a transfer, the client aborts it. */
+    void data_closed(connection & data, nanoseconds arrival)
+    {
+        if (data_.get() == &data)
+        {
+            data_.reset();
+        }
+
+        if (!transfer_ || transfer_->data != &data)
+        {
+            return;
+        }
+
+        if (transfer_->upload)
+        {
+            finish_upload(false, arrival);
+            return;
+        }
+
+        if (arrival < transfer_->end)
+        {
+            for (auto it = control_.incoming.rbegin(); it != control_.incoming.rend(); ++it)
+            {
+                if (it->completion && it->consumed == 0)
+                {
+                    auto content = make_shared<const string>("426 Connection closed; transfer aborted.\r\n");
+
+                    it->content = content;
+                    it->size = content->size();
+                    it->start = arrival + network_.link_.latency;
+                    it->completion = false;
+                    break;
+                }
+            }
+
+            busy_until_ = arrival;
+            aborted_ = true;
+        }
+
+        transfer_.reset();
+    }
+
+private:
+    struct transfer
+    {
+        connection *data;
+        bool upload;
+
+        /* When the server has sent the last byte of a download. */
+        nanoseconds end;
+
+        string name;
+        string content;
+        uint64_t size;
+        bool keep;
+    };
+
+    void handle(const string & verb, const string & argument, nanoseconds arrival)
+    {
+        if (verb == "QUIT")
+        {
+            control_.end = reply("221 Goodbye.", reply_time(verb, arrival));
+        }
+        else if (verb == "NOOP")
+        {
+            reply("200 NOOP command successful.", reply_time(verb, arrival));
+        }
+        else if (verb == "SYST")
+        {
+            reply("215 UNIX Type: L8", reply_time(verb, arrival));
+        }
+        else if (verb == "USER")
+        {
+            logged_in_ = false;
+            username_ = argument;
+            reply("331 Username ok, send password.", reply_time(verb, arrival));
+        }
+        else if (verb == "PASS")
+        {
+            logged_in_ = username_ == network_.username_ && argument == network_.password_;
+            reply(logged_in_ ? "230 Login successful." : "530 Authentication failed.", reply_time(verb, arrival));
+        }
+        else if (verb == "ABOR")
+        {
+            reply(aborted_ ? "226 ABOR command successful." : "225 No transfer to abort.", reply_time(verb, arrival));
+            aborted_ = false;
+        }
+        else if (!logged_in_)
+        {
+            reply("530 Log in with USER and PASS first.", reply_time(verb, arrival));
+        }
+        else if (verb == "PWD")
+        {
+            reply("257 \"/\" is the current directory.", reply_time(verb, arrival));
+        }
+        else if (verb == "TYPE")
+        {
+            if (argument == "A" || argument == "I" || argument == "L 8")
+            {
+                reply("200 Type set to " + argument + ".", reply_time(verb, arrival));
+            }
+            else
+            {
+                reply("504 Unsupported type '" + argument + "'.", reply_time(verb, arrival));
+            }
+        }
+        else if (verb == "EPSV" || verb == "PASV")
+        {
+            passive(verb, arrival);
+        }
+        else if (verb == "REST")
+        {
+            try
+            {
+                offset_ = std::stoull(argument);
+                reply("350 Restarting at position " + argument + ".", reply_time(verb, arrival));
+            }
+            catch (const std::exception &)
+            {
+                reply("501 Invalid REST parameter.", reply_time(verb, arrival));
+            }
+        }
+        else if (verb == "SIZE")
+        {
+            optional<file_entry> file = network_.find_file(argument);
+
+            reply(file ? "213 " + std::to_string(file->size) : "550 No such file.", reply_time(verb, arrival));
+        }
+        else if (verb == "RETR")
+        {
+            retr(verb, argument, arrival);
+        }
+        else if (verb == "STOR" || verb == "APPE")
+        {
+            stor(verb, argument, arrival);
+        }
+        else if (verb == "LIST")
+        {
+            list(verb, argument, arrival);
+        }
+        else
+        {
+            reply("502 Command not implemented.", reply_time(verb, arrival));
+        }
+    }
+
+    void passive(const string & verb, nanoseconds arrival)
+    {
+        if (passive_port_)
+        {
+            network_.passive_ports_.erase(*passive_port_);
+        }
+
+        uint16_t port = network_.next_port_;
+
+        while (network_.passive_ports_.count(port) > 0)
+        {
+            port = port == 65535 ? first_passive_port : port + 1;
+        }
+
+        network_.next_port_ = port == 65535 ? first_passive_port : port + 1;
+        network_.passive_ports_[port] = weak_from_this();
+        passive_port_ = port;
+        data_.reset();
+
+        if (verb == "EPSV")
+        {
+            reply("229 Entering extended passive mode (|||" + std::to_string(port) + "|).", reply_time(verb, arrival));
+        }
+        else
+        {
+            reply("227 Entering passive mode (192,0,2,1," + std::to_string(port / 256) + "," +
+                  std::to_string(port % 256) + ").", reply_time(verb, arrival));
+        }
+    }
+
+    void retr(const string & verb, const string & name, nanoseconds arrival)
+    {
+        optional<file_entry> file = network_.find_file(name);
+        uint64_t offset = std::exchange(offset_, 0);
+
+        if (!file)
+        {
+            reply("550 No such file.", reply_time(verb, arrival));
+            return;
+        }
+
+        offset = std::min(offset, file->size);
+
+        send(verb, name, "150 Opening data connection for " + name + " (" + std::to_string(file->size) + " bytes).",
+             file->content, offset, file->size - offset, arrival);
+    }
+
+    void list(const string & verb, const string & directory, nanoseconds arrival)
+    {
+        string prefix = directory.empty() || directory == "/" ? string() : directory + "/";
+        auto listing = make_shared<string>();
+
+        for (auto it = network_.files_.lower_bound(prefix);
+             it != network_.files_.end() && it->first.compare(0, prefix.size(), prefix) == 0; ++it)
+        {
+            *listing += "-rw-r--r-- 1 user user " + std::to_string(it->second.size) + " Jan 01 00:00 " +
+                        it->first.substr(prefix.size()) + "\r\n";
+        }
+
+        send(verb, directory, "150 Opening data connection for the listing.", listing, 0, listing->size(), arrival);
+    }
+
+    /* Starts a download, which the client may abort until the server has
+     * sent it all.
+     */
+    void send(const string & verb,
+              const string & name,
+              const string & preliminary_reply,
+              const shared_ptr<const string> & content,
+              uint64_t offset,
+              uint64_t size,
+              nanoseconds arrival)
+    {
+        if (!data_)
+        {
+            reply("425 Use PASV or EPSV first.", reply_time(verb, arrival));
+            return;
+        }
+
+        nanoseconds time = reply_time(verb, arrival);
+        nanoseconds end = time + transmission_time(size, data_->rate);
+
+        reply(preliminary_reply, time);
+
+        data_->incoming.push_back(segment{time + network_.link_.latency, data_->rate, content, offset, size, 0, false});
+        data_->end = end + network_.link_.latency;
+
+        busy_until_ = end;
+        reply("226 Transfer complete.", end, true);
+
+        transfer_ = transfer{data_.get(), false, end, name, string(), 0, false};
+        data_.reset();
+    }
+
+    void stor(const string & verb, const string & name, nanoseconds arrival)
+    {
+        uint64_t offset = std::exchange(offset_, 0);
+        optional<file_entry> existing = network_.find_file(name);
+        bool keep = network_.keep_uploads_;
+
+        if (!data_)
+        {
+            reply("425 Use PASV or EPSV first.", reply_time(verb, arrival));
+            return;
+        }
+
+        transfer upload{data_.get(), true, nanoseconds::zero(), name, string(), 0, keep};
+
+        if (existing)
+        {
+            upload.size = verb == "APPE" ? existing->size : std::min(offset, existing->size);
+
+            if (keep)
+            {
+                upload.content = contents(*existing, upload.size);
+            }
+        }
+
+        reply("150 Opening data connection for " + name + ".", reply_time(verb, arrival));
+
+        transfer_ = std::move(upload);
+        data_.reset();
+    }
+
+    /* Like most servers, keep what was received, even if incomplete. */
+    nanoseconds finish_upload(bool completed, nanoseconds arrival)
+    {
+        nanoseconds time = std::max(arrival, busy_until_);
+        busy_until_ = time;
+
+        file_entry file{nullptr, transfer_->size};
+
+        if (transfer_->keep)
+        {
+            file.content = make_shared<const string>(std::move(transfer_->content));
+        }
+
+        network_.files_[transfer_->name] = file;
+        transfer_.reset();
+
+        if (completed)
+        {
+            reply("226 Transfer complete.", time);
+        }
+        else
+        {
+            aborted_ = true;
+            reply("426 Connection closed; transfer aborted.", time);
+        }
+
+        return time;
+    }
+
+    /* Replies are sent one after another, each after thinking. */
+    nanoseconds reply_time(const string & verb, nanoseconds arrival)
+    {
+        microseconds think_time = network_.link_.think_time;
+        auto it = network_.think_times_.find(verb);
+
+        if (it != network_.think_times_.end())
+        {
+            think_time += it->second;
+        }
+
+        busy_until_ = std::max(arrival, busy_until_) + think_time;
+
+        return busy_until_;
+    }
+
+    /* Sends the reply at 'time', and returns when it has arrived. */
+    nanoseconds reply(const string & text, nanoseconds time, bool completion = false)
+    {
+        auto content = make_shared<const string>(text + "\r\n");
+
+        segment reply{time + network_.link_.latency, control_.rate, content, 0, content->size(), 0, completion};
+        control_.incoming.push_back(reply);
+
+        return reply.arrival(reply.size);
+    }
+
+    static string contents(const file_entry & file, uint64_t size)
+    {
+        string content(static_cast<size_t>(size), '\0');
+        segment all{nanoseconds::zero(), 0, file.content, 0, size, 0, false};
+
+        all.copy(content.data(), content.size());
+
+        return content;
+    }
+
+    simulated_network & network_;
+    connection & control_;
+    shared_ptr<connection> data_;
+    optional<uint16_t> passive_port_;
+    optional<transfer> transfer_;
+    string username_;
+    bool logged_in_;
+    uint64_t offset_;
+    bool aborted_;
+    bool counted_;
+    nanoseconds busy_until_;
+};
+
+/* The client end of a connection. */
+class simulated_network::stream : public transport_stream
+{
+public:
+    stream(simulated_network & network, const shared_ptr<connection> & connection)
+        : network_(network),
+          connection_(connection)
+    {
+    }
+
+    ~stream() override
+    {
+        close(false);
+    }
+
+    size_t read_some(char *data, size_t size, error_code & ec) override
+    {
+        std::unique_lock<mutex> lock(network_.mutex_);
+
+        nanoseconds & now = network_.clock();
+        std::deque<segment> & incoming = connection_->incoming;
+
+        while (!incoming.empty() && incoming.front().consumed == incoming.front().size)
+        {
+            incoming.pop_front();
+        }
+
+        if (incoming.empty())
+        {
+            if (connection_->end)
+            {
+                now = std::max(now, *connection_->end);
+                ec = boost::asio::error::eof;
+            }
+            else
+            {
+                ec = boost::asio::error::timed_out;
+            }
+
+            return 0;
+        }
+
+        segment & segment = incoming.front();
+        size_t len = static_cast<size_t>(std::min<uint64_t>(size, segment.size - segment.consumed));
+
+        segment.copy(data, len);
+        segment.consumed += len;
+
+        if (!connection_->control && network_.shared_link_)
+        {
+            nanoseconds start = std::max(segment.start, connection_->arrived_until);
+
+            connection_->arrived_until = network_.shared_link_->download(lock, *connection_, start, len, segment.rate);
+            now = std::max(now, connection_->arrived_until);
+        }
+        else
+        {
+            now = std::max(now, segment.arrival(segment.consumed));
+        }
+
+        ec.clear();
+
+        return len;
+    }
+
+    /* The sender waits until the data is on the link. */
+    size_t write_some(const char *data, size_t size, error_code & ec) override
+    {
+        std::unique_lock<mutex> lock(network_.mutex_);
+
+        shared_ptr<session> session = connection_->session.lock();
+
+        if (connection_->send_closed || connection_->closed || !session)
+        {
+            ec = boost::asio::error::broken_pipe;
+            return 0;
+        }
+
+        nanoseconds & now = network_.clock();
+
+        if (!connection_->control && network_.shared_link_)
+        {
+            now = network_.shared_link_->upload(lock, *connection_, std::max(now, connection_->sending_until),
+                                                size, connection_->rate);
+        }
+        else
+        {
+            now = std::max(now, connection_->sending_until) + transmission_time(size, connection_->rate);
+        }
+
+        connection_->sending_until = now;
+
+        if (connection_->control)
+        {
+            session->receive_command(data, size, now + network_.link_.latency);
+        }
+        else
+        {
+            session->receive_data(*connection_, data, size);
+        }
+
+        ec.clear();
+
+        return size;
+    }
+
+    void shutdown_send(error_code & ec) override
+    {
+        lock_guard<mutex> lock(network_.mutex_);
+
+        ec.clear();
+
+        if (connection_->send_closed || connection_->closed)
+        {
+            return;
+        }
+
+        connection_->send_closed = true;
+
+        nanoseconds arrival = std::max(network_.clock(), connection_->sending_until) + network_.link_.latency;
+
+        if (shared_ptr<session> session = connection_->session.lock(); session && !connection_->control)
+        {
+            session->end_of_data(*connection_, arrival);
+        }
+    }
+
+    void close(bool /* reset */) override
+    {
+        lock_guard<mutex> lock(network_.mutex_);
+
+        if (connection_->closed)
+        {
+            return;
+        }
+
+        connection_->closed = true;
+
+        if (network_.shared_link_)
+        {
+            network_.shared_link_->close(*connection_);
+        }
+
+        nanoseconds arrival = network_.clock() + network_.link_.latency;
+
+        if (shared_ptr<session> session = connection_->session.lock())
+        {
+            if (connection_->control)
+            {
+                session->close();
+            }
+            else
+            {
+                session->data_closed(*connection_, arrival);
+            }
+        }
+
+        connection_->owner.reset();
+    }
+
+    std::string remote_ip() const override
+    {
+        return server_ip;
+    }
+
+    bool sample(tcp_sample & sample) const override
+    {
+        lock_guard<mutex> lock(network_.mutex_);
+
+        microseconds rtt = 2 * network_.link_.latency;
+        microseconds elapsed = std::chrono::duration_cast<microseconds>(network_.clock() - connection_->opened);
+
+        sample = tcp_sample();
+        sample.elapsed = elapsed;
+        sample.rtt = rtt;
+        sample.receive_rtt = rtt;
+        sample.mss = mss;
+        sample.delivery_rate = connection_->rate;
+        sample.congestion_window = static_cast<std::uint32_t>(
+            std::chrono::duration<double>(rtt).count() * static_cast<double>(connection_->rate) / mss);
+        sample.busy_time = elapsed;
+        sample.rwnd_limited = connection_->window_limited ? elapsed : microseconds::zero();
+
+        return true;
+    }
+
+private:
+    simulated_network & network_;
+    shared_ptr<connection> connection_;
+};
+
+simulated_network::simulated_network(const struct link & link)
+    : link_(link),
+      username_("user"),
+      password_("password"),
+      keep_uploads_(true),
+      max_sessions_(0),
+      open_sessions_(0),
+      sessions_(0),
+      next_port_(first_passive_port)
+{
+    if (link.shared_bandwidth > 0)
+    {
+        shared_link_ = std::make_unique<shared_link>(*this, link.shared_bandwidth);
+    }
+}
+
+simulated_network::~simulated_network() = default;
+
+std::unique_ptr<transport_stream> simulated_network::connect(const string & /* hostname */,
+                                                             uint16_t port,
+                                                             size_t socket_buffer_size,
+                                                             error_code & ec)
+{
+    lock_guard<mutex> lock(mutex_);
+
+    nanoseconds & now = clock();
+
+    /* SYN, SYN-ACK. */
+    now += 2 * link_.latency;
+
+    auto it = passive_ports_.find(port);
+
+    if (it != passive_ports_.end())
+    {
+        shared_ptr<session> session = it->second.lock();
+        passive_ports_.erase(it);
+
+        if (!session)
+        {
+            ec = boost::asio::error::connection_refused;
+            return nullptr;
+        }
+
+        bool window_limited;
+        uint64_t data_rate = rate(socket_buffer_size > 0 ? socket_buffer_size : link_.window, window_limited);
+
+        auto data = make_shared<connection>(false, data_rate, window_limited, now);
+        data->session = session;
+        session->accept(data);
+
+        if (shared_link_)
+        {
+            shared_link_->open(*data);
+        }
+
+        ec.clear();
+        return std::make_unique<stream>(*this, data);
+    }
+
+    bool window_limited;
+    uint64_t control_rate = rate(link_.window, window_limited);
+
+    auto control = make_shared<connection>(true, control_rate, window_limited, now);
+    auto session = make_shared<simulated_network::session>(*this, *control);
+
+    control->owner = session;
+    control->session = session;
+
+    bool refused = max_sessions_ > 0 && open_sessions_ >= max_sessions_;
+
+    if (!refused)
+    {
+        open_sessions_++;
+    }
+
+    sessions_++;
+    session->greet(now - link_.latency, refused);
+
+    if (shared_link_)
+    {
+        shared_link_->open(*control);
+    }
+
+    ec.clear();
+    return std::make_unique<stream>(*this, control);
+}
+
+void simulated_network::set_credentials(const string & username, const string & password)
+{
+    lock_guard<mutex> lock(mutex_);
+    username_ = username;
+    password_ = password;
+}
+
+void simulated_network::add_file(const string & name, const string & content)
+{
+    lock_guard<mutex> lock(mutex_);
+    files_[name] = file_entry{make_shared<const string>(content), content.size()};
+}
+
+void simulated_network::add_synthetic_file(const string & name, uint64_t size)
+{
+    lock_guard<mutex> lock(mutex_);
+    files_[name] = file_entry{nullptr, size};
+}
+
+void simulated_network::remove_file(const string & name)
+{
+    lock_guard<mutex> lock(mutex_);
+    files_.erase(name);
+}
+
+optional<string> simulated_network::file(const string & name) const
+{
+    lock_guard<mutex> lock(mutex_);
+    optional<file_entry> file = find_file(name);
+
+    if (!file || !file->content)
+    {
+        return std::nullopt;
+    }
+
+    return *file->content;
+}
+
+optional<uint64_t> simulated_network::file_size(const string & name) const
+{
+    lock_guard<mutex> lock(mutex_);
+    optional<file_entry> file = find_file(name);
+
+    if (!file)
+    {
+        return std::nullopt;
+    }
+
+    return file->size;
+}
+
+void simulated_network::set_keep_uploads(bool keep)
+{
+    lock_guard<mutex> lock(mutex_);
+    keep_uploads_ = keep;
+}
+
+void simulated_network::set_max_sessions(size_t sessions)
+{
+    lock_guard<mutex> lock(mutex_);
+    max_sessions_ = sessions;
+}
+
+void simulated_network::set_think_time(const string & command, microseconds time)
+{
+    lock_guard<mutex> lock(mutex_);
+    think_times_[command] = time;
+}
+
+nanoseconds simulated_network::now() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return clock();
+}
+
+void simulated_network::advance(nanoseconds duration)
+{
+    lock_guard<mutex> lock(mutex_);
+    clock() += duration;
+}
+
+nanoseconds simulated_network::elapsed() const
+{
+    lock_guard<mutex> lock(mutex_);
+    nanoseconds elapsed = nanoseconds::zero();
+
+    for (const auto & [thread, time] : clocks_)
+    {
+        elapsed = std::max(elapsed, time);
+    }
+
+    return elapsed;
+}
+
+uint64_t simulated_network::sessions() const
+{
+    lock_guard<mutex> lock(mutex_);
+    return sessions_;
+}
+
+nanoseconds & simulated_network::clock() const
+{
+    auto [it, created] = clocks_.try_emplace(std::this_thread::get_id(), nanoseconds::zero());
+
+    /* The threads share the timeline of the shared link. */
+    if (shared_link_)
+    {
+        shared_link_->resume(it->second, created);
+    }
+
+    return it->second;
+}
+
+/* TCP sends at most a window per round trip. */
+uint64_t simulated_network::rate(size_t window, bool & window_limited) const
+{
+    nanoseconds rtt = 2 * link_.latency;
+    uint64_t rate = link_.bandwidth;
+
+    window_limited = false;
+
+    if (window > 0 && rtt > nanoseconds::zero())
+    {
+        auto window_rate = static_cast<uint64_t>(static_cast<double>(window) * 1e9 / static_cast<double>(rtt.count()));
+
+        if (rate == 0 || window_rate < rate)
+        {
+            rate = window_rate;
+            window_limited = true;
+        }
+    }
+
+    return rate;
+}
+
+optional<simulated_network::file_entry> simulated_network::find_file(const string & name) const
+{
+    auto it = files_.find(name);
+
+    if (it == files_.end())
+    {
+        return std::nullopt;
+    }
+
+    return it->second;
+}
+
+} // namespace ftp::test
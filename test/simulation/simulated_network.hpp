@@ -0,0 +1,211 @@
+/*
+ * MIT License
+ *
+ * Copyright (c) 2020 Denis Kovalchuk
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef FTP_SIMULATED_NETWORK_HPP
+#define FTP_SIMULATED_NETWORK_HPP
+
+#include "ftp/transport.hpp"
+#include <chrono>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <cstddef>
+#include <cstdint>
+
+namespace ftp::test
+{
+
+/* A network with an FTP server behind it, all in memory, for clients that
+ * use it as their transport. Nothing waits in real time: a session costs
+ * what its commands and data cost to process, so long transfers and many
+ * sessions run in milliseconds.
+ *
+ * Time is virtual. Each thread has its own clock, which moves forward when
+ * the thread waits for the network, or by advance(). A thread models one
+ * actor, e.g. a worker of a transfer_scheduler, and the threads run at the
+ * same time in virtual time. The clocks only depend on what each thread
+ * does, not on how the threads are scheduled, so the results are the same
+ * on every run. Threads only meet through the files of the server.
+ *
+ * Each direction of each connection has the latency and the bandwidth of
+ * the link, limited further by the window over the round trip time. The
+ * server thinks for a while before each reply. Reads that nothing could
+ * ever satisfy fail with 'timed_out' at once, instead of waiting for the
+ * timeouts.
+ *
+ * With a shared bandwidth, the data connections of all threads meet on a
+ * bottleneck as well, on a timeline common to all clocks. The open data
+ * connections share it fairly, as TCP flows roughly do, and no more than
+ * the shared bandwidth ever passes. A thread sends once the other threads
+ * with open connections have got as far, unless they haven't used the
+ * network for a while in real time, e.g. a scheduler's worker waiting for
+ * jobs. Such a thread, and one that first uses the network, starts at the
+ * time of the others. Which threads wait depends on their pace, so the
+ * clocks may vary a little between runs.
+ *
+ * The server takes sessions on every port, and serves the commands of
+ * ftp::test::server: USER, PASS, TYPE, EPSV, PASV, RETR, STOR, REST, APPE,
+ * LIST, SIZE, ABOR, NOOP, SYST, PWD and QUIT. It's reached at 192.0.2.1.
+ *
+ * Create it with std::make_shared, the clients keep it alive.
+ */
+class simulated_network : public transport
+{
+public:
+    struct link
+    {
+        link()
+            : latency(0),
+              bandwidth(0),
+              shared_bandwidth(0),
+              window(0),
+              think_time(0)
+        {
+        }
+
+        /* One way. */
+        std::chrono::microseconds latency;
+
+        /* Bytes per second, 0 means unlimited. */
+        std::uint64_t bandwidth;
+
+        /* Bytes per second in each direction, shared by the data
+         * connections of all sessions. 0 means unlimited.
+         */
+        std::uint64_t shared_bandwidth;
+
+        /* The receive window of data connections without a socket buffer
+         * size, 0 means unlimited.
+         */
+        std::size_t window;
+
+        /* Before every reply of the server, the greeting included. */
+        std::chrono::microseconds think_time;
+    };
+
+    explicit simulated_network(const link & link = simulated_network::link());
+
+    simulated_network(const simulated_network &) = delete;
+
+    simulated_network & operator=(const simulated_network &) = delete;
+
+    ~simulated_network() override;
+
+    std::unique_ptr<transport_stream> connect(const std::string & hostname,
+                                              std::uint16_t port,
+                                              std::size_t socket_buffer_size,
+                                              boost::system::error_code & ec) override;
+
+    /* The user that may log in, "user" with "password" by default. */
+    void set_credentials(const std::string & username, const std::string & password);
+
+    void add_file(const std::string & name, const std::string & content);
+
+    /* Filled with a repeated pattern that takes no memory. */
+    void add_synthetic_file(const std::string & name, std::uint64_t size);
+
+    void remove_file(const std::string & name);
+
+    /* The content of a file that isn't synthetic. */
+    std::optional<std::string> file(const std::string & name) const;
+
+    std::optional<std::uint64_t> file_size(const std::string & name) const;
+
+    /* When off, uploads are dropped and stored as synthetic files of the
+     * same size. On by default.
+     */
+    void set_keep_uploads(bool keep);
+
+    /* Sessions beyond the limit are greeted with 421. 0 means unlimited,
+     * the default.
+     */
+    void set_max_sessions(std::size_t sessions);
+
+    /* Added to the think time of the link before replies to the command,
+     * e.g. "RETR".
+     */
+    void set_think_time(const std::string & command, std::chrono::microseconds time);
+
+    /* The clock of the calling thread. */
+    std::chrono::nanoseconds now() const;
+
+    /* Moves the clock of the calling thread forward, e.g. for the work the
+     * thread does between commands.
+     */
+    void advance(std::chrono::nanoseconds duration);
+
+    /* The latest clock of all threads, the time everything took. */
+    std::chrono::nanoseconds elapsed() const;
+
+    /* The sessions accepted so far. */
+    std::uint64_t sessions() const;
+
+private:
+    struct file_entry
+    {
+        /* nullptr for synthetic files. */
+        std::shared_ptr<const std::string> content;
+        std::uint64_t size;
+    };
+
+    struct segment;
+
+    struct connection;
+
+    class session;
+
+    class shared_link;
+
+    class stream;
+
+    std::chrono::nanoseconds & clock() const;
+
+    /* The rate of a data connection with the window. */
+    std::uint64_t rate(std::size_t window, bool & window_limited) const;
+
+    std::optional<file_entry> find_file(const std::string & name) const;
+
+    link link_;
+
+    /* nullptr without a shared bandwidth. */
+    std::unique_ptr<shared_link> shared_link_;
+    mutable std::mutex mutex_;
+    mutable std::map<std::thread::id, std::chrono::nanoseconds> clocks_;
+    std::map<std::string, file_entry> files_;
+    std::map<std::uint16_t, std::weak_ptr<session>> passive_ports_;
+    std::map<std::string, std::chrono::microseconds> think_times_;
+    std::string username_;
+    std::string password_;
+    bool keep_uploads_;
+    std::size_t max_sessions_;
+    std::size_t open_sessions_;
+    std::uint64_t sessions_;
+    std::uint16_t next_port_;
+};
+
+} // namespace ftp::test
+#endif //FTP_SIMULATED_NETWORK_HPP